@@ -9,8 +9,8 @@
 #include <vm/lit_chunk.h>
 
 typedef struct LitParameter {
-	const char* name;
-	const char* type;
+	LitString* name;
+	LitString* type;
 } LitParameter;
 
 DECLARE_ARRAY(LitParameters, LitParameter, parameters)
@@ -76,10 +76,10 @@ LitGroupingExpression* lit_make_grouping_expression(LitCompiler* compiler, uint6
 
 typedef struct {
 	LitExpression expression;
-	const char* name;
+	LitString* name;
 } LitVarExpression;
 
-LitVarExpression* lit_make_var_expression(LitCompiler* compiler, uint64_t line, const char* name);
+LitVarExpression* lit_make_var_expression(LitCompiler* compiler, uint64_t line, LitString* name);
 
 typedef struct {
 	LitExpression expression;
@@ -103,6 +103,7 @@ typedef struct {
 
 	LitExpression* callee;
 	LitExpressions* args;
+	struct LitStatement* target; // Function or method, that is always called, set by the resolver
 } LitCallExpression;
 
 LitCallExpression* lit_make_call_expression(LitCompiler* compiler, uint64_t line, LitExpression* callee, LitExpressions* args);
@@ -112,10 +113,10 @@ typedef struct {
 
 	LitExpression* object;
 	bool emit_static_init;
-	const char* property;
+	LitString* property;
 } LitGetExpression;
 
-LitGetExpression* lit_make_get_expression(LitCompiler* compiler, uint64_t line, LitExpression* object, const char* property);
+LitGetExpression* lit_make_get_expression(LitCompiler* compiler, uint64_t line, LitExpression* object, LitString* property);
 
 typedef struct {
 	LitExpression expression;
@@ -123,10 +124,10 @@ typedef struct {
 	LitExpression* object;
 	LitExpression* value;
 	bool emit_static_init;
-	const char* property;
+	LitString* property;
 } LitSetExpression;
 
-LitSetExpression* lit_make_set_expression(LitCompiler* compiler, uint64_t line, LitExpression* object, LitExpression* value, const char* property);
+LitSetExpression* lit_make_set_expression(LitCompiler* compiler, uint64_t line, LitExpression* object, LitExpression* value, LitString* property);
 
 typedef struct {
 	LitExpression expression;
@@ -136,10 +137,10 @@ LitThisExpression* lit_make_this_expression(LitCompiler* compiler, uint64_t line
 
 typedef struct {
 	LitExpression expression;
-	const char* method;
+	LitString* method;
 } LitSuperExpression;
 
-LitSuperExpression* lit_make_super_expression(LitCompiler* compiler, uint64_t line, const char* method);
+LitSuperExpression* lit_make_super_expression(LitCompiler* compiler, uint64_t line, LitString* method);
 
 typedef struct {
 	LitExpression expression;
@@ -168,7 +169,7 @@ typedef enum {
 	CONTINUE_STATEMENT
 } LitStatementType;
 
-typedef struct {
+typedef struct LitStatement {
 	LitStatementType type;
 	uint64_t line;
 }	LitStatement;
@@ -189,13 +190,13 @@ typedef struct {
 	LitStatement statement;
 
 	LitExpression* init;
-	const char* name;
-	const char* type;
+	LitString* name;
+	LitString* type;
 	bool final;
 	LitOpCode default_value;
 } LitVarStatement;
 
-LitVarStatement* lit_make_var_statement(LitCompiler* compiler, uint64_t line, const char* name, LitExpression* init, const char* type, bool final);
+LitVarStatement* lit_make_var_statement(LitCompiler* compiler, uint64_t line, LitString* name, LitExpression* init, LitString* type, bool final);
 
 typedef struct {
 	LitStatement statement;
@@ -238,10 +239,13 @@ typedef struct {
 	LitParameters* parameters;
 	LitStatement* body;
 	LitParameter return_type;
-	const char* name;
+	LitString* name;
+
+	bool reassigned; // Set by the resolver, calls to the function are looked up then
+	LitClosure* closure; // Created by the emitter for the direct calls
 } LitFunctionStatement;
 
-LitFunctionStatement* lit_make_function_statement(LitCompiler* compiler, uint64_t line, const char* name, LitParameters* parameters, LitStatement* body, LitParameter return_type);
+LitFunctionStatement* lit_make_function_statement(LitCompiler* compiler, uint64_t line, LitString* name, LitParameters* parameters, LitStatement* body, LitParameter return_type);
 DECLARE_ARRAY(LitFunctions, LitFunctionStatement*, functions)
 
 typedef struct {
@@ -275,11 +279,11 @@ typedef struct {
 	LitAccessType access;
 	bool is_static;
 	bool final;
-	const char* name;
-	const char* type;
+	LitString* name;
+	LitString* type;
 } LitFieldStatement;
 
-LitFieldStatement* lit_make_field_statement(LitCompiler* compiler, uint64_t line, const char* name, LitExpression* init, const char* type,
+LitFieldStatement* lit_make_field_statement(LitCompiler* compiler, uint64_t line, LitString* name, LitExpression* init, LitString* type,
 	LitStatement* getter, LitStatement* setter, LitAccessType access, bool is_static, bool final);
 
 typedef struct {
@@ -292,10 +296,12 @@ typedef struct {
 	bool is_static;
 	bool abstract;
 	LitAccessType access;
-	const char* name;
+	LitString* name;
+
+	LitClosure* closure; // Created by the emitter for the direct calls
 } LitMethodStatement;
 
-LitMethodStatement* lit_make_method_statement(LitCompiler* compiler, uint64_t line, const char* name, LitParameters* parameters, LitStatement* body, LitParameter return_type,
+LitMethodStatement* lit_make_method_statement(LitCompiler* compiler, uint64_t line, LitString* name, LitParameters* parameters, LitStatement* body, LitParameter return_type,
 	bool overriden, bool is_static, bool abstract, LitAccessType access);
 
 DECLARE_ARRAY(LitMethods, LitMethodStatement*, methods)
@@ -309,10 +315,10 @@ typedef struct {
 	bool abstract;
 	bool is_static;
 	bool final;
-	const char* name;
+	LitString* name;
 } LitClassStatement;
 
-LitClassStatement* lit_make_class_statement(LitCompiler* compiler, uint64_t line, const char* name, LitVarExpression* super, LitMethods* methods, LitStatements* fields, bool abstract, bool is_static, bool final);
+LitClassStatement* lit_make_class_statement(LitCompiler* compiler, uint64_t line, LitString* name, LitVarExpression* super, LitMethods* methods, LitStatements* fields, bool abstract, bool is_static, bool final);
 
 typedef struct {
 	LitStatement statement;
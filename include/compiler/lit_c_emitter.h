@@ -0,0 +1,65 @@
+#ifndef LIT_C_EMITTER_H
+#define LIT_C_EMITTER_H
+
+#include <lit_predefines.h>
+#include <compiler/lit_ast.h>
+#include <util/lit_array.h>
+#include <vm/lit_object.h>
+
+/*
+ * Translates a program to c ahead of time (lit --emit-c)
+ * Global functions, that only work with numbers and bools, become c functions,
+ * their locals are plain doubles and calls between them are c calls
+ * The rest of the program stays bytecode, that is embedded into the c file,
+ * and the runtime calls the translated functions instead of their bytecode (see lit_eval_compiled())
+ */
+
+typedef enum {
+	C_TYPE_NONE, // Can not be translated
+	C_TYPE_VOID,
+	C_TYPE_NUMBER,
+	C_TYPE_BOOL
+} LitCType;
+
+typedef struct {
+	LitString* name;
+	LitCType type;
+	int id; // Suffix of the c name, so that shadowed locals and odd names don't clash
+} LitCLocal;
+
+DECLARE_ARRAY(LitCLocals, LitCLocal, c_locals)
+DECLARE_ARRAY(LitCText, char, c_text)
+
+typedef struct {
+	LitFunctionStatement* statement;
+	LitCType return_type;
+
+	bool translated; // Cleared, once the body turns out to need the vm
+	int constant; // Index of the function in the constants of the script, -1, if it isn't there
+} LitCFunction;
+
+DECLARE_ARRAY(LitCFunctions, LitCFunction, c_functions)
+
+typedef struct sLitCEmitter {
+	LitCompiler* compiler;
+
+	LitCFunctions functions;
+	LitCText text; // Translated functions and their registry
+	LitCText* out; // Where the function, that is being translated, goes
+
+	LitCFunction* function;
+	LitCLocals locals;
+	int local_id;
+	int depth; // Indentation
+} LitCEmitter;
+
+void lit_init_c_emitter(LitCompiler* compiler, LitCEmitter* emitter);
+void lit_free_c_emitter(LitCEmitter* emitter);
+
+// Called by lit_compile() with the optimized statements, before they are freed
+void lit_emit_c_functions(LitCEmitter* emitter, LitStatements* statements, LitFunction* script);
+
+// Writes the translated functions, the bytecode of the script and main() into the file
+bool lit_write_c(LitCEmitter* emitter, LitFunction* script, const char* path, bool debug);
+
+#endif
\ No newline at end of file
@@ -11,6 +11,21 @@
 #include <vm/lit_chunk.h>
 #include <vm/lit_memory.h>
 
+struct sLitOptions {
+	bool optimize; // Runs the optimizer over the AST before emitting it
+	bool trace_ast; // Prints the parsed AST as json, before it is resolved
+	bool stats; // Prints cache hits and misses and the time, spent compiling
+	bool strip; // Leaves the line tables out of the files, saved with --compile
+	bool jit; // Compiles hot functions to machine code, while running
+
+	int inline_limit; // Biggest body in AST nodes, that is inlined, 0 turns inlining off
+
+	const char* cache; // Directory with the compiled files, NULL to always compile
+	const char* profile; // Type feedback, loaded before the run and saved after it, NULL to not profile
+};
+
+void lit_init_options(LitOptions* options);
+
 struct sLitCompiler {
 	LitMemManager mem_manager;
 
@@ -18,7 +33,12 @@ struct sLitCompiler {
 	LitLexer lexer;
 	LitEmitter emitter;
 	LitString* init_string;
-} sLitCompiler;
+	LitString* this_string;
+	LitOptions options;
+
+	struct sLitInliner* inliner; // Only set, while the optimizer runs
+	struct sLitCEmitter* c_emitter; // Only set for --emit-c, gets the statements, before they are freed
+};
 
 void lit_init_compiler(LitCompiler* compiler);
 void lit_compiler_define_native(LitCompiler* compiler, LitNativeRegistry* native);
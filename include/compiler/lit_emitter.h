@@ -5,7 +5,7 @@
 #include <compiler/lit_ast.h>
 
 typedef struct LitLocal {
-	const char* name;
+	LitString* name;
 	int depth;
 	bool upvalue;
 } LitLocal;
@@ -42,6 +42,7 @@ typedef struct LitEmitter {
 	LitInts breaks;
 
 	uint64_t loop_start;
+	int loop_locals; // Locals, that were declared before the loop, break and continue pop the rest
 	bool had_error;
 } LitEmitter;
 
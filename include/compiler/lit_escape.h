@@ -0,0 +1,15 @@
+#ifndef LIT_ESCAPE_H
+#define LIT_ESCAPE_H
+
+#include <lit_predefines.h>
+#include <compiler/lit_ast.h>
+#include <compiler/lit_inliner.h>
+
+/*
+ * Escape analysis: a local, that holds a new instance, and is only used to read and write its fields
+ * (or to call its methods, that can be inlined), never leaves the function
+ * The instance is never created then, every field gets its own local instead
+ */
+void lit_replace_scalars(LitCompiler* compiler, LitInliner* inliner, LitStatements* statements);
+
+#endif
\ No newline at end of file
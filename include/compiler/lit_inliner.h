@@ -0,0 +1,61 @@
+#ifndef LIT_INLINER_H
+#define LIT_INLINER_H
+
+#include <lit_predefines.h>
+#include <compiler/lit_ast.h>
+#include <util/lit_table.h>
+
+/*
+ * Replaces calls to small functions and methods with their bodies
+ * Only bodies, that return a single expression without side effects, are inlined,
+ * so the arguments can be substituted for the parameters
+ */
+
+// Most fields, that an instance can have, to be replaced with locals
+#define LIT_SCALAR_FIELDS 16
+
+DECLARE_TABLE(LitInlineFunctions, LitFunctionStatement*, inline_functions, LitFunctionStatement*)
+DECLARE_TABLE(LitInlineClasses, LitClassStatement*, inline_classes, LitClassStatement*)
+
+typedef struct sLitInliner {
+	LitInlineFunctions functions; // Global functions, whose bodies are already optimized
+	LitInlineClasses classes; // Global classes
+	LitTable candidates; // Global functions and classes, that are never redefined or assigned
+	LitTable shadowed; // Names, that are declared or assigned somewhere
+	LitTable overriden; // Names of the methods, that override something
+
+	LitClassStatement* class; // Class and method, that are being optimized
+	LitMethodStatement* method;
+	int depth; // Functions and methods, that are being optimized
+} LitInliner;
+
+// Goes through the whole program, to find the functions, that always mean the same thing
+void lit_init_inliner(LitCompiler* compiler, LitInliner* inliner, LitStatements* statements);
+void lit_free_inliner(LitCompiler* compiler, LitInliner* inliner);
+
+// Should be called, once the body of the function is optimized
+void lit_inliner_add_function(LitCompiler* compiler, LitInliner* inliner, LitFunctionStatement* function);
+
+// Returns the body with the arguments in place of the parameters, or NULL, if the call can't be inlined
+LitExpression* lit_inline_call(LitCompiler* compiler, LitInliner* inliner, LitCallExpression* call);
+
+/*
+ * Instances, that never escape their function, are replaced with a local per field (see lit_escape.h)
+ * The local is named receiver.field
+ */
+LitString* lit_scalar_name(LitCompiler* compiler, LitString* receiver, LitString* name);
+
+// Returns NULL, if the name doesn't always mean the same global class
+LitClassStatement* lit_find_class(LitInliner* inliner, LitString* name);
+
+// Returns the method, if a call to it on a replaced instance can be inlined
+LitMethodStatement* lit_find_scalar_method(LitCompiler* compiler, LitInliner* inliner, LitClassStatement* class, LitCallExpression* call);
+LitExpression* lit_inline_scalar_call(LitCompiler* compiler, LitInliner* inliner, LitClassStatement* class, LitCallExpression* call, LitString* receiver);
+
+// Only classes without a super, whose constructor just assigns the fields, can be replaced
+bool lit_can_inline_constructor(LitCompiler* compiler, LitClassStatement* class, int arg_count);
+
+// Writes the locals for the arguments and the fields into the statements, and takes the arguments
+void lit_inline_constructor(LitCompiler* compiler, LitClassStatement* class, LitExpressions* args, LitString* receiver, LitStatements* into, uint64_t line);
+
+#endif
\ No newline at end of file
@@ -43,11 +43,14 @@ typedef struct {
 	const char* start;
 	uint64_t length;
 	uint64_t line;
+
+	LitString* identifier; // Interned name, only set for identifiers
 } LitToken;
 
 typedef struct {
 	const char* start;
 	const char* current_code;
+	const char* end;
 	uint64_t line;
 	uint64_t last_line;
 
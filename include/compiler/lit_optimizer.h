@@ -0,0 +1,16 @@
+#ifndef LIT_OPTIMIZER_H
+#define LIT_OPTIMIZER_H
+
+#include <lit_predefines.h>
+#include <compiler/lit_ast.h>
+
+/*
+ * Runs between the resolver and the emitter,
+ * folds constant expressions and removes the branches,
+ * that can never be executed
+ * Small functions are inlined, and instances, that never leave
+ * their function, are replaced with locals
+ */
+void lit_optimize(LitCompiler* compiler, LitStatements* statements);
+
+#endif
\ No newline at end of file
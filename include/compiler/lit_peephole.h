@@ -0,0 +1,13 @@
+#ifndef LIT_PEEPHOLE_H
+#define LIT_PEEPHOLE_H
+
+#include <lit_predefines.h>
+#include <vm/lit_chunk.h>
+
+/*
+ * Rewrites a finished chunk, removing the waste, that the emitter leaves behind
+ * Jump offsets and the line table are rebuilt to match the new code
+ */
+void lit_optimize_chunk(LitCompiler* compiler, LitChunk* chunk);
+
+#endif
\ No newline at end of file
@@ -14,12 +14,42 @@
 #include <util/lit_table.h>
 #include <vm/lit_object.h>
 
+typedef enum {
+	PRIMITIVE_TYPE, // void, any, int, double, bool, char, string
+	INSTANCE_TYPE, // Instance of a class, like String
+	CLASS_TYPE, // Class<String>, the class itself
+	FUNCTION_TYPE, // Function<int, double, void>, the last argument is the return type
+	GENERIC_TYPE // Any other template, like List<int>
+} LitResolverTypeKind;
+
+/*
+ * Types are parsed once and interned by their canonical name,
+ * so two types are the same only if they are the same pointer
+ */
+typedef struct sLitResolverType {
+	LitResolverTypeKind kind;
+	uint32_t id;
+
+	LitString* name; // Canonical name, like Function<int, void>
+	LitString* base; // Name without the template, like Function
+
+	struct sLitResolverType** arguments; // Template arguments, parameters for functions
+	int argument_count;
+	struct sLitResolverType* return_type; // Only set for functions
+} LitResolverType;
+
+DECLARE_TABLE(LitResolverTypes, LitResolverType*, resolver_types, LitResolverType*)
+
 typedef struct LitResolverLocal {
+	LitString* name;
+	int shadowed; // Index of the outer local with the same name, -1 if there is none
+
 	bool defined;
 	bool nil;
 	bool field;
 	bool final;
-	const char* type;
+	LitResolverType* type;
+	LitFunctionStatement* function; // Global function, that the variable was declared with
 } LitResolverLocal;
 
 void lit_init_resolver_local(LitResolverLocal* letal);
@@ -28,7 +58,7 @@ typedef struct LitResolverField {
 	bool is_static;
 	bool is_final;
 	LitAccessType access;
-	const char* type;
+	LitResolverType* type;
 	struct sLitType* original;
 } LitResolverField;
 
@@ -41,9 +71,10 @@ typedef struct LitResolverMethod {
 	bool is_overriden;
 	bool abstract;
 	LitAccessType access;
-	char* signature;
+	LitResolverType* signature;
 	LitString* name;
 	struct sLitType* original;
+	LitMethodStatement* statement; // Only set for methods of global classes, they can be called directly
 } LitResolverMethod;
 
 void lit_free_resolver_method(LitCompiler* compiler, LitResolverMethod* method);
@@ -75,14 +106,22 @@ void lit_free_type(LitMemManager* manager, LitType* type);
 DECLARE_TABLE(LitResolverLocals, LitResolverLocal*, resolver_locals, LitResolverLocal*)
 DECLARE_TABLE(LitTypes, bool, types, bool)
 DECLARE_TABLE(LitClasses, LitType*, classes, LitType*)
-DECLARE_ARRAY(LitScopes, LitResolverLocals*, scopes)
-DECLARE_ARRAY(LitStrings, char*, strings)
+DECLARE_ARRAY(LitResolverStack, LitResolverLocal, resolver_stack)
+DECLARE_TABLE(LitResolverIndex, int, resolver_index, int*)
+DECLARE_ARRAY(LitScopes, int, scopes)
 
+/*
+ * Locals of all open scopes live in one flat stack,
+ * scopes only remember, where they start, and the index
+ * maps a name to the innermost local, that has it
+ */
 typedef struct LitResolver {
+	LitResolverStack locals;
+	LitResolverIndex index;
 	LitScopes scopes;
 	LitResolverLocals externals;
 	LitTypes types;
-	LitStrings allocated_strings;
+	LitResolverTypes interned_types;
 	LitClasses classes;
 	LitStatement* loop;
 	LitCompiler* compiler;
@@ -100,12 +139,32 @@ typedef struct LitResolver {
 	LitType* double_class;
 	LitType* string_class;
 	LitType* bool_class;
+
+	// Types, that are checked often, so they don't have to be looked up
+	LitResolverType* void_type;
+	LitResolverType* any_type;
+	LitResolverType* int_type;
+	LitResolverType* double_type;
+	LitResolverType* bool_type;
+	LitResolverType* char_type;
+	LitResolverType* string_type;
+	LitResolverType* string_object_type;
+	LitResolverType* object_type;
 } LitResolver;
 
 void lit_init_resolver(LitResolver* resolver);
 void lit_free_resolver(LitResolver* resolver);
 void lit_define_type(LitResolver* resolver, const char* type);
 
+// Defines a global, before anything is resolved, the pointer is only valid until the next declaration
+LitResolverLocal* lit_resolver_define_global(LitResolver* resolver, LitString* name, LitResolverType* type);
+
+/*
+ * Parses a type like Function<int, double, void>
+ * and returns its interned descriptor
+ */
+LitResolverType* lit_resolver_type(LitResolver* resolver, const char* type);
+
 bool lit_resolve(LitCompiler* compiler, LitStatements* statements);
 
 #endif
\ No newline at end of file
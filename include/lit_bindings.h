@@ -40,9 +40,11 @@
 #define FUNCTION(name) int name##_native(LitVm* vm, LitValue* args, int count)
 #define RETURN_VOID return 0;
 #define RETURN_NUMBER(number) lit_push(vm, MAKE_NUMBER_VALUE(number)); return 1;
+#define RETURN_INT(number) lit_push(vm, MAKE_INT_VALUE(number)); return 1;
 #define RETURN_NIL lit_push(vm, NIL_VALUE); return 1;
 #define RETURN_BOOL(value) lit_push(vm, MAKE_BOOL_VALUE(value)); return 1;
 #define RETURN_OBJECT(value) lit_push(vm, MAKE_OBJECT_VALUE(value)); return 1;
 #define RETURN_STRING(value) lit_push(vm, MAKE_OBJECT_VALUE(value)); return 1;
+#define RETURN_VALUE(value) lit_push(vm, value); return 1;
 
 #endif
\ No newline at end of file
@@ -17,7 +17,9 @@ struct sLitMemManager {
 	size_t bytes_allocated;
 	LitObject* objects;
 	LitTable strings;
-} sLitMemManager;
+
+	char buffer[24]; // lit_to_string() formats numbers and chars here
+};
 
 #define MM(x) ((LitMemManager*) x)
 
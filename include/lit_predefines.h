@@ -11,5 +11,8 @@ typedef struct sLitCompiler LitCompiler;
 typedef struct sLitVm LitVm;
 typedef struct sLitObject LitObject;
 typedef struct sLitString LitString;
+typedef struct sLitClosure LitClosure;
+typedef struct sLitOptions LitOptions;
+typedef struct sLitFiber LitFiber;
 
 #endif
\ No newline at end of file
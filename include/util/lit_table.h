@@ -205,7 +205,8 @@ DECLARE_TABLE(LitTable, LitValue, table, LitValue*)
 		for (int i = 0; i <= table->capacity_mask; i++) { \
 			name##Entry* entry = &table->entries[i]; \
 	\
-			if (entry->key != NULL && !entry->key->object.dark) { \
+			/* Deleting moves the following entries back, so the slot is checked again */ \
+			while (entry->key != NULL && !entry->key->object.dark) { \
 				lit_##shr##_delete(manager, table, entry->key); \
 			} \
 		} \
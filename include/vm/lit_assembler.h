@@ -0,0 +1,115 @@
+#ifndef LIT_ASSEMBLER_H
+#define LIT_ASSEMBLER_H
+
+/*
+ * Encodes the few x86-64 instructions, that the jits emit (see lit_jit.h and lit_trace.h),
+ * and maps the finished code as executable
+ * Memory operands are always [base + disp]
+ */
+
+#include <lit_common.h>
+#include <lit_predefines.h>
+#include <util/lit_array.h>
+
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSI 6
+#define RDI 7
+#define R12 12
+#define R13 13
+#define R14 14
+
+// Sse instructions on scalar doubles, they take the prefix 0xf2, unless noted
+#define MOVSD_LOAD 0x10
+#define MOVSD_STORE 0x11
+#define MOVAPD 0x28 // 0x66
+#define UCOMISD 0x2e // 0x66
+#define SQRTSD 0x51
+#define ADDSD 0x58
+#define MULSD 0x59
+#define SUBSD 0x5c
+#define DIVSD 0x5e
+#define XORPD 0x57 // 0x66
+#define CVTSI2SD 0x2a
+#define CVTTSD2SI 0x2c // To a general register, the 0x80000000 it gives for anything out of range is INT32_MIN
+
+// Condition codes, jcc is 0x0f 0x80 + code, setcc 0x0f 0x90 + code, the opposite condition is code ^ 1
+#define CONDITION_OVERFLOW 0x0
+#define CONDITION_BELOW 0x2
+#define CONDITION_ABOVE_EQUAL 0x3
+#define CONDITION_EQUAL 0x4
+#define CONDITION_NOT_EQUAL 0x5
+#define CONDITION_BELOW_EQUAL 0x6
+#define CONDITION_ABOVE 0x7
+#define CONDITION_SIGN 0x8
+#define CONDITION_NOT_PARITY 0xb
+#define CONDITION_LESS_EQUAL 0xe
+#define CONDITION_ALWAYS 0x10 // Plain jmp
+
+DECLARE_ARRAY(LitCodeBytes, uint8_t, code_bytes)
+
+typedef struct {
+	LitMemManager* manager;
+	LitCodeBytes code;
+} LitAssembler;
+
+void lit_init_assembler(LitAssembler* assembler, LitMemManager* manager);
+void lit_free_assembler(LitAssembler* assembler);
+
+// Copies the code into an executable mapping, returns NULL, if it can't be mapped
+uint8_t* lit_asm_map(LitAssembler* assembler);
+void lit_asm_unmap(uint8_t* code, size_t size);
+
+uint32_t lit_asm_position(LitAssembler* assembler);
+
+void lit_asm_byte(LitAssembler* assembler, uint8_t byte);
+void lit_asm_bytes(LitAssembler* assembler, const uint8_t* bytes, int count);
+void lit_asm_u32(LitAssembler* assembler, uint32_t value);
+void lit_asm_u64(LitAssembler* assembler, uint64_t value);
+
+// mov reg, [base + disp]
+void lit_asm_load(LitAssembler* assembler, int reg, int base, int32_t disp);
+// mov [base + disp], reg
+void lit_asm_store(LitAssembler* assembler, int base, int32_t disp, int reg);
+// lea reg, [base + disp]
+void lit_asm_address(LitAssembler* assembler, int reg, int base, int32_t disp);
+// mov to, from
+void lit_asm_move(LitAssembler* assembler, int to, int from);
+// mov reg, imm64
+void lit_asm_immediate(LitAssembler* assembler, int reg, uint64_t value);
+
+// Sse instruction with a memory operand, like addsd xmm, [base + disp]
+void lit_asm_sse(LitAssembler* assembler, uint8_t prefix, uint8_t opcode, int xmm, int base, int32_t disp);
+// Sse instruction on two registers, like addsd to, from
+void lit_asm_sse_registers(LitAssembler* assembler, uint8_t prefix, uint8_t opcode, int to, int from);
+// movq xmm, reg
+void lit_asm_to_xmm(LitAssembler* assembler, int xmm, int reg);
+// movq reg, xmm
+void lit_asm_from_xmm(LitAssembler* assembler, int reg, int xmm);
+// Compares the tag of the value in the register with the int tag, equal means it is an int, uses rdx
+void lit_asm_check_int(LitAssembler* assembler, int reg);
+// Loads the value at [base + disp] into the sse register, ints are converted to doubles, uses rax and rdx
+void lit_asm_unbox(LitAssembler* assembler, int xmm, int base, int32_t disp);
+// Turns the int in the low half of the register, with the high half cleared, into an int value, uses the scratch register
+void lit_asm_box_int(LitAssembler* assembler, int reg, int scratch);
+
+// setcc al
+void lit_asm_set(LitAssembler* assembler, uint8_t condition);
+// Turns the flag in al into a bool value in rax, uses rcx
+void lit_asm_bool(LitAssembler* assembler, bool invert);
+
+// Saves the callee saved registers, the stack stays aligned for calls
+void lit_asm_save(LitAssembler* assembler);
+// Restores them and returns
+void lit_asm_restore(LitAssembler* assembler);
+
+// Calls the function through rax
+void lit_asm_call(LitAssembler* assembler, void* function);
+
+// Returns the position of the rel32, that is patched, once the target is known
+uint32_t lit_asm_jump(LitAssembler* assembler, uint8_t condition);
+void lit_asm_patch(LitAssembler* assembler, uint32_t position, uint32_t target);
+
+#endif
\ No newline at end of file
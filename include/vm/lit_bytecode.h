@@ -0,0 +1,106 @@
+#ifndef LIT_BYTECODE_H
+#define LIT_BYTECODE_H
+
+/*
+ * Compiled functions, saved to a .litc file,
+ * so that they can be run without compiling the source again
+ *
+ * The file is mapped into memory, the code and the line tables
+ * are used right from the mapping, only the constants are relocated
+ * Line tables live in a separate debug section at the end of the file,
+ * its pages are only read, if an error needs a line
+ * Numbers are stored in the byte order of the machine, that wrote the file
+ */
+
+#include <lit_common.h>
+#include <lit_predefines.h>
+
+#include <vm/lit_object.h>
+
+#define LIT_BYTECODE_MAGIC "LITC"
+#define LIT_BYTECODE_VERSION 4
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t opcode_count; // Files from a build with other opcodes are rejected
+
+	uint32_t string_count;
+	uint32_t function_count;
+	uint32_t padding;
+
+	uint64_t size; // The whole file, to catch truncated files
+	uint64_t strings_offset; // LitBytecodeString[string_count]
+	uint64_t functions_offset; // LitBytecodeFunction[function_count], the first one is the script
+	uint64_t debug_offset; // Line tables, zero size, if they were stripped
+	uint64_t debug_size;
+} LitBytecodeHeader;
+
+// Points into the string pool, every string there is null terminated
+typedef struct {
+	uint32_t offset;
+	uint32_t length;
+} LitBytecodeString;
+
+typedef struct {
+	uint64_t code_offset;
+	uint64_t code_count;
+	uint64_t lines_offset; // Packed line table in the debug section
+	uint64_t lines_size;
+	uint64_t constants_offset; // LitBytecodeConstant[constant_count]
+	uint32_t constant_count;
+
+	int32_t arity;
+	int32_t upvalue_count;
+	int32_t name; // String index, -1, if the function has no name
+} LitBytecodeFunction;
+
+typedef enum {
+	BYTECODE_VALUE, // Numbers, bools and nil are stored as they are
+	BYTECODE_STRING,
+	BYTECODE_FUNCTION,
+	BYTECODE_CLOSURE // Closure without upvalues, that direct calls reference
+} LitBytecodeConstantType;
+
+typedef struct {
+	uint32_t type;
+	uint32_t index; // String or function index
+	uint64_t value;
+} LitBytecodeConstant;
+
+typedef struct {
+	uint8_t* data;
+	size_t size;
+} LitBytecode;
+
+/*
+ * Writes the functions into memory, that has to be freed with lit_free_serialized_bytecode
+ * The path is only used in the errors, NULL keeps them silent, returns false, if a constant can't be saved
+ */
+bool lit_serialize_bytecode(LitMemManager* manager, LitFunction* function, const char* path, bool debug, LitBytecode* bytecode);
+void lit_free_serialized_bytecode(LitMemManager* manager, LitBytecode* bytecode);
+
+// Line tables are left out, if debug is false
+bool lit_save_bytecode(LitMemManager* manager, LitFunction* function, const char* path, bool debug);
+
+/*
+ * Hashes the source together with the options and the executable of the compiler,
+ * the same key always means the same bytecode
+ */
+uint64_t lit_bytecode_key(const char* source_code, LitOptions* options);
+
+// Saves to a temporary file and renames it, so that nobody sees a half written file, the errors are silent
+bool lit_save_bytecode_atomic(LitMemManager* manager, LitFunction* function, const char* path, bool debug);
+
+// The errors are printed only if report is true
+bool lit_map_bytecode(LitBytecode* bytecode, const char* path, bool report);
+void lit_unmap_bytecode(LitBytecode* bytecode);
+
+/*
+ * Creates the functions, their chunks point into the mapping,
+ * so it has to stay mapped, until they are freed
+ * Returns NULL, if the file is broken
+ */
+LitFunction* lit_load_bytecode(LitMemManager* manager, LitBytecode* bytecode);
+
+#endif
\ No newline at end of file
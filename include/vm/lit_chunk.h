@@ -15,14 +15,57 @@ typedef enum {
 
 DECLARE_ARRAY(LitArray, LitValue, array)
 
+/*
+ * Once the chunk is done, its lines are packed into runs of bytes, that share a line,
+ * each run is a varint byte count and a zigzag varint line delta
+ * Every LIT_LINE_CHECKPOINT runs a checkpoint remembers, where the run starts,
+ * so that a line is found with a binary search and a short scan
+ */
+#define LIT_LINE_CHECKPOINT 16
+
+typedef struct {
+	uint32_t run_count;
+	uint32_t checkpoint_count; // LitLineCheckpoint[checkpoint_count] follow, then the runs
+} LitLineTableHeader;
+
+typedef struct {
+	uint32_t offset; // Bytecode offset, where the run starts
+	uint32_t line; // Line before the run, its delta is added to it
+	uint32_t position; // Where the run is encoded, from the start of the runs
+} LitLineCheckpoint;
+
+/*
+ * Threaded code, that the interpreter runs, has a slot for every byte of the code,
+ * so that the bytecode offsets map to it directly, only the slots of the opcodes are filled
+ * Instructions with two operands keep the second one in the slot after them
+ */
+typedef struct sLitThreadedInstruction {
+	void* handler;
+
+	union {
+		LitValue constant;
+		struct sLitThreadedInstruction* target; // Jumps and loops
+		uint64_t index; // Locals, upvalues and argument counts
+	} operand;
+} LitThreadedInstruction;
+
 typedef struct {
 	uint64_t count;
 	uint64_t capacity;
 	uint8_t* code;
+
+	// NULL, until the chunk is run for the first time
+	LitThreadedInstruction* threaded;
+
+	// Pairs of byte count and line, only used, while the chunk is written
 	uint64_t* lines;
 	uint64_t line_count;
 	uint64_t line_capacity;
 
+	// Packed lines, NULL, if the debug info was stripped
+	uint8_t* line_table;
+	uint64_t line_table_size;
+
 	LitArray constants;
 } LitChunk;
 
@@ -31,6 +74,58 @@ void lit_free_chunk(LitMemManager* manager, LitChunk* chunk);
 
 void lit_chunk_write(LitMemManager* manager, LitChunk* chunk, uint8_t byte, uint64_t line);
 int lit_chunk_add_constant(LitMemManager* manager, LitChunk* chunk, LitValue constant);
+// Returns 0, if the line is not known
 uint64_t lit_chunk_get_line(LitChunk* chunk, uint64_t offset);
 
+// Packs the lines into the line table, the chunk can't be written after that
+void lit_chunk_pack_lines(LitMemManager* manager, LitChunk* chunk);
+
+/*
+ * Returns the size of the instruction at the offset in bytes,
+ * the opcode included
+ */
+uint64_t lit_chunk_instruction_size(LitChunk* chunk, uint64_t offset);
+
+// Same as above, but OP_CLOSURE doesn't count its upvalues
+static inline uint64_t lit_opcode_size(LitOpCode opcode) {
+	switch (opcode) {
+		case OP_CONSTANT:
+		case OP_DEFINE_GLOBAL:
+		case OP_GET_GLOBAL:
+		case OP_SET_GLOBAL:
+		case OP_GET_LOCAL:
+		case OP_SET_LOCAL:
+		case OP_GET_UPVALUE:
+		case OP_SET_UPVALUE:
+		case OP_CALL:
+		case OP_TAIL_CALL:
+		case OP_INVOKE:
+		case OP_CLASS:
+		case OP_SUBCLASS:
+		case OP_METHOD:
+		case OP_GET_FIELD:
+		case OP_SET_FIELD:
+		case OP_DEFINE_FIELD:
+		case OP_DEFINE_METHOD:
+		case OP_DEFINE_STATIC_FIELD:
+		case OP_DEFINE_STATIC_METHOD:
+		case OP_SUPER:
+		case OP_CLOSURE: return 2;
+		case OP_JUMP:
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP_IF_TRUE:
+		case OP_LOOP:
+		case OP_CALL_DIRECT:
+		case OP_TAIL_CALL_DIRECT:
+		case OP_INVOKE_DIRECT: return 3;
+		default: return 1;
+	}
+}
+
+/*
+ * Decodes the chunk into its threaded code, the handlers are indexed by the opcode
+ * The slot after the last instruction returns from the function
+ */
+void lit_chunk_thread(LitMemManager* manager, LitChunk* chunk, void** handlers);
+
 #endif
\ No newline at end of file
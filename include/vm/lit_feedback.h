@@ -0,0 +1,73 @@
+#ifndef LIT_FEEDBACK_H
+#define LIT_FEEDBACK_H
+
+/*
+ * Type feedback, collected by the interpreter, when it runs with --profile
+ * Every instruction, that could be specialized, gets a slot in its function:
+ * field reads and invokes see the classes of their receivers, calls see the kinds of their callees,
+ * arithmetic and comparisons see the types of their operands, conditional jumps count how often they are taken
+ *
+ * The profile is saved to a text file after the run, and merged into the functions,
+ * when the next run loads it, so the feedback adds up over runs
+ * Functions are matched by their name and a hash of their bytecode, so a profile
+ * of an older version of the code is ignored for the functions, that changed
+ */
+
+#include <lit_common.h>
+#include <lit_predefines.h>
+
+#include <vm/lit_object.h>
+
+#define LIT_FEEDBACK_CLASSES 4 // Receiver classes per site, a site, that sees more, is megamorphic
+
+typedef enum {
+	FEEDBACK_INT = 1 << 0,
+	FEEDBACK_DOUBLE = 1 << 1,
+	FEEDBACK_BOOL = 1 << 2,
+	FEEDBACK_NIL = 1 << 3,
+	FEEDBACK_STRING = 1 << 4,
+	FEEDBACK_INSTANCE = 1 << 5,
+	FEEDBACK_CLASS = 1 << 6,
+	FEEDBACK_CLOSURE = 1 << 7,
+	FEEDBACK_NATIVE = 1 << 8, // Natives and native methods
+	FEEDBACK_BOUND_METHOD = 1 << 9,
+	FEEDBACK_OTHER = 1 << 10
+} LitFeedbackType;
+
+typedef struct {
+	uint32_t offset;
+	uint16_t types; // LitFeedbackType bits of the operands, the callee or the receiver, that were seen
+
+	bool megamorphic;
+	uint8_t class_count;
+	LitString* classes[LIT_FEEDBACK_CLASSES]; // Names of the receiver classes
+
+	uint32_t taken; // Conditional jumps only
+	uint32_t not_taken;
+} LitFeedbackSlot;
+
+typedef struct sLitFeedback {
+	LitFeedbackSlot* slots; // In the order of the instructions
+	uint32_t slot_count;
+	uint32_t* index; // Slot of every bytecode offset, UINT32_MAX, where no profiled instruction starts
+	uint64_t code_count;
+} LitFeedback;
+
+bool lit_is_profiled(LitOpCode opcode);
+LitFeedbackType lit_feedback_type(LitValue value);
+
+// Returns the slot of the instruction at the offset, NULL, if it has no feedback
+LitFeedbackSlot* lit_get_feedback(LitFunction* function, uint64_t offset);
+
+// Called by the interpreter before every profiled instruction, while the operands are still on the stack
+void lit_feedback_record(LitVm* vm, LitFunction* function, uint64_t offset);
+
+void lit_gray_feedback(LitVm* vm, LitFunction* function);
+void lit_free_feedback(LitMemManager* manager, LitFunction* function);
+
+// Merges the profile into the functions of the vm, a missing file is an empty profile
+void lit_load_profile(LitVm* vm, const char* path);
+// Saves the feedback of every function, that is still alive
+bool lit_save_profile(LitVm* vm, const char* path);
+
+#endif
\ No newline at end of file
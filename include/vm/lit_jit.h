@@ -0,0 +1,39 @@
+#ifndef LIT_JIT_H
+#define LIT_JIT_H
+
+/*
+ * Baseline jit for x86-64
+ * Once a function was called or looped LIT_JIT_THRESHOLD times, every instruction
+ * of its chunk is translated into a fixed piece of machine code, that works right on the vm stack,
+ * so the native code can stop and go on at any instruction
+ * Instructions without a template leave the native code with the ip set to them,
+ * the interpreter runs them and enters the native code again on the next call, return or loop
+ *
+ * The resolver makes sure, that arithmetic and comparisons only ever see numbers
+ * Two ints are added, subtracted, multiplied or divided in general registers, and the result is tagged as an int again,
+ * unless the opcode in the interpreter would give a double, then the code falls back to sse
+ * Anything else turns int tagged values into doubles, when it loads them, and stores the results as plain doubles
+ */
+
+#include <lit_common.h>
+#include <lit_predefines.h>
+
+#include <vm/lit_vm.h>
+
+#define LIT_JIT_THRESHOLD 1000
+
+typedef struct sLitJitCode {
+	uint8_t* code; // Executable mapping
+	size_t size;
+	uint32_t* entries; // Native offset of every instruction, by its bytecode offset
+	uint64_t entry_count;
+} LitJitCode;
+
+// Returns false, if the function can't be compiled on this machine
+bool lit_jit_compile(LitVm* vm, LitFunction* function);
+void lit_jit_free(LitMemManager* manager, LitFunction* function);
+
+// Runs the frame from its ip, until it meets an instruction, that only the interpreter runs
+void lit_jit_run(LitVm* vm, LitFrame* frame);
+
+#endif
\ No newline at end of file
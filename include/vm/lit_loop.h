@@ -0,0 +1,103 @@
+#ifndef LIT_LOOP_H
+#define LIT_LOOP_H
+
+/*
+ * Event loop for the async natives, made by the first one, that the script calls
+ * An async native tries its operation right away, if it would block, the native parks the running fiber
+ * with the operation and its fd in the epoll, and the vm switches to the next ready fiber,
+ * the loop only blocks in epoll_wait, once no fiber is ready
+ * When the fd is ready, the loop does the operation, and the result is handed to the parked fiber
+ * as the result of the native, that it waits in, so one vm thread multiplexes any count of operations
+ * Any count of fibers can wait on the same fd, it is registered once with the events of all of them,
+ * closing the fd hands its waiting fibers the failed result
+ *
+ * Fibers, that are spawned, run as tasks on the loop, the script only ends,
+ * once its main fiber and every task are done
+ * Regular files can't be polled, so readFile() reads them right away
+ */
+
+#include <lit_common.h>
+#include <lit_predefines.h>
+
+#include <vm/lit_vm.h>
+
+#define LIT_LOOP_EVENTS 64 // Most events, that one epoll_wait handles
+#define LIT_LOOP_CHUNK 4096 // Most bytes, that one read() returns
+
+typedef enum {
+	WAIT_TIMER,
+	WAIT_READ_FILE,
+	WAIT_READ,
+	WAIT_WRITE,
+	WAIT_ACCEPT,
+	WAIT_CONNECT,
+	WAIT_PROCESS
+} LitWaitType;
+
+// An operation, that a parked fiber waits for
+typedef struct sLitWait {
+	LitWaitType type;
+	int fd; // Registered in the epoll
+	LitFiber* fiber;
+
+	LitString* data; // WAIT_WRITE only, what is written
+	char* buffer; // WAIT_READ_FILE only, what was read so far
+	size_t length; // Bytes in the buffer or bytes written
+	size_t capacity;
+	int pid; // WAIT_PROCESS only, the fd is its pidfd
+	uint32_t events; // That the wait needs
+
+	struct sLitWait* previous;
+	struct sLitWait* next;
+	struct sLitWait* next_on_fd; // The waits on one fd, in the order, in that they were parked
+} LitWait;
+
+typedef struct {
+	LitFiber* fiber;
+	LitValue value; // The result of the native, that the fiber waited in, nil for new tasks
+} LitReady;
+
+typedef struct sLitLoop {
+	int epoll;
+
+	LitReady* ready; // A ring, the fibers run in the order, in that they got ready
+	uint32_t ready_start;
+	uint32_t ready_count;
+	uint32_t ready_capacity;
+
+	LitWait* waits;
+	uint32_t wait_count;
+
+	LitWait** fd_waits; // The first wait on every fd, indexed by the fd
+	uint32_t fd_capacity;
+} LitLoop;
+
+// Queues a new fiber, it runs, once the running fiber waits or finishes
+void lit_loop_spawn(LitVm* vm, LitFiber* fiber);
+
+// Tells, if any fiber is ready or waits for an operation
+bool lit_loop_pending(LitVm* vm);
+// Takes the next ready fiber for vm->next_fiber and pushes the value, that it gets, blocks, until a fiber is ready
+void lit_loop_next(LitVm* vm);
+
+/*
+ * The async natives, they return the count of the values, that they pushed, like natives do
+ * The result is pushed, if the operation is done right away, otherwise the running fiber is parked
+ */
+int lit_loop_sleep(LitVm* vm, double milliseconds);
+int lit_loop_read_file(LitVm* vm, LitString* path);
+int lit_loop_read(LitVm* vm, int fd);
+int lit_loop_write(LitVm* vm, int fd, LitString* data);
+int lit_loop_accept(LitVm* vm, int fd);
+int lit_loop_connect(LitVm* vm, LitString* path);
+int lit_loop_exec(LitVm* vm, LitString* command);
+
+// Never block, they return -1, if they fail
+int lit_loop_listen(LitVm* vm, LitString* path);
+bool lit_loop_pipe(LitVm* vm, int fds[2]);
+int lit_loop_close(LitVm* vm, int fd);
+
+void lit_gray_loop(LitVm* vm);
+void lit_free_loop(LitVm* vm);
+
+#endif
\ No newline at end of file
@@ -15,6 +15,12 @@
 // Used by both VM and compiler
 void* base_reallocate(LitMemManager* manager, void* previous, size_t old_size, size_t new_size);
 
+/*
+ * Moves all objects and interned strings from one manager to another,
+ * the receiving manager must not have any interned strings yet
+ */
+void lit_move_objects(LitMemManager* to, LitMemManager* from);
+
 #define reallocate(x, b, c, d) base_reallocate(_Generic((x), LitCompiler*: (LitMemManager*)(x), LitVm*: (LitMemManager*)(x), LitMemManager*: x), b, c, d)
 
 // VM only stuff
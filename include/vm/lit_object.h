@@ -18,6 +18,7 @@
 #define IS_NATIVE_METHOD(value) lit_is_object_type(value, OBJECT_NATIVE_METHOD)
 #define IS_CLASS(value) lit_is_object_type(value, OBJECT_CLASS)
 #define IS_INSTANCE(value) lit_is_object_type(value, OBJECT_INSTANCE)
+#define IS_FIBER(value) lit_is_object_type(value, OBJECT_FIBER)
 
 #define AS_CLOSURE(value) ((LitClosure*) AS_OBJECT(value))
 #define AS_FUNCTION(value) ((LitFunction*) AS_OBJECT(value))
@@ -29,6 +30,7 @@
 #define AS_STRING(value) ((LitString*) AS_OBJECT(value))
 #define AS_CSTRING(value) (((LitString*) AS_OBJECT(value))->chars)
 #define AS_UPVALUE(value) ((LitUpvalue*) AS_OBJECT(value))
+#define AS_FIBER(value) ((LitFiber*) AS_OBJECT(value))
 
 typedef enum {
 	OBJECT_STRING,
@@ -39,7 +41,8 @@ typedef enum {
 	OBJECT_BOUND_METHOD,
 	OBJECT_CLASS,
 	OBJECT_INSTANCE,
-	OBJECT_NATIVE_METHOD
+	OBJECT_NATIVE_METHOD,
+	OBJECT_FIBER // See lit_vm.h, it has the frames
 } LitObjectType;
 
 struct sLitObject {
@@ -54,10 +57,17 @@ struct sLitString {
 	int length;
 	char* chars;
 	uint32_t hash;
+	bool interned;
 };
 
+/*
+ * Only strings, that come from the source code (names and literals)
+ * are interned right away. Strings, produced at runtime are interned
+ * on demand, when they are used as a table key or compared.
+ */
 LitString* lit_new_string(LitMemManager* manager, int length);
 void lit_hash_string(LitString* string);
+LitString* lit_intern_string(LitMemManager* manager, LitString* string);
 LitString* lit_make_string(LitMemManager* manager, char* chars, int length);
 LitString* lit_copy_string(LitMemManager* manager, const char* chars, size_t length);
 LitString* lit_format_string(LitMemManager* manager, const char* format, ...);
@@ -73,6 +83,9 @@ typedef struct sLitUpvalue {
 
 LitUpvalue* lit_new_upvalue(LitMemManager* manager, LitValue* slot);
 
+// Function, translated to c by lit --emit-c, gets the arguments and returns the result
+typedef LitValue (*LitCompiledFn)(LitValue* args);
+
 typedef struct {
 	LitObject object;
 
@@ -81,6 +94,12 @@ typedef struct {
 
 	LitChunk chunk;
 	LitString* name;
+
+	uint32_t hotness; // Calls and loops, counted up to LIT_JIT_THRESHOLD
+	struct sLitJitCode* jit; // Native code, NULL, until the function gets hot
+	struct sLitTrace* traces; // Hot loops (see lit_trace.h)
+	LitCompiledFn compiled; // Runs instead of the bytecode, NULL for most functions (see lit_c_emitter.h)
+	struct sLitFeedback* feedback; // Observed types, NULL, unless the function was profiled (see lit_feedback.h)
 } LitFunction;
 
 LitFunction* lit_new_function(LitMemManager* manager);
@@ -93,6 +112,12 @@ typedef struct {
 	const char* signature;
 } LitNativeRegistry;
 
+typedef struct {
+	uint32_t constant; // Index of the function in the constants of the script
+	const char* name;
+	LitCompiledFn function;
+} LitCompiledRegistry;
+
 typedef struct {
 	LitObject object;
 	LitNativeFn function;
@@ -100,13 +125,13 @@ typedef struct {
 
 LitNative* lit_new_native(LitMemManager* manager, LitNativeFn function);
 
-typedef struct {
+struct sLitClosure {
 	LitObject object;
 
 	LitFunction* function;
 	LitUpvalue** upvalues;
 	int upvalue_count;
-} LitClosure;
+};
 
 LitClosure* lit_new_closure(LitMemManager* manager, LitFunction* function);
 
@@ -35,6 +35,7 @@ OPCODE(GET_UPVALUE)
 OPCODE(SET_UPVALUE)
 OPCODE(JUMP)
 OPCODE(JUMP_IF_FALSE)
+OPCODE(JUMP_IF_TRUE)
 OPCODE(LOOP)
 OPCODE(CLOSURE)
 OPCODE(SUBCLASS)
@@ -44,6 +45,10 @@ OPCODE(GET_FIELD)
 OPCODE(SET_FIELD)
 OPCODE(INVOKE)
 OPCODE(CALL)
+OPCODE(TAIL_CALL)
+OPCODE(CALL_DIRECT)
+OPCODE(TAIL_CALL_DIRECT)
+OPCODE(INVOKE_DIRECT)
 OPCODE(DEFINE_FIELD)
 OPCODE(DEFINE_METHOD)
 OPCODE(SUPER)
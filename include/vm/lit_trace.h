@@ -0,0 +1,58 @@
+#ifndef LIT_TRACE_H
+#define LIT_TRACE_H
+
+/*
+ * Tracing jit for hot loops
+ * Every loop header has a trace, that counts the back edges to it
+ * Once the count runs out, the interpreter records one iteration of the loop:
+ * the instructions, that ran, the branches, that were taken, and the types, that were seen
+ * The path is compiled into straight native code, that loops back to its start,
+ * numbers stay unboxed in sse registers, the locals of the frame, that the loop uses, included
+ * Every branch and every type, that the path relies on, is guarded,
+ * a guard, that fails, writes the registers back and side exits to the interpreter
+ * at the instruction, that it guards, so the interpreter runs it again
+ *
+ * Only innermost loops without calls are traced, a recording, that meets
+ * anything else, is aborted, and the loop is never recorded again
+ */
+
+#include <lit_common.h>
+#include <lit_predefines.h>
+
+#include <vm/lit_vm.h>
+
+#define LIT_TRACE_THRESHOLD 64
+#define LIT_TRACE_LENGTH 1024 // Most instructions in a trace
+
+typedef struct sLitTrace {
+	uint8_t* header; // First instruction of the loop
+
+	/*
+	 * Back edges, until the loop is looked at again, the template jit counts it down too (see lit_jit.h)
+	 * It is 1, once the trace is compiled, so that the next back edge enters it
+	 */
+	int32_t countdown;
+	bool blacklisted;
+
+	int base; // Stack depth at the header, relative to the slots
+	uint8_t* code; // NULL, until the trace is compiled
+	size_t size;
+
+	struct sLitTrace* next;
+} LitTrace;
+
+// Returns the trace of the loop, that starts at the header, creates it, if needed
+LitTrace* lit_get_trace(LitVm* vm, LitFunction* function, uint8_t* header);
+void lit_free_traces(LitMemManager* manager, LitFunction* function);
+
+/*
+ * Called by the interpreter on every back edge, once the ip is at the header
+ * Runs the trace, if it is compiled, returns true, if the interpreter should record the loop
+ */
+bool lit_trace_loop(LitVm* vm, LitFrame* frame);
+
+// Called by the interpreter before every instruction, while it records, returns false, once the recording is over
+bool lit_trace_record(LitVm* vm, LitFrame* frame);
+void lit_free_recorder(LitVm* vm);
+
+#endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define LIT_VALUE_H
 
 #include <stdio.h>
+#include <math.h>
 
 #include <lit_common.h>
 #include <lit_predefines.h>
@@ -16,20 +17,29 @@
 #define TAG_TRUE 3
 #define TAG_CHAR 4
 
+/*
+ * Ints live in the nan space too, the high half of the value is the tag and the low half is the int
+ * Numbers are either ints or doubles, arithmetic on two ints stays int, unless it overflows
+ */
+#define INT_TAG ((uint64_t) 0x7ffd000000000000)
+
 typedef uint64_t LitValue;
 
 #define MASK_TAG (7)
 #define GET_TAG(value) ((int) ((value) & MASK_TAG))
-#define IS_FALSE(v) (GET_TAG(v) == TAG_FALSE)
-#define IS_TRUE(v) (GET_TAG(v) == TAG_TRUE)
+#define IS_FALSE(v) ((v) == FALSE_VALUE)
+#define IS_TRUE(v) ((v) == TRUE_VALUE)
 #define IS_CHAR(v) (GET_TAG(v) == TAG_CHAR)
 #define IS_BOOL(v) (IS_TRUE(v) || IS_FALSE(v))
 #define IS_NIL(v) ((v) == NIL_VALUE)
-#define IS_NUMBER(v) (((v) & QNAN) != QNAN)
+#define IS_DOUBLE(v) (((v) & QNAN) != QNAN)
+#define IS_INT(v) (((v) >> 32) == (INT_TAG >> 32))
+#define IS_NUMBER(v) (IS_DOUBLE(v) || IS_INT(v))
 #define IS_OBJECT(v) (((v) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
 
 #define AS_BOOL(v) ((v) == TRUE_VALUE)
 #define AS_NUMBER(v) lit_value_to_num(v)
+#define AS_INT(v) ((int32_t) (uint32_t) (v))
 #define AS_OBJECT(v) ((LitObject*)(uintptr_t)((v) & ~(SIGN_BIT | QNAN)))
 
 #define MAKE_BOOL_VALUE(boolean) ((boolean) ? TRUE_VALUE : FALSE_VALUE)
@@ -37,6 +47,8 @@ typedef uint64_t LitValue;
 #define TRUE_VALUE ((LitValue) (uint64_t) (QNAN | TAG_TRUE))
 #define NIL_VALUE ((LitValue) (uint64_t) (QNAN | TAG_NIL))
 #define MAKE_NUMBER_VALUE(num) lit_num_to_value(num)
+#define MAKE_INT_VALUE(i) ((LitValue) (INT_TAG | (uint32_t) (i)))
+#define MAKE_FITTING_NUMBER_VALUE(num) lit_fitting_num_to_value(num)
 #define MAKE_CHAR_VALUE(num) lit_char_to_value(num)
 
 #define MAKE_OBJECT_VALUE(obj) (LitValue) (SIGN_BIT | QNAN | (uint64_t) (uintptr_t) (obj))
@@ -60,6 +72,10 @@ static inline LitValue lit_char_to_value(unsigned char ch) {
 }
 
 static inline double lit_value_to_num(LitValue value) {
+	if (IS_INT(value)) {
+		return (double) AS_INT(value);
+	}
+
 	DoubleUnion data;
 	data.bits64 = value;
 	return data.num;
@@ -71,7 +87,17 @@ static inline LitValue lit_num_to_value(double num) {
 	return data.bits64;
 }
 
+// Makes an int, if the number is whole and fits one, -0 stays a double
+static inline LitValue lit_fitting_num_to_value(double num) {
+	if (num >= INT32_MIN && num <= INT32_MAX && num == (int32_t) num && !(num == 0 && signbit(num))) {
+		return MAKE_INT_VALUE((int32_t) num);
+	}
+
+	return lit_num_to_value(num);
+}
+
 bool lit_is_false(LitValue value);
+bool lit_are_values_equal(LitVm* vm, LitValue a, LitValue b);
 char *lit_to_string(LitVm* vm, LitValue value);
 
 #endif
\ No newline at end of file
@@ -25,19 +25,57 @@ typedef struct {
 	LitValue* slots;
 } LitFrame;
 
-typedef struct sLitVm {
+/*
+ * A coroutine with its own stack and frames, the vm runs one fiber at a time
+ * The running fiber keeps its stack top, frames count and open upvalues in the vm,
+ * switching to another fiber saves them and loads the ones of the other fiber, nothing is copied
+ */
+struct sLitFiber {
+	LitObject object;
+
+	LitClosure* closure; // Called on the first resume, NULL for the main fiber
+	LitFiber* parent; // Resumed the fiber and gets back what it yields, NULL, unless the fiber runs
+
+	LitValue* stack; // VM_STACK_MAX values, NULL, once the fiber is done
+	LitValue* stack_top;
+	LitFrame* frames; // FRAMES_MAX frames
+	int frame_count;
+	LitUpvalue* open_upvalues;
+
+	bool parked; // Waits in the event loop, only the loop resumes it (see lit_loop.h)
+};
+
+LitFiber* lit_new_fiber(LitMemManager* manager, LitClosure* closure);
+// Frees the stack of a finished fiber
+void lit_free_fiber_stack(LitMemManager* manager, LitFiber* fiber);
+
+struct sLitVm {
 	LitMemManager mem_manager;
 
-	LitValue stack[VM_STACK_MAX];
+	// The stack, the frames and the open upvalues of the running fiber
+	LitValue* stack;
 	LitValue* stack_top;
+	LitFrame* frames;
+	int frame_count;
+	LitUpvalue* open_upvalues;
+
 	LitTable globals;
 	LitString *init_string;
 
-	LitFrame frames[FRAMES_MAX];
-	int frame_count;
+	LitFiber* fiber; // The running fiber
+	LitFiber* next_fiber; // Set by the fiber and the async natives, the vm switches to it, once the native returns
+	struct sLitLoop* loop; // Made by the first async native (see lit_loop.h)
+
 	bool abort;
+	bool jit; // Compiles hot functions to machine code (see lit_jit.h)
+	struct sLitTraceRecorder* recorder; // The loop, that is being recorded, if any (see lit_trace.h)
+	bool profile; // Collects type feedback in the interpreter (see lit_feedback.h)
+
+	// What the last call_value() did, the interpreter reads them right after the call
+	bool last_native; // Nothing was pushed to the frames, the result is on the stack already
+	bool last_init; // A class was called and its init() runs, so the instance is returned
+	bool last_super; // The next bound method comes from super, which leaves its receiver one slot higher
 
-	LitUpvalue* open_upvalues;
 	size_t next_gc;
 
 	int gray_count;
@@ -51,7 +89,8 @@ typedef struct sLitVm {
 	LitClass* string_class;
 	LitClass* int_class;
 	LitClass* double_class;
-} sLitVm;
+	LitClass* fiber_class;
+};
 
 void lit_init_vm(LitVm* vm);
 void lit_vm_define_native(LitVm* vm, LitNativeRegistry* native);
@@ -86,8 +125,20 @@ void lit_define_lib(LitVm* vm, LitLibRegistry* lib);
 void lit_free_vm(LitVm* vm);
 
 bool lit_eval(const char* source_code);
+bool lit_eval_with_options(const char* source_code, LitOptions* options);
+
+// Compiles the code and saves it as bytecode, instead of running it
+bool lit_compile_to_file(const char* source_code, const char* path, LitOptions* options);
+bool lit_eval_bytecode(const char* path, LitOptions* options);
+
+// Translates the code to c, that runs the program without the compiler (see lit_c_emitter.h)
+bool lit_compile_to_c(const char* source_code, const char* path, LitOptions* options);
+bool lit_eval_compiled(const uint8_t* data, size_t size, LitCompiledRegistry* functions);
 bool lit_execute(LitVm* vm, LitFunction* function);
 
+// Prints the error with the frames of the running fiber and stops the vm, natives return right after it
+void lit_runtime_error(LitVm* vm, const char* format, ...);
+
 void lit_push(LitVm* vm, LitValue value);
 LitValue lit_pop(LitVm* vm);
 LitValue lit_peek(LitVm* vm, int depth);
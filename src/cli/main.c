@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <memory.h>
+#include <time.h>
 
 #include <lit.h>
 
@@ -33,6 +34,19 @@ void show_help() {
 	printf("lit - powerful and fast static-typed language\n");
 	printf("\tlit [file]\tRun the file\n");
 	printf("\t-e --exec [code string]\tExecutes a string of code\n");
+	printf("\t-c --compile [output]\tSaves the file as bytecode, instead of running it\n");
+	printf("\t--emit-c [output.c]\tTranslates the file to c, that is built with the lit runtime\n");
+	printf("\t--strip\tLeaves the line tables out of the compiled file\n");
+	printf("\tlit [file.litc]\tRuns a file, saved with --compile\n");
+	printf("\t--cache [directory]\tKeeps the compiled files there, LIT_CACHE or ~/.cache/lit by default\n");
+	printf("\t--no-cache\tAlways compiles the file\n");
+	printf("\t--stats\tPrints cache hits and misses and the compile time\n");
+	printf("\t--no-optimize\tDisables the optimizer, emitted bytecode follows the source\n");
+	printf("\t--no-jit\tRuns everything in the interpreter, instead of compiling hot functions to machine code\n");
+	printf("\t--profile [file]\tCollects type feedback in the interpreter, merges it with the file and saves it there\n");
+	printf("\t--inline-limit [nodes]\tInlines functions up to that size, 0 turns inlining off, 16 by default\n");
+	printf("\t--trace-ast\tPrints the parsed AST as json before running the file\n");
+	printf("\t--bench-lexer [megabytes]\tLexes a generated corpus and prints the throughput\n");
 	printf("\t-h --help\tShows this hint\n");
 }
 
@@ -68,10 +82,116 @@ static char* read_file(const char* path) {
 	return buffer;
 }
 
+static const char* default_cache() {
+	static char path[1024];
+	const char* directory = getenv("LIT_CACHE");
+
+	if (directory != NULL) {
+		return *directory == '\0' ? NULL : directory;
+	}
+
+	if ((directory = getenv("XDG_CACHE_HOME")) != NULL && *directory != '\0') {
+		snprintf(path, sizeof(path), "%s/lit", directory);
+	} else if ((directory = getenv("HOME")) != NULL && *directory != '\0') {
+		snprintf(path, sizeof(path), "%s/.cache/lit", directory);
+	} else {
+		return NULL;
+	}
+
+	return path;
+}
+
+static bool is_bytecode_file(const char* path) {
+	size_t length = strlen(path);
+	return length > 5 && strcmp(path + length - 5, ".litc") == 0;
+}
+
+static const char* corpus_snippet =
+	"// Computes the thing number %d\n"
+	"int thing_%d(int value, String name) {\n"
+	"\tvar result_%d = value * 31 + 7.5 // Magic\n"
+	"\n"
+	"\t/*\n"
+	"\t * Block comments are skipped too\n"
+	"\t */\n"
+	"\tif (result_%d > 100 && name != \"skip\") {\n"
+	"\t\treturn result_%d - value\n"
+	"\t} else if (value == 0) {\n"
+	"\t\tprint(\"zero %%d\")\n"
+	"\t}\n"
+	"\n"
+	"\twhile (false) {}\n"
+	"\treturn value\n"
+	"}\n"
+	"\n"
+	"class Thing_%d < Object {\n"
+	"\tprivate static final var counter = 0\n"
+	"\n"
+	"\toverride void init() {\n"
+	"\t\tthis.counter += 1\n"
+	"\t}\n"
+	"}\n\n";
+
+// Lexes a generated corpus and reports the throughput, to keep an eye on the lexer
+static void benchmark_lexer(size_t megabytes) {
+	size_t size = megabytes * 1024 * 1024;
+	char* corpus = (char*) malloc(size + 1024);
+
+	if (corpus == NULL) {
+		fprintf(stderr, "Not enough memory for the corpus\n");
+		exit(74);
+	}
+
+	size_t length = 0;
+
+	for (int i = 0; length < size; i++) {
+		int id = i % 1000; // Identifiers repeat, like they do in real code
+		length += (size_t) sprintf(corpus + length, corpus_snippet, id, id, id, id, id, id);
+	}
+
+	LitCompiler compiler;
+	lit_init_compiler(&compiler);
+
+	uint64_t tokens = 0;
+	double best = 0;
+
+	// The best of a few passes, the first one also pays for interning all the names
+	for (int pass = 0; pass < 5; pass++) {
+		clock_t start = clock();
+		tokens = 0;
+
+		lit_init_lexer(&compiler, &compiler.lexer, corpus);
+
+		while (lit_lexer_next_token(&compiler.lexer).type != TOKEN_EOF) {
+			tokens++;
+		}
+
+		double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+		if (pass == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+
+	double lexed = (double) length / (1024 * 1024);
+	printf("Lexed %.1f MB, %lu tokens in %.3f s: %.1f MB/s\n", lexed, (unsigned long) tokens, best, lexed / best);
+
+	lit_free_compiler(&compiler);
+	lit_free_bytecode_objects(&compiler);
+	free(corpus);
+}
+
 int main(int argc, char** argv) {
   if (argc == 1) {
   	show_repl();
   } else {
+	  LitOptions options;
+	  lit_init_options(&options);
+
+	  const char* output = NULL;
+	  const char* c_output = NULL;
+	  options.cache = default_cache();
+
 	  for (int i = 1; i < argc; i++) {
 		  char* arg = argv[i];
 
@@ -80,17 +200,76 @@ int main(int argc, char** argv) {
 				  if (i == argc - 1) {
 					  printf("Usage: lit -e [code]");
 				  } else {
-					  return lit_eval(argv[i + 1]) ? 0 : 2;
+					  return lit_eval_with_options(argv[i + 1], &options) ? 0 : 2;
 				  }
+			  } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--compile") == 0) {
+				  if (i == argc - 1) {
+					  printf("Usage: lit -c [output.litc] [file]");
+					  return -1;
+				  }
+
+				  output = argv[++i];
+			  } else if (strcmp(arg, "--emit-c") == 0) {
+				  if (i == argc - 1) {
+					  printf("Usage: lit --emit-c [output.c] [file]");
+					  return -1;
+				  }
+
+				  c_output = argv[++i];
+			  } else if (strcmp(arg, "--strip") == 0) {
+				  options.strip = true;
+			  } else if (strcmp(arg, "--bench-lexer") == 0) {
+				  benchmark_lexer(i == argc - 1 ? 64 : (size_t) atoi(argv[i + 1]));
+				  return 0;
+			  } else if (strcmp(arg, "--cache") == 0) {
+				  if (i == argc - 1) {
+					  printf("Usage: lit --cache [directory] [file]");
+					  return -1;
+				  }
+
+				  options.cache = argv[++i];
+			  } else if (strcmp(arg, "--no-cache") == 0) {
+				  options.cache = NULL;
+			  } else if (strcmp(arg, "--stats") == 0) {
+				  options.stats = true;
+			  } else if (strcmp(arg, "--no-optimize") == 0) {
+				  options.optimize = false;
+			  } else if (strcmp(arg, "--no-jit") == 0) {
+				  options.jit = false;
+			  } else if (strcmp(arg, "--profile") == 0) {
+				  if (i == argc - 1) {
+					  printf("Usage: lit --profile [file] [file]");
+					  return -1;
+				  }
+
+				  options.profile = argv[++i];
+			  } else if (strcmp(arg, "--inline-limit") == 0) {
+				  if (i == argc - 1) {
+					  printf("Usage: lit --inline-limit [nodes] [file]");
+					  return -1;
+				  }
+
+				  options.inline_limit = atoi(argv[++i]);
+			  } else if (strcmp(arg, "--trace-ast") == 0) {
+				  options.trace_ast = true;
 			  } else if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
 					show_help();
 			  } else {
 			  	printf("Unknown option %s! Run with -h for help.", arg);
 			  	return -1;
 			  }
+		  } else if (is_bytecode_file(arg)) {
+			  return lit_eval_bytecode(arg, &options) ? 0 : 2;
 		  } else {
 			  const char* source_code = read_file(arg);
-			  bool had_error = !lit_eval(source_code);
+			  bool had_error;
+
+			  if (c_output != NULL) {
+				  had_error = !lit_compile_to_c(source_code, c_output, &options);
+			  } else {
+				  had_error = output == NULL ? !lit_eval_with_options(source_code, &options) : !lit_compile_to_file(source_code, output, &options);
+			  }
+
 			  free((void*) source_code);
 
 			  return had_error ? 2 : 0;
@@ -74,7 +74,7 @@ LitGroupingExpression* lit_make_grouping_expression(LitCompiler* compiler, uint6
 	return expression;
 }
 
-LitVarExpression* lit_make_var_expression(LitCompiler* compiler, uint64_t line, const char* name) {
+LitVarExpression* lit_make_var_expression(LitCompiler* compiler, uint64_t line, LitString* name) {
 	LitVarExpression* expression = ALLOCATE_EXPRESSION(compiler, LitVarExpression, VAR_EXPRESSION);
 
 	expression->name = name;
@@ -106,11 +106,12 @@ LitCallExpression* lit_make_call_expression(LitCompiler* compiler, uint64_t line
 
 	expression->callee = callee;
 	expression->args = args;
+	expression->target = NULL;
 
 	return expression;
 }
 
-LitGetExpression* lit_make_get_expression(LitCompiler* compiler, uint64_t line, LitExpression* object, const char* property) {
+LitGetExpression* lit_make_get_expression(LitCompiler* compiler, uint64_t line, LitExpression* object, LitString* property) {
 	LitGetExpression* expression = ALLOCATE_EXPRESSION(compiler, LitGetExpression, GET_EXPRESSION);
 
 	expression->object = object;
@@ -120,7 +121,7 @@ LitGetExpression* lit_make_get_expression(LitCompiler* compiler, uint64_t line,
 	return expression;
 }
 
-LitSetExpression* lit_make_set_expression(LitCompiler* compiler, uint64_t line, LitExpression* object, LitExpression* value, const char* property) {
+LitSetExpression* lit_make_set_expression(LitCompiler* compiler, uint64_t line, LitExpression* object, LitExpression* value, LitString* property) {
 	LitSetExpression* expression = ALLOCATE_EXPRESSION(compiler, LitSetExpression, SET_EXPRESSION);
 
 	expression->object = object;
@@ -135,7 +136,7 @@ LitThisExpression* lit_make_this_expression(LitCompiler* compiler, uint64_t line
 	return ALLOCATE_EXPRESSION(compiler, LitThisExpression, THIS_EXPRESSION);
 }
 
-LitSuperExpression* lit_make_super_expression(LitCompiler* compiler, uint64_t line, const char* method) {
+LitSuperExpression* lit_make_super_expression(LitCompiler* compiler, uint64_t line, LitString* method) {
 	LitSuperExpression* expression = ALLOCATE_EXPRESSION(compiler, LitSuperExpression, SUPER_EXPRESSION);
 
 	expression->method = method;
@@ -165,7 +166,7 @@ LitLambdaExpression* lit_make_lambda_expression(LitCompiler* compiler, uint64_t
 	return expression;
 }
 
-LitVarStatement* lit_make_var_statement(LitCompiler* compiler, uint64_t line, const char* name, LitExpression* init, const char* type, bool final) {
+LitVarStatement* lit_make_var_statement(LitCompiler* compiler, uint64_t line, LitString* name, LitExpression* init, LitString* type, bool final) {
 	LitVarStatement* statement = ALLOCATE_STATEMENT(compiler, LitVarStatement, VAR_STATEMENT);
 
 	statement->name = name;
@@ -213,13 +214,15 @@ LitWhileStatement* lit_make_while_statement(LitCompiler* compiler, uint64_t line
 	return statement;
 }
 
-LitFunctionStatement* lit_make_function_statement(LitCompiler* compiler, uint64_t line, const char* name, LitParameters* parameters, LitStatement* body, LitParameter return_type) {
+LitFunctionStatement* lit_make_function_statement(LitCompiler* compiler, uint64_t line, LitString* name, LitParameters* parameters, LitStatement* body, LitParameter return_type) {
 	LitFunctionStatement* statement = ALLOCATE_STATEMENT(compiler, LitFunctionStatement, FUNCTION_STATEMENT);
 
 	statement->name = name;
 	statement->parameters = parameters;
 	statement->body = body;
 	statement->return_type = return_type;
+	statement->reassigned = false;
+	statement->closure = NULL;
 
 	return statement;
 }
@@ -232,7 +235,7 @@ LitReturnStatement* lit_make_return_statement(LitCompiler* compiler, uint64_t li
 	return statement;
 }
 
-LitFieldStatement* lit_make_field_statement(LitCompiler* compiler, uint64_t line, const char* name, LitExpression* init, const char* type,
+LitFieldStatement* lit_make_field_statement(LitCompiler* compiler, uint64_t line, LitString* name, LitExpression* init, LitString* type,
 	LitStatement* getter, LitStatement* setter, LitAccessType access, bool is_static, bool final) {
 
 	LitFieldStatement* statement = ALLOCATE_STATEMENT(compiler, LitFieldStatement, FIELD_STATEMENT);
@@ -249,7 +252,7 @@ LitFieldStatement* lit_make_field_statement(LitCompiler* compiler, uint64_t line
 	return statement;
 }
 
-LitMethodStatement* lit_make_method_statement(LitCompiler* compiler, uint64_t line, const char* name, LitParameters* parameters, LitStatement* body,
+LitMethodStatement* lit_make_method_statement(LitCompiler* compiler, uint64_t line, LitString* name, LitParameters* parameters, LitStatement* body,
 	LitParameter return_type, bool overriden, bool is_static, bool abstract, LitAccessType access) {
 
 	LitMethodStatement* statement = ALLOCATE_STATEMENT(compiler, LitMethodStatement, METHOD_STATEMENT);
@@ -262,11 +265,12 @@ LitMethodStatement* lit_make_method_statement(LitCompiler* compiler, uint64_t li
 	statement->is_static = is_static;
 	statement->abstract = abstract;
 	statement->access = access;
+	statement->closure = NULL;
 
 	return statement;
 }
 
-LitClassStatement* lit_make_class_statement(LitCompiler* compiler, uint64_t line, const char* name, LitVarExpression* super, LitMethods* methods,
+LitClassStatement* lit_make_class_statement(LitCompiler* compiler, uint64_t line, LitString* name, LitVarExpression* super, LitMethods* methods,
 		LitStatements* fields, bool abstract, bool is_static, bool final) {
 
 	LitClassStatement* statement = ALLOCATE_STATEMENT(compiler, LitClassStatement, CLASS_STATEMENT);
@@ -294,11 +298,6 @@ void lit_free_statement(LitCompiler* compiler, LitStatement* statement) {
 	switch (statement->type) {
 		case VAR_STATEMENT: {
 			LitVarStatement* stmt = (LitVarStatement*) statement;
-			reallocate(compiler, (void*) stmt->name, strlen(stmt->name) + 1, 0);
-
-			if (stmt->type != NULL) {
-				reallocate(compiler, (void*) stmt->type, strlen(stmt->type) + 1, 0);
-			}
 
 			if (stmt->init != NULL) {
 				lit_free_expression(compiler, stmt->init);
@@ -309,11 +308,6 @@ void lit_free_statement(LitCompiler* compiler, LitStatement* statement) {
 		}
 		case FIELD_STATEMENT: {
 			LitFieldStatement* stmt = (LitFieldStatement*) statement;
-			reallocate(compiler, (void*) stmt->name, strlen(stmt->name) + 1, 0);
-
-			/*if (stmt->type != NULL) {
-				reallocate(compiler, (void*) stmt->type, strlen(stmt->type) + 1, 0);
-			}*/ // Not sure if thats needed, crashes here, FIXME
 
 			if (stmt->init != NULL) {
 				lit_free_expression(compiler, stmt->init);
@@ -389,22 +383,10 @@ void lit_free_statement(LitCompiler* compiler, LitStatement* statement) {
 		}
 		case FUNCTION_STATEMENT: {
 			LitFunctionStatement* stmt = (LitFunctionStatement*) statement;
-			reallocate(compiler, (void*) stmt->name, strlen(stmt->name) + 1, 0);
-
-			if (strcmp(stmt->return_type.type, "void") != 0) {
-				reallocate(compiler, (void*) stmt->return_type.type, strlen(stmt->return_type.type) + 1, 0);
-			}
 
 			lit_free_statement(compiler, stmt->body);
 
 			if (stmt->parameters != NULL) {
-				for (int i = 0; i  < stmt->parameters->count; i++) {
-					LitParameter parameter = stmt->parameters->values[i];
-
-					reallocate(compiler, (void*) parameter.name, strlen(parameter.name) + 1, 0);
-					reallocate(compiler, (void*) parameter.type, strlen(parameter.type) + 1, 0);
-				}
-
 				lit_free_parameters(MM(compiler), stmt->parameters);
 				reallocate(compiler, (void*) stmt->parameters, sizeof(LitParameters), 0);
 			}
@@ -414,24 +396,12 @@ void lit_free_statement(LitCompiler* compiler, LitStatement* statement) {
 		}
 		case METHOD_STATEMENT: {
 			LitMethodStatement* stmt = (LitMethodStatement*) statement;
-			reallocate(compiler, (void*) stmt->name, strlen(stmt->name) + 1, 0);
-
-			if (strcmp(stmt->return_type.type, "void") != 0) {
-				reallocate(compiler, (void*) stmt->return_type.type, strlen(stmt->return_type.type) + 1, 0);
-			}
 
 			if (stmt->body != NULL) {
 				lit_free_statement(compiler, stmt->body);
 			}
 
 			if (stmt->parameters != NULL) {
-				for (int i = 0; i  < stmt->parameters->count; i++) {
-					LitParameter parameter = stmt->parameters->values[i];
-
-					reallocate(compiler, (void*) parameter.name, strlen(parameter.name) + 1, 0);
-					reallocate(compiler, (void*) parameter.type, strlen(parameter.type) + 1, 0);
-				}
-
 				lit_free_parameters(MM(compiler), stmt->parameters);
 				reallocate(compiler, (void*) stmt->parameters, sizeof(LitParameters), 0);
 			}
@@ -451,7 +421,6 @@ void lit_free_statement(LitCompiler* compiler, LitStatement* statement) {
 		}
 		case CLASS_STATEMENT: {
 			LitClassStatement* stmt = (LitClassStatement*) statement;
-			reallocate(compiler, (void*) stmt->name, strlen(stmt->name) + 1, 0);
 
 			if (stmt->fields != NULL) {
 				for (int i = 0; i < stmt->fields->count; i++) {
@@ -527,9 +496,6 @@ void lit_free_expression(LitCompiler* compiler, LitExpression* expression) {
 			break;
 		}
 		case VAR_EXPRESSION: {
-			LitVarExpression* expr = (LitVarExpression*) expression;
-
-			reallocate(compiler, (void*) expr->name, strlen(expr->name) + 1, 0);
 			reallocate(compiler, (void*) expression, sizeof(LitVarExpression), 0);
 
 			break;
@@ -570,20 +536,9 @@ void lit_free_expression(LitCompiler* compiler, LitExpression* expression) {
 		case LAMBDA_EXPRESSION: {
 			LitLambdaExpression* expr = (LitLambdaExpression*) expression;
 
-			if (strcmp(expr->return_type.type, "void") != 0) {
-				reallocate(compiler, (void*) expr->return_type.type, strlen(expr->return_type.type) + 1, 0);
-			}
-
 			lit_free_statement(compiler, expr->body);
 
 			if (expr->parameters != NULL) {
-				for (int i = 0; i  < expr->parameters->count; i++) {
-					LitParameter parameter = expr->parameters->values[i];
-
-					reallocate(compiler, (void*) parameter.name, strlen(parameter.name) + 1, 0);
-					reallocate(compiler, (void*) parameter.type, strlen(parameter.type) + 1, 0);
-				}
-
 				lit_free_parameters(MM(compiler), expr->parameters);
 				reallocate(compiler, (void*) expr->parameters, sizeof(LitParameters), 0);
 			}
@@ -595,7 +550,6 @@ void lit_free_expression(LitCompiler* compiler, LitExpression* expression) {
 			LitGetExpression* expr = (LitGetExpression*) expression;
 
 			lit_free_expression(compiler, expr->object);
-			reallocate(compiler, (void*) expr->property, strlen(expr->property) + 1, 0);
 			reallocate(compiler, (void*) expression, sizeof(LitGetExpression), 0);
 
 			break;
@@ -605,7 +559,6 @@ void lit_free_expression(LitCompiler* compiler, LitExpression* expression) {
 
 			lit_free_expression(compiler, expr->object);
 			lit_free_expression(compiler, expr->value);
-			reallocate(compiler, (void*) expr->property, strlen(expr->property) + 1, 0);
 			reallocate(compiler, (void*) expression, sizeof(LitSetExpression), 0);
 
 			break;
@@ -616,9 +569,6 @@ void lit_free_expression(LitCompiler* compiler, LitExpression* expression) {
 			break;
 		}
 		case SUPER_EXPRESSION: {
-			LitSuperExpression* expr = (LitSuperExpression*) expression;
-
-			reallocate(compiler, (void*) expr->method, strlen(expr->method) + 1, 0);
 			reallocate(compiler, (void*) expression, sizeof(LitSuperExpression), 0);
 
 			break;
@@ -0,0 +1,786 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+#include <compiler/lit_c_emitter.h>
+#include <compiler/lit_compiler.h>
+#include <vm/lit_bytecode.h>
+#include <vm/lit_memory.h>
+
+DEFINE_ARRAY(LitCLocals, LitCLocal, c_locals)
+DEFINE_ARRAY(LitCText, char, c_text)
+DEFINE_ARRAY(LitCFunctions, LitCFunction, c_functions)
+
+void lit_init_c_emitter(LitCompiler* compiler, LitCEmitter* emitter) {
+	emitter->compiler = compiler;
+	emitter->out = &emitter->text;
+	emitter->function = NULL;
+	emitter->local_id = 0;
+	emitter->depth = 0;
+
+	lit_init_c_functions(&emitter->functions);
+	lit_init_c_text(&emitter->text);
+	lit_init_c_locals(&emitter->locals);
+}
+
+void lit_free_c_emitter(LitCEmitter* emitter) {
+	lit_free_c_functions(MM(emitter->compiler), &emitter->functions);
+	lit_free_c_text(MM(emitter->compiler), &emitter->text);
+	lit_free_c_locals(MM(emitter->compiler), &emitter->locals);
+}
+
+static void write(LitCEmitter* emitter, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+
+	char buffer[length + 1];
+
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	for (int i = 0; i < length; i++) {
+		lit_c_text_write(MM(emitter->compiler), emitter->out, buffer[i]);
+	}
+}
+
+static void write_indent(LitCEmitter* emitter) {
+	for (int i = 0; i < emitter->depth; i++) {
+		write(emitter, "\t");
+	}
+}
+
+// Names in lit can have dots in them (see lit_scalar_name()), c names can't
+static void write_name(LitCEmitter* emitter, LitString* name, int id) {
+	for (int i = 0; i < name->length; i++) {
+		char c = name->chars[i];
+		write(emitter, "%c", (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ? c : '_');
+	}
+
+	write(emitter, "_%i", id);
+}
+
+static void write_function_name(LitCEmitter* emitter, LitCFunction* function) {
+	write(emitter, "lit_");
+	write_name(emitter, function->statement->name, (int) (function - emitter->functions.values));
+}
+
+// Always a double literal, so that c never does integer math
+static void write_number(LitCEmitter* emitter, double number) {
+	if (isnan(number)) {
+		write(emitter, "NAN");
+		return;
+	} else if (isinf(number)) {
+		write(emitter, number < 0 ? "(-INFINITY)" : "INFINITY");
+		return;
+	}
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.17g", number);
+
+	write(emitter, number < 0 || signbit(number) ? "(%s%s)" : "%s%s", buffer, strpbrk(buffer, ".e") == NULL ? ".0" : "");
+}
+
+static const char* c_type_name(LitCType type) {
+	switch (type) {
+		case C_TYPE_NUMBER: return "double";
+		case C_TYPE_BOOL: return "bool";
+		default: return "void";
+	}
+}
+
+static LitCType type_from_name(LitString* name, bool allow_void) {
+	if (name == NULL) {
+		return C_TYPE_NONE;
+	} else if (strcmp(name->chars, "int") == 0 || strcmp(name->chars, "double") == 0) {
+		return C_TYPE_NUMBER;
+	} else if (strcmp(name->chars, "bool") == 0) {
+		return C_TYPE_BOOL;
+	} else if (allow_void && strcmp(name->chars, "void") == 0) {
+		return C_TYPE_VOID;
+	}
+
+	return C_TYPE_NONE;
+}
+
+static LitCLocal* find_local(LitCEmitter* emitter, LitString* name) {
+	for (int i = emitter->locals.count - 1; i >= 0; i--) {
+		if (emitter->locals.values[i].name == name) {
+			return &emitter->locals.values[i];
+		}
+	}
+
+	return NULL;
+}
+
+static LitCLocal* add_local(LitCEmitter* emitter, LitString* name, LitCType type) {
+	LitCLocal local = { name, type, emitter->local_id++ };
+	lit_c_locals_write(MM(emitter->compiler), &emitter->locals, local);
+
+	return &emitter->locals.values[emitter->locals.count - 1];
+}
+
+// Only global functions, that are translated too, are called, locals hide them
+static LitCFunction* find_function(LitCEmitter* emitter, LitExpression* callee) {
+	if (callee->type != VAR_EXPRESSION) {
+		return NULL;
+	}
+
+	LitString* name = ((LitVarExpression*) callee)->name;
+
+	if (find_local(emitter, name) != NULL) {
+		return NULL;
+	}
+
+	for (int i = 0; i < emitter->functions.count; i++) {
+		LitCFunction* function = &emitter->functions.values[i];
+
+		if (function->translated && function->statement->name == name) {
+			return function;
+		}
+	}
+
+	return NULL;
+}
+
+static bool is_value(LitCType type) {
+	return type == C_TYPE_NUMBER || type == C_TYPE_BOOL;
+}
+
+static LitCType emit_expression(LitCEmitter* emitter, LitExpression* expression);
+
+static LitCType emit_number(LitCEmitter* emitter, LitExpression* expression) {
+	return emit_expression(emitter, expression) == C_TYPE_NUMBER ? C_TYPE_NUMBER : C_TYPE_NONE;
+}
+
+static LitCType emit_binary(LitCEmitter* emitter, LitBinaryExpression* expr) {
+	const char* function = NULL;
+	const char* operator = NULL;
+	bool comparison = false;
+
+	switch (expr->operator) {
+		case TOKEN_PLUS: operator = "+"; break;
+		case TOKEN_MINUS: operator = "-"; break;
+		case TOKEN_STAR: operator = "*"; break;
+		case TOKEN_SLASH: operator = "/"; break;
+		case TOKEN_PERCENT: function = "fmod"; break;
+		case TOKEN_CARET: function = "pow"; break;
+		case TOKEN_CELL: function = "pow"; break;
+		case TOKEN_GREATER: operator = ">"; comparison = true; break;
+		case TOKEN_GREATER_EQUAL: operator = ">="; comparison = true; break;
+		case TOKEN_LESS: operator = "<"; comparison = true; break;
+		case TOKEN_LESS_EQUAL: operator = "<="; comparison = true; break;
+
+		// Both sides have the same type, bools are never equal to numbers in lit
+		case TOKEN_EQUAL_EQUAL: case TOKEN_BANG_EQUAL: {
+			write(emitter, "(");
+			LitCType left = emit_expression(emitter, expr->left);
+			write(emitter, expr->operator == TOKEN_EQUAL_EQUAL ? " == " : " != ");
+			LitCType right = emit_expression(emitter, expr->right);
+			write(emitter, ")");
+
+			return is_value(left) && left == right ? C_TYPE_BOOL : C_TYPE_NONE;
+		}
+
+		default: return C_TYPE_NONE;
+	}
+
+	if (function != NULL) {
+		// a # b is the b-th root of a
+		write(emitter, "%s(", function);
+		bool numbers = emit_number(emitter, expr->left) != C_TYPE_NONE;
+		write(emitter, expr->operator == TOKEN_CELL ? ", 1.0 / " : ", ");
+		numbers &= emit_number(emitter, expr->right) != C_TYPE_NONE;
+		write(emitter, ")");
+
+		return numbers ? C_TYPE_NUMBER : C_TYPE_NONE;
+	}
+
+	write(emitter, "(");
+	bool numbers = emit_number(emitter, expr->left) != C_TYPE_NONE;
+	write(emitter, " %s ", operator);
+	numbers &= emit_number(emitter, expr->right) != C_TYPE_NONE;
+	write(emitter, ")");
+
+	if (!numbers) {
+		return C_TYPE_NONE;
+	}
+
+	return comparison ? C_TYPE_BOOL : C_TYPE_NUMBER;
+}
+
+static LitCType emit_call(LitCEmitter* emitter, LitCallExpression* expr) {
+	LitCFunction* function = find_function(emitter, expr->callee);
+
+	if (function == NULL) {
+		return C_TYPE_NONE;
+	}
+
+	LitParameters* parameters = function->statement->parameters;
+	int arg_count = expr->args == NULL ? 0 : expr->args->count;
+
+	if (arg_count != (parameters == NULL ? 0 : parameters->count)) {
+		return C_TYPE_NONE;
+	}
+
+	write_function_name(emitter, function);
+	write(emitter, "(");
+
+	for (int i = 0; i < arg_count; i++) {
+		if (i > 0) {
+			write(emitter, ", ");
+		}
+
+		if (emit_expression(emitter, expr->args->values[i]) != type_from_name(parameters->values[i].type, false)) {
+			return C_TYPE_NONE;
+		}
+	}
+
+	write(emitter, ")");
+	return function->return_type;
+}
+
+// Lit checks conditions with lit_is_false(), so 0 is false, like in c
+static bool emit_condition(LitCEmitter* emitter, LitExpression* expression) {
+	return is_value(emit_expression(emitter, expression));
+}
+
+static LitCType emit_if_expression(LitCEmitter* emitter, LitIfExpression* expr) {
+	write(emitter, "(");
+	bool valid = emit_condition(emitter, expr->condition);
+	write(emitter, " ? ");
+	LitCType type = emit_expression(emitter, expr->if_branch);
+	write(emitter, " : ");
+
+	int count = expr->else_if_branches == NULL ? 0 : expr->else_if_branches->count;
+
+	for (int i = 0; i < count; i++) {
+		valid &= emit_condition(emitter, expr->else_if_conditions->values[i]);
+		write(emitter, " ? ");
+		valid &= emit_expression(emitter, expr->else_if_branches->values[i]) == type;
+		write(emitter, " : ");
+	}
+
+	// Without an else branch the expression can be nil
+	valid &= expr->else_branch != NULL && emit_expression(emitter, expr->else_branch) == type;
+	write(emitter, ")");
+
+	return valid && is_value(type) ? type : C_TYPE_NONE;
+}
+
+static LitCType emit_expression(LitCEmitter* emitter, LitExpression* expression) {
+	switch (expression->type) {
+		case LITERAL_EXPRESSION: {
+			LitValue value = ((LitLiteralExpression*) expression)->value;
+
+			if (IS_NUMBER(value)) {
+				write_number(emitter, AS_NUMBER(value));
+				return C_TYPE_NUMBER;
+			} else if (IS_BOOL(value)) {
+				write(emitter, AS_BOOL(value) ? "true" : "false");
+				return C_TYPE_BOOL;
+			}
+
+			return C_TYPE_NONE;
+		}
+
+		case GROUPING_EXPRESSION: {
+			write(emitter, "(");
+			LitCType type = emit_expression(emitter, ((LitGroupingExpression*) expression)->expr);
+			write(emitter, ")");
+
+			return type;
+		}
+
+		case VAR_EXPRESSION: {
+			LitVarExpression* expr = (LitVarExpression*) expression;
+			LitCLocal* local = find_local(emitter, expr->name);
+
+			if (local == NULL) {
+				return C_TYPE_NONE;
+			}
+
+			write_name(emitter, local->name, local->id);
+			return local->type;
+		}
+
+		case ASSIGN_EXPRESSION: {
+			LitAssignExpression* expr = (LitAssignExpression*) expression;
+
+			if (expr->to->type != VAR_EXPRESSION) {
+				return C_TYPE_NONE;
+			}
+
+			LitCLocal* local = find_local(emitter, ((LitVarExpression*) expr->to)->name);
+
+			if (local == NULL) {
+				return C_TYPE_NONE;
+			}
+
+			LitCType type = local->type;
+
+			write(emitter, "(");
+			write_name(emitter, local->name, local->id);
+			write(emitter, " = ");
+			bool valid = emit_expression(emitter, expr->value) == type;
+			write(emitter, ")");
+
+			return valid ? type : C_TYPE_NONE;
+		}
+
+		case UNARY_EXPRESSION: {
+			LitUnaryExpression* expr = (LitUnaryExpression*) expression;
+
+			switch (expr->operator) {
+				case TOKEN_BANG: {
+					write(emitter, "!(");
+					bool valid = emit_condition(emitter, expr->right);
+					write(emitter, ")");
+
+					return valid ? C_TYPE_BOOL : C_TYPE_NONE;
+				}
+
+				case TOKEN_MINUS: case TOKEN_CELL: {
+					write(emitter, expr->operator == TOKEN_MINUS ? "-(" : "sqrt(");
+					LitCType type = emit_number(emitter, expr->right);
+					write(emitter, ")");
+
+					return type;
+				}
+
+				default: return C_TYPE_NONE;
+			}
+		}
+
+		case BINARY_EXPRESSION: return emit_binary(emitter, (LitBinaryExpression*) expression);
+
+		// And and or give back one of the operands, so only bools are the same in c
+		case LOGICAL_EXPRESSION: {
+			LitLogicalExpression* expr = (LitLogicalExpression*) expression;
+
+			write(emitter, "(");
+			bool valid = emit_expression(emitter, expr->left) == C_TYPE_BOOL;
+			write(emitter, expr->operator == TOKEN_AND ? " && " : " || ");
+			valid &= emit_expression(emitter, expr->right) == C_TYPE_BOOL;
+			write(emitter, ")");
+
+			return valid ? C_TYPE_BOOL : C_TYPE_NONE;
+		}
+
+		case IF_EXPRESSION: return emit_if_expression(emitter, (LitIfExpression*) expression);
+		case CALL_EXPRESSION: return emit_call(emitter, (LitCallExpression*) expression);
+
+		default: return C_TYPE_NONE;
+	}
+}
+
+static bool emit_statement(LitCEmitter* emitter, LitStatement* statement);
+
+static bool emit_statements(LitCEmitter* emitter, LitStatements* statements) {
+	int local_count = emitter->locals.count;
+	bool valid = true;
+
+	for (int i = 0; valid && statements != NULL && i < statements->count; i++) {
+		valid = emit_statement(emitter, statements->values[i]);
+	}
+
+	emitter->locals.count = local_count;
+	return valid;
+}
+
+// Statements, that are bodies of ifs and whiles, always get their own block
+static bool emit_body(LitCEmitter* emitter, LitStatement* statement) {
+	write(emitter, "{\n");
+	emitter->depth++;
+
+	bool valid = statement->type == BLOCK_STATEMENT ? emit_statements(emitter, ((LitBlockStatement*) statement)->statements) : emit_statement(emitter, statement);
+
+	emitter->depth--;
+	write_indent(emitter);
+	write(emitter, "}");
+
+	return valid;
+}
+
+static bool emit_statement(LitCEmitter* emitter, LitStatement* statement) {
+	write_indent(emitter);
+
+	switch (statement->type) {
+		case VAR_STATEMENT: {
+			LitVarStatement* stmt = (LitVarStatement*) statement;
+			LitCType type = type_from_name(stmt->type, false);
+
+			if (stmt->type != NULL && type == C_TYPE_NONE) {
+				return false;
+			}
+
+			LitCText init;
+			LitCText* out = emitter->out;
+
+			// The type of the local is only known after its init, and the init can't see the local
+			lit_init_c_text(&init);
+			emitter->out = &init;
+
+			LitCType init_type = C_TYPE_NONE;
+
+			if (stmt->init != NULL) {
+				init_type = emit_expression(emitter, stmt->init);
+			} else if (stmt->default_value == OP_CONSTANT) {
+				init_type = C_TYPE_NUMBER;
+				write(emitter, "0.0");
+			} else if (stmt->default_value == OP_FALSE) {
+				init_type = C_TYPE_BOOL;
+				write(emitter, "false");
+			}
+
+			emitter->out = out;
+
+			if (!is_value(init_type) || (type != C_TYPE_NONE && init_type != type)) {
+				lit_free_c_text(MM(emitter->compiler), &init);
+				return false;
+			}
+
+			LitCLocal* local = add_local(emitter, stmt->name, init_type);
+
+			write(emitter, "%s ", c_type_name(init_type));
+			write_name(emitter, local->name, local->id);
+			write(emitter, " = %.*s;\n", init.count, init.values);
+			lit_free_c_text(MM(emitter->compiler), &init);
+
+			return true;
+		}
+
+		case EXPRESSION_STATEMENT: {
+			bool valid = emit_expression(emitter, ((LitExpressionStatement*) statement)->expr) != C_TYPE_NONE;
+			write(emitter, ";\n");
+
+			return valid;
+		}
+
+		case IF_STATEMENT: {
+			LitIfStatement* stmt = (LitIfStatement*) statement;
+
+			write(emitter, "if (");
+			bool valid = emit_condition(emitter, stmt->condition);
+			write(emitter, ") ");
+			valid &= emit_body(emitter, stmt->if_branch);
+
+			for (int i = 0; valid && stmt->else_if_branches != NULL && i < stmt->else_if_branches->count; i++) {
+				write(emitter, " else if (");
+				valid &= emit_condition(emitter, stmt->else_if_conditions->values[i]);
+				write(emitter, ") ");
+				valid &= emit_body(emitter, stmt->else_if_branches->values[i]);
+			}
+
+			if (stmt->else_branch != NULL) {
+				write(emitter, " else ");
+				valid &= emit_body(emitter, stmt->else_branch);
+			}
+
+			write(emitter, "\n");
+			return valid;
+		}
+
+		case BLOCK_STATEMENT: {
+			write(emitter, "{\n");
+			emitter->depth++;
+
+			bool valid = emit_statements(emitter, ((LitBlockStatement*) statement)->statements);
+
+			emitter->depth--;
+			write_indent(emitter);
+			write(emitter, "}\n");
+
+			return valid;
+		}
+
+		case WHILE_STATEMENT: {
+			LitWhileStatement* stmt = (LitWhileStatement*) statement;
+
+			write(emitter, "while (");
+			bool valid = emit_condition(emitter, stmt->condition);
+			write(emitter, ") ");
+			valid &= emit_body(emitter, stmt->body);
+			write(emitter, "\n");
+
+			return valid;
+		}
+
+		case RETURN_STATEMENT: {
+			LitReturnStatement* stmt = (LitReturnStatement*) statement;
+
+			if (stmt->value == NULL) {
+				write(emitter, "return;\n");
+				return emitter->function->return_type == C_TYPE_VOID;
+			}
+
+			write(emitter, "return ");
+			bool valid = emit_expression(emitter, stmt->value) == emitter->function->return_type;
+			write(emitter, ";\n");
+
+			return valid;
+		}
+
+		case BREAK_STATEMENT: write(emitter, "break;\n"); return true;
+		case CONTINUE_STATEMENT: write(emitter, "continue;\n"); return true;
+
+		default: return false;
+	}
+}
+
+// The bytecode returns nil, when a function falls off its end, a double can't be nil
+static bool always_returns(LitStatement* statement) {
+	switch (statement->type) {
+		case RETURN_STATEMENT: return true;
+
+		case BLOCK_STATEMENT: {
+			LitStatements* statements = ((LitBlockStatement*) statement)->statements;
+			return statements != NULL && statements->count > 0 && always_returns(statements->values[statements->count - 1]);
+		}
+
+		case IF_STATEMENT: {
+			LitIfStatement* stmt = (LitIfStatement*) statement;
+
+			if (stmt->else_branch == NULL || !always_returns(stmt->if_branch) || !always_returns(stmt->else_branch)) {
+				return false;
+			}
+
+			for (int i = 0; stmt->else_if_branches != NULL && i < stmt->else_if_branches->count; i++) {
+				if (!always_returns(stmt->else_if_branches->values[i])) {
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		default: return false;
+	}
+}
+
+static void emit_signature(LitCEmitter* emitter, LitCFunction* function) {
+	LitParameters* parameters = function->statement->parameters;
+
+	emitter->locals.count = 0;
+	emitter->local_id = 0;
+
+	write(emitter, "static %s ", c_type_name(function->return_type));
+	write_function_name(emitter, function);
+	write(emitter, "(");
+
+	if (parameters == NULL || parameters->count == 0) {
+		write(emitter, "void");
+	}
+
+	for (int i = 0; parameters != NULL && i < parameters->count; i++) {
+		LitCLocal* local = add_local(emitter, parameters->values[i].name, type_from_name(parameters->values[i].type, false));
+
+		write(emitter, i == 0 ? "%s " : ", %s ", c_type_name(local->type));
+		write_name(emitter, local->name, local->id);
+	}
+
+	write(emitter, ")");
+}
+
+// Returns false, if the body needs anything, but numbers, bools and other translated functions
+static bool emit_function(LitCEmitter* emitter, LitCFunction* function, LitCText* out) {
+	emitter->out = out;
+	emitter->function = function;
+	emitter->depth = 0;
+
+	emit_signature(emitter, function);
+	write(emitter, " ");
+
+	bool valid = emit_body(emitter, function->statement->body);
+	write(emitter, "\n\n");
+
+	emitter->out = &emitter->text;
+	emitter->function = NULL;
+
+	return valid;
+}
+
+static bool is_candidate(LitFunctionStatement* statement) {
+	LitParameters* parameters = statement->parameters;
+
+	if (statement->reassigned || type_from_name(statement->return_type.type, true) == C_TYPE_NONE) {
+		return false;
+	}
+
+	for (int i = 0; parameters != NULL && i < parameters->count; i++) {
+		if (type_from_name(parameters->values[i].type, false) == C_TYPE_NONE) {
+			return false;
+		}
+	}
+
+	return type_from_name(statement->return_type.type, true) == C_TYPE_VOID || always_returns(statement->body);
+}
+
+// The vm finds the function by its constant, the name is checked too
+static int find_constant(LitFunction* script, LitFunctionStatement* statement) {
+	LitArray* constants = &script->chunk.constants;
+
+	for (int i = 0; statement->closure != NULL && i < constants->count; i++) {
+		if (constants->values[i] == MAKE_OBJECT_VALUE(statement->closure->function)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void emit_entry(LitCEmitter* emitter, LitCFunction* function) {
+	LitParameters* parameters = function->statement->parameters;
+	int index = (int) (function - emitter->functions.values);
+
+	write(emitter, "static LitValue enter_");
+	write_name(emitter, function->statement->name, index);
+	write(emitter, "(LitValue* args) {\n\t");
+
+	// The c code computes in doubles, an int function gives back an int, if the double is a whole one, like the vm would
+	switch (function->return_type) {
+		case C_TYPE_NUMBER: {
+			bool integer = strcmp(function->statement->return_type.type->chars, "int") == 0;
+			write(emitter, integer ? "return MAKE_FITTING_NUMBER_VALUE(" : "return MAKE_NUMBER_VALUE(");
+
+			break;
+		}
+
+		case C_TYPE_BOOL: write(emitter, "return MAKE_BOOL_VALUE("); break;
+		default: write(emitter, "("); break;
+	}
+
+	write_function_name(emitter, function);
+	write(emitter, "(");
+
+	for (int i = 0; parameters != NULL && i < parameters->count; i++) {
+		const char* convert = type_from_name(parameters->values[i].type, false) == C_TYPE_BOOL ? "AS_BOOL" : "AS_NUMBER";
+		write(emitter, i == 0 ? "%s(args[%i])" : ", %s(args[%i])", convert, i);
+	}
+
+	write(emitter, "));\n");
+
+	if (function->return_type == C_TYPE_VOID) {
+		write(emitter, "\treturn NIL_VALUE;\n");
+	}
+
+	write(emitter, "}\n\n");
+}
+
+void lit_emit_c_functions(LitCEmitter* emitter, LitStatements* statements, LitFunction* script) {
+	for (int i = 0; i < statements->count; i++) {
+		if (statements->values[i]->type == FUNCTION_STATEMENT && is_candidate((LitFunctionStatement*) statements->values[i])) {
+			LitFunctionStatement* statement = (LitFunctionStatement*) statements->values[i];
+			LitCFunction function = { statement, type_from_name(statement->return_type.type, true), true, find_constant(script, statement) };
+
+			lit_c_functions_write(MM(emitter->compiler), &emitter->functions, function);
+		}
+	}
+
+	// A function, that can't be translated, takes the ones, that call it, down too, until nothing changes
+	bool changed = true;
+
+	while (changed) {
+		changed = false;
+
+		for (int i = 0; i < emitter->functions.count; i++) {
+			LitCFunction* function = &emitter->functions.values[i];
+
+			if (function->translated) {
+				LitCText scratch;
+				lit_init_c_text(&scratch);
+
+				if (!emit_function(emitter, function, &scratch)) {
+					function->translated = false;
+					changed = true;
+				}
+
+				lit_free_c_text(MM(emitter->compiler), &scratch);
+			}
+		}
+	}
+
+	for (int i = 0; i < emitter->functions.count; i++) {
+		if (emitter->functions.values[i].translated) {
+			emit_signature(emitter, &emitter->functions.values[i]);
+			write(emitter, ";\n");
+		}
+	}
+
+	write(emitter, "\n");
+
+	for (int i = 0; i < emitter->functions.count; i++) {
+		if (emitter->functions.values[i].translated) {
+			emit_function(emitter, &emitter->functions.values[i], &emitter->text);
+		}
+	}
+
+	for (int i = 0; i < emitter->functions.count; i++) {
+		LitCFunction* function = &emitter->functions.values[i];
+
+		if (function->translated && function->constant != -1) {
+			emit_entry(emitter, function);
+		}
+	}
+
+	write(emitter, "static LitCompiledRegistry compiled[] = {\n");
+
+	for (int i = 0; i < emitter->functions.count; i++) {
+		LitCFunction* function = &emitter->functions.values[i];
+
+		if (function->translated && function->constant != -1) {
+			write(emitter, "\t{ %i, \"%s\", enter_", function->constant, function->statement->name->chars);
+			write_name(emitter, function->statement->name, i);
+			write(emitter, " },\n");
+		}
+	}
+
+	write(emitter, "\t{ 0, NULL, NULL }\n};\n\n");
+}
+
+bool lit_write_c(LitCEmitter* emitter, LitFunction* script, const char* path, bool debug) {
+	LitBytecode bytecode;
+
+	if (!lit_serialize_bytecode(MM(emitter->compiler), script, path, debug, &bytecode)) {
+		return false;
+	}
+
+	FILE* file = fopen(path, "w");
+
+	if (file == NULL) {
+		fprintf(stderr, "Could not write the file %s\n", path);
+		lit_free_serialized_bytecode(MM(emitter->compiler), &bytecode);
+
+		return false;
+	}
+
+	fprintf(file, "// Translated by lit --emit-c, build it with the lit_runtime library:\n");
+	fprintf(file, "// cc -O2 -Ilit/include program.c liblit_runtime.a -lm\n\n");
+	fprintf(file, "#include <math.h>\n\n#include <lit.h>\n\n");
+	fwrite(emitter->text.values, 1, (size_t) emitter->text.count, file);
+
+	// The runtime reads the structures of the bytecode right from the array
+	fprintf(file, "static const uint8_t bytecode[%lu] __attribute__((aligned(8))) = {", (unsigned long) bytecode.size);
+
+	for (size_t i = 0; i < bytecode.size; i++) {
+		fprintf(file, i % 16 == 0 ? "\n\t0x%02x," : " 0x%02x,", bytecode.data[i]);
+	}
+
+	fprintf(file, "\n};\n\n");
+	fprintf(file, "int main(int argc, char** argv) {\n");
+	fprintf(file, "\treturn lit_eval_compiled(bytecode, sizeof(bytecode), compiled) ? 0 : 2;\n");
+	fprintf(file, "}\n");
+
+	bool written = !ferror(file);
+
+	if (fclose(file) != 0 || !written) {
+		fprintf(stderr, "Could not write the file %s\n", path);
+		written = false;
+	}
+
+	lit_free_serialized_bytecode(MM(emitter->compiler), &bytecode);
+	return written;
+}
\ No newline at end of file
@@ -5,6 +5,19 @@
 #include <compiler/lit_compiler.h>
 #include <compiler/lit_parser.h>
 #include <compiler/lit_resolver.h>
+#include <compiler/lit_optimizer.h>
+#include <compiler/lit_c_emitter.h>
+
+void lit_init_options(LitOptions* options) {
+	options->optimize = true;
+	options->trace_ast = false;
+	options->stats = false;
+	options->strip = false;
+	options->jit = true;
+	options->inline_limit = 16;
+	options->cache = NULL;
+	options->profile = NULL;
+}
 
 void lit_init_compiler(LitCompiler* compiler) {
 	LitMemManager* manager = (LitMemManager*) compiler;
@@ -16,11 +29,15 @@ void lit_init_compiler(LitCompiler* compiler) {
 	lit_init_table(&manager->strings);
 
 	compiler->init_string = lit_copy_string(manager, "init", 4);
+	compiler->this_string = lit_copy_string(manager, "this", 4);
 	compiler->resolver.compiler = compiler;
 	lit_init_resolver(&compiler->resolver);
 	lit_init_resolver_locals(&compiler->resolver.externals);
 
 	lit_init_emitter(compiler, &compiler->emitter);
+	lit_init_options(&compiler->options);
+	compiler->inliner = NULL;
+	compiler->c_emitter = NULL;
 }
 
 void lit_free_compiler(LitCompiler* compiler) {
@@ -44,6 +61,7 @@ void lit_free_bytecode_objects(LitCompiler* compiler) {
 /*
  * Splits source code into tokens and converts them to AST tree
  * Then resolves the AST tree (finds non existing vars, etc)
+ * Optimizes it, if it is enabled in the options
  * And emits it into bytecode
  */
 
@@ -62,7 +80,7 @@ LitFunction* lit_compile(LitCompiler* compiler, const char* source_code) {
 		return NULL; // Parsing error
 	}
 
-	if (DEBUG_TRACE_AST) {
+	if (DEBUG_TRACE_AST || compiler->options.trace_ast) {
 		printf("[\n");
 
 		for (int i = 0; i < statements.count; i++) {
@@ -85,8 +103,16 @@ LitFunction* lit_compile(LitCompiler* compiler, const char* source_code) {
 		return NULL; // Resolving error
 	}
 
+	if (compiler->options.optimize) {
+		lit_optimize(compiler, &statements);
+	}
+
 	LitFunction* function = lit_emit(&compiler->emitter, &statements);
 
+	if (compiler->c_emitter != NULL) {
+		lit_emit_c_functions(compiler->c_emitter, &statements, function);
+	}
+
 	if (DEBUG_TRACE_CODE) {
 		lit_trace_chunk(MM(compiler), &function->chunk, "$main");
 	}
@@ -103,14 +129,11 @@ void lit_compiler_define_native(LitCompiler* compiler, LitNativeRegistry* native
 	LitString* str = lit_copy_string(MM(compiler), native->name, (int) strlen(native->name));
 	LitResolverLocal* letal = (LitResolverLocal*) reallocate(compiler, NULL, 0, sizeof(LitResolverLocal));
 
-	size_t len = strlen(native->signature);
-	char* tp = (char*) reallocate(compiler, NULL, 0, len);
-	strncpy(tp, native->signature, len);
-
-	letal->type = tp;
+	letal->type = lit_resolver_type(&compiler->resolver, native->signature);
 	letal->defined = true;
 	letal->nil = false;
 	letal->field = false;
+	letal->function = NULL;
 
 	lit_resolver_locals_set(MM(compiler), &compiler->resolver.externals, str, letal);
 }
@@ -139,13 +162,7 @@ LitType* lit_compiler_define_class(LitCompiler* compiler, const char* name, LitT
 	lit_classes_set(MM(compiler), &compiler->resolver.classes, type->name, type);
 	lit_types_set(MM(compiler), &compiler->resolver.types, type->name, true);
 
-	LitResolverLocal* local = (LitResolverLocal*) reallocate(compiler, NULL, 0, sizeof(LitResolverLocal));
-	lit_init_resolver_local(local);
-
-	local->defined = true;
-	local->type = lit_format_string(MM(compiler), "Class<$>", type->name->chars)->chars;
-
-	lit_resolver_locals_set(MM(compiler), compiler->resolver.scopes.values[0], type->name, local);
+	lit_resolver_define_global(&compiler->resolver, type->name, lit_resolver_type(&compiler->resolver, lit_format_string(MM(compiler), "Class<$>", type->name->chars)->chars));
 
 	if (super != NULL) {
 		lit_resolver_methods_add_all(MM(compiler), &type->methods, &super->methods);
@@ -171,11 +188,12 @@ LitResolverNativeMethod* lit_compiler_define_method(LitCompiler* compiler, LitTy
 	m->function = method;
 	LitResolverMethod* mt = (LitResolverMethod*) m;
 
-	mt->signature = (char *) signature;
+	mt->signature = lit_resolver_type(&compiler->resolver, signature);
 	mt->is_static = is_static;
 	mt->access = PUBLIC_ACCESS;
 	mt->abstract = false;
 	mt->is_overriden = false;
+	mt->statement = NULL;
 	mt->name = lit_copy_string(MM(compiler), name, strlen(name));
 
 	lit_resolver_methods_set(MM(compiler), mt->is_static ? &class->static_methods : &class->methods, lit_copy_string(MM(compiler), name, strlen(name)), mt);
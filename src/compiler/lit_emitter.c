@@ -6,6 +6,7 @@
 #include <lit_debug.h>
 
 #include <compiler/lit_emitter.h>
+#include <compiler/lit_peephole.h>
 #include <vm/lit_memory.h>
 #include <compiler/lit_ast.h>
 
@@ -45,6 +46,15 @@ static uint8_t make_constant(LitEmitter* emitter, LitValue value) {
 	return (uint8_t) constant;
 }
 
+// Called, when the function body is fully emitted
+static void optimize_function(LitEmitter* emitter, LitFunction* function) {
+	if (emitter->compiler->options.optimize && !emitter->had_error) {
+		lit_optimize_chunk(emitter->compiler, &function->chunk);
+	}
+
+	lit_chunk_pack_lines(MM(emitter->compiler), &function->chunk);
+}
+
 static void emit_constant(LitEmitter* emitter, LitValue constant, uint64_t line) {
 	emit_bytes(emitter, OP_CONSTANT, make_constant(emitter, constant), line);
 }
@@ -56,13 +66,6 @@ static uint64_t emit_jump(LitEmitter* emitter, uint8_t instruction, uint64_t lin
 	return emitter->function->function->chunk.count - 2;
 }
 
-static uint64_t emit_jump_instant(LitEmitter* emitter, uint8_t instruction, uint64_t jump, uint64_t line) {
-	emit_byte(emitter, instruction, line);
-	emit_bytes(emitter, (uint8_t) ((jump >> 8) & 0xff), (uint8_t) (jump & 0xff), line);
-
-	return emitter->function->function->chunk.count - 2;
-}
-
 static void patch_jump(LitEmitter* emitter, uint64_t offset) {
 	LitChunk* chunk = &emitter->function->function->chunk;
 	uint64_t jump = chunk->count - offset - 2;
@@ -87,11 +90,12 @@ static void emit_loop(LitEmitter* emitter, uint64_t loop_start, uint64_t line) {
 	emit_bytes(emitter, (uint8_t) ((offset >> 8) & 0xff), (uint8_t) (offset & 0xff), line);
 }
 
-static int resolve_local(LitEmitterFunction* function, const char* name) {
+static int resolve_local(LitEmitterFunction* function, LitString* name) {
 	for (int i = function->local_count - 1; i >= 0; i--) {
 		LitLocal* local = &function->locals[i];
 
-		if (strcmp(name, local->name) == 0) {
+		// Names are interned by the lexer
+		if (name == local->name) {
 			return i;
 		}
 	}
@@ -100,10 +104,11 @@ static int resolve_local(LitEmitterFunction* function, const char* name) {
 }
 
 static int add_upvalue(LitEmitter* emitter, LitEmitterFunction* function, uint8_t index, bool is_local);
-static int add_local(LitEmitter* emitter, const char* name);
+static int add_local(LitEmitter* emitter, LitString* name);
 static void emit_statement(LitEmitter* emitter, LitStatement* statement);
+static void emit_expression(LitEmitter* emitter, LitExpression* expression);
 
-static int resolve_upvalue(LitEmitter* emitter, LitEmitterFunction* function, char* name) {
+static int resolve_upvalue(LitEmitter* emitter, LitEmitterFunction* function, LitString* name) {
 	if (function->enclosing == NULL) {
 		return -1;
 	}
@@ -124,6 +129,83 @@ static int resolve_upvalue(LitEmitter* emitter, LitEmitterFunction* function, ch
 	return -1;
 }
 
+// Global functions and methods get their closure, once they are declared or called, whatever is emitted first
+static LitClosure* get_direct_closure(LitEmitter* emitter, LitStatement* target) {
+	LitClosure** closure = target->type == FUNCTION_STATEMENT ? &((LitFunctionStatement*) target)->closure : &((LitMethodStatement*) target)->closure;
+
+	if (*closure == NULL) {
+		*closure = lit_new_closure(MM(emitter->compiler), lit_new_function(MM(emitter->compiler)));
+	}
+
+	return *closure;
+}
+
+/*
+ * The target is referenced as a constant, so nothing is looked up at runtime
+ * The slot below the arguments, where the callee usually is, stays empty
+ */
+static void emit_direct_call(LitEmitter* emitter, LitCallExpression* expr, bool tail) {
+	uint64_t line = expr->expression.line;
+	bool method = expr->target->type == METHOD_STATEMENT;
+
+	if (expr->callee->type == GET_EXPRESSION) {
+		LitGetExpression* get = (LitGetExpression*) expr->callee;
+		emit_expression(emitter, get->object);
+
+		if (get->emit_static_init) {
+			emit_byte(emitter, OP_STATIC_INIT, line);
+		}
+	} else if (expr->callee->type == SUPER_EXPRESSION) {
+		emit_bytes(emitter, OP_GET_LOCAL, 0, line);
+	}
+
+	emit_byte(emitter, OP_NIL, line);
+	int arg_count = expr->args == NULL ? 0 : expr->args->count;
+
+	for (int i = 0; i < arg_count; i++) {
+		emit_expression(emitter, expr->args->values[i]);
+	}
+
+	uint8_t constant = make_constant(emitter, MAKE_OBJECT_VALUE(get_direct_closure(emitter, expr->target)));
+
+	emit_bytes(emitter, method ? OP_INVOKE_DIRECT : (tail ? OP_TAIL_CALL_DIRECT : OP_CALL_DIRECT), constant, line);
+	emit_byte(emitter, (uint8_t) arg_count, line);
+}
+
+// Tail calls reuse the frame of the caller, if the callee is a closure, OP_RETURN after them handles the rest
+static void emit_call(LitEmitter* emitter, LitCallExpression* expr, bool tail) {
+	LitStatement* target = expr->target;
+
+	if (target != NULL && !(target->type == FUNCTION_STATEMENT && ((LitFunctionStatement*) target)->reassigned)) {
+		emit_direct_call(emitter, expr, tail);
+		return;
+	}
+
+	if (expr->callee->type == GET_EXPRESSION) {
+		emit_expression(emitter, ((LitGetExpression*) expr->callee)->object);
+	}
+
+	emit_expression(emitter, expr->callee);
+
+	if (expr->args != NULL) {
+		for (int i = 0; i < expr->args->count; i++) {
+			emit_expression(emitter, expr->args->values[i]);
+		}
+	}
+
+	if (expr->callee->type == GET_EXPRESSION) {
+		emit_byte(emitter, OP_INVOKE, expr->expression.line);
+	} else {
+		emit_byte(emitter, tail ? OP_TAIL_CALL : OP_CALL, expr->expression.line);
+	}
+
+	if (expr->args != NULL) {
+		emit_byte(emitter, (uint8_t) expr->args->count, expr->expression.line);
+	} else {
+		emit_byte(emitter, 0, expr->expression.line);
+	}
+}
+
 static void emit_expression(LitEmitter* emitter, LitExpression* expression) {
 	switch (expression->type) {
 		case BINARY_EXPRESSION: {
@@ -180,12 +262,12 @@ static void emit_expression(LitEmitter* emitter, LitExpression* expression) {
 			if (local != -1) {
 				emit_bytes(emitter, OP_GET_LOCAL, (uint8_t) local, expression->line);
 			} else {
-				int upvalue = resolve_upvalue(emitter, emitter->function, (char*) expr->name);
+				int upvalue = resolve_upvalue(emitter, emitter->function, expr->name);
 
 				if (upvalue != -1) {
 					emit_bytes(emitter, OP_GET_UPVALUE, (uint8_t) upvalue, expression->line);
 				} else {
-					emit_bytes(emitter, OP_GET_GLOBAL, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), expr->name, strlen(expr->name)))), expression->line);
+					emit_bytes(emitter, OP_GET_GLOBAL, make_constant(emitter, MAKE_OBJECT_VALUE(expr->name)), expression->line);
 				}
 			}
 
@@ -200,7 +282,7 @@ static void emit_expression(LitEmitter* emitter, LitExpression* expression) {
 				emit_expression(emitter, e->object);
 				emit_expression(emitter, expr->value);
 
-				emit_bytes(emitter, OP_SET_FIELD, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), e->property, strlen(e->property)))), expression->line);
+				emit_bytes(emitter, OP_SET_FIELD, make_constant(emitter, MAKE_OBJECT_VALUE(e->property)), expression->line);
 			} else {
 				LitVarExpression *e = (LitVarExpression*) expr->to;
 
@@ -210,13 +292,12 @@ static void emit_expression(LitEmitter* emitter, LitExpression* expression) {
 				if (local != -1) {
 					emit_bytes(emitter, OP_SET_LOCAL, (uint8_t) local, expression->line);
 				} else {
-					int upvalue = resolve_upvalue(emitter, emitter->function, (char *) e->name);
+					int upvalue = resolve_upvalue(emitter, emitter->function, e->name);
 
 					if (upvalue != -1) {
 						emit_bytes(emitter, OP_SET_UPVALUE, (uint8_t) upvalue, expression->line);
 					} else {
-						emit_bytes(emitter, OP_SET_GLOBAL, make_constant(emitter, MAKE_OBJECT_VALUE(
-							lit_copy_string(MM(emitter->compiler), e->name, strlen(e->name)))), expression->line);
+						emit_bytes(emitter, OP_SET_GLOBAL, make_constant(emitter, MAKE_OBJECT_VALUE(e->name)), expression->line);
 					}
 				}
 			}
@@ -256,32 +337,7 @@ static void emit_expression(LitEmitter* emitter, LitExpression* expression) {
 			break;
 		}
 		case CALL_EXPRESSION: {
-			LitCallExpression* expr = (LitCallExpression*) expression;
-
-			if (expr->callee->type == GET_EXPRESSION) {
-				emit_expression(emitter, ((LitGetExpression*) expr->callee)->object);
-			}
-
-			emit_expression(emitter, expr->callee);
-
-			if (expr->args != NULL) {
-				for (int i = 0; i < expr->args->count; i++) {
-					emit_expression(emitter, expr->args->values[i]);
-				}
-			}
-
-			if (expr->callee->type == GET_EXPRESSION) {
-				emit_byte(emitter, OP_INVOKE, expression->line);
-			} else {
-				emit_byte(emitter, OP_CALL, expression->line);
-			}
-
-			if (expr->args != NULL) {
-				emit_byte(emitter, (uint8_t) expr->args->count, expression->line);
-			} else {
-				emit_byte(emitter, 0, expression->line);
-			}
-
+			emit_call(emitter, (LitCallExpression*) expression, false);
 			break;
 		}
 		case GET_EXPRESSION: {
@@ -292,7 +348,7 @@ static void emit_expression(LitEmitter* emitter, LitExpression* expression) {
 			}
 
 			emit_expression(emitter, expr->object);
-			emit_bytes(emitter, OP_GET_FIELD, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), expr->property, strlen(expr->property)))), expression->line);
+			emit_bytes(emitter, OP_GET_FIELD, make_constant(emitter, MAKE_OBJECT_VALUE(expr->property)), expression->line);
 
 			break;
 		}
@@ -306,7 +362,7 @@ static void emit_expression(LitEmitter* emitter, LitExpression* expression) {
 			}
 
 			emit_expression(emitter, expr->value);
-			emit_bytes(emitter, OP_SET_FIELD, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), expr->property, strlen(expr->property)))), expression->line);
+			emit_bytes(emitter, OP_SET_FIELD, make_constant(emitter, MAKE_OBJECT_VALUE(expr->property)), expression->line);
 
 			break;
 		}
@@ -333,6 +389,7 @@ static void emit_expression(LitEmitter* emitter, LitExpression* expression) {
 			}
 
 			emit_statement(emitter, expr->body);
+			optimize_function(emitter, function.function);
 
 			if (DEBUG_TRACE_CODE) {
 				lit_trace_chunk(MM(emitter->compiler), &function.function->chunk, "lambda");
@@ -354,7 +411,7 @@ static void emit_expression(LitEmitter* emitter, LitExpression* expression) {
 		}
 		case SUPER_EXPRESSION: {
 			LitSuperExpression* expr = (LitSuperExpression*) expression;
-			emit_bytes(emitter, OP_SUPER, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), expr->method, strlen(expr->method)))), expression->line);
+			emit_bytes(emitter, OP_SUPER, make_constant(emitter, MAKE_OBJECT_VALUE(expr->method)), expression->line);
 
 			break;
 		}
@@ -435,13 +492,13 @@ static int add_upvalue(LitEmitter* emitter, LitEmitterFunction* function, uint8_
 	return function->function->upvalue_count++;
 }
 
-static int add_local(LitEmitter* emitter, const char* name) {
+static int add_local(LitEmitter* emitter, LitString* name) {
 	if (emitter->function->local_count == UINT8_COUNT) {
 		error(emitter, "Too many local variables in function");
 		return -1;
 	}
 
-	if (strcmp(name, "this") == 0) {
+	if (name == emitter->compiler->this_string) {
 		LitLocal* local = &emitter->function->locals[0];
 
 		local->name = name;
@@ -462,6 +519,13 @@ static int add_local(LitEmitter* emitter, const char* name) {
 	}
 }
 
+// Emits the pops for the locals above the count, the captured ones are closed instead
+static void pop_locals(LitEmitter* emitter, int count, uint64_t line) {
+	for (int i = emitter->function->local_count - 1; i >= count; i--) {
+		emit_byte(emitter, emitter->function->locals[i].upvalue ? OP_CLOSE_UPVALUE : OP_POP, line);
+	}
+}
+
 static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 	switch (statement->type) {
 		case VAR_STATEMENT: {
@@ -471,14 +535,14 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 				emit_expression(emitter, stmt->init);
 			} else {
 				if (stmt->default_value == OP_CONSTANT) {
-					emit_constant(emitter, MAKE_NUMBER_VALUE(0), statement->line);
+					emit_constant(emitter, strcmp(stmt->type->chars, "double") == 0 ? MAKE_NUMBER_VALUE(0) : MAKE_INT_VALUE(0), statement->line);
 				} else {
 					emit_byte(emitter, stmt->default_value, statement->line);
 				}
 			}
 
 			if (emitter->function->depth == 0) {
-				int str = make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), stmt->name, strlen(stmt->name))));
+				int str = make_constant(emitter, MAKE_OBJECT_VALUE(stmt->name));
 				emit_bytes(emitter, OP_DEFINE_GLOBAL, (uint8_t) str, statement->line);
 			} else {
 				emit_bytes(emitter, OP_SET_LOCAL, (uint8_t) add_local(emitter, stmt->name), statement->line);
@@ -496,6 +560,7 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			emit_expression(emitter, stmt->condition);
 
 			uint64_t else_jump = emit_jump(emitter, OP_JUMP_IF_FALSE, statement->line);
+			emit_byte(emitter, OP_POP, statement->line);
 			emit_statement(emitter, stmt->if_branch);
 
 			uint64_t end_jump = emit_jump(emitter, OP_JUMP, statement->line);
@@ -504,8 +569,10 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			if (stmt->else_if_branches != NULL) {
 				for (int i = 0; i < stmt->else_if_branches->count; i++) {
 					patch_jump(emitter, else_jump);
+					emit_byte(emitter, OP_POP, statement->line);
 					emit_expression(emitter, stmt->else_if_conditions->values[i]);
 					else_jump = emit_jump(emitter, OP_JUMP_IF_FALSE, statement->line);
+					emit_byte(emitter, OP_POP, statement->line);
 					emit_statement(emitter, stmt->else_if_branches->values[i]);
 
 					end_jumps[i] = emit_jump(emitter, OP_JUMP, statement->line);
@@ -513,6 +580,7 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			}
 
 			patch_jump(emitter, else_jump);
+			emit_byte(emitter, OP_POP, statement->line);
 
 			if (stmt->else_branch != NULL) {
 				emit_statement(emitter, stmt->else_branch);
@@ -529,18 +597,29 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 		}
 		case BLOCK_STATEMENT: {
 			LitBlockStatement* stmt = ((LitBlockStatement*) statement);
+			int local_count = emitter->function->local_count;
 
 			if (stmt->statements != NULL) {
 				emit_statements(emitter, stmt->statements);
 			}
 
+			// Locals live on the stack, so they have to leave it with the block, or loops would fill it up
+			if (emitter->function->depth != 0) {
+				pop_locals(emitter, local_count, statement->line);
+				emitter->function->local_count = local_count;
+			}
+
 			break;
 		}
 		case WHILE_STATEMENT: {
 			LitWhileStatement* stmt = (LitWhileStatement*) statement;
 
 			uint64_t loop_start = emitter->function->function->chunk.count;
+			uint64_t enclosing_loop_start = emitter->loop_start;
+			int enclosing_loop_locals = emitter->loop_locals;
+
 			emitter->loop_start = loop_start; // Save for continue statements
+			emitter->loop_locals = emitter->function->local_count;
 
 			emit_expression(emitter, stmt->condition);
 			uint64_t exit_jump = emit_jump(emitter, OP_JUMP_IF_FALSE, statement->line);
@@ -550,6 +629,8 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			emit_loop(emitter, loop_start, statement->line);
 			patch_jump(emitter, exit_jump);
 			emit_byte(emitter, OP_POP, statement->line);
+			emitter->loop_start = enclosing_loop_start;
+			emitter->loop_locals = enclosing_loop_locals;
 
 			// Patch breaks
 			for (int i = 0; i < emitter->breaks.count; i++) {
@@ -568,8 +649,8 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			function.depth = emitter->function->depth + 1;
 			function.local_count = 0;
 			function.enclosing = emitter->function;
-			function.function = lit_new_function(MM(emitter->compiler));
-			function.function->name = lit_copy_string(MM(emitter->compiler), stmt->name, (int) strlen(stmt->name));
+			function.function = emitter->function->depth == 0 ? get_direct_closure(emitter, statement)->function : lit_new_function(MM(emitter->compiler));
+			function.function->name = stmt->name;
 			function.function->arity = stmt->parameters == NULL ? 0 : stmt->parameters->count;
 
 			emitter->function = &function;
@@ -581,9 +662,10 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			}
 
 			emit_statement(emitter, stmt->body);
+			optimize_function(emitter, function.function);
 
 			if (DEBUG_TRACE_CODE) {
-				lit_trace_chunk(MM(emitter->compiler), &function.function->chunk, stmt->name);
+				lit_trace_chunk(MM(emitter->compiler), &function.function->chunk, stmt->name->chars);
 			}
 
 			emitter->function = function.enclosing;
@@ -595,7 +677,7 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			}
 
 			if (emitter->function->depth == 0) {
-				emit_bytes(emitter, OP_DEFINE_GLOBAL, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), stmt->name, strlen(stmt->name)))), statement->line);
+				emit_bytes(emitter, OP_DEFINE_GLOBAL, make_constant(emitter, MAKE_OBJECT_VALUE(stmt->name)), statement->line);
 			} else {
 				emit_bytes(emitter, OP_SET_LOCAL, (uint8_t) add_local(emitter, stmt->name), statement->line);
 			}
@@ -608,6 +690,8 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			if (stmt->value == NULL) {
 				// FIXME: should not emit nil in init() method
 				// emit_byte(emitter, OP_NIL);
+			} else if (stmt->value->type == CALL_EXPRESSION && emitter->function->depth > 0) {
+				emit_call(emitter, (LitCallExpression*) stmt->value, true);
 			} else {
 				emit_expression(emitter, stmt->value);
 			}
@@ -620,9 +704,9 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 
 			if (stmt->super != NULL) {
 				emit_expression(emitter, (LitExpression*) stmt->super);
-				emit_bytes(emitter, OP_SUBCLASS, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), stmt->name, strlen(stmt->name)))), statement->line);
+				emit_bytes(emitter, OP_SUBCLASS, make_constant(emitter, MAKE_OBJECT_VALUE(stmt->name)), statement->line);
 			} else {
-				emit_bytes(emitter, OP_CLASS, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), stmt->name, strlen(stmt->name)))), statement->line);
+				emit_bytes(emitter, OP_CLASS, make_constant(emitter, MAKE_OBJECT_VALUE(stmt->name)), statement->line);
 			}
 
 			if (stmt->fields != NULL) {
@@ -632,18 +716,22 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 					if (field->init != NULL) {
 						emit_expression(emitter, field->init);
 					} else {
-						if (strcmp(field->type, "bool") == 0) {
+						const char* type = field->type->chars;
+
+						if (strcmp(type, "bool") == 0) {
 							emit_byte(emitter, OP_FALSE, statement->line);
-						} else if (strcmp(field->type, "int") == 0 || strcmp(field->type, "double") == 0) {
+						} else if (strcmp(type, "int") == 0) {
+							emit_constant(emitter, MAKE_INT_VALUE(0), statement->line);
+						} else if (strcmp(type, "double") == 0) {
 							emit_constant(emitter, MAKE_NUMBER_VALUE(0), statement->line);
-						} else if (strcmp(field->type, "char") == 0) {
+						} else if (strcmp(type, "char") == 0) {
 							emit_constant(emitter, MAKE_CHAR_VALUE('\0'), statement->line);
 						} else {
 							emit_byte(emitter, OP_NIL, statement->line);
 						}
 					}
 
-					emit_bytes(emitter, field->is_static ? OP_DEFINE_STATIC_FIELD : OP_DEFINE_FIELD, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), field->name, strlen(field->name)))), statement->line);
+					emit_bytes(emitter, field->is_static ? OP_DEFINE_STATIC_FIELD : OP_DEFINE_FIELD, make_constant(emitter, MAKE_OBJECT_VALUE(field->name)), statement->line);
 				}
 			}
 
@@ -656,22 +744,13 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 					function.depth = emitter->function->depth + 1;
 					function.local_count = 1;
 					function.enclosing = emitter->function;
-					function.function = lit_new_function(MM(emitter->compiler));
+					function.function = emitter->function->depth == 0 ? get_direct_closure(emitter, (LitStatement*) method)->function : lit_new_function(MM(emitter->compiler));
 
-					size_t name_len = strlen(method->name);
-					size_t type_len = strlen(stmt->name);
-
-					char* name = (char*) reallocate(MM(emitter->compiler), NULL, 0, name_len + type_len + 1);
-
-					strncpy(name, stmt->name, type_len);
-					name[type_len] = '.';
-					strncpy(&name[type_len + 1], method->name, name_len);
-
-					function.function->name = lit_copy_string(MM(emitter->compiler), name, name_len + type_len + 1);
+					function.function->name = lit_format_string(MM(emitter->compiler), "%.%", stmt->name, method->name);
 					function.function->arity = method->parameters == NULL ? 0 : method->parameters->count;
 
 					emitter->function = &function;
-					add_local(emitter, "this");
+					add_local(emitter, emitter->compiler->this_string);
 
 					if (method->parameters != NULL) {
 						for (int i = 0; i < method->parameters->count; i++) {
@@ -683,8 +762,10 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 						emit_statement(emitter, method->body);
 					}
 
+					optimize_function(emitter, function.function);
+
 					if (DEBUG_TRACE_CODE) {
-						lit_trace_chunk(MM(emitter->compiler), &function.function->chunk, method->name);
+						lit_trace_chunk(MM(emitter->compiler), &function.function->chunk, method->name->chars);
 					}
 
 					emitter->function = function.enclosing;
@@ -695,11 +776,11 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 						emit_byte(emitter, function.upvalues[i].index, statement->line);
 					}
 
-					emit_bytes(emitter, method->is_static ? OP_DEFINE_STATIC_METHOD : OP_DEFINE_METHOD, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), method->name, strlen(method->name)))), statement->line);
+					emit_bytes(emitter, method->is_static ? OP_DEFINE_STATIC_METHOD : OP_DEFINE_METHOD, make_constant(emitter, MAKE_OBJECT_VALUE(method->name)), statement->line);
 				}
 			}
 
-			emit_bytes(emitter, OP_DEFINE_GLOBAL, make_constant(emitter, MAKE_OBJECT_VALUE(lit_copy_string(MM(emitter->compiler), stmt->name, strlen(stmt->name)))), statement->line);
+			emit_bytes(emitter, OP_DEFINE_GLOBAL, make_constant(emitter, MAKE_OBJECT_VALUE(stmt->name)), statement->line);
 			break;
 		}
 		case METHOD_STATEMENT: {
@@ -707,11 +788,13 @@ static void emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			UNREACHABLE();
 		}
 		case BREAK_STATEMENT: {
+			pop_locals(emitter, emitter->loop_locals, statement->line);
 			lit_ints_write(MM(emitter->compiler), &emitter->breaks, emit_jump(emitter, OP_JUMP, statement->line));
 			break;
 		}
 		case CONTINUE_STATEMENT: {
-			emit_jump_instant(emitter, OP_JUMP, emitter->loop_start, statement->line);
+			pop_locals(emitter, emitter->loop_locals, statement->line);
+			emit_loop(emitter, emitter->loop_start, statement->line);
 			break;
 		}
 		default: {
@@ -741,6 +824,7 @@ void lit_free_emitter(LitEmitter* emitter) {
 
 LitFunction* lit_emit(LitEmitter* emitter, LitStatements* statements) {
 	emitter->had_error = false;
+	emitter->loop_locals = 0;
 
 	LitEmitterFunction function;
 	LitFunction* fn = lit_new_function(MM(emitter->compiler));
@@ -757,6 +841,7 @@ LitFunction* lit_emit(LitEmitter* emitter, LitStatements* statements) {
 	emit_statements(emitter, statements);
 	emit_byte(emitter, OP_NIL, 0);
 	emit_byte(emitter, OP_RETURN, 0);
+	optimize_function(emitter, function.function);
 
 	return emitter->had_error ? NULL : function.function;
 }
\ No newline at end of file
@@ -0,0 +1,390 @@
+#include <memory.h>
+
+#include <compiler/lit_escape.h>
+#include <compiler/lit_compiler.h>
+#include <vm/lit_memory.h>
+
+typedef struct {
+	LitCompiler* compiler;
+	LitInliner* inliner;
+	LitClassStatement* class;
+	LitString* name; // Local, that holds the instance
+
+	bool rewrite; // Statements are only checked, until it is known, that the instance doesn't escape
+	bool escapes;
+	int depth; // Nested functions, the locals can't be used there
+} LitEscape;
+
+static LitExpression* visit_expression(LitEscape* escape, LitExpression* expression);
+static void visit_statement(LitEscape* escape, LitStatement* statement);
+
+static bool is_instance(LitEscape* escape, LitExpression* expression) {
+	return escape->depth == 0 && expression->type == VAR_EXPRESSION && ((LitVarExpression*) expression)->name == escape->name;
+}
+
+// lit_can_inline_constructor() made sure, that all the instance fields are plain
+static bool has_field(LitClassStatement* class, LitString* name) {
+	if (class->fields != NULL) {
+		for (int i = 0; i < class->fields->count; i++) {
+			LitFieldStatement* field = (LitFieldStatement*) class->fields->values[i];
+
+			if (field->statement.type == FIELD_STATEMENT && field->name == name) {
+				return !field->is_static;
+			}
+		}
+	}
+
+	return false;
+}
+
+static LitExpression* make_field(LitEscape* escape, LitString* name, uint64_t line) {
+	return (LitExpression*) lit_make_var_expression(escape->compiler, line, lit_scalar_name(escape->compiler, escape->name, name));
+}
+
+static void visit_expressions(LitEscape* escape, LitExpressions* expressions) {
+	if (expressions != NULL) {
+		for (int i = 0; i < expressions->count; i++) {
+			expressions->values[i] = visit_expression(escape, expressions->values[i]);
+		}
+	}
+}
+
+static void visit_statements(LitEscape* escape, LitStatements* statements) {
+	if (statements != NULL) {
+		for (int i = 0; i < statements->count; i++) {
+			visit_statement(escape, statements->values[i]);
+		}
+	}
+}
+
+// Another local with the same name hides the instance
+static void visit_parameters(LitEscape* escape, LitParameters* parameters) {
+	if (parameters != NULL) {
+		for (int i = 0; i < parameters->count; i++) {
+			if (parameters->values[i].name == escape->name) {
+				escape->escapes = true;
+			}
+		}
+	}
+}
+
+static LitExpression* visit_assign_expression(LitEscape* escape, LitAssignExpression* expr) {
+	// In compound assignments (a.b += 1) the left side of the binary expression is the same expression, as the target
+	bool compound = expr->value->type == BINARY_EXPRESSION && ((LitBinaryExpression*) expr->value)->left == expr->to;
+	LitBinaryExpression* binary = (LitBinaryExpression*) expr->value;
+
+	if (compound) {
+		binary->right = visit_expression(escape, binary->right);
+	} else {
+		expr->value = visit_expression(escape, expr->value);
+	}
+
+	if (expr->to->type != GET_EXPRESSION || !is_instance(escape, ((LitGetExpression*) expr->to)->object)) {
+		// Only a get with the instance as the object is replaced, so the target stays the same
+		visit_expression(escape, expr->to);
+		return (LitExpression*) expr;
+	}
+
+	LitGetExpression* to = (LitGetExpression*) expr->to;
+
+	if (!has_field(escape->class, to->property)) {
+		escape->escapes = true;
+	} else if (escape->rewrite) {
+		LitExpression* field = make_field(escape, to->property, expr->to->line);
+
+		lit_free_expression(escape->compiler, expr->to);
+		expr->to = field;
+
+		if (compound) {
+			binary->left = field;
+		}
+	}
+
+	return (LitExpression*) expr;
+}
+
+// Returns the expression, that takes the place of the given one
+static LitExpression* visit_expression(LitEscape* escape, LitExpression* expression) {
+	if (expression == NULL || escape->escapes) {
+		return expression;
+	}
+
+	switch (expression->type) {
+		case VAR_EXPRESSION: {
+			// Anything else, than a field access, lets the instance out
+			if (((LitVarExpression*) expression)->name == escape->name) {
+				escape->escapes = true;
+			}
+
+			break;
+		}
+		case GET_EXPRESSION: {
+			LitGetExpression* expr = (LitGetExpression*) expression;
+
+			if (!is_instance(escape, expr->object)) {
+				expr->object = visit_expression(escape, expr->object);
+			} else if (!has_field(escape->class, expr->property)) {
+				escape->escapes = true; // A bound method keeps the instance
+			} else if (escape->rewrite) {
+				LitExpression* field = make_field(escape, expr->property, expression->line);
+				lit_free_expression(escape->compiler, expression);
+
+				return field;
+			}
+
+			break;
+		}
+		case SET_EXPRESSION: {
+			LitSetExpression* expr = (LitSetExpression*) expression;
+			expr->value = visit_expression(escape, expr->value);
+
+			if (!is_instance(escape, expr->object)) {
+				expr->object = visit_expression(escape, expr->object);
+			} else if (!has_field(escape->class, expr->property)) {
+				escape->escapes = true;
+			} else if (escape->rewrite) {
+				LitExpression* value = expr->value;
+				expr->value = (LitExpression*) lit_make_literal_expression(escape->compiler, expression->line, NIL_VALUE);
+
+				LitExpression* assign = (LitExpression*) lit_make_assign_expression(escape->compiler, expression->line, make_field(escape, expr->property, expression->line), value);
+				lit_free_expression(escape->compiler, expression);
+
+				return assign;
+			}
+
+			break;
+		}
+		case ASSIGN_EXPRESSION: return visit_assign_expression(escape, (LitAssignExpression*) expression);
+		case CALL_EXPRESSION: {
+			LitCallExpression* expr = (LitCallExpression*) expression;
+
+			if (expr->callee->type != GET_EXPRESSION || !is_instance(escape, ((LitGetExpression*) expr->callee)->object)) {
+				expr->callee = visit_expression(escape, expr->callee);
+				visit_expressions(escape, expr->args);
+
+				break;
+			}
+
+			// Methods, that can't be inlined, get the instance as this
+			if (lit_find_scalar_method(escape->compiler, escape->inliner, escape->class, expr) == NULL) {
+				escape->escapes = true;
+			} else if (escape->rewrite) {
+				LitExpression* inlined = lit_inline_scalar_call(escape->compiler, escape->inliner, escape->class, expr, escape->name);
+				lit_free_expression(escape->compiler, expression);
+
+				// Copies of the arguments still use the instance
+				return visit_expression(escape, inlined);
+			} else {
+				visit_expressions(escape, expr->args);
+			}
+
+			break;
+		}
+		case BINARY_EXPRESSION: {
+			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+
+			// The left side of a compound assignment is visited with the assignment
+			if (!expr->ignore_left) {
+				expr->left = visit_expression(escape, expr->left);
+			}
+
+			expr->right = visit_expression(escape, expr->right);
+			break;
+		}
+		case LOGICAL_EXPRESSION: {
+			LitLogicalExpression* expr = (LitLogicalExpression*) expression;
+
+			expr->left = visit_expression(escape, expr->left);
+			expr->right = visit_expression(escape, expr->right);
+
+			break;
+		}
+		case UNARY_EXPRESSION: {
+			LitUnaryExpression* expr = (LitUnaryExpression*) expression;
+			expr->right = visit_expression(escape, expr->right);
+
+			break;
+		}
+		case GROUPING_EXPRESSION: {
+			LitGroupingExpression* expr = (LitGroupingExpression*) expression;
+			expr->expr = visit_expression(escape, expr->expr);
+
+			break;
+		}
+		case IF_EXPRESSION: {
+			LitIfExpression* expr = (LitIfExpression*) expression;
+
+			expr->condition = visit_expression(escape, expr->condition);
+			expr->if_branch = visit_expression(escape, expr->if_branch);
+			expr->else_branch = visit_expression(escape, expr->else_branch);
+
+			visit_expressions(escape, expr->else_if_conditions);
+			visit_expressions(escape, expr->else_if_branches);
+
+			break;
+		}
+		case LAMBDA_EXPRESSION: {
+			LitLambdaExpression* expr = (LitLambdaExpression*) expression;
+
+			visit_parameters(escape, expr->parameters);
+			escape->depth++;
+			visit_statement(escape, expr->body);
+			escape->depth--;
+
+			break;
+		}
+		default: break;
+	}
+
+	return expression;
+}
+
+static void visit_statement(LitEscape* escape, LitStatement* statement) {
+	if (statement == NULL || escape->escapes) {
+		return;
+	}
+
+	switch (statement->type) {
+		case VAR_STATEMENT: {
+			LitVarStatement* stmt = (LitVarStatement*) statement;
+
+			if (stmt->name == escape->name) {
+				escape->escapes = true;
+			}
+
+			stmt->init = visit_expression(escape, stmt->init);
+			break;
+		}
+		case EXPRESSION_STATEMENT: {
+			LitExpressionStatement* stmt = (LitExpressionStatement*) statement;
+			stmt->expr = visit_expression(escape, stmt->expr);
+
+			break;
+		}
+		case RETURN_STATEMENT: {
+			LitReturnStatement* stmt = (LitReturnStatement*) statement;
+			stmt->value = visit_expression(escape, stmt->value);
+
+			break;
+		}
+		case IF_STATEMENT: {
+			LitIfStatement* stmt = (LitIfStatement*) statement;
+
+			stmt->condition = visit_expression(escape, stmt->condition);
+			visit_statement(escape, stmt->if_branch);
+			visit_statement(escape, stmt->else_branch);
+			visit_expressions(escape, stmt->else_if_conditions);
+			visit_statements(escape, stmt->else_if_branches);
+
+			break;
+		}
+		case BLOCK_STATEMENT: visit_statements(escape, ((LitBlockStatement*) statement)->statements); break;
+		case WHILE_STATEMENT: {
+			LitWhileStatement* stmt = (LitWhileStatement*) statement;
+
+			stmt->condition = visit_expression(escape, stmt->condition);
+			visit_statement(escape, stmt->body);
+
+			break;
+		}
+		case FUNCTION_STATEMENT: {
+			LitFunctionStatement* stmt = (LitFunctionStatement*) statement;
+
+			if (stmt->name == escape->name) {
+				escape->escapes = true;
+			}
+
+			visit_parameters(escape, stmt->parameters);
+			escape->depth++;
+			visit_statement(escape, stmt->body);
+			escape->depth--;
+
+			break;
+		}
+		case CLASS_STATEMENT:
+		case METHOD_STATEMENT:
+		case FIELD_STATEMENT: {
+			// Classes inside of functions are not looked into
+			escape->escapes = true;
+			break;
+		}
+		default: break;
+	}
+}
+
+// The class of the instance, that the statement creates, if the instance can be replaced
+static LitClassStatement* find_created_class(LitCompiler* compiler, LitInliner* inliner, LitStatement* statement) {
+	if (statement->type != VAR_STATEMENT) {
+		return NULL;
+	}
+
+	LitExpression* init = ((LitVarStatement*) statement)->init;
+
+	if (init == NULL || init->type != CALL_EXPRESSION || ((LitCallExpression*) init)->callee->type != VAR_EXPRESSION) {
+		return NULL;
+	}
+
+	LitCallExpression* call = (LitCallExpression*) init;
+	LitClassStatement* class = lit_find_class(inliner, ((LitVarExpression*) call->callee)->name);
+
+	if (class == NULL || !lit_can_inline_constructor(compiler, class, call->args == NULL ? 0 : call->args->count)) {
+		return NULL;
+	}
+
+	return class;
+}
+
+void lit_replace_scalars(LitCompiler* compiler, LitInliner* inliner, LitStatements* statements) {
+	// Globals can be used from anywhere
+	if (inliner->depth == 0) {
+		return;
+	}
+
+	for (int i = 0; i < statements->count; i++) {
+		LitClassStatement* class = find_created_class(compiler, inliner, statements->values[i]);
+
+		if (class == NULL) {
+			continue;
+		}
+
+		LitVarStatement* stmt = (LitVarStatement*) statements->values[i];
+		LitEscape escape = { compiler, inliner, class, stmt->name, false, false, 0 };
+
+		// The local lives until the end of the block
+		for (int j = i + 1; j < statements->count && !escape.escapes; j++) {
+			visit_statement(&escape, statements->values[j]);
+		}
+
+		if (escape.escapes) {
+			continue;
+		}
+
+		escape.rewrite = true;
+
+		for (int j = i + 1; j < statements->count; j++) {
+			visit_statement(&escape, statements->values[j]);
+		}
+
+		LitStatements locals;
+		lit_init_statements(&locals);
+
+		lit_inline_constructor(compiler, class, ((LitCallExpression*) stmt->init)->args, stmt->name, &locals, stmt->statement.line);
+		lit_free_statement(compiler, (LitStatement*) stmt);
+
+		// The locals take the place of the instance
+		int count = statements->count;
+		int added = locals.count - 1;
+
+		for (int j = 0; j < added; j++) {
+			lit_statements_write(MM(compiler), statements, NULL);
+		}
+
+		memmove(statements->values + i + locals.count, statements->values + i + 1, sizeof(LitStatement*) * (count - i - 1));
+		memcpy(statements->values + i, locals.values, sizeof(LitStatement*) * locals.count);
+
+		statements->count = count + added;
+		i += added;
+
+		lit_free_statements(MM(compiler), &locals);
+	}
+}
@@ -0,0 +1,768 @@
+#include <memory.h>
+
+#include <compiler/lit_inliner.h>
+#include <compiler/lit_compiler.h>
+#include <vm/lit_memory.h>
+
+DEFINE_TABLE(LitInlineFunctions, LitFunctionStatement*, inline_functions, LitFunctionStatement*, NULL, entry->value)
+DEFINE_TABLE(LitInlineClasses, LitClassStatement*, inline_classes, LitClassStatement*, NULL, entry->value)
+
+static void collect_statement(LitCompiler* compiler, LitInliner* inliner, LitStatement* statement, bool top);
+static void collect_expression(LitCompiler* compiler, LitInliner* inliner, LitExpression* expression);
+
+static void shadow(LitCompiler* compiler, LitInliner* inliner, LitString* name) {
+	lit_table_set(MM(compiler), &inliner->shadowed, name, TRUE_VALUE);
+}
+
+static void collect_parameters(LitCompiler* compiler, LitInliner* inliner, LitParameters* parameters) {
+	if (parameters != NULL) {
+		for (int i = 0; i < parameters->count; i++) {
+			shadow(compiler, inliner, parameters->values[i].name);
+		}
+	}
+}
+
+static void collect_expressions(LitCompiler* compiler, LitInliner* inliner, LitExpressions* expressions) {
+	if (expressions != NULL) {
+		for (int i = 0; i < expressions->count; i++) {
+			collect_expression(compiler, inliner, expressions->values[i]);
+		}
+	}
+}
+
+static void collect_statements(LitCompiler* compiler, LitInliner* inliner, LitStatements* statements, bool top) {
+	if (statements != NULL) {
+		for (int i = 0; i < statements->count; i++) {
+			collect_statement(compiler, inliner, statements->values[i], top);
+		}
+	}
+}
+
+static void collect_expression(LitCompiler* compiler, LitInliner* inliner, LitExpression* expression) {
+	if (expression == NULL) {
+		return;
+	}
+
+	switch (expression->type) {
+		case BINARY_EXPRESSION: {
+			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+
+			collect_expression(compiler, inliner, expr->left);
+			collect_expression(compiler, inliner, expr->right);
+
+			break;
+		}
+		case UNARY_EXPRESSION: collect_expression(compiler, inliner, ((LitUnaryExpression*) expression)->right); break;
+		case GROUPING_EXPRESSION: collect_expression(compiler, inliner, ((LitGroupingExpression*) expression)->expr); break;
+		case ASSIGN_EXPRESSION: {
+			LitAssignExpression* expr = (LitAssignExpression*) expression;
+
+			if (expr->to->type == VAR_EXPRESSION) {
+				shadow(compiler, inliner, ((LitVarExpression*) expr->to)->name);
+			}
+
+			collect_expression(compiler, inliner, expr->to);
+			collect_expression(compiler, inliner, expr->value);
+
+			break;
+		}
+		case LOGICAL_EXPRESSION: {
+			LitLogicalExpression* expr = (LitLogicalExpression*) expression;
+
+			collect_expression(compiler, inliner, expr->left);
+			collect_expression(compiler, inliner, expr->right);
+
+			break;
+		}
+		case CALL_EXPRESSION: {
+			LitCallExpression* expr = (LitCallExpression*) expression;
+
+			collect_expression(compiler, inliner, expr->callee);
+			collect_expressions(compiler, inliner, expr->args);
+
+			break;
+		}
+		case LAMBDA_EXPRESSION: {
+			LitLambdaExpression* expr = (LitLambdaExpression*) expression;
+
+			collect_parameters(compiler, inliner, expr->parameters);
+			collect_statement(compiler, inliner, expr->body, false);
+
+			break;
+		}
+		case GET_EXPRESSION: collect_expression(compiler, inliner, ((LitGetExpression*) expression)->object); break;
+		case SET_EXPRESSION: {
+			LitSetExpression* expr = (LitSetExpression*) expression;
+
+			// A field with the name of a method hides it
+			shadow(compiler, inliner, expr->property);
+			collect_expression(compiler, inliner, expr->object);
+			collect_expression(compiler, inliner, expr->value);
+
+			break;
+		}
+		case IF_EXPRESSION: {
+			LitIfExpression* expr = (LitIfExpression*) expression;
+
+			collect_expression(compiler, inliner, expr->condition);
+			collect_expression(compiler, inliner, expr->if_branch);
+			collect_expression(compiler, inliner, expr->else_branch);
+			collect_expressions(compiler, inliner, expr->else_if_conditions);
+			collect_expressions(compiler, inliner, expr->else_if_branches);
+
+			break;
+		}
+	}
+}
+
+static void collect_statement(LitCompiler* compiler, LitInliner* inliner, LitStatement* statement, bool top) {
+	if (statement == NULL) {
+		return;
+	}
+
+	switch (statement->type) {
+		case VAR_STATEMENT: {
+			LitVarStatement* stmt = (LitVarStatement*) statement;
+
+			shadow(compiler, inliner, stmt->name);
+			collect_expression(compiler, inliner, stmt->init);
+
+			break;
+		}
+		case EXPRESSION_STATEMENT: collect_expression(compiler, inliner, ((LitExpressionStatement*) statement)->expr); break;
+		case IF_STATEMENT: {
+			LitIfStatement* stmt = (LitIfStatement*) statement;
+
+			collect_expression(compiler, inliner, stmt->condition);
+			collect_statement(compiler, inliner, stmt->if_branch, false);
+			collect_statement(compiler, inliner, stmt->else_branch, false);
+			collect_expressions(compiler, inliner, stmt->else_if_conditions);
+			collect_statements(compiler, inliner, stmt->else_if_branches, false);
+
+			break;
+		}
+		case BLOCK_STATEMENT: collect_statements(compiler, inliner, ((LitBlockStatement*) statement)->statements, false); break;
+		case WHILE_STATEMENT: {
+			LitWhileStatement* stmt = (LitWhileStatement*) statement;
+
+			collect_expression(compiler, inliner, stmt->condition);
+			collect_statement(compiler, inliner, stmt->body, false);
+
+			break;
+		}
+		case FUNCTION_STATEMENT: {
+			LitFunctionStatement* stmt = (LitFunctionStatement*) statement;
+
+			if (top && lit_table_get(&inliner->candidates, stmt->name) == NULL) {
+				lit_table_set(MM(compiler), &inliner->candidates, stmt->name, TRUE_VALUE);
+			} else {
+				shadow(compiler, inliner, stmt->name);
+			}
+
+			collect_parameters(compiler, inliner, stmt->parameters);
+			collect_statement(compiler, inliner, stmt->body, false);
+
+			break;
+		}
+		case RETURN_STATEMENT: collect_expression(compiler, inliner, ((LitReturnStatement*) statement)->value); break;
+		case METHOD_STATEMENT: {
+			LitMethodStatement* stmt = (LitMethodStatement*) statement;
+
+			if (stmt->overriden) {
+				lit_table_set(MM(compiler), &inliner->overriden, stmt->name, TRUE_VALUE);
+			}
+
+			collect_parameters(compiler, inliner, stmt->parameters);
+			collect_statement(compiler, inliner, stmt->body, false);
+
+			break;
+		}
+		case FIELD_STATEMENT: {
+			LitFieldStatement* stmt = (LitFieldStatement*) statement;
+
+			shadow(compiler, inliner, stmt->name);
+			collect_expression(compiler, inliner, stmt->init);
+			collect_statement(compiler, inliner, stmt->getter, false);
+			collect_statement(compiler, inliner, stmt->setter, false);
+
+			break;
+		}
+		case CLASS_STATEMENT: {
+			LitClassStatement* stmt = (LitClassStatement*) statement;
+
+			if (top && lit_table_get(&inliner->candidates, stmt->name) == NULL) {
+				lit_table_set(MM(compiler), &inliner->candidates, stmt->name, TRUE_VALUE);
+				lit_inline_classes_set(MM(compiler), &inliner->classes, stmt->name, stmt);
+			} else {
+				shadow(compiler, inliner, stmt->name);
+			}
+
+			collect_statements(compiler, inliner, stmt->fields, false);
+
+			if (stmt->methods != NULL) {
+				for (int i = 0; i < stmt->methods->count; i++) {
+					collect_statement(compiler, inliner, (LitStatement*) stmt->methods->values[i], false);
+				}
+			}
+
+			break;
+		}
+	}
+}
+
+void lit_init_inliner(LitCompiler* compiler, LitInliner* inliner, LitStatements* statements) {
+	lit_init_inline_functions(&inliner->functions);
+	lit_init_inline_classes(&inliner->classes);
+	lit_init_table(&inliner->candidates);
+	lit_init_table(&inliner->shadowed);
+	lit_init_table(&inliner->overriden);
+
+	inliner->class = NULL;
+	inliner->method = NULL;
+	inliner->depth = 0;
+
+	collect_statements(compiler, inliner, statements, true);
+}
+
+void lit_free_inliner(LitCompiler* compiler, LitInliner* inliner) {
+	lit_free_inline_functions(MM(compiler), &inliner->functions);
+	lit_free_inline_classes(MM(compiler), &inliner->classes);
+	lit_free_table(MM(compiler), &inliner->candidates);
+	lit_free_table(MM(compiler), &inliner->shadowed);
+	lit_free_table(MM(compiler), &inliner->overriden);
+}
+
+// The expression, that a body of a single return statement gives back
+static LitExpression* get_returned(LitStatement* body) {
+	if (body != NULL && body->type == BLOCK_STATEMENT) {
+		LitStatements* statements = ((LitBlockStatement*) body)->statements;
+
+		if (statements == NULL || statements->count != 1) {
+			return NULL;
+		}
+
+		body = statements->values[0];
+	}
+
+	if (body == NULL || body->type != RETURN_STATEMENT) {
+		return NULL;
+	}
+
+	return ((LitReturnStatement*) body)->value;
+}
+
+static int find_parameter(LitParameters* parameters, LitString* name) {
+	if (parameters != NULL) {
+		for (int i = 0; i < parameters->count; i++) {
+			if (parameters->values[i].name == name) {
+				return i;
+			}
+		}
+	}
+
+	return -1;
+}
+
+// Plain fields, that are declared in the class itself, reading them runs no code
+static bool is_plain_field(LitClassStatement* class, LitString* name) {
+	if (class->fields == NULL) {
+		return false;
+	}
+
+	for (int i = 0; i < class->fields->count; i++) {
+		LitFieldStatement* field = (LitFieldStatement*) class->fields->values[i];
+
+		if (field->statement.type == FIELD_STATEMENT && field->name == name) {
+			return !field->is_static && field->getter == NULL && field->setter == NULL;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Checks, that the body only reads the parameters and this, and can't have any side effects
+ * Counts the nodes on the way, the class is NULL for functions
+ * If the fields of this live in locals (scalar), a bare this can't be used
+ */
+static bool can_inline(LitExpression* expression, LitParameters* parameters, LitClassStatement* class, bool scalar, int* size) {
+	if (expression == NULL) {
+		return true;
+	}
+
+	(*size)++;
+
+	switch (expression->type) {
+		case LITERAL_EXPRESSION: return true;
+		case VAR_EXPRESSION: return find_parameter(parameters, ((LitVarExpression*) expression)->name) != -1;
+		case THIS_EXPRESSION: return class != NULL && !scalar;
+		case UNARY_EXPRESSION: return can_inline(((LitUnaryExpression*) expression)->right, parameters, class, scalar, size);
+		case GROUPING_EXPRESSION: return can_inline(((LitGroupingExpression*) expression)->expr, parameters, class, scalar, size);
+		case BINARY_EXPRESSION: {
+			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+			return !expr->ignore_left && can_inline(expr->left, parameters, class, scalar, size) && can_inline(expr->right, parameters, class, scalar, size);
+		}
+		case LOGICAL_EXPRESSION: {
+			LitLogicalExpression* expr = (LitLogicalExpression*) expression;
+			return can_inline(expr->left, parameters, class, scalar, size) && can_inline(expr->right, parameters, class, scalar, size);
+		}
+		case GET_EXPRESSION: {
+			LitGetExpression* expr = (LitGetExpression*) expression;
+			(*size)++; // For this, that is not checked itself
+			return class != NULL && expr->object->type == THIS_EXPRESSION && is_plain_field(class, expr->property);
+		}
+		case IF_EXPRESSION: {
+			LitIfExpression* expr = (LitIfExpression*) expression;
+
+			if (!can_inline(expr->condition, parameters, class, scalar, size) || !can_inline(expr->if_branch, parameters, class, scalar, size) || !can_inline(expr->else_branch, parameters, class, scalar, size)) {
+				return false;
+			}
+
+			if (expr->else_if_branches != NULL) {
+				for (int i = 0; i < expr->else_if_branches->count; i++) {
+					if (!can_inline(expr->else_if_conditions->values[i], parameters, class, scalar, size) || !can_inline(expr->else_if_branches->values[i], parameters, class, scalar, size)) {
+						return false;
+					}
+				}
+			}
+
+			return true;
+		}
+		default: return false;
+	}
+}
+
+// Arguments, that are as cheap to evaluate again, as to read from a local
+static bool is_trivial(LitExpression* expression) {
+	return expression->type == LITERAL_EXPRESSION || expression->type == VAR_EXPRESSION || expression->type == THIS_EXPRESSION;
+}
+
+// Arguments, that can be evaluated later, or not at all, without anybody noticing
+static bool is_pure(LitInliner* inliner, LitExpression* expression) {
+	// Reading a variable or this has no side effects, and the inlined body can't change them
+	if (is_trivial(expression)) {
+		return true;
+	}
+
+	LitClassStatement* class = inliner->method != NULL && !inliner->method->is_static ? inliner->class : NULL;
+	int size = 0;
+
+	return can_inline(expression, NULL, class, false, &size);
+}
+
+static int count_uses(LitExpression* expression, LitString* name) {
+	if (expression == NULL) {
+		return 0;
+	}
+
+	switch (expression->type) {
+		case VAR_EXPRESSION: return ((LitVarExpression*) expression)->name == name ? 1 : 0;
+		case UNARY_EXPRESSION: return count_uses(((LitUnaryExpression*) expression)->right, name);
+		case GROUPING_EXPRESSION: return count_uses(((LitGroupingExpression*) expression)->expr, name);
+		case GET_EXPRESSION: return count_uses(((LitGetExpression*) expression)->object, name);
+		case BINARY_EXPRESSION: return count_uses(((LitBinaryExpression*) expression)->left, name) + count_uses(((LitBinaryExpression*) expression)->right, name);
+		case LOGICAL_EXPRESSION: return count_uses(((LitLogicalExpression*) expression)->left, name) + count_uses(((LitLogicalExpression*) expression)->right, name);
+		case IF_EXPRESSION: {
+			LitIfExpression* expr = (LitIfExpression*) expression;
+			int count = count_uses(expr->condition, name) + count_uses(expr->if_branch, name) + count_uses(expr->else_branch, name);
+
+			if (expr->else_if_branches != NULL) {
+				for (int i = 0; i < expr->else_if_branches->count; i++) {
+					count += count_uses(expr->else_if_conditions->values[i], name) + count_uses(expr->else_if_branches->values[i], name);
+				}
+			}
+
+			return count;
+		}
+		default: return 0;
+	}
+}
+
+static LitExpression* copy_expression(LitCompiler* compiler, LitExpression* expression, LitParameters* parameters, LitExpressions* args, uint64_t line, LitString* receiver);
+
+static LitExpressions* copy_expressions(LitCompiler* compiler, LitExpressions* expressions, LitParameters* parameters, LitExpressions* args, uint64_t line, LitString* receiver) {
+	if (expressions == NULL) {
+		return NULL;
+	}
+
+	LitExpressions* copy = (LitExpressions*) reallocate(compiler, NULL, 0, sizeof(LitExpressions));
+	lit_init_expressions(copy);
+
+	for (int i = 0; i < expressions->count; i++) {
+		lit_expressions_write(MM(compiler), copy, copy_expression(compiler, expressions->values[i], parameters, args, line, receiver));
+	}
+
+	return copy;
+}
+
+/*
+ * Copies an expression, that passed can_inline(), the parameters are replaced with copies of the arguments
+ * If the receiver is given, this.field becomes the local, that holds the field
+ */
+static LitExpression* copy_expression(LitCompiler* compiler, LitExpression* expression, LitParameters* parameters, LitExpressions* args, uint64_t line, LitString* receiver) {
+	if (expression == NULL) {
+		return NULL;
+	}
+
+	switch (expression->type) {
+		case LITERAL_EXPRESSION: return (LitExpression*) lit_make_literal_expression(compiler, line, ((LitLiteralExpression*) expression)->value);
+		case THIS_EXPRESSION: return (LitExpression*) lit_make_this_expression(compiler, line);
+		case VAR_EXPRESSION: {
+			LitString* name = ((LitVarExpression*) expression)->name;
+			int index = find_parameter(parameters, name);
+
+			if (index != -1) {
+				return copy_expression(compiler, args->values[index], NULL, NULL, line, NULL);
+			}
+
+			return (LitExpression*) lit_make_var_expression(compiler, line, name);
+		}
+		case UNARY_EXPRESSION: {
+			LitUnaryExpression* expr = (LitUnaryExpression*) expression;
+			return (LitExpression*) lit_make_unary_expression(compiler, line, copy_expression(compiler, expr->right, parameters, args, line, receiver), expr->operator);
+		}
+		case GROUPING_EXPRESSION: {
+			LitGroupingExpression* expr = (LitGroupingExpression*) expression;
+			return (LitExpression*) lit_make_grouping_expression(compiler, line, copy_expression(compiler, expr->expr, parameters, args, line, receiver));
+		}
+		case BINARY_EXPRESSION: {
+			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+
+			return (LitExpression*) lit_make_binary_expression(compiler, line, copy_expression(compiler, expr->left, parameters, args, line, receiver),
+				copy_expression(compiler, expr->right, parameters, args, line, receiver), expr->operator);
+		}
+		case LOGICAL_EXPRESSION: {
+			LitLogicalExpression* expr = (LitLogicalExpression*) expression;
+
+			return (LitExpression*) lit_make_logical_expression(compiler, line, expr->operator, copy_expression(compiler, expr->left, parameters, args, line, receiver),
+				copy_expression(compiler, expr->right, parameters, args, line, receiver));
+		}
+		case GET_EXPRESSION: {
+			LitGetExpression* expr = (LitGetExpression*) expression;
+
+			if (receiver != NULL) {
+				return (LitExpression*) lit_make_var_expression(compiler, line, lit_scalar_name(compiler, receiver, expr->property));
+			}
+
+			return (LitExpression*) lit_make_get_expression(compiler, line, copy_expression(compiler, expr->object, parameters, args, line, receiver), expr->property);
+		}
+		case IF_EXPRESSION: {
+			LitIfExpression* expr = (LitIfExpression*) expression;
+
+			return (LitExpression*) lit_make_if_expression(compiler, line, copy_expression(compiler, expr->condition, parameters, args, line, receiver),
+				copy_expression(compiler, expr->if_branch, parameters, args, line, receiver), copy_expression(compiler, expr->else_branch, parameters, args, line, receiver),
+				copy_expressions(compiler, expr->else_if_branches, parameters, args, line, receiver), copy_expressions(compiler, expr->else_if_conditions, parameters, args, line, receiver));
+		}
+		default: UNREACHABLE();
+	}
+
+	return NULL;
+}
+
+void lit_inliner_add_function(LitCompiler* compiler, LitInliner* inliner, LitFunctionStatement* function) {
+	// Only the global functions are candidates, the nested ones shadow the name
+	if (lit_table_get(&inliner->candidates, function->name) != NULL && lit_table_get(&inliner->shadowed, function->name) == NULL) {
+		lit_inline_functions_set(MM(compiler), &inliner->functions, function->name, function);
+	}
+}
+
+// Methods, that are called on this, and can't be overriden by a subclass
+static LitMethodStatement* find_method(LitInliner* inliner, LitGetExpression* callee) {
+	LitClassStatement* class = inliner->class;
+
+	if (class == NULL || class->methods == NULL || inliner->method == NULL || inliner->method->is_static || callee->object->type != THIS_EXPRESSION) {
+		return NULL;
+	}
+
+	for (int i = 0; i < class->methods->count; i++) {
+		LitMethodStatement* method = class->methods->values[i];
+
+		if (method->name == callee->property) {
+			bool sealed = class->final || (method->access == PRIVATE_ACCESS && lit_table_get(&inliner->overriden, method->name) == NULL);
+			bool hidden = lit_table_get(&inliner->shadowed, method->name) != NULL;
+
+			return sealed && !hidden && !method->is_static && !method->abstract ? method : NULL;
+		}
+	}
+
+	return NULL;
+}
+
+// Every argument is evaluated exactly once, when the function is called, the inlined body must not tell the difference
+static bool can_pass_arguments(LitInliner* inliner, LitExpression* body, LitParameters* parameters, LitExpressions* args) {
+	int parameter_count = parameters == NULL ? 0 : parameters->count;
+	int arg_count = args == NULL ? 0 : args->count;
+
+	if (parameter_count != arg_count) {
+		return false;
+	}
+
+	for (int i = 0; i < parameter_count; i++) {
+		LitExpression* arg = args->values[i];
+
+		if (count_uses(body, parameters->values[i].name) > 1 ? !is_trivial(arg) : !is_pure(inliner, arg)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+LitExpression* lit_inline_call(LitCompiler* compiler, LitInliner* inliner, LitCallExpression* call) {
+	if (compiler->options.inline_limit <= 0) {
+		return NULL;
+	}
+
+	LitParameters* parameters = NULL;
+	LitClassStatement* class = NULL;
+	LitExpression* body = NULL;
+
+	if (call->callee->type == VAR_EXPRESSION) {
+		LitFunctionStatement* function = lit_inline_functions_get(&inliner->functions, ((LitVarExpression*) call->callee)->name);
+
+		if (function == NULL) {
+			return NULL;
+		}
+
+		parameters = function->parameters;
+		body = get_returned(function->body);
+	} else if (call->callee->type == GET_EXPRESSION) {
+		LitMethodStatement* method = find_method(inliner, (LitGetExpression*) call->callee);
+
+		if (method == NULL) {
+			return NULL;
+		}
+
+		class = inliner->class;
+		parameters = method->parameters;
+		body = get_returned(method->body);
+	}
+
+	int size = 0;
+
+	if (body == NULL || !can_inline(body, parameters, class, false, &size) || size > compiler->options.inline_limit
+		|| !can_pass_arguments(inliner, body, parameters, call->args)) {
+
+		return NULL;
+	}
+
+	return copy_expression(compiler, body, parameters, call->args, call->expression.line, NULL);
+}
+
+LitString* lit_scalar_name(LitCompiler* compiler, LitString* receiver, LitString* name) {
+	return lit_intern_string(MM(compiler), lit_format_string(MM(compiler), "%.%", receiver, name));
+}
+
+LitClassStatement* lit_find_class(LitInliner* inliner, LitString* name) {
+	if (lit_table_get(&inliner->shadowed, name) != NULL) {
+		return NULL;
+	}
+
+	return lit_inline_classes_get(&inliner->classes, name);
+}
+
+LitMethodStatement* lit_find_scalar_method(LitCompiler* compiler, LitInliner* inliner, LitClassStatement* class, LitCallExpression* call) {
+	if (compiler->options.inline_limit <= 0 || call->callee->type != GET_EXPRESSION || class->methods == NULL) {
+		return NULL;
+	}
+
+	LitString* name = ((LitGetExpression*) call->callee)->property;
+
+	// The instance is known to be exactly of this class, so overriding doesn't matter
+	for (int i = 0; i < class->methods->count; i++) {
+		LitMethodStatement* method = class->methods->values[i];
+
+		if (method->name == name) {
+			LitExpression* body = get_returned(method->body);
+			int size = 0;
+
+			if (method->is_static || body == NULL || !can_inline(body, method->parameters, class, true, &size)
+				|| size > compiler->options.inline_limit || !can_pass_arguments(inliner, body, method->parameters, call->args)) {
+
+				return NULL;
+			}
+
+			return method;
+		}
+	}
+
+	return NULL;
+}
+
+LitExpression* lit_inline_scalar_call(LitCompiler* compiler, LitInliner* inliner, LitClassStatement* class, LitCallExpression* call, LitString* receiver) {
+	LitMethodStatement* method = lit_find_scalar_method(compiler, inliner, class, call);
+
+	if (method == NULL) {
+		return NULL;
+	}
+
+	return copy_expression(compiler, get_returned(method->body), method->parameters, call->args, call->expression.line, receiver);
+}
+
+static LitMethodStatement* find_constructor(LitCompiler* compiler, LitClassStatement* class) {
+	if (class->methods != NULL) {
+		for (int i = 0; i < class->methods->count; i++) {
+			LitMethodStatement* method = class->methods->values[i];
+
+			if (method->name == compiler->init_string && !method->is_static) {
+				return method;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+// Constructors, that only assign the fields of this, using the parameters and the fields
+static bool is_field_assignment(LitStatement* statement, LitMethodStatement* constructor, LitClassStatement* class) {
+	if (statement->type != EXPRESSION_STATEMENT || ((LitExpressionStatement*) statement)->expr->type != SET_EXPRESSION) {
+		return false;
+	}
+
+	LitSetExpression* set = (LitSetExpression*) ((LitExpressionStatement*) statement)->expr;
+	int size = 0;
+
+	return set->object->type == THIS_EXPRESSION && is_plain_field(class, set->property) && can_inline(set->value, constructor->parameters, class, true, &size);
+}
+
+// The resolver ends void methods with one
+static bool is_empty_return(LitStatements* statements, int index) {
+	LitStatement* statement = statements->values[index];
+	return index == statements->count - 1 && statement->type == RETURN_STATEMENT && ((LitReturnStatement*) statement)->value == NULL;
+}
+
+bool lit_can_inline_constructor(LitCompiler* compiler, LitClassStatement* class, int arg_count) {
+	if (class->super != NULL || class->abstract || class->is_static) {
+		return false;
+	}
+
+	int field_count = 0;
+
+	if (class->fields != NULL) {
+		for (int i = 0; i < class->fields->count; i++) {
+			LitFieldStatement* field = (LitFieldStatement*) class->fields->values[i];
+
+			if (field->statement.type != FIELD_STATEMENT || field->is_static) {
+				continue;
+			}
+
+			// Initializers are evaluated once, when the class is created, only constants can be copied
+			if (field->getter != NULL || field->setter != NULL || (field->init != NULL && field->init->type != LITERAL_EXPRESSION)) {
+				return false;
+			}
+
+			field_count++;
+		}
+	}
+
+	if (field_count > LIT_SCALAR_FIELDS) {
+		return false;
+	}
+
+	LitMethodStatement* constructor = find_constructor(compiler, class);
+
+	if (constructor == NULL) {
+		return arg_count == 0;
+	}
+
+	if ((constructor->parameters == NULL ? 0 : constructor->parameters->count) != arg_count || constructor->body == NULL) {
+		return false;
+	}
+
+	if (constructor->body->type != BLOCK_STATEMENT) {
+		return is_field_assignment(constructor->body, constructor, class);
+	}
+
+	LitStatements* statements = ((LitBlockStatement*) constructor->body)->statements;
+
+	if (statements != NULL) {
+		for (int i = 0; i < statements->count; i++) {
+			if (!is_field_assignment(statements->values[i], constructor, class) && !is_empty_return(statements, i)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Same values, that the emitter gives to the fields without an initializer
+static LitValue default_value(LitFieldStatement* field) {
+	if (field->init != NULL) {
+		return ((LitLiteralExpression*) field->init)->value;
+	}
+
+	const char* type = field->type->chars;
+
+	if (strcmp(type, "bool") == 0) {
+		return FALSE_VALUE;
+	} else if (strcmp(type, "int") == 0) {
+		return MAKE_INT_VALUE(0);
+	} else if (strcmp(type, "double") == 0) {
+		return MAKE_NUMBER_VALUE(0);
+	} else if (strcmp(type, "char") == 0) {
+		return MAKE_CHAR_VALUE('\0');
+	}
+
+	return NIL_VALUE;
+}
+
+static void inline_field_assignment(LitCompiler* compiler, LitStatement* statement, LitMethodStatement* constructor, LitExpressions* args, LitString* receiver, LitStatements* into, uint64_t line) {
+	LitSetExpression* set = (LitSetExpression*) ((LitExpressionStatement*) statement)->expr;
+
+	LitExpression* to = (LitExpression*) lit_make_var_expression(compiler, line, lit_scalar_name(compiler, receiver, set->property));
+	LitExpression* value = copy_expression(compiler, set->value, constructor->parameters, args, line, receiver);
+
+	lit_statements_write(MM(compiler), into, (LitStatement*) lit_make_expression_statement(compiler, line, (LitExpression*) lit_make_assign_expression(compiler, line, to, value)));
+}
+
+void lit_inline_constructor(LitCompiler* compiler, LitClassStatement* class, LitExpressions* args, LitString* receiver, LitStatements* into, uint64_t line) {
+	LitMethodStatement* constructor = find_constructor(compiler, class);
+	LitExpressions parameters;
+
+	lit_init_expressions(&parameters);
+
+	// The arguments are evaluated once and kept in locals, just like the parameters
+	if (constructor != NULL && constructor->parameters != NULL) {
+		for (int i = 0; i < constructor->parameters->count; i++) {
+			LitString* name = lit_intern_string(MM(compiler), lit_format_string(MM(compiler), "%:%", receiver, constructor->parameters->values[i].name));
+			LitExpression* arg = args->values[i];
+
+			args->values[i] = (LitExpression*) lit_make_literal_expression(compiler, line, NIL_VALUE);
+
+			lit_statements_write(MM(compiler), into, (LitStatement*) lit_make_var_statement(compiler, line, name, arg, constructor->parameters->values[i].type, false));
+			lit_expressions_write(MM(compiler), &parameters, (LitExpression*) lit_make_var_expression(compiler, line, name));
+		}
+	}
+
+	if (class->fields != NULL) {
+		for (int i = 0; i < class->fields->count; i++) {
+			LitFieldStatement* field = (LitFieldStatement*) class->fields->values[i];
+
+			if (field->statement.type == FIELD_STATEMENT && !field->is_static) {
+				LitExpression* value = (LitExpression*) lit_make_literal_expression(compiler, line, default_value(field));
+				lit_statements_write(MM(compiler), into, (LitStatement*) lit_make_var_statement(compiler, line, lit_scalar_name(compiler, receiver, field->name), value, field->type, false));
+			}
+		}
+	}
+
+	if (constructor != NULL) {
+		if (constructor->body->type != BLOCK_STATEMENT) {
+			inline_field_assignment(compiler, constructor->body, constructor, &parameters, receiver, into, line);
+		} else if (((LitBlockStatement*) constructor->body)->statements != NULL) {
+			LitStatements* statements = ((LitBlockStatement*) constructor->body)->statements;
+
+			for (int i = 0; i < statements->count; i++) {
+				if (!is_empty_return(statements, i)) {
+					inline_field_assignment(compiler, statements->values[i], constructor, &parameters, receiver, into, line);
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < parameters.count; i++) {
+		lit_free_expression(compiler, parameters.values[i]);
+	}
+
+	lit_free_expressions(MM(compiler), &parameters);
+}
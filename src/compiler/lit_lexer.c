@@ -3,17 +3,173 @@
 
 #include <compiler/lit_lexer.h>
 #include <lit_common.h>
-
-static bool is_digit(char c) {
-	return c >= '0' && c <= '9';
+#include <lit_mem_manager.h>
+#include <vm/lit_object.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+enum {
+	CHAR_SPACE = 1, // ' ', '\t' and '\r'
+	CHAR_NEWLINE = 2,
+	CHAR_ALPHA = 4, // Letters and '_'
+	CHAR_DIGIT = 8
+};
+
+#define LETTERS(c) [c] = CHAR_ALPHA, [c + 1] = CHAR_ALPHA, [c + 2] = CHAR_ALPHA, [c + 3] = CHAR_ALPHA, [c + 4] = CHAR_ALPHA, \
+	[c + 5] = CHAR_ALPHA, [c + 6] = CHAR_ALPHA, [c + 7] = CHAR_ALPHA, [c + 8] = CHAR_ALPHA, [c + 9] = CHAR_ALPHA, [c + 10] = CHAR_ALPHA, \
+	[c + 11] = CHAR_ALPHA, [c + 12] = CHAR_ALPHA, [c + 13] = CHAR_ALPHA, [c + 14] = CHAR_ALPHA, [c + 15] = CHAR_ALPHA, [c + 16] = CHAR_ALPHA, \
+	[c + 17] = CHAR_ALPHA, [c + 18] = CHAR_ALPHA, [c + 19] = CHAR_ALPHA, [c + 20] = CHAR_ALPHA, [c + 21] = CHAR_ALPHA, [c + 22] = CHAR_ALPHA, \
+	[c + 23] = CHAR_ALPHA, [c + 24] = CHAR_ALPHA, [c + 25] = CHAR_ALPHA
+
+static const uint8_t char_classes[256] = {
+	[' '] = CHAR_SPACE, ['\t'] = CHAR_SPACE, ['\r'] = CHAR_SPACE, ['\n'] = CHAR_NEWLINE,
+	['0'] = CHAR_DIGIT, ['1'] = CHAR_DIGIT, ['2'] = CHAR_DIGIT, ['3'] = CHAR_DIGIT, ['4'] = CHAR_DIGIT,
+	['5'] = CHAR_DIGIT, ['6'] = CHAR_DIGIT, ['7'] = CHAR_DIGIT, ['8'] = CHAR_DIGIT, ['9'] = CHAR_DIGIT,
+	LETTERS('a'), LETTERS('A'), ['_'] = CHAR_ALPHA
+};
+
+#undef LETTERS
+
+static inline bool is_digit(char c) {
+	return char_classes[(uint8_t) c] & CHAR_DIGIT;
 }
 
-static bool is_alpha(char c) {
-	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+static inline bool is_alpha(char c) {
+	return char_classes[(uint8_t) c] & CHAR_ALPHA;
 }
 
 static inline bool is_at_end(LitLexer* lexer) {
-	return *lexer->current_code == '\0' || lexer->ended;
+	return lexer->current_code >= lexer->end || lexer->ended;
+}
+
+#ifdef __SSE2__
+// Without -mpopcnt __builtin_popcount ends up as a libgcc call
+static inline uint32_t count_bits(uint32_t bits) {
+	bits = bits - ((bits >> 1) & 0x55555555);
+	bits = (bits & 0x33333333) + ((bits >> 2) & 0x33333333);
+
+	return (((bits + (bits >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+static inline uint32_t space_mask(__m128i chunk) {
+	__m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+	return (uint32_t) _mm_movemask_epi8(_mm_or_si128(spaces, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+}
+
+static inline uint32_t newline_mask(__m128i chunk) {
+	return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+}
+
+// Bytes above 127 are negative here, so they never fall into the ranges
+static inline uint32_t identifier_mask(__m128i chunk) {
+	__m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+	__m128i letters = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+	__m128i digits = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+	__m128i underscores = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+
+	return (uint32_t) _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letters, digits), underscores));
+}
+#endif
+
+/*
+ * Most runs are a couple of bytes long, so the first few are checked one by one,
+ * the vector loops only pay off for indentation and long names
+ */
+#define SCALAR_PREFIX 8
+
+// Skips spaces and newlines, 16 bytes at a time, while there are enough of them left
+static void skip_spaces(LitLexer* lexer) {
+	const char* current = lexer->current_code;
+	const char* end = lexer->end;
+	const char* prefix_end = end - current > SCALAR_PREFIX ? current + SCALAR_PREFIX : end;
+	uint64_t line = lexer->line;
+
+	while (current < prefix_end && (char_classes[(uint8_t) *current] & (CHAR_SPACE | CHAR_NEWLINE))) {
+		line += *current == '\n';
+		current++;
+	}
+
+#ifdef __SSE2__
+	while (current == prefix_end && end - current >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*) current);
+		uint32_t newlines = newline_mask(chunk);
+		uint32_t stop = ~(space_mask(chunk) | newlines) & 0xffff;
+
+		if (stop != 0) {
+			uint32_t length = (uint32_t) __builtin_ctz(stop);
+
+			line += count_bits(newlines & ((1u << length) - 1));
+			current += length;
+
+			break;
+		}
+
+		line += count_bits(newlines);
+		current += 16;
+		prefix_end = current;
+	}
+#endif
+
+	if (current == prefix_end) {
+		while (current < end && (char_classes[(uint8_t) *current] & (CHAR_SPACE | CHAR_NEWLINE))) {
+			line += *current == '\n';
+			current++;
+		}
+	}
+
+	lexer->current_code = current;
+	lexer->line = line;
+}
+
+static void skip_identifier(LitLexer* lexer) {
+	const char* current = lexer->current_code;
+	const char* end = lexer->end;
+	const char* prefix_end = end - current > SCALAR_PREFIX ? current + SCALAR_PREFIX : end;
+
+	while (current < prefix_end && (char_classes[(uint8_t) *current] & (CHAR_ALPHA | CHAR_DIGIT))) {
+		current++;
+	}
+
+#ifdef __SSE2__
+	while (current == prefix_end && end - current >= 16) {
+		uint32_t stop = ~identifier_mask(_mm_loadu_si128((const __m128i*) current)) & 0xffff;
+
+		if (stop != 0) {
+			current += __builtin_ctz(stop);
+			break;
+		}
+
+		current += 16;
+		prefix_end = current;
+	}
+#endif
+
+	if (current == prefix_end) {
+		while (current < end && (char_classes[(uint8_t) *current] & (CHAR_ALPHA | CHAR_DIGIT))) {
+			current++;
+		}
+	}
+
+	lexer->current_code = current;
+}
+
+static uint64_t count_lines(const char* from, const char* to) {
+	uint64_t lines = 0;
+
+#ifdef __SSE2__
+	while (to - from >= 16) {
+		lines += count_bits(newline_mask(_mm_loadu_si128((const __m128i*) from)));
+		from += 16;
+	}
+#endif
+
+	while (from < to) {
+		lines += *from++ == '\n';
+	}
+
+	return lines;
 }
 
 static LitToken make_token(LitLexer* lexer, LitTokenType type) {
@@ -23,6 +179,7 @@ static LitToken make_token(LitLexer* lexer, LitTokenType type) {
 	token.start = lexer->start;
 	token.length = lexer->current_code - lexer->start;
 	token.line = lexer->line;
+	token.identifier = NULL;
 
 	return token;
 }
@@ -34,6 +191,7 @@ static LitToken make_error_token(LitLexer* lexer, const char* message) {
 	token.start = message;
 	token.length = (int) strlen(message);
 	token.line = lexer->line;
+	token.identifier = NULL;
 
 	return token;
 }
@@ -70,153 +228,91 @@ static char peek_next(LitLexer* lexer) {
 
 static void skip_whitespace(LitLexer* lexer) {
 	for (;;) {
-		char c = peek(lexer);
+		skip_spaces(lexer);
 
-		switch (c) {
-			case ' ':
-			case '\r':
-			case '\t':
-				advance(lexer);
-				break;
-			case '\n':
-				lexer->line++;
-				advance(lexer);
-				break;
-			case '/':
-				if (peek_next(lexer) == '/') {
-					advance(lexer);
-
-					if (peek_next(lexer) == '*') {
-						lexer->ended = true;
-						return;
-					}
-
-					while (peek(lexer) != '\n' && !is_at_end(lexer)) {
-						advance(lexer);
-					}
-				} else if (peek_next(lexer) == '*') {
-					advance(lexer);
-					advance(lexer);
-
-					while ((peek(lexer) != '*' || peek_next(lexer) != '/') && !is_at_end(lexer)) {
-						if (peek(lexer) == '\n') {
-							lexer->line++;
-						}
-
-						advance(lexer);
-					}
-
-					advance(lexer); // Star
-					advance(lexer); // Slash
-				} else {
-					return;
-				}
-
-				break;
-			default:
-				return;
+		if (peek(lexer) != '/') {
+			return;
 		}
-	}
-}
 
-static LitTokenType check_keyword(LitLexer* lexer, int start, int length, const char* rest, LitTokenType type) {
-	if (lexer->current_code - lexer->start == start + length &&
-	    memcmp(lexer->start + start, rest, (size_t) length) == 0) {
+		if (peek_next(lexer) == '/') {
+			advance(lexer);
 
-		return type;
-	}
+			if (peek_next(lexer) == '*') {
+				lexer->ended = true;
+				return;
+			}
 
-	return TOKEN_IDENTIFIER;
-}
+			// memchr is vectorized by libc already
+			const char* newline = memchr(lexer->current_code, '\n', (size_t) (lexer->end - lexer->current_code));
+			lexer->current_code = newline == NULL ? lexer->end : newline;
+		} else if (peek_next(lexer) == '*') {
+			const char* body = lexer->current_code + 2;
+			const char* star = body;
 
-static LitTokenType find_identifier_type(LitLexer* lexer) {
-	switch (lexer->start[0]) {
-		case 'a': return check_keyword(lexer, 1, 7, "bstract", TOKEN_ABSTRACT);
-		case 'b': return check_keyword(lexer, 1, 4, "reak", TOKEN_BREAK);
-		case 'c': {
-			if (lexer->current_code - lexer->start > 1) {
-				switch (lexer->start[1]) {
-					case 'l': return check_keyword(lexer, 2, 3, "ass", TOKEN_CLASS);
-					case 'o': return check_keyword(lexer, 2, 6, "ntinue", TOKEN_CONTINUE);
-				}
+			while ((star = memchr(star, '*', (size_t) (lexer->end - star))) != NULL && star[1] != '/') {
+				star++;
 			}
 
-			break;
-		}
-		case 'e': return check_keyword(lexer, 1, 3, "lse", TOKEN_ELSE);
-		case 'i': {
-			if (lexer->current_code - lexer->start > 1) {
-				switch (lexer->start[1]) {
-					case 'f': return check_keyword(lexer, 2, 0, "", TOKEN_IF);
-					case 's': return check_keyword(lexer, 2, 0, "", TOKEN_IS);
-				}
-			}
-		}
-		case 'n': return check_keyword(lexer, 1, 2, "il", TOKEN_NIL);
-		case 'r': return check_keyword(lexer, 1, 5, "eturn", TOKEN_RETURN);
-		case 's': {
-			if (lexer->current_code - lexer->start > 1) {
-				switch (lexer->start[1]) {
-					case 'u': return check_keyword(lexer, 2, 3, "per", TOKEN_SUPER);
-					case 'w': return check_keyword(lexer, 2, 4, "itch", TOKEN_SWITCH);
-					case 't': return check_keyword(lexer, 2, 4, "atic", TOKEN_STATIC);
-				}
-			}
+			const char* comment_end = star == NULL ? lexer->end : star + 2;
 
-			break;
+			lexer->line += count_lines(body, comment_end);
+			lexer->current_code = comment_end;
+		} else {
+			return;
 		}
-		case 'v': {
-			if (lexer->current_code - lexer->start > 2) {
-				switch (lexer->start[2]) {
-					case 'r': return check_keyword(lexer, 3, 0, "", TOKEN_VAR);
-					case 'l': return check_keyword(lexer, 3, 0, "", TOKEN_VAL);
-				}
-			}
+	}
+}
 
-			break;
-		}
-		case 'w': return check_keyword(lexer, 1, 4, "hile", TOKEN_WHILE);
-		case 'f': {
-			if (lexer->current_code - lexer->start > 1) {
-				switch (lexer->start[1]) {
-					case 'a': return check_keyword(lexer, 2, 3, "lse", TOKEN_FALSE);
-					case 'o': return check_keyword(lexer, 2, 1, "r", TOKEN_FOR);
-					case 'i': return check_keyword(lexer, 2, 3, "nal", TOKEN_FINAL);
-				}
-			}
+typedef struct {
+	const char* name;
+	uint64_t length;
+	LitTokenType type;
+} LitKeyword;
+
+/*
+ * Perfect hash of the keywords, found by trying small multipliers,
+ * every keyword gets its own slot, so a single compare tells if it's a keyword
+ */
+#define KEYWORD_HASH(start, length) ((((uint8_t) (start)[0]) * 3u + ((uint8_t) (start)[(length) - 1]) * 17u + ((uint32_t) (length) << 1u)) & 63u)
+
+static const LitKeyword keywords[64] = {
+	[5] = {"if", 2, TOKEN_IF},
+	[6] = {"protected", 9, TOKEN_PROTECTED},
+	[7] = {"this", 4, TOKEN_THIS},
+	[10] = {"for", 3, TOKEN_FOR},
+	[11] = {"break", 5, TOKEN_BREAK},
+	[13] = {"switch", 6, TOKEN_SWITCH},
+	[18] = {"override", 8, TOKEN_OVERRIDE},
+	[19] = {"private", 7, TOKEN_PRIVATE},
+	[20] = {"val", 3, TOKEN_VAL},
+	[22] = {"class", 5, TOKEN_CLASS},
+	[25] = {"true", 4, TOKEN_TRUE},
+	[34] = {"is", 2, TOKEN_IS},
+	[36] = {"while", 5, TOKEN_WHILE},
+	[39] = {"abstract", 8, TOKEN_ABSTRACT},
+	[40] = {"final", 5, TOKEN_FINAL},
+	[44] = {"else", 4, TOKEN_ELSE},
+	[46] = {"continue", 8, TOKEN_CONTINUE},
+	[47] = {"public", 6, TOKEN_PUBLIC},
+	[48] = {"return", 6, TOKEN_RETURN},
+	[49] = {"false", 5, TOKEN_FALSE},
+	[53] = {"super", 5, TOKEN_SUPER},
+	[56] = {"static", 6, TOKEN_STATIC},
+	[58] = {"var", 3, TOKEN_VAR},
+	[60] = {"nil", 3, TOKEN_NIL}
+};
 
-			break;
-		}
-		case 't': {
-			if (lexer->current_code - lexer->start > 1) {
-				switch (lexer->start[1]) {
-					case 'h': return check_keyword(lexer, 2, 2, "is", TOKEN_THIS);
-					case 'r': return check_keyword(lexer, 2, 2, "ue", TOKEN_TRUE);
-				}
-			}
+static LitTokenType find_identifier_type(LitLexer* lexer) {
+	uint64_t length = (uint64_t) (lexer->current_code - lexer->start);
 
-			break;
-		}
-		case 'o': return check_keyword(lexer, 1, 7, "verride", TOKEN_OVERRIDE);
-		case 'p': {
-			if (lexer->current_code - lexer->start > 1) {
-				switch (lexer->start[1]) {
-					case 'u': return check_keyword(lexer, 2, 4, "blic", TOKEN_PUBLIC);
-					case 'r': {
-						if (lexer->current_code - lexer->start > 2) {
-							switch (lexer->start[2]) {
-								case 'i': return check_keyword(lexer, 3, 4, "vate", TOKEN_PRIVATE);
-								case 'o': return check_keyword(lexer, 3, 6, "tected", TOKEN_PROTECTED);
-							}
-						}
-
-						break;
-					}
-				}
-			}
+	if (length < 2 || length > 9) {
+		return TOKEN_IDENTIFIER;
+	}
 
-			break;
-		}
+	const LitKeyword* keyword = &keywords[KEYWORD_HASH(lexer->start, length)];
+
+	if (keyword->length == length && memcmp(lexer->start, keyword->name, length) == 0) {
+		return keyword->type;
 	}
 
 	return TOKEN_IDENTIFIER;
@@ -250,11 +346,16 @@ LitToken lit_lexer_next_token(LitLexer* lexer) {
 	}
 
 	if (is_alpha(c)) {
-		while (is_alpha(peek(lexer)) || is_digit(peek(lexer))) {
-			advance(lexer);
+		skip_identifier(lexer);
+
+		LitToken token = make_token(lexer, find_identifier_type(lexer));
+
+		// Names are interned once here, so the rest of the compiler can compare them by pointer
+		if (token.type == TOKEN_IDENTIFIER) {
+			token.identifier = lit_copy_string(MM(lexer->compiler), token.start, (size_t) token.length);
 		}
 
-		return make_token(lexer, find_identifier_type(lexer));
+		return token;
 	}
 
 	switch (c) {
@@ -324,4 +425,5 @@ void lit_init_lexer(LitCompiler* compiler, LitLexer* lexer, const char* code) {
 	lexer->panic_mode = false;
 	lexer->compiler = compiler;
 	lexer->ended = false;
+	lexer->end = code + strlen(code);
 }
\ No newline at end of file
@@ -0,0 +1,657 @@
+#include <math.h>
+#include <memory.h>
+
+#include <compiler/lit_optimizer.h>
+#include <compiler/lit_inliner.h>
+#include <compiler/lit_escape.h>
+#include <compiler/lit_compiler.h>
+#include <vm/lit_memory.h>
+
+static LitExpression* optimize_expression(LitCompiler* compiler, LitExpression* expression);
+static LitStatement* optimize_statement(LitCompiler* compiler, LitStatement* statement);
+static LitStatement* optimize_body(LitCompiler* compiler, LitStatement* statement);
+static void optimize_statements(LitCompiler* compiler, LitStatements* statements);
+
+static bool is_constant(LitExpression* expression) {
+	return expression->type == LITERAL_EXPRESSION;
+}
+
+static LitValue constant_value(LitExpression* expression) {
+	return ((LitLiteralExpression*) expression)->value;
+}
+
+static bool is_number_constant(LitExpression* expression) {
+	return is_constant(expression) && IS_NUMBER(constant_value(expression));
+}
+
+static bool is_int_constant_equal(LitExpression* expression, int32_t number) {
+	return is_constant(expression) && IS_INT(constant_value(expression)) && AS_INT(constant_value(expression)) == number;
+}
+
+/*
+ * Frees the expression with all its children and
+ * returns a literal with the value, that it would produce at runtime
+ */
+static LitExpression* replace_with_constant(LitCompiler* compiler, LitExpression* expression, LitValue value) {
+	uint64_t line = expression->line;
+	lit_free_expression(compiler, expression);
+
+	return (LitExpression*) lit_make_literal_expression(compiler, line, value);
+}
+
+/*
+ * Frees the expression, but keeps one of its children, that takes its place
+ * The free functions expect every child to be present, so the slot gets a nil literal
+ */
+static LitExpression* replace_with_child(LitCompiler* compiler, LitExpression* expression, LitExpression** child) {
+	LitExpression* result = *child;
+
+	*child = (LitExpression*) lit_make_literal_expression(compiler, result->line, NIL_VALUE);
+	lit_free_expression(compiler, expression);
+
+	return result;
+}
+
+// Same as above, but for statements, the slot gets an empty block
+static LitStatement* replace_with_child_statement(LitCompiler* compiler, LitStatement* statement, LitStatement** child) {
+	LitStatement* result = *child;
+
+	*child = (LitStatement*) lit_make_block_statement(compiler, result->line, NULL);
+	lit_free_statement(compiler, statement);
+
+	return result;
+}
+
+// Int operands give an int, when the opcode in the vm would give one
+static bool fold_int_operator(LitTokenType operator, int32_t a, int32_t b, LitValue* result) {
+	int32_t value;
+
+	switch (operator) {
+		case TOKEN_PLUS: {
+			if (__builtin_add_overflow(a, b, &value)) {
+				return false;
+			}
+
+			break;
+		}
+
+		case TOKEN_MINUS: {
+			if (__builtin_sub_overflow(a, b, &value)) {
+				return false;
+			}
+
+			break;
+		}
+
+		case TOKEN_STAR: {
+			if (__builtin_mul_overflow(a, b, &value) || (value == 0 && (a < 0 || b < 0))) {
+				return false;
+			}
+
+			break;
+		}
+
+		case TOKEN_SLASH: {
+			if (b <= 0 || a % b != 0) {
+				return false;
+			}
+
+			value = a / b;
+			break;
+		}
+
+		case TOKEN_PERCENT: {
+			if (b <= 0 || (a < 0 && a % b == 0)) {
+				return false;
+			}
+
+			value = a % b;
+			break;
+		}
+
+		default: return false;
+	}
+
+	*result = MAKE_INT_VALUE(value);
+	return true;
+}
+
+// Mirrors the math opcodes in the vm, so that the folded value is exactly the same
+static bool fold_binary_operator(LitTokenType operator, LitValue left, LitValue right, LitValue* result) {
+	if (IS_INT(left) && IS_INT(right) && fold_int_operator(operator, AS_INT(left), AS_INT(right), result)) {
+		return true;
+	}
+
+	double a = AS_NUMBER(left);
+	double b = AS_NUMBER(right);
+
+	switch (operator) {
+		case TOKEN_PLUS: *result = MAKE_NUMBER_VALUE(a + b); return true;
+		case TOKEN_MINUS: *result = MAKE_NUMBER_VALUE(a - b); return true;
+		case TOKEN_STAR: *result = MAKE_NUMBER_VALUE(a * b); return true;
+		case TOKEN_SLASH: *result = MAKE_NUMBER_VALUE(a / b); return true;
+		case TOKEN_PERCENT: *result = MAKE_NUMBER_VALUE(fmod(a, b)); return true;
+		case TOKEN_CARET: *result = MAKE_NUMBER_VALUE(pow(a, b)); return true;
+		case TOKEN_CELL: *result = MAKE_NUMBER_VALUE(pow(a, 1.0 / b)); return true;
+		case TOKEN_EQUAL_EQUAL: *result = MAKE_BOOL_VALUE(a == b); return true;
+		case TOKEN_BANG_EQUAL: *result = MAKE_BOOL_VALUE(a != b); return true;
+		case TOKEN_GREATER: *result = MAKE_BOOL_VALUE(a > b); return true;
+		case TOKEN_GREATER_EQUAL: *result = MAKE_BOOL_VALUE(a >= b); return true;
+		case TOKEN_LESS: *result = MAKE_BOOL_VALUE(a < b); return true;
+		case TOKEN_LESS_EQUAL: *result = MAKE_BOOL_VALUE(a <= b); return true;
+		default: return false;
+	}
+}
+
+static LitExpression* optimize_binary_expression(LitCompiler* compiler, LitBinaryExpression* expr) {
+	LitExpression* expression = (LitExpression*) expr;
+
+	// In compound assignments (a += 1) the left side is shared with the assign expression
+	if (expr->ignore_left) {
+		expr->right = optimize_expression(compiler, expr->right);
+		return expression;
+	}
+
+	expr->left = optimize_expression(compiler, expr->left);
+	expr->right = optimize_expression(compiler, expr->right);
+
+	if (is_number_constant(expr->left) && is_number_constant(expr->right)) {
+		LitValue result;
+
+		if (fold_binary_operator(expr->operator, constant_value(expr->left), constant_value(expr->right), &result)) {
+			return replace_with_constant(compiler, expression, result);
+		}
+	} else if (is_constant(expr->left) && is_constant(expr->right)
+		&& !IS_OBJECT(constant_value(expr->left)) && !IS_OBJECT(constant_value(expr->right))) {
+
+		// Nil, bools and chars are only equal, when their bits are
+		if (expr->operator == TOKEN_EQUAL_EQUAL || expr->operator == TOKEN_BANG_EQUAL) {
+			bool equal = constant_value(expr->left) == constant_value(expr->right);
+			return replace_with_constant(compiler, expression, MAKE_BOOL_VALUE(expr->operator == TOKEN_EQUAL_EQUAL ? equal : !equal));
+		}
+	}
+
+	// Identities, that give back exactly the other operand, -0 and nan included, only int constants keep an int operand an int
+	switch (expr->operator) {
+		case TOKEN_STAR: {
+			if (is_int_constant_equal(expr->right, 1)) {
+				return replace_with_child(compiler, expression, &expr->left);
+			} else if (is_int_constant_equal(expr->left, 1)) {
+				return replace_with_child(compiler, expression, &expr->right);
+			}
+
+			break;
+		}
+		case TOKEN_SLASH: {
+			if (is_int_constant_equal(expr->right, 1)) {
+				return replace_with_child(compiler, expression, &expr->left);
+			}
+
+			break;
+		}
+		case TOKEN_MINUS: {
+			if (is_int_constant_equal(expr->right, 0)) {
+				return replace_with_child(compiler, expression, &expr->left);
+			}
+
+			break;
+		}
+	}
+
+	return expression;
+}
+
+static LitExpression* optimize_unary_expression(LitCompiler* compiler, LitUnaryExpression* expr) {
+	LitExpression* expression = (LitExpression*) expr;
+	expr->right = optimize_expression(compiler, expr->right);
+
+	if (!is_constant(expr->right)) {
+		return expression;
+	}
+
+	LitValue value = constant_value(expr->right);
+
+	switch (expr->operator) {
+		case TOKEN_BANG: return replace_with_constant(compiler, expression, MAKE_BOOL_VALUE(lit_is_false(value)));
+		case TOKEN_MINUS: {
+			if (IS_NUMBER(value)) {
+				// -0 is a double, and so is the negated INT32_MIN
+				if (IS_INT(value) && AS_INT(value) != 0 && AS_INT(value) != INT32_MIN) {
+					return replace_with_constant(compiler, expression, MAKE_INT_VALUE(-AS_INT(value)));
+				}
+
+				return replace_with_constant(compiler, expression, MAKE_NUMBER_VALUE(-AS_NUMBER(value)));
+			}
+
+			break;
+		}
+		case TOKEN_CELL: {
+			if (IS_NUMBER(value)) {
+				return replace_with_constant(compiler, expression, MAKE_NUMBER_VALUE(sqrt(AS_NUMBER(value))));
+			}
+
+			break;
+		}
+	}
+
+	return expression;
+}
+
+static LitExpression* optimize_logical_expression(LitCompiler* compiler, LitLogicalExpression* expr) {
+	LitExpression* expression = (LitExpression*) expr;
+
+	expr->left = optimize_expression(compiler, expr->left);
+	expr->right = optimize_expression(compiler, expr->right);
+
+	if (is_constant(expr->left)) {
+		bool truthy = !lit_is_false(constant_value(expr->left));
+
+		// Or gives back the left side if it is true, and gives it back if it is false
+		if ((expr->operator == TOKEN_OR) == truthy) {
+			return replace_with_child(compiler, expression, &expr->left);
+		}
+
+		return replace_with_child(compiler, expression, &expr->right);
+	}
+
+	return expression;
+}
+
+static LitExpression* optimize_if_expression(LitCompiler* compiler, LitIfExpression* expr) {
+	LitExpression* expression = (LitExpression*) expr;
+
+	expr->condition = optimize_expression(compiler, expr->condition);
+	expr->if_branch = optimize_expression(compiler, expr->if_branch);
+
+	if (expr->else_branch != NULL) {
+		expr->else_branch = optimize_expression(compiler, expr->else_branch);
+	}
+
+	LitExpressions* conditions = expr->else_if_conditions;
+	LitExpressions* branches = expr->else_if_branches;
+
+	if (branches != NULL) {
+		int count = 0;
+
+		for (int i = 0; i < branches->count; i++) {
+			LitExpression* condition = optimize_expression(compiler, conditions->values[i]);
+			LitExpression* branch = optimize_expression(compiler, branches->values[i]);
+
+			if (!is_constant(condition)) {
+				conditions->values[count] = condition;
+				branches->values[count] = branch;
+				count++;
+
+				continue;
+			}
+
+			bool taken = !lit_is_false(constant_value(condition));
+			lit_free_expression(compiler, condition);
+
+			if (!taken) {
+				lit_free_expression(compiler, branch);
+				continue;
+			}
+
+			// This branch is always taken, so it becomes the else branch, and everything after it is unreachable
+			if (expr->else_branch != NULL) {
+				lit_free_expression(compiler, expr->else_branch);
+			}
+
+			expr->else_branch = branch;
+
+			for (int j = i + 1; j < branches->count; j++) {
+				lit_free_expression(compiler, conditions->values[j]);
+				lit_free_expression(compiler, branches->values[j]);
+			}
+
+			break;
+		}
+
+		conditions->count = count;
+		branches->count = count;
+	}
+
+	while (is_constant(expr->condition)) {
+		if (!lit_is_false(constant_value(expr->condition))) {
+			return replace_with_child(compiler, expression, &expr->if_branch);
+		}
+
+		if (branches == NULL || branches->count == 0) {
+			return replace_with_child(compiler, expression, &expr->else_branch);
+		}
+
+		// The first else if takes place of the never taken if branch
+		lit_free_expression(compiler, expr->condition);
+		lit_free_expression(compiler, expr->if_branch);
+
+		expr->condition = conditions->values[0];
+		expr->if_branch = branches->values[0];
+
+		branches->count--;
+		conditions->count--;
+
+		memmove(conditions->values, conditions->values + 1, sizeof(LitExpression*) * conditions->count);
+		memmove(branches->values, branches->values + 1, sizeof(LitExpression*) * branches->count);
+	}
+
+	return expression;
+}
+
+static LitExpression* optimize_expression(LitCompiler* compiler, LitExpression* expression) {
+	switch (expression->type) {
+		case BINARY_EXPRESSION: return optimize_binary_expression(compiler, (LitBinaryExpression*) expression);
+		case UNARY_EXPRESSION: return optimize_unary_expression(compiler, (LitUnaryExpression*) expression);
+		case LOGICAL_EXPRESSION: return optimize_logical_expression(compiler, (LitLogicalExpression*) expression);
+		case IF_EXPRESSION: return optimize_if_expression(compiler, (LitIfExpression*) expression);
+		case GROUPING_EXPRESSION: {
+			LitGroupingExpression* expr = (LitGroupingExpression*) expression;
+			expr->expr = optimize_expression(compiler, expr->expr);
+
+			if (is_constant(expr->expr)) {
+				return replace_with_child(compiler, expression, &expr->expr);
+			}
+
+			break;
+		}
+		case ASSIGN_EXPRESSION: {
+			LitAssignExpression* expr = (LitAssignExpression*) expression;
+			expr->value = optimize_expression(compiler, expr->value);
+
+			break;
+		}
+		case CALL_EXPRESSION: {
+			LitCallExpression* expr = (LitCallExpression*) expression;
+			expr->callee = optimize_expression(compiler, expr->callee);
+
+			if (expr->args != NULL) {
+				for (int i = 0; i < expr->args->count; i++) {
+					expr->args->values[i] = optimize_expression(compiler, expr->args->values[i]);
+				}
+			}
+
+			LitExpression* inlined = lit_inline_call(compiler, compiler->inliner, expr);
+
+			if (inlined != NULL) {
+				lit_free_expression(compiler, expression);
+				return optimize_expression(compiler, inlined);
+			}
+
+			break;
+		}
+		case LAMBDA_EXPRESSION: {
+			LitLambdaExpression* expr = (LitLambdaExpression*) expression;
+
+			compiler->inliner->depth++;
+			expr->body = optimize_body(compiler, expr->body);
+			compiler->inliner->depth--;
+
+			break;
+		}
+		case GET_EXPRESSION: {
+			LitGetExpression* expr = (LitGetExpression*) expression;
+			expr->object = optimize_expression(compiler, expr->object);
+
+			break;
+		}
+		case SET_EXPRESSION: {
+			LitSetExpression* expr = (LitSetExpression*) expression;
+
+			expr->object = optimize_expression(compiler, expr->object);
+			expr->value = optimize_expression(compiler, expr->value);
+
+			break;
+		}
+	}
+
+	return expression;
+}
+
+// Returns NULL, if the statement was removed
+static LitStatement* optimize_if_statement(LitCompiler* compiler, LitIfStatement* stmt) {
+	LitStatement* statement = (LitStatement*) stmt;
+
+	stmt->condition = optimize_expression(compiler, stmt->condition);
+	stmt->if_branch = optimize_body(compiler, stmt->if_branch);
+
+	if (stmt->else_branch != NULL) {
+		stmt->else_branch = optimize_body(compiler, stmt->else_branch);
+	}
+
+	LitExpressions* conditions = stmt->else_if_conditions;
+	LitStatements* branches = stmt->else_if_branches;
+
+	if (branches != NULL) {
+		int count = 0;
+
+		for (int i = 0; i < branches->count; i++) {
+			LitExpression* condition = optimize_expression(compiler, conditions->values[i]);
+			LitStatement* branch = optimize_body(compiler, branches->values[i]);
+
+			if (!is_constant(condition)) {
+				conditions->values[count] = condition;
+				branches->values[count] = branch;
+				count++;
+
+				continue;
+			}
+
+			bool taken = !lit_is_false(constant_value(condition));
+			lit_free_expression(compiler, condition);
+
+			if (!taken) {
+				lit_free_statement(compiler, branch);
+				continue;
+			}
+
+			if (stmt->else_branch != NULL) {
+				lit_free_statement(compiler, stmt->else_branch);
+			}
+
+			stmt->else_branch = branch;
+
+			for (int j = i + 1; j < branches->count; j++) {
+				lit_free_expression(compiler, conditions->values[j]);
+				lit_free_statement(compiler, branches->values[j]);
+			}
+
+			break;
+		}
+
+		conditions->count = count;
+		branches->count = count;
+	}
+
+	while (is_constant(stmt->condition)) {
+		if (!lit_is_false(constant_value(stmt->condition))) {
+			return replace_with_child_statement(compiler, statement, &stmt->if_branch);
+		}
+
+		if (branches == NULL || branches->count == 0) {
+			if (stmt->else_branch == NULL) {
+				lit_free_statement(compiler, statement);
+				return NULL;
+			}
+
+			return replace_with_child_statement(compiler, statement, &stmt->else_branch);
+		}
+
+		lit_free_expression(compiler, stmt->condition);
+		lit_free_statement(compiler, stmt->if_branch);
+
+		stmt->condition = conditions->values[0];
+		stmt->if_branch = branches->values[0];
+
+		branches->count--;
+		conditions->count--;
+
+		memmove(conditions->values, conditions->values + 1, sizeof(LitExpression*) * conditions->count);
+		memmove(branches->values, branches->values + 1, sizeof(LitStatement*) * branches->count);
+	}
+
+	return statement;
+}
+
+// For the places, where a statement is required, removed statements are replaced with an empty block
+static LitStatement* optimize_body(LitCompiler* compiler, LitStatement* statement) {
+	uint64_t line = statement->line;
+	LitStatement* result = optimize_statement(compiler, statement);
+
+	if (result == NULL) {
+		return (LitStatement*) lit_make_block_statement(compiler, line, NULL);
+	}
+
+	return result;
+}
+
+// Returns NULL, if the statement was removed
+static LitStatement* optimize_statement(LitCompiler* compiler, LitStatement* statement) {
+	switch (statement->type) {
+		case VAR_STATEMENT: {
+			LitVarStatement* stmt = (LitVarStatement*) statement;
+
+			if (stmt->init != NULL) {
+				stmt->init = optimize_expression(compiler, stmt->init);
+			}
+
+			break;
+		}
+		case EXPRESSION_STATEMENT: {
+			LitExpressionStatement* stmt = (LitExpressionStatement*) statement;
+			stmt->expr = optimize_expression(compiler, stmt->expr);
+
+			// Lonely constant does nothing
+			if (is_constant(stmt->expr)) {
+				lit_free_statement(compiler, statement);
+				return NULL;
+			}
+
+			break;
+		}
+		case IF_STATEMENT: return optimize_if_statement(compiler, (LitIfStatement*) statement);
+		case BLOCK_STATEMENT: {
+			LitBlockStatement* stmt = (LitBlockStatement*) statement;
+
+			if (stmt->statements != NULL) {
+				optimize_statements(compiler, stmt->statements);
+			}
+
+			break;
+		}
+		case WHILE_STATEMENT: {
+			LitWhileStatement* stmt = (LitWhileStatement*) statement;
+			stmt->condition = optimize_expression(compiler, stmt->condition);
+
+			if (is_constant(stmt->condition) && lit_is_false(constant_value(stmt->condition))) {
+				lit_free_statement(compiler, statement);
+				return NULL;
+			}
+
+			stmt->body = optimize_body(compiler, stmt->body);
+			break;
+		}
+		case FUNCTION_STATEMENT: {
+			LitFunctionStatement* stmt = (LitFunctionStatement*) statement;
+
+			compiler->inliner->depth++;
+			stmt->body = optimize_body(compiler, stmt->body);
+			compiler->inliner->depth--;
+
+			lit_inliner_add_function(compiler, compiler->inliner, stmt);
+
+			break;
+		}
+		case RETURN_STATEMENT: {
+			LitReturnStatement* stmt = (LitReturnStatement*) statement;
+
+			if (stmt->value != NULL) {
+				stmt->value = optimize_expression(compiler, stmt->value);
+			}
+
+			break;
+		}
+		case METHOD_STATEMENT: {
+			LitMethodStatement* stmt = (LitMethodStatement*) statement;
+
+			if (stmt->body != NULL) {
+				LitMethodStatement* enclosing = compiler->inliner->method;
+
+				compiler->inliner->method = stmt;
+				compiler->inliner->depth++;
+				stmt->body = optimize_body(compiler, stmt->body);
+				compiler->inliner->depth--;
+				compiler->inliner->method = enclosing;
+			}
+
+			break;
+		}
+		case FIELD_STATEMENT: {
+			LitFieldStatement* stmt = (LitFieldStatement*) statement;
+
+			if (stmt->init != NULL) {
+				stmt->init = optimize_expression(compiler, stmt->init);
+			}
+
+			if (stmt->getter != NULL) {
+				stmt->getter = optimize_body(compiler, stmt->getter);
+			}
+
+			if (stmt->setter != NULL) {
+				stmt->setter = optimize_body(compiler, stmt->setter);
+			}
+
+			break;
+		}
+		case CLASS_STATEMENT: {
+			LitClassStatement* stmt = (LitClassStatement*) statement;
+			LitClassStatement* enclosing = compiler->inliner->class;
+
+			compiler->inliner->class = stmt;
+
+			if (stmt->fields != NULL) {
+				for (int i = 0; i < stmt->fields->count; i++) {
+					optimize_statement(compiler, stmt->fields->values[i]);
+				}
+			}
+
+			if (stmt->methods != NULL) {
+				for (int i = 0; i < stmt->methods->count; i++) {
+					optimize_statement(compiler, (LitStatement*) stmt->methods->values[i]);
+				}
+			}
+
+			compiler->inliner->class = enclosing;
+
+			break;
+		}
+	}
+
+	return statement;
+}
+
+static void optimize_statements(LitCompiler* compiler, LitStatements* statements) {
+	int count = 0;
+
+	for (int i = 0; i < statements->count; i++) {
+		LitStatement* statement = optimize_statement(compiler, statements->values[i]);
+
+		if (statement != NULL) {
+			statements->values[count++] = statement;
+		}
+	}
+
+	statements->count = count;
+	lit_replace_scalars(compiler, compiler->inliner, statements);
+}
+
+void lit_optimize(LitCompiler* compiler, LitStatements* statements) {
+	LitInliner inliner;
+
+	lit_init_inliner(compiler, &inliner, statements);
+	compiler->inliner = &inliner;
+
+	optimize_statements(compiler, statements);
+
+	compiler->inliner = NULL;
+	lit_free_inliner(compiler, &inliner);
+}
\ No newline at end of file
@@ -13,20 +13,17 @@ static LitStatement* parse_statement(LitLexer* lexer);
 static LitStatement* parse_declaration(LitLexer* lexer);
 static LitStatement* parse_var_declaration(LitLexer* lexer, bool final);
 
-static const char* copy_string(LitLexer* lexer, LitToken* name) {
-	char* str = (char*) reallocate(lexer->compiler, NULL, 0, (size_t) name->length + (size_t) 1);
-	strncpy(str, name->start, (size_t) name->length);
-	str[name->length] = '\0';
+// Identifiers are already interned by the lexer
+static LitString* copy_string(LitLexer* lexer, LitToken* name) {
+	if (name->identifier != NULL) {
+		return name->identifier;
+	}
 
-	return str;
+	return lit_copy_string(MM(lexer->compiler), name->start, (size_t) name->length);
 }
 
-static const char* copy_string_native(LitLexer* lexer, const char* name, uint64_t length) {
-	char* str = (char*) reallocate(lexer->compiler, NULL, 0, (size_t) length + (size_t) 1);
-	strncpy(str, name, (size_t) length);
-	str[length] = '\0';
-
-	return str;
+static LitString* copy_string_native(LitLexer* lexer, const char* name, uint64_t length) {
+	return lit_copy_string(MM(lexer->compiler), name, (size_t) length);
 }
 
 static void error(LitLexer* lexer, LitToken *token, const char* message);
@@ -135,7 +132,7 @@ static LitExpression* parse_if_expression(LitLexer* lexer) {
 			}
 
 			lit_expressions_write(MM(lexer->compiler), else_if_conditions, parse_expression(lexer));
-			lit_expressions_write(MM(lexer->compiler), else_if_conditions, parse_expression(lexer));
+			lit_expressions_write(MM(lexer->compiler), else_if_branches, parse_expression(lexer));
 		} else {
 			else_branch = parse_expression(lexer);
 		}
@@ -149,365 +146,292 @@ static LitExpression* parse_if_expression(LitLexer* lexer) {
 	return (LitExpression*) lit_make_if_expression(lexer->compiler, line, condition, if_branch, else_branch, else_if_branches, else_if_conditions);
 }
 
-static LitExpression* parse_lambda(LitLexer* lexer);
-
-static LitExpression* parse_primary(LitLexer* lexer) {
-	if (match(lexer, TOKEN_THIS)) {
-		return (LitExpression*) lit_make_this_expression(lexer->compiler, lexer->last_line);
-	}
-
-	if (match(lexer, TOKEN_SUPER)) {
-		uint64_t line = lexer->last_line;
-
-		consume(lexer, TOKEN_DOT, "Expected '.' after super");
-		LitToken token = consume(lexer, TOKEN_IDENTIFIER, "Expected method name after dot");
-
-		return (LitExpression*) lit_make_super_expression(lexer->compiler, line, copy_string(lexer, &token));
-	}
-
-	if (match(lexer, TOKEN_IDENTIFIER)) {
-		return (LitExpression*) lit_make_var_expression(lexer->compiler, lexer->last_line, copy_string(lexer, &lexer->previous));
-	}
-
-	if (match(lexer, TOKEN_TRUE)) {
-		return (LitExpression*) lit_make_literal_expression(lexer->compiler, lexer->last_line, TRUE_VALUE);
-	}
-
-	if (match(lexer, TOKEN_FALSE)) {
-		return (LitExpression*) lit_make_literal_expression(lexer->compiler, lexer->last_line, FALSE_VALUE);
-	}
+/*
+ * Expressions are parsed with a Pratt parser, every token gets a rule
+ * with the functions, that parse it in prefix and infix positions
+ */
+typedef enum {
+	PREC_NONE,
+	PREC_ASSIGNMENT, // =
+	PREC_IF, // if a b else c
+	PREC_TERNARY, // a ? b : c
+	PREC_OR, // ||
+	PREC_AND, // &&
+	PREC_EQUALITY, // == !=
+	PREC_COMPARISON, // < > <= >=
+	PREC_TERM, // + -
+	PREC_FACTOR, // * / %
+	PREC_POWER, // ^ #
+	PREC_UNARY, // ! - #
+	PREC_IS, // is
+	PREC_COMPOUND_TERM, // += -= ++ --
+	PREC_COMPOUND_FACTOR, // *= /= %=
+	PREC_COMPOUND_POWER, // ^= #=
+	PREC_CALL, // . ()
+	PREC_PRIMARY
+} LitPrecedence;
+
+typedef LitExpression* (*LitPrefixFn)(LitLexer* lexer);
+
+// Line is the line, where the whole expression started
+typedef LitExpression* (*LitInfixFn)(LitLexer* lexer, LitExpression* left, uint64_t line);
+
+typedef struct {
+	LitPrefixFn prefix;
+	LitInfixFn infix;
+
+	LitPrecedence prefix_precedence; // The highest precedence, at which the prefix is allowed
+	LitPrecedence precedence;
+
+	bool single; // The operator can't be chained, like a += 1 += 2
+} LitParseRule;
+
+static LitParseRule rules[TOKEN_EOF + 1];
+
+static LitExpression* parse_precedence(LitLexer* lexer, LitPrecedence precedence) {
+	uint64_t line = lexer->line;
+	LitParseRule* rule = &rules[lexer->current.type];
 
-	if (match(lexer, TOKEN_NIL)) {
-		return (LitExpression*) lit_make_literal_expression(lexer->compiler, lexer->last_line, NIL_VALUE);
+	if (rule->prefix == NULL || precedence > rule->prefix_precedence) {
+		error(lexer, &lexer->current, "Unexpected token");
+		return NULL;
 	}
 
-	if (match(lexer, TOKEN_NUMBER)) {
-		return (LitExpression*) lit_make_literal_expression(lexer->compiler, lexer->last_line, MAKE_NUMBER_VALUE(strtod(lexer->previous.start, NULL)));
-	}
+	advance(lexer);
 
-	if (match(lexer, TOKEN_STRING)) {
-		return (LitExpression*) lit_make_literal_expression(lexer->compiler, lexer->last_line,
-			MAKE_OBJECT_VALUE(lit_copy_string(MM(lexer->compiler), lexer->previous.start + 1, lexer->previous.length - 2)));
-	}
+	LitExpression* expression = rule->prefix(lexer);
+	// Operators above the limit were already tried on the operand, that was just parsed
+	LitPrecedence limit = rule->prefix_precedence - 1;
 
-	if (match(lexer, TOKEN_CHAR)) {
-		return (LitExpression*) lit_make_literal_expression(lexer->compiler, lexer->last_line, MAKE_CHAR_VALUE((unsigned char) lexer->previous.start[1]));
-	}
+	for (;;) {
+		rule = &rules[lexer->current.type];
 
-	if (match(lexer, TOKEN_LEFT_PAREN)) {
-		uint64_t line = lexer->last_line;
+		if (rule->infix == NULL || rule->precedence < precedence || rule->precedence > limit) {
+			return expression;
+		}
 
-		LitExpression* expression = parse_expression(lexer);
-		consume(lexer, TOKEN_RIGHT_PAREN, "Expected ')' after expression");
+		advance(lexer);
 
-		return (LitExpression*) lit_make_grouping_expression(lexer->compiler, line, expression);
+		expression = rule->infix(lexer, expression, line);
+		limit = rule->single ? rule->precedence - 1 : rule->precedence;
 	}
+}
 
-	/*
-	if (match(lexer, TOKEN_EQUAL)) {
-		consume(lexer, TOKEN_GREATER, "Expected '>' in lambda declaration");
-		return parse_lambda(lexer);
-	}*/ // fixme: lambdas
+static LitExpression* parse_if(LitLexer* lexer) {
+	return parse_if_expression(lexer);
+}
 
-	error(lexer, &lexer->current, "Unexpected token");
-	return NULL;
+static LitExpression* parse_this(LitLexer* lexer) {
+	return (LitExpression*) lit_make_this_expression(lexer->compiler, lexer->last_line);
 }
 
-static LitExpression* finish_call(LitLexer* lexer, LitExpression* callee) {
+static LitExpression* parse_super(LitLexer* lexer) {
 	uint64_t line = lexer->last_line;
-	LitExpressions* args = (LitExpressions*) reallocate(lexer->compiler, NULL, 0, sizeof(LitExpressions));
-	lit_init_expressions(args);
 
-	if (lexer->current.type != TOKEN_RIGHT_PAREN) {
-		do {
-			lit_expressions_write(MM(lexer->compiler), args, parse_expression(lexer));
-		} while (match(lexer, TOKEN_COMMA));
-	}
+	consume(lexer, TOKEN_DOT, "Expected '.' after super");
+	LitToken token = consume(lexer, TOKEN_IDENTIFIER, "Expected method name after dot");
 
-	consume(lexer, TOKEN_RIGHT_PAREN, "Expected ')' after arguments");
-	return (LitExpression*) lit_make_call_expression(lexer->compiler, line, callee, args);
+	return (LitExpression*) lit_make_super_expression(lexer->compiler, line, copy_string(lexer, &token));
 }
 
-static LitExpression* parse_equality(LitLexer* lexer);
+static LitExpression* parse_variable(LitLexer* lexer) {
+	return (LitExpression*) lit_make_var_expression(lexer->compiler, lexer->last_line, copy_string(lexer, &lexer->previous));
+}
 
-static LitExpression* parse_call(LitLexer* lexer) {
-	LitExpression* expression = parse_primary(lexer);
+static LitExpression* parse_literal(LitLexer* lexer) {
+	LitValue value = NIL_VALUE;
 
-	while (true) {
-		if (match(lexer, TOKEN_LEFT_PAREN)) {
-			expression = finish_call(lexer, expression);
-		} else if (match(lexer, TOKEN_DOT)) {
-			uint64_t line = lexer->last_line;
-			LitToken token = consume(lexer, TOKEN_IDENTIFIER, "Expected property name after '.'");
+	switch (lexer->previous.type) {
+		case TOKEN_TRUE: value = TRUE_VALUE; break;
+		case TOKEN_FALSE: value = FALSE_VALUE; break;
+		case TOKEN_NUMBER: {
+			double number = strtod(lexer->previous.start, NULL);
 
-			if (match(lexer, TOKEN_EQUAL)) {
-				expression = (LitExpression*) lit_make_set_expression(lexer->compiler, line, expression, parse_equality(lexer), copy_string(lexer, &token));
+			// Only literals without a fraction are ints, 10.0 stays a double
+			if (memchr(lexer->previous.start, '.', lexer->previous.length) == NULL) {
+				value = MAKE_FITTING_NUMBER_VALUE(number);
 			} else {
-				expression = (LitExpression*) lit_make_get_expression(lexer->compiler, line, expression, copy_string(lexer, &token));
+				value = MAKE_NUMBER_VALUE(number);
 			}
-		} else {
-			break;
-		}
-	}
-
-	return expression;
-}
-
-static LitExpression* parse_compound_power(LitLexer* lexer) {
-	LitExpression* expression = parse_call(lexer);
-
-	if (match(lexer, TOKEN_CARET_EQUAL) || match(lexer, TOKEN_CELL_EQUAL)) {
-		/*
-		 * Desugar this:
-		 * a ^= 10
-		 * into this:
-		 * a = a ^ 10
-		 */
-
-		uint64_t line = lexer->last_line;
-		LitTokenType type = lexer->previous.type;
-		LitExpression* operator = NULL;
-
-		if (type == TOKEN_CARET_EQUAL) {
-			LitBinaryExpression* bin = lit_make_binary_expression(lexer->compiler, line, expression, parse_call(lexer), TOKEN_CARET);
-			bin->ignore_left = true; // Because its already freed from another expression
-			operator = (LitExpression *) bin;
-		} else if (type == TOKEN_CELL_EQUAL) {
-			LitBinaryExpression* bin = lit_make_binary_expression(lexer->compiler, line, expression, parse_call(lexer), TOKEN_CELL);
-			bin->ignore_left = true; // Because its already freed from another expression
-			operator = (LitExpression *) bin;
-		}
-
-		return (LitExpression *) lit_make_assign_expression(lexer->compiler, line, expression, operator);
-	}
 
-	return expression;
-}
-
-static LitExpression* parse_compound_multiplication(LitLexer* lexer) {
-	LitExpression* expression = parse_compound_power(lexer);
-
-	if (match(lexer, TOKEN_STAR_EQUAL) || match(lexer, TOKEN_SLASH_EQUAL) || match(lexer, TOKEN_PERCENT_EQUAL)) {
-		/*
-		 * Desugar this:
-		 * a *= 10
-		 * into this:
-		 * a = a * 10
-		 */
-
-		uint64_t line = lexer->last_line;
-		LitTokenType type = lexer->previous.type;
-		LitExpression* operator = NULL;
-
-		if (type == TOKEN_STAR_EQUAL) {
-			LitBinaryExpression* bin = lit_make_binary_expression(lexer->compiler, line, expression, parse_compound_power(lexer), TOKEN_STAR);
-			bin->ignore_left = true; // Because its already freed from another expression
-			operator = (LitExpression *) bin;
-		} else if (type == TOKEN_SLASH_EQUAL) {
-			LitBinaryExpression* bin = lit_make_binary_expression(lexer->compiler, line, expression, parse_compound_power(lexer), TOKEN_SLASH);
-			bin->ignore_left = true; // Because its already freed from another expression
-			operator = (LitExpression *) bin;
-		} else {
-			LitBinaryExpression* bin = lit_make_binary_expression(lexer->compiler, line, expression, parse_compound_power(lexer), TOKEN_PERCENT);
-			bin->ignore_left = true; // Because its already freed from another expression
-			operator = (LitExpression *) bin;
-		}
-
-		return (LitExpression *) lit_make_assign_expression(lexer->compiler, line, expression, operator);
-	}
-
-	return expression;
-}
-
-static LitExpression* parse_compound_addition(LitLexer* lexer) {
-	LitExpression* expression = parse_compound_multiplication(lexer);
-
-	if (match(lexer, TOKEN_PLUS_EQUAL) || match(lexer, TOKEN_MINUS_EQUAL) || match(lexer, TOKEN_PLUS_PLUS) || match(lexer, TOKEN_MINUS_MINUS)) {
-		/*
-		 * Desugar this:
-		 * a += 10 or a++
-		 * into this:
-		 * a = a + 10 or a = a + 1
-		 */
-
-		uint64_t line = lexer->last_line;
-		LitTokenType type = lexer->previous.type;
-		LitExpression* operator = NULL;
-
-		if (type == TOKEN_PLUS_EQUAL) {
-			LitBinaryExpression* bin = lit_make_binary_expression(lexer->compiler, line, expression, parse_compound_multiplication(lexer), TOKEN_PLUS);
-			bin->ignore_left = true; // Because its already freed from another expression
-			operator = (LitExpression *) bin;
-		} else if (type == TOKEN_MINUS_EQUAL) {
-			LitBinaryExpression* bin = lit_make_binary_expression(lexer->compiler, line, expression, parse_compound_multiplication(lexer), TOKEN_MINUS);
-			bin->ignore_left = true; // Because its already freed from another expression
-			operator = (LitExpression *) bin;
-		} else if (type == TOKEN_PLUS_PLUS) {
-			LitBinaryExpression* bin = lit_make_binary_expression(lexer->compiler, line, expression, (LitExpression *) lit_make_literal_expression(lexer->compiler, line, MAKE_NUMBER_VALUE(1)), TOKEN_PLUS);
-			bin->ignore_left = true; // Because its already freed from another expression
-			operator = (LitExpression *) bin;
-		} else {
-			LitBinaryExpression* bin = lit_make_binary_expression(lexer->compiler, line, expression, (LitExpression *) lit_make_literal_expression(lexer->compiler, line, MAKE_NUMBER_VALUE(1)), TOKEN_MINUS);
-			bin->ignore_left = true; // Because its already freed from another expression
-			operator = (LitExpression *) bin;
+			break;
 		}
 
-		return (LitExpression *) lit_make_assign_expression(lexer->compiler, line, expression, operator);
+		case TOKEN_STRING: value = MAKE_OBJECT_VALUE(lit_copy_string(MM(lexer->compiler), lexer->previous.start + 1, lexer->previous.length - 2)); break;
+		case TOKEN_CHAR: value = MAKE_CHAR_VALUE((unsigned char) lexer->previous.start[1]); break;
+		default: break;
 	}
 
-	return expression;
+	return (LitExpression*) lit_make_literal_expression(lexer->compiler, lexer->last_line, value);
 }
 
-static LitExpression* parse_is(LitLexer* lexer) {
-	LitExpression *expression = parse_compound_addition(lexer);
+static LitExpression* parse_grouping(LitLexer* lexer) {
+	uint64_t line = lexer->last_line;
 
-	if (match(lexer, TOKEN_IS)) {
-		uint64_t line = lexer->last_line;
-		LitTokenType operator = lexer->previous.type;
-		expression = (LitExpression*) lit_make_binary_expression(lexer->compiler, line, expression, parse_compound_addition(lexer), operator);
-	}
+	LitExpression* expression = parse_expression(lexer);
+	consume(lexer, TOKEN_RIGHT_PAREN, "Expected ')' after expression");
 
-	return expression;
+	return (LitExpression*) lit_make_grouping_expression(lexer->compiler, line, expression);
 }
 
 static LitExpression* parse_unary(LitLexer* lexer) {
-	if (match(lexer, TOKEN_BANG) || match(lexer, TOKEN_MINUS) || match(lexer, TOKEN_CELL)) {
-		uint64_t line = lexer->last_line;
-		LitTokenType operator = lexer->previous.type;
-		return (LitExpression*) lit_make_unary_expression(lexer->compiler, line, parse_unary(lexer), operator);
-	}
+	uint64_t line = lexer->last_line;
+	LitTokenType operator = lexer->previous.type;
 
-	return parse_is(lexer);
+	return (LitExpression*) lit_make_unary_expression(lexer->compiler, line, parse_precedence(lexer, PREC_UNARY), operator);
 }
 
-static LitExpression* parse_power(LitLexer* lexer) {
-	LitExpression* expression = parse_unary(lexer);
+static LitExpression* parse_call(LitLexer* lexer, LitExpression* callee, uint64_t start_line) {
+	uint64_t line = lexer->last_line;
+	LitExpressions* args = (LitExpressions*) reallocate(lexer->compiler, NULL, 0, sizeof(LitExpressions));
+	lit_init_expressions(args);
 
-	while (match(lexer, TOKEN_CARET) || match(lexer, TOKEN_CELL)) {
-		uint64_t line = lexer->last_line;
-		LitTokenType operator = lexer->previous.type;
-		expression = (LitExpression*) lit_make_binary_expression(lexer->compiler, line, expression, parse_unary(lexer), operator);
+	if (lexer->current.type != TOKEN_RIGHT_PAREN) {
+		do {
+			lit_expressions_write(MM(lexer->compiler), args, parse_expression(lexer));
+		} while (match(lexer, TOKEN_COMMA));
 	}
 
-	return expression;
+	consume(lexer, TOKEN_RIGHT_PAREN, "Expected ')' after arguments");
+	return (LitExpression*) lit_make_call_expression(lexer->compiler, line, callee, args);
 }
 
-static LitExpression* parse_multiplication(LitLexer* lexer) {
-	LitExpression* expression = parse_power(lexer);
+static LitExpression* parse_dot(LitLexer* lexer, LitExpression* object, uint64_t start_line) {
+	uint64_t line = lexer->last_line;
+	LitToken token = consume(lexer, TOKEN_IDENTIFIER, "Expected property name after '.'");
 
-	while (match(lexer, TOKEN_STAR) || match(lexer, TOKEN_SLASH) || match(lexer, TOKEN_PERCENT)) {
-		uint64_t line = lexer->last_line;
-		LitTokenType operator = lexer->previous.type;
-		expression = (LitExpression*) lit_make_binary_expression(lexer->compiler, line, expression, parse_power(lexer), operator);
+	if (match(lexer, TOKEN_EQUAL)) {
+		return (LitExpression*) lit_make_set_expression(lexer->compiler, line, object, parse_precedence(lexer, PREC_EQUALITY), copy_string(lexer, &token));
 	}
 
-	return expression;
+	return (LitExpression*) lit_make_get_expression(lexer->compiler, line, object, copy_string(lexer, &token));
 }
 
-static LitExpression* parse_addition(LitLexer* lexer) {
-	LitExpression* expression = parse_multiplication(lexer);
-
-	while (match(lexer, TOKEN_PLUS) || match(lexer, TOKEN_MINUS)) {
-		uint64_t line = lexer->last_line;
-		LitTokenType operator = lexer->previous.type;
-		expression = (LitExpression*) lit_make_binary_expression(lexer->compiler, line, expression, parse_multiplication(lexer), operator);
-	}
+static LitExpression* parse_binary(LitLexer* lexer, LitExpression* left, uint64_t start_line) {
+	uint64_t line = lexer->last_line;
+	LitTokenType operator = lexer->previous.type;
 
-	return expression;
+	return (LitExpression*) lit_make_binary_expression(lexer->compiler, line, left, parse_precedence(lexer, rules[operator].precedence + 1), operator);
 }
 
-static LitExpression* parse_comprasion(LitLexer *lexer) {
-	LitExpression* expression = parse_addition(lexer);
-
-	while (match(lexer, TOKEN_LESS) || match(lexer, TOKEN_LESS_EQUAL) || match(lexer, TOKEN_GREATER) || match(lexer, TOKEN_GREATER_EQUAL)) {
-		uint64_t line = lexer->last_line;
-		LitTokenType operator = lexer->previous.type;
-		expression = (LitExpression*) lit_make_binary_expression(lexer->compiler, line, expression, parse_addition(lexer), operator);
-	}
+static LitExpression* parse_logical(LitLexer* lexer, LitExpression* left, uint64_t start_line) {
+	uint64_t line = lexer->last_line;
+	LitTokenType operator = lexer->previous.type;
 
-	return expression;
+	return (LitExpression*) lit_make_logical_expression(lexer->compiler, line, operator, left, parse_precedence(lexer, rules[operator].precedence + 1));
 }
 
-static LitExpression* parse_equality(LitLexer* lexer) {
-	LitExpression* expression = parse_comprasion(lexer);
+static LitExpression* parse_compound(LitLexer* lexer, LitExpression* left, uint64_t start_line) {
+	/*
+	 * Desugar this:
+	 * a += 10 or a++
+	 * into this:
+	 * a = a + 10 or a = a + 1
+	 */
 
-	while (match(lexer, TOKEN_BANG_EQUAL) || match(lexer, TOKEN_EQUAL_EQUAL)) {
-		uint64_t line = lexer->last_line;
-		LitTokenType operator = lexer->previous.type;
-		expression = (LitExpression*) lit_make_binary_expression(lexer->compiler, line, expression, parse_comprasion(lexer), operator);
+	uint64_t line = lexer->last_line;
+	LitTokenType type = lexer->previous.type;
+	LitTokenType operator;
+	LitExpression* right;
+
+	switch (type) {
+		case TOKEN_PLUS_PLUS: operator = TOKEN_PLUS; break;
+		case TOKEN_MINUS_MINUS: operator = TOKEN_MINUS; break;
+		case TOKEN_PLUS_EQUAL: operator = TOKEN_PLUS; break;
+		case TOKEN_MINUS_EQUAL: operator = TOKEN_MINUS; break;
+		case TOKEN_STAR_EQUAL: operator = TOKEN_STAR; break;
+		case TOKEN_SLASH_EQUAL: operator = TOKEN_SLASH; break;
+		case TOKEN_PERCENT_EQUAL: operator = TOKEN_PERCENT; break;
+		case TOKEN_CARET_EQUAL: operator = TOKEN_CARET; break;
+		default: operator = TOKEN_CELL; break;
+	}
+
+	if (type == TOKEN_PLUS_PLUS || type == TOKEN_MINUS_MINUS) {
+		right = (LitExpression*) lit_make_literal_expression(lexer->compiler, line, MAKE_INT_VALUE(1));
+	} else {
+		right = parse_precedence(lexer, rules[type].precedence + 1);
 	}
 
-	return expression;
-}
-
-static LitExpression* parse_and(LitLexer* lexer) {
-	LitExpression* expression = parse_equality(lexer);
+	LitBinaryExpression* bin = lit_make_binary_expression(lexer->compiler, line, left, right, operator);
+	bin->ignore_left = true; // Because its already freed from another expression
 
-	while (match(lexer, TOKEN_AND)) {
-		uint64_t line = lexer->last_line;
-		LitTokenType operator = lexer->previous.type;
-		expression = (LitExpression*) lit_make_logical_expression(lexer->compiler, line, operator, expression, parse_equality(lexer));
-	}
-
-	return expression;
+	return (LitExpression*) lit_make_assign_expression(lexer->compiler, line, left, (LitExpression*) bin);
 }
 
-static LitExpression* parse_or(LitLexer* lexer) {
-	LitExpression* expression = parse_and(lexer);
-
-	while (match(lexer, TOKEN_OR)) {
-		uint64_t line = lexer->last_line;
-		LitTokenType operator = lexer->previous.type;
-		expression = (LitExpression*) lit_make_logical_expression(lexer->compiler, line, operator, expression, parse_and(lexer));
-	}
+static LitExpression* parse_ternary(LitLexer* lexer, LitExpression* condition, uint64_t line) {
+	LitExpression* if_branch = parse_expression(lexer);
+	consume(lexer, TOKEN_COLON, "Expected ':'");
+	LitExpression* else_branch = parse_expression(lexer);
 
-	return expression;
+	return (LitExpression*) lit_make_if_expression(lexer->compiler, line, condition, if_branch, else_branch, NULL, NULL);
 }
 
-static LitExpression* parse_short_if(LitLexer* lexer) {
-	uint64_t line = lexer->line;
-	LitExpression* expression = parse_or(lexer);
-
-	if (match(lexer, TOKEN_QUESTION)) {
-		LitExpression* if_branch = parse_expression(lexer);
-		consume(lexer, TOKEN_COLON, "Expected ':'");
-		LitExpression* else_branch = parse_expression(lexer);
-
-		return (LitExpression*) lit_make_if_expression(lexer->compiler, line, expression, if_branch, else_branch, NULL, NULL);
-	}
-
-	return expression;
-}
+static LitExpression* parse_assignment(LitLexer* lexer, LitExpression* to, uint64_t start_line) {
+	uint64_t line = lexer->last_line;
+	LitToken equal = lexer->previous;
+	LitExpression* value = parse_precedence(lexer, PREC_ASSIGNMENT);
 
-static LitExpression* parse_if_expr(LitLexer* lexer) {
-	if (match(lexer, TOKEN_IF)) {
-		return parse_if_expression(lexer);
+	if (to->type == VAR_EXPRESSION) {
+		return (LitExpression*) lit_make_assign_expression(lexer->compiler, line, to, value);
 	}
 
-	return parse_short_if(lexer);
+	error(lexer, &equal, "Invalid assignment target");
+	return NULL;
 }
 
-static LitExpression* parse_assigment(LitLexer* lexer) {
-	LitExpression* expression = parse_if_expr(lexer);
-
-	if (match(lexer, TOKEN_EQUAL)) {
-		uint64_t line = lexer->last_line;
-		LitToken equal = lexer->previous;
-		LitExpression* value = parse_assigment(lexer);
-
-		if (expression->type == VAR_EXPRESSION) {
-			return (LitExpression*) lit_make_assign_expression(lexer->compiler, line, expression, value);
-		}
-
-		error(lexer, &equal, "Invalid assignment target");
-		return NULL;
-	}
-
-	return expression;
-}
+#define PREFIX(fn, precedence) { fn, NULL, precedence, PREC_NONE, false }
+#define INFIX(fn, precedence) { NULL, fn, PREC_NONE, precedence, false }
+#define SINGLE(fn, precedence) { NULL, fn, PREC_NONE, precedence, true }
+
+static LitParseRule rules[TOKEN_EOF + 1] = {
+	[TOKEN_LEFT_PAREN] = { parse_grouping, parse_call, PREC_PRIMARY, PREC_CALL, false },
+	[TOKEN_DOT] = INFIX(parse_dot, PREC_CALL),
+	[TOKEN_MINUS] = { parse_unary, parse_binary, PREC_UNARY, PREC_TERM, false },
+	[TOKEN_PLUS] = INFIX(parse_binary, PREC_TERM),
+	[TOKEN_SLASH] = INFIX(parse_binary, PREC_FACTOR),
+	[TOKEN_STAR] = INFIX(parse_binary, PREC_FACTOR),
+	[TOKEN_PERCENT] = INFIX(parse_binary, PREC_FACTOR),
+	[TOKEN_CARET] = INFIX(parse_binary, PREC_POWER),
+	[TOKEN_CELL] = { parse_unary, parse_binary, PREC_UNARY, PREC_POWER, false },
+	[TOKEN_BANG] = PREFIX(parse_unary, PREC_UNARY),
+	[TOKEN_BANG_EQUAL] = INFIX(parse_binary, PREC_EQUALITY),
+	[TOKEN_EQUAL_EQUAL] = INFIX(parse_binary, PREC_EQUALITY),
+	[TOKEN_GREATER] = INFIX(parse_binary, PREC_COMPARISON),
+	[TOKEN_GREATER_EQUAL] = INFIX(parse_binary, PREC_COMPARISON),
+	[TOKEN_LESS] = INFIX(parse_binary, PREC_COMPARISON),
+	[TOKEN_LESS_EQUAL] = INFIX(parse_binary, PREC_COMPARISON),
+	[TOKEN_IS] = SINGLE(parse_binary, PREC_IS),
+	[TOKEN_AND] = INFIX(parse_logical, PREC_AND),
+	[TOKEN_OR] = INFIX(parse_logical, PREC_OR),
+	[TOKEN_QUESTION] = SINGLE(parse_ternary, PREC_TERNARY),
+	[TOKEN_EQUAL] = SINGLE(parse_assignment, PREC_ASSIGNMENT),
+	[TOKEN_PLUS_EQUAL] = SINGLE(parse_compound, PREC_COMPOUND_TERM),
+	[TOKEN_MINUS_EQUAL] = SINGLE(parse_compound, PREC_COMPOUND_TERM),
+	[TOKEN_PLUS_PLUS] = SINGLE(parse_compound, PREC_COMPOUND_TERM),
+	[TOKEN_MINUS_MINUS] = SINGLE(parse_compound, PREC_COMPOUND_TERM),
+	[TOKEN_STAR_EQUAL] = SINGLE(parse_compound, PREC_COMPOUND_FACTOR),
+	[TOKEN_SLASH_EQUAL] = SINGLE(parse_compound, PREC_COMPOUND_FACTOR),
+	[TOKEN_PERCENT_EQUAL] = SINGLE(parse_compound, PREC_COMPOUND_FACTOR),
+	[TOKEN_CARET_EQUAL] = SINGLE(parse_compound, PREC_COMPOUND_POWER),
+	[TOKEN_CELL_EQUAL] = SINGLE(parse_compound, PREC_COMPOUND_POWER),
+	[TOKEN_IDENTIFIER] = PREFIX(parse_variable, PREC_PRIMARY),
+	[TOKEN_STRING] = PREFIX(parse_literal, PREC_PRIMARY),
+	[TOKEN_NUMBER] = PREFIX(parse_literal, PREC_PRIMARY),
+	[TOKEN_CHAR] = PREFIX(parse_literal, PREC_PRIMARY),
+	[TOKEN_TRUE] = PREFIX(parse_literal, PREC_PRIMARY),
+	[TOKEN_FALSE] = PREFIX(parse_literal, PREC_PRIMARY),
+	[TOKEN_NIL] = PREFIX(parse_literal, PREC_PRIMARY),
+	[TOKEN_THIS] = PREFIX(parse_this, PREC_PRIMARY),
+	[TOKEN_SUPER] = PREFIX(parse_super, PREC_PRIMARY),
+	[TOKEN_IF] = PREFIX(parse_if, PREC_IF)
+};
+
+#undef PREFIX
+#undef INFIX
+#undef SINGLE
 
 static LitExpression* parse_expression(LitLexer* lexer) {
-	return parse_assigment(lexer);
+	return parse_precedence(lexer, PREC_ASSIGNMENT);
 }
 
 static LitStatement* parse_expression_statement(LitLexer* lexer) {
@@ -637,12 +561,12 @@ static LitStatement* parse_block_statement(LitLexer* lexer) {
 	return (LitStatement*) lit_make_block_statement(lexer->compiler, line, statements);
 }
 
-static char* parse_argument_type(LitLexer* lexer) {
+static LitString* parse_argument_type(LitLexer* lexer) {
 	consume(lexer, TOKEN_IDENTIFIER, "Expected argument type");
 	char* start = (char*) lexer->previous.start;
 
 	if (!match(lexer, TOKEN_LESS)) {
-		return (char*) copy_string_native(lexer, start, lexer->previous.length);
+		return copy_string(lexer, &lexer->previous);
 	}
 
 	while (!match(lexer, TOKEN_GREATER)) {
@@ -653,7 +577,7 @@ static char* parse_argument_type(LitLexer* lexer) {
 		}
 	}
 
-	return (char*) copy_string_native(lexer, start, (uint64_t) (lexer->current.start - start - 1));
+	return copy_string_native(lexer, start, (uint64_t) (lexer->current.start - start - 1));
 }
 
 static LitExpression* parse_lambda(LitLexer* lexer) {
@@ -666,16 +590,16 @@ static LitExpression* parse_lambda(LitLexer* lexer) {
 		lit_init_parameters(parameters);
 
 		do {
-			char* type = parse_argument_type(lexer);
+			LitString* type = parse_argument_type(lexer);
 			LitToken name = consume(lexer, TOKEN_IDENTIFIER, "Expected argument name");
 
-			lit_parameters_write(MM(lexer->compiler), parameters, (LitParameter) {copy_string_native(lexer, name.start, name.length), type});
+			lit_parameters_write(MM(lexer->compiler), parameters, (LitParameter) {copy_string(lexer, &name), type});
 		} while (match(lexer, TOKEN_COMMA));
 	}
 
 	consume(lexer, TOKEN_RIGHT_PAREN, "Expected ')' after parameters");
 
-	LitParameter return_type = (LitParameter) {NULL, "void"};
+	LitParameter return_type = (LitParameter) {NULL, copy_string_native(lexer, "void", 4)};
 
 	if (match(lexer, TOKEN_GREATER)) {
 		LitToken type = consume(lexer, TOKEN_IDENTIFIER, "Expected return type");
@@ -687,7 +611,7 @@ static LitExpression* parse_lambda(LitLexer* lexer) {
 	return (LitExpression*) lit_make_lambda_expression(lexer->compiler, line, parameters, parse_block_statement(lexer), (LitParameter) {NULL, return_type.type});
 }
 
-static LitStatement* parse_function_statement(LitLexer* lexer, const char* return_type, char* name) {
+static LitStatement* parse_function_statement(LitLexer* lexer, LitString* return_type, LitString* name) {
 	uint64_t line = lexer->last_line;
 	consume(lexer, TOKEN_LEFT_PAREN, "Expected '(' after function name");
 
@@ -698,10 +622,10 @@ static LitStatement* parse_function_statement(LitLexer* lexer, const char* retur
 		lit_init_parameters(parameters);
 
 		do {
-			char* type = parse_argument_type(lexer);
+			LitString* type = parse_argument_type(lexer);
 			LitToken argName = consume(lexer, TOKEN_IDENTIFIER, "Expected argument name");
 
-			lit_parameters_write(MM(lexer->compiler), parameters, (LitParameter) {copy_string_native(lexer, argName.start, argName.length), type});
+			lit_parameters_write(MM(lexer->compiler), parameters, (LitParameter) {copy_string(lexer, &argName), type});
 		} while (match(lexer, TOKEN_COMMA));
 	}
 
@@ -720,7 +644,7 @@ static LitStatement* parse_function_statement(LitLexer* lexer, const char* retur
 	return (LitStatement*) lit_make_function_statement(lexer->compiler, line, name, parameters, body, (LitParameter) {NULL, return_type});
 }
 
-static LitStatement* parse_method_statement(LitLexer* lexer, bool final, bool abstract, bool override, bool is_static, LitAccessType access, const char* return_type, char *name) {
+static LitStatement* parse_method_statement(LitLexer* lexer, bool final, bool abstract, bool override, bool is_static, LitAccessType access, LitString* return_type, LitString* name) {
 	uint64_t line = lexer->last_line;
 
 	if (final) {
@@ -742,10 +666,10 @@ static LitStatement* parse_method_statement(LitLexer* lexer, bool final, bool ab
 		lit_init_parameters(parameters);
 
 		do {
-			char* type = parse_argument_type(lexer);
+			LitString* type = parse_argument_type(lexer);
 			LitToken argName = consume(lexer, TOKEN_IDENTIFIER, "Expected argument name");
 
-			lit_parameters_write(MM(lexer->compiler), parameters, (LitParameter) {copy_string_native(lexer, argName.start, argName.length), type});
+			lit_parameters_write(MM(lexer->compiler), parameters, (LitParameter) {copy_string(lexer, &argName), type});
 		} while (match(lexer, TOKEN_COMMA));
 	}
 
@@ -828,8 +752,8 @@ static LitStatement* parse_var_declaration(LitLexer* lexer, bool final) {
 
 static LitStatement* parse_extended_var_declaration(LitLexer* lexer, LitToken* type, LitToken* name, bool final) {
 	uint64_t line = lexer->last_line;
-	char* name_str = (char *) copy_string(lexer, name);
-	char* type_str = (char *) copy_string(lexer, type);
+	LitString* name_str = copy_string(lexer, name);
+	LitString* type_str = copy_string(lexer, type);
 
 	advance(lexer);
 	LitExpression* init = NULL;
@@ -841,7 +765,7 @@ static LitStatement* parse_extended_var_declaration(LitLexer* lexer, LitToken* t
 	return (LitStatement*) lit_make_var_statement(lexer->compiler, line, name_str, init, type_str, final);
 }
 
-static LitStatement* parse_field_declaration(LitLexer* lexer, bool final, bool abstract, bool override, bool is_static, LitAccessType access, char* type, char* name) {
+static LitStatement* parse_field_declaration(LitLexer* lexer, bool final, bool abstract, bool override, bool is_static, LitAccessType access, LitString* type, LitString* name) {
 	LitExpression* init = NULL;
 	uint64_t line = lexer->last_line;
 
@@ -880,7 +804,7 @@ static LitStatement* parse_class_declaration(LitLexer* lexer, bool abstract, boo
 	}
 
 	LitToken name_token = consume(lexer, TOKEN_IDENTIFIER, "Expect class name");
-	char* class_name = (char *) copy_string(lexer, &name_token);
+	LitString* class_name = copy_string(lexer, &name_token);
 	LitVarExpression* super = NULL;
 
 	if (match(lexer, TOKEN_LESS)) {
@@ -984,7 +908,7 @@ static LitStatement* parse_class_declaration(LitLexer* lexer, bool abstract, boo
 					lit_init_statements(fields);
 				}
 
-				char* name = (char *) copy_string(lexer, &lexer->current);
+				LitString* name = copy_string(lexer, &lexer->current);
 				advance(lexer);
 				lit_statements_write(MM(lexer->compiler), fields, parse_field_declaration(lexer, final, is_abstract, override, field_is_static, access, NULL, name));
 			} else {
@@ -997,8 +921,8 @@ static LitStatement* parse_class_declaration(LitLexer* lexer, bool abstract, boo
 				LitToken before = lexer->previous;
 				advance(lexer);
 
-				char* type = (char *) copy_string(lexer, &before);
-				char* name = (char *) copy_string(lexer, &lexer->previous);
+				LitString* type = copy_string(lexer, &before);
+				LitString* name = copy_string(lexer, &lexer->previous);
 
 				if (lexer->current.type == TOKEN_LEFT_PAREN) {
 					if (methods == NULL) {
@@ -1053,8 +977,8 @@ static LitStatement* parse_declaration(LitLexer* lexer) {
 			advance(lexer);
 
 			if (lexer->current.type == TOKEN_LEFT_PAREN) {
-				char* type = (char *) copy_string(lexer, &before);
-				char* name = (char *) copy_string(lexer, &lexer->previous);
+				LitString* type = copy_string(lexer, &before);
+				LitString* name = copy_string(lexer, &lexer->previous);
 
 				return parse_function_statement(lexer, type, name);
 			}
@@ -0,0 +1,352 @@
+#include <memory.h>
+
+#include <compiler/lit_peephole.h>
+#include <compiler/lit_compiler.h>
+#include <vm/lit_memory.h>
+
+typedef struct {
+	uint64_t offset;
+	uint64_t size;
+	uint64_t line;
+	uint64_t target; // Index of the instruction, that the jump leads to
+
+	uint8_t opcode;
+	bool removed;
+	bool jump_target;
+} LitInstruction;
+
+static bool is_jump(uint8_t opcode) {
+	return opcode == OP_JUMP || opcode == OP_JUMP_IF_FALSE || opcode == OP_JUMP_IF_TRUE || opcode == OP_LOOP;
+}
+
+static bool is_forward_jump(uint8_t opcode) {
+	return opcode == OP_JUMP || opcode == OP_JUMP_IF_FALSE || opcode == OP_JUMP_IF_TRUE;
+}
+
+// Instructions, that push a value and have no other effects
+static bool is_pure_push(uint8_t opcode) {
+	switch (opcode) {
+		case OP_NIL:
+		case OP_TRUE:
+		case OP_FALSE:
+		case OP_CONSTANT:
+		case OP_GET_LOCAL:
+		case OP_GET_UPVALUE: return true;
+		default: return false;
+	}
+}
+
+static uint8_t get_for_set(uint8_t opcode) {
+	switch (opcode) {
+		case OP_SET_LOCAL: return OP_GET_LOCAL;
+		case OP_SET_UPVALUE: return OP_GET_UPVALUE;
+		case OP_SET_GLOBAL: return OP_GET_GLOBAL;
+		default: return OP_RETURN;
+	}
+}
+
+// Skips removed instructions, jumps to removed code end up at the next instruction, that is still there
+static uint64_t resolve(LitInstruction* instructions, uint64_t count, uint64_t index) {
+	while (index < count && instructions[index].removed) {
+		index++;
+	}
+
+	return index;
+}
+
+static LitInstruction* next_instruction(LitInstruction* instructions, uint64_t count, uint64_t index) {
+	index = resolve(instructions, count, index + 1);
+	return index < count ? &instructions[index] : NULL;
+}
+
+static bool has_same_operand(LitChunk* chunk, LitInstruction* a, LitInstruction* b) {
+	uint8_t first = chunk->code[a->offset + 1];
+	uint8_t second = chunk->code[b->offset + 1];
+
+	if (a->opcode == OP_SET_GLOBAL) {
+		// Globals are named by constants, strings are interned, so equal names are the same object
+		return chunk->constants.values[first] == chunk->constants.values[second];
+	}
+
+	return first == second;
+}
+
+static void mark_jump_targets(LitInstruction* instructions, uint64_t count) {
+	for (uint64_t i = 0; i < count; i++) {
+		instructions[i].jump_target = false;
+	}
+
+	for (uint64_t i = 0; i < count; i++) {
+		LitInstruction* instruction = &instructions[i];
+
+		if (!instruction->removed && is_jump(instruction->opcode)) {
+			uint64_t target = resolve(instructions, count, instruction->target);
+
+			if (target < count) {
+				instructions[target].jump_target = true;
+			}
+		}
+	}
+}
+
+// Jumps to the removed instruction now land on the next one
+static void remove_instruction(LitInstruction* instructions, uint64_t count, LitInstruction* instruction) {
+	instruction->removed = true;
+
+	if (instruction->jump_target) {
+		uint64_t next = resolve(instructions, count, (uint64_t) (instruction - instructions) + 1);
+
+		if (next < count) {
+			instructions[next].jump_target = true;
+		}
+	}
+}
+
+static void retarget(LitInstruction* instructions, uint64_t count, LitInstruction* jump, uint64_t target) {
+	jump->target = target;
+	target = resolve(instructions, count, target);
+
+	if (target < count) {
+		instructions[target].jump_target = true;
+	}
+}
+
+static bool optimize_instruction(LitChunk* chunk, LitInstruction* instructions, uint64_t count, uint64_t index) {
+	LitInstruction* instruction = &instructions[index];
+	LitInstruction* next = next_instruction(instructions, count, index);
+
+	if (is_forward_jump(instruction->opcode)) {
+		uint64_t target = resolve(instructions, count, instruction->target);
+
+		// Jump to the next instruction does nothing, conditional jumps only peek the value
+		if (next == NULL ? target >= count : target == (uint64_t) (next - instructions)) {
+			remove_instruction(instructions, count, instruction);
+			return true;
+		}
+
+		if (target < count) {
+			LitInstruction* destination = &instructions[target];
+
+			/*
+			 * Jump to a jump goes straight to its destination,
+			 * the conditional jumps don't pop, so the same condition jumps again
+			 */
+			if (destination != instruction && (destination->opcode == OP_JUMP || destination->opcode == instruction->opcode)) {
+				retarget(instructions, count, instruction, destination->target);
+				return true;
+			}
+		}
+	}
+
+	if (next == NULL || next->jump_target) {
+		return false;
+	}
+
+	uint64_t next_index = (uint64_t) (next - instructions);
+
+	switch (instruction->opcode) {
+		case OP_RETURN:
+		case OP_JUMP:
+		case OP_LOOP: {
+			// Nothing jumps here, so it can't be reached
+			remove_instruction(instructions, count, next);
+			return true;
+		}
+		case OP_JUMP_IF_FALSE: {
+			// a || b jumps over the jump to the end, when a is false
+			if (next->opcode == OP_JUMP && resolve(instructions, count, instruction->target) == resolve(instructions, count, next_index + 1)) {
+				instruction->opcode = OP_JUMP_IF_TRUE;
+				retarget(instructions, count, instruction, next->target);
+				remove_instruction(instructions, count, next);
+
+				return true;
+			}
+
+			break;
+		}
+		case OP_NOT: {
+			// The condition is popped on both paths, so it doesn't matter, if it was negated
+			if (next->opcode == OP_JUMP_IF_FALSE) {
+				LitInstruction* after = next_instruction(instructions, count, next_index);
+				uint64_t target = resolve(instructions, count, next->target);
+
+				if (after != NULL && after->opcode == OP_POP && target < count && instructions[target].opcode == OP_POP) {
+					next->opcode = OP_JUMP_IF_TRUE;
+					remove_instruction(instructions, count, instruction);
+
+					return true;
+				}
+			}
+
+			break;
+		}
+		case OP_SET_LOCAL:
+		case OP_SET_UPVALUE:
+		case OP_SET_GLOBAL: {
+			// The stored value is still on the stack, no need to pop it and load it again
+			if (next->opcode == OP_POP) {
+				LitInstruction* after = next_instruction(instructions, count, next_index);
+
+				if (after != NULL && !after->jump_target && after->opcode == get_for_set(instruction->opcode) && has_same_operand(chunk, instruction, after)) {
+					remove_instruction(instructions, count, next);
+					remove_instruction(instructions, count, after);
+
+					return true;
+				}
+			}
+
+			break;
+		}
+	}
+
+	if (is_pure_push(instruction->opcode) && next->opcode == OP_POP) {
+		remove_instruction(instructions, count, instruction);
+		remove_instruction(instructions, count, next);
+
+		return true;
+	}
+
+	return false;
+}
+
+static void rewrite_chunk(LitCompiler* compiler, LitChunk* chunk, LitInstruction* instructions, uint64_t count) {
+	uint64_t* offsets = ALLOCATE(compiler, uint64_t, count + 1);
+	uint64_t position = 0;
+
+	// Removed instructions get the offset of the next instruction, so jumps to them are resolved for free
+	for (uint64_t i = 0; i < count; i++) {
+		offsets[i] = position;
+
+		if (!instructions[i].removed) {
+			position += instructions[i].size;
+		}
+	}
+
+	offsets[count] = position;
+
+	LitChunk result;
+	lit_init_chunk(&result);
+
+	for (uint64_t i = 0; i < count; i++) {
+		LitInstruction* instruction = &instructions[i];
+
+		if (instruction->removed) {
+			continue;
+		}
+
+		if (is_jump(instruction->opcode)) {
+			uint64_t from = offsets[i] + 3;
+			uint64_t to = offsets[instruction->target];
+			uint64_t jump = instruction->opcode == OP_LOOP ? from - to : to - from;
+
+			lit_chunk_write(MM(compiler), &result, instruction->opcode, instruction->line);
+			lit_chunk_write(MM(compiler), &result, (uint8_t) ((jump >> 8) & 0xff), instruction->line);
+			lit_chunk_write(MM(compiler), &result, (uint8_t) (jump & 0xff), instruction->line);
+		} else {
+			lit_chunk_write(MM(compiler), &result, instruction->opcode, instruction->line);
+
+			for (uint64_t j = 1; j < instruction->size; j++) {
+				lit_chunk_write(MM(compiler), &result, chunk->code[instruction->offset + j], instruction->line);
+			}
+		}
+	}
+
+	FREE_ARRAY(compiler, uint64_t, offsets, count + 1);
+	FREE_ARRAY(compiler, uint8_t, chunk->code, chunk->capacity);
+	FREE_ARRAY(compiler, uint64_t, chunk->lines, chunk->line_capacity);
+
+	chunk->code = result.code;
+	chunk->count = result.count;
+	chunk->capacity = result.capacity;
+	chunk->lines = result.lines;
+	chunk->line_count = result.line_count;
+	chunk->line_capacity = result.line_capacity;
+}
+
+void lit_optimize_chunk(LitCompiler* compiler, LitChunk* chunk) {
+	uint64_t size = chunk->count;
+
+	if (size == 0) {
+		return;
+	}
+
+	// Maps byte offsets to instruction indices, -1 for offsets inside of the instructions
+	int64_t* starts = ALLOCATE(compiler, int64_t, size + 1);
+	LitInstruction* instructions = ALLOCATE(compiler, LitInstruction, size);
+	uint64_t count = 0;
+
+	for (uint64_t i = 0; i <= size; i++) {
+		starts[i] = -1;
+	}
+
+	// Lines are stored as pairs of (instruction count, line)
+	uint64_t line_index = 0;
+	uint64_t line_end = chunk->lines[0];
+	uint64_t offset = 0;
+
+	while (offset < size) {
+		while (offset >= line_end && line_index + 2 < chunk->line_count) {
+			line_index += 2;
+			line_end += chunk->lines[line_index];
+		}
+
+		LitInstruction* instruction = &instructions[count];
+
+		instruction->offset = offset;
+		instruction->size = lit_chunk_instruction_size(chunk, offset);
+		instruction->line = chunk->lines[line_index + 1];
+		instruction->opcode = chunk->code[offset];
+		instruction->removed = false;
+		instruction->jump_target = false;
+
+		starts[offset] = count++;
+		offset += instruction->size;
+	}
+
+	bool valid = offset == size;
+	starts[size] = count;
+
+	for (uint64_t i = 0; valid && i < count; i++) {
+		LitInstruction* instruction = &instructions[i];
+
+		if (is_jump(instruction->opcode)) {
+			uint16_t jump = (uint16_t) ((chunk->code[instruction->offset + 1] << 8) | chunk->code[instruction->offset + 2]);
+			uint64_t to = instruction->offset + 3;
+
+			if (instruction->opcode == OP_LOOP) {
+				valid = jump <= to;
+				to -= jump;
+			} else {
+				to += jump;
+			}
+
+			// Bail out on jumps, that don't land on an instruction, rather than breaking them
+			if (!valid || to > size || starts[to] == -1) {
+				valid = false;
+				break;
+			}
+
+			instruction->target = (uint64_t) starts[to];
+		}
+	}
+
+	if (valid) {
+		bool changed = true;
+
+		while (changed) {
+			changed = false;
+			mark_jump_targets(instructions, count);
+
+			for (uint64_t i = 0; i < count; i++) {
+				if (!instructions[i].removed && optimize_instruction(chunk, instructions, count, i)) {
+					changed = true;
+				}
+			}
+		}
+
+		rewrite_chunk(compiler, chunk, instructions, count);
+	}
+
+	FREE_ARRAY(compiler, int64_t, starts, size + 1);
+	FREE_ARRAY(compiler, LitInstruction, instructions, size);
+}
\ No newline at end of file
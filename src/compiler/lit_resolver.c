@@ -14,19 +14,22 @@
 #include <vm/lit_object.h>
 #include <compiler/lit_ast.h>
 
-DEFINE_ARRAY(LitScopes, LitResolverLocals*, scopes)
-DEFINE_ARRAY(LitStrings, char*, strings)
+DEFINE_ARRAY(LitResolverStack, LitResolverLocal, resolver_stack)
+DEFINE_ARRAY(LitScopes, int, scopes)
+
+DEFINE_TABLE(LitResolverIndex, int, resolver_index, int*, -1, &entry->value)
 
 DEFINE_TABLE(LitResolverLocals, LitResolverLocal*, resolver_locals, LitResolverLocal*, NULL, entry->value);
 DEFINE_TABLE(LitTypes, bool, types, bool, false, entry->value)
 DEFINE_TABLE(LitClasses, LitType*, classes, LitType*, NULL, entry->value)
 DEFINE_TABLE(LitResolverFields, LitResolverField*, resolver_fields, LitResolverField*, NULL, entry->value)
 DEFINE_TABLE(LitResolverMethods, LitResolverMethod*, resolver_methods, LitResolverMethod*, NULL, entry->value)
+DEFINE_TABLE(LitResolverTypes, LitResolverType*, resolver_types, LitResolverType*, NULL, entry->value)
 
 static void resolve_statement(LitResolver* resolver, LitStatement* statement);
 static void resolve_statements(LitResolver* resolver, LitStatements* statements);
 
-static const char* resolve_expression(LitResolver* resolver, LitExpression* expression);
+static LitResolverType* resolve_expression(LitResolver* resolver, LitExpression* expression);
 static void resolve_expressions(LitResolver* resolver, LitExpressions* expressions);
 
 static void error(LitResolver* resolver, uint64_t line, const char* format, ...) {
@@ -43,64 +46,278 @@ static void error(LitResolver* resolver, uint64_t line, const char* format, ...)
 	resolver->had_error = true;
 }
 
-static bool compare_arg(char* needed, char* given) {
-	// FIXME: class extened or not, check that
+static bool is_number(LitResolver* resolver, LitResolverType* type) {
+	return type == resolver->int_type || type == resolver->double_type;
+}
+
+static LitType* get_class(LitResolver* resolver, LitResolverType* type);
 
+static bool compare_arg(LitResolver* resolver, LitResolverType* needed, LitResolverType* given) {
 	if (needed == NULL || given == NULL) {
 		return true; // Ignore the error, cause already generated it
 	}
 
-	if (strcmp(given, needed) == 0 || strcmp(needed, "any") == 0) {
+	// An any value is checked at runtime, so it can be given to anything, like a cast
+	if (given == needed || needed == resolver->any_type || given == resolver->any_type) {
 		return true;
 	}
 
-	if ((strcmp(given, "double") == 0 || strcmp(given, "int") == 0) && (strcmp(needed, "double") == 0 || strcmp(needed, "int") == 0)) {
-		return true;
+	if (given->kind == INSTANCE_TYPE && needed->kind == INSTANCE_TYPE) {
+		LitType* needed_class = get_class(resolver, needed);
+
+		// Instances of subclasses can be used as the instances of their supers
+		for (LitType* class = get_class(resolver, given); class != NULL && needed_class != NULL; class = class->super) {
+			if (class == needed_class) {
+				return true;
+			}
+		}
 	}
 
-	return false;
+	return is_number(resolver, given) && is_number(resolver, needed);
 }
 
 static void push_scope(LitResolver* resolver) {
-	LitResolverLocals* table = (LitResolverLocals*) reallocate(resolver->compiler, NULL, 0, sizeof(LitResolverLocals));
-	lit_init_resolver_locals(table);
-	lit_scopes_write(MM(resolver->compiler), &resolver->scopes, table);
-
+	lit_scopes_write(MM(resolver->compiler), &resolver->scopes, resolver->locals.count);
 	resolver->depth ++;
 }
 
-static LitResolverLocals* peek_scope(LitResolver* resolver) {
-	return resolver->scopes.values[resolver->depth - 1];
-}
-
 static void pop_scope(LitResolver* resolver) {
 	resolver->scopes.count --;
-	LitResolverLocals* table = resolver->scopes.values[resolver->scopes.count];
+	int start = resolver->scopes.values[resolver->scopes.count];
 
-	for (int i = 0; i <= table->capacity_mask; i++) {
-		LitResolverLocal* value = table->entries[i].value;
+	// Names, that were shadowed by this scope, point to the outer locals again
+	for (int i = resolver->locals.count - 1; i >= start; i--) {
+		LitResolverLocal* local = &resolver->locals.values[i];
 
-		if (value != NULL) {
-			reallocate(resolver->compiler, (void*) value, sizeof(LitResolverLocal), 0);
+		if (local->shadowed == -1) {
+			lit_resolver_index_delete(MM(resolver->compiler), &resolver->index, local->name);
+		} else {
+			lit_resolver_index_set(MM(resolver->compiler), &resolver->index, local->name, local->shadowed);
 		}
 	}
 
-	lit_free_resolver_locals(MM(resolver->compiler), table);
-	reallocate(resolver->compiler, table, sizeof(LitResolverLocals), 0);
-
+	resolver->locals.count = start;
 	resolver->depth --;
 }
 
-static size_t strlen_ignoring(const char *str) {
-	const char *s;
-	for (s = str; *s && *s != '<'; ++s);
+// Returns the local, if it was declared in the current scope
+static LitResolverLocal* find_in_scope(LitResolver* resolver, LitString* name) {
+	int* index = lit_resolver_index_get(&resolver->index, name);
+
+	if (index == NULL || *index < resolver->scopes.values[resolver->depth - 1]) {
+		return NULL;
+	}
+
+	return &resolver->locals.values[*index];
+}
+
+static LitResolverLocal* add_local(LitResolver* resolver, LitString* name) {
+	int* index = lit_resolver_index_get(&resolver->index, name);
+
+	LitResolverLocal local;
+	lit_init_resolver_local(&local);
+
+	local.name = name;
+	local.shadowed = index == NULL ? -1 : *index;
+
+	lit_resolver_stack_write(MM(resolver->compiler), &resolver->locals, local);
+	lit_resolver_index_set(MM(resolver->compiler), &resolver->index, name, resolver->locals.count - 1);
+
+	return &resolver->locals.values[resolver->locals.count - 1];
+}
+
+static bool is_primitive(const char* name, size_t length) {
+	static const char* primitives[] = { "void", "any", "int", "double", "bool", "char", "string" };
+
+	for (size_t i = 0; i < sizeof(primitives) / sizeof(primitives[0]); i++) {
+		if (strlen(primitives[i]) == length && memcmp(primitives[i], name, length) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static LitResolverType* intern_type(LitResolver* resolver, LitString* name, LitString* base, LitResolverType** arguments, int argument_count) {
+	LitResolverType* type = lit_resolver_types_get(&resolver->interned_types, name);
+
+	if (type != NULL) {
+		return type;
+	}
+
+	type = (LitResolverType*) reallocate(resolver->compiler, NULL, 0, sizeof(LitResolverType));
+
+	type->id = (uint32_t) resolver->interned_types.count;
+	type->name = name;
+	type->base = base;
+	type->arguments = NULL;
+	type->argument_count = argument_count;
+	type->return_type = NULL;
+
+	if (argument_count == 0) {
+		type->kind = is_primitive(name->chars, (size_t) name->length) ? PRIMITIVE_TYPE : INSTANCE_TYPE;
+	} else if (strcmp(base->chars, "Function") == 0) {
+		// The last argument is the return type, it is not stored as a parameter
+		type->kind = FUNCTION_TYPE;
+		type->argument_count--;
+		type->return_type = arguments[argument_count - 1];
+	} else if (argument_count == 1 && strcmp(base->chars, "Class") == 0) {
+		type->kind = CLASS_TYPE;
+	} else {
+		type->kind = GENERIC_TYPE;
+	}
+
+	if (type->argument_count > 0) {
+		type->arguments = ALLOCATE(resolver->compiler, LitResolverType*, type->argument_count);
+		memcpy(type->arguments, arguments, sizeof(LitResolverType*) * type->argument_count);
+	}
+
+	lit_resolver_types_set(MM(resolver->compiler), &resolver->interned_types, name, type);
+	return type;
+}
+
+// Builds the canonical name, like Function<int, void>, and interns the type under it
+static LitResolverType* make_template_type(LitResolver* resolver, LitString* base, LitResolverType** arguments, int argument_count) {
+	if (argument_count == 0) {
+		return intern_type(resolver, base, base, NULL, 0);
+	}
+
+	// String lengths are never negative, the unsigned copies let the compiler see it too
+	uint32_t base_length = (uint32_t) base->length;
+	size_t length = (size_t) base_length + 2; // '<' and '>'
+
+	for (int i = 0; i < argument_count; i++) {
+		length += (uint32_t) arguments[i]->name->length + (i == 0 ? 0 : 2); // ', '
+	}
+
+	char* chars = ALLOCATE(resolver->compiler, char, length + 1);
+	char* place = chars;
+
+	memcpy(place, base->chars, base_length);
+	place += base_length;
+	*place++ = '<';
 
-	return s - str;
+	for (int i = 0; i < argument_count; i++) {
+		if (i > 0) {
+			*place++ = ',';
+			*place++ = ' ';
+		}
+
+		uint32_t argument_length = (uint32_t) arguments[i]->name->length;
+
+		memcpy(place, arguments[i]->name->chars, argument_length);
+		place += argument_length;
+	}
+
+	*place++ = '>';
+	*place = '\0';
+
+	LitString* name = lit_copy_string(MM(resolver->compiler), chars, length);
+	FREE_ARRAY(resolver->compiler, char, chars, length + 1);
+
+	return intern_type(resolver, name, base, arguments, argument_count);
 }
 
-static void resolve_type(LitResolver* resolver, const char* type, uint64_t line) {
-	if (type != NULL && !lit_types_get(&resolver->types, lit_copy_string(MM(resolver->compiler), type, (int) strlen_ignoring(type)))) {
-		error(resolver, line, "Type %s is not defined", type);
+static void skip_spaces(const char** current) {
+	while (**current == ' ') {
+		(*current)++;
+	}
+}
+
+static LitResolverType* parse_type(LitResolver* resolver, const char** current) {
+	skip_spaces(current);
+	const char* start = *current;
+
+	while (**current != '\0' && **current != '<' && **current != '>' && **current != ',' && **current != ' ') {
+		(*current)++;
+	}
+
+	LitString* base = lit_copy_string(MM(resolver->compiler), start, (size_t) (*current - start));
+	skip_spaces(current);
+
+	if (**current != '<') {
+		return intern_type(resolver, base, base, NULL, 0);
+	}
+
+	(*current)++;
+
+	LitResolverType* arguments[UINT8_COUNT];
+	int argument_count = 0;
+
+	while (**current != '\0' && **current != '>') {
+		LitResolverType* argument = parse_type(resolver, current);
+
+		if (argument_count < UINT8_COUNT) {
+			arguments[argument_count++] = argument;
+		}
+
+		skip_spaces(current);
+
+		if (**current == ',') {
+			(*current)++;
+		}
+	}
+
+	if (**current == '>') {
+		(*current)++;
+	}
+
+	return make_template_type(resolver, base, arguments, argument_count);
+}
+
+static LitResolverType* type_from_name(LitResolver* resolver, LitString* name) {
+	if (name == NULL) {
+		return NULL;
+	}
+
+	// Types, that are already written in the canonical form, are found without parsing
+	LitResolverType* interned = lit_resolver_types_get(&resolver->interned_types, name);
+
+	if (interned != NULL) {
+		return interned;
+	}
+
+	const char* current = name->chars;
+	return parse_type(resolver, &current);
+}
+
+LitResolverType* lit_resolver_type(LitResolver* resolver, const char* type) {
+	if (type == NULL) {
+		return NULL;
+	}
+
+	return type_from_name(resolver, lit_copy_string(MM(resolver->compiler), type, strlen(type)));
+}
+
+static LitResolverType* make_function_type(LitResolver* resolver, LitResolverType** parameters, int parameter_count, LitResolverType* return_type) {
+	LitResolverType* arguments[UINT8_COUNT + 1];
+
+	if (parameter_count > UINT8_COUNT) {
+		parameter_count = UINT8_COUNT;
+	}
+
+	memcpy(arguments, parameters, sizeof(LitResolverType*) * parameter_count);
+	arguments[parameter_count] = return_type;
+
+	return make_template_type(resolver, lit_copy_string(MM(resolver->compiler), "Function", 8), arguments, parameter_count + 1);
+}
+
+static LitResolverType* make_class_type(LitResolver* resolver, LitString* name) {
+	LitResolverType* instance = intern_type(resolver, name, name, NULL, 0);
+	return make_template_type(resolver, lit_copy_string(MM(resolver->compiler), "Class", 5), &instance, 1);
+}
+
+static LitType* get_class(LitResolver* resolver, LitResolverType* type) {
+	if (type->kind == CLASS_TYPE) {
+		type = type->arguments[0];
+	}
+
+	return lit_classes_get(&resolver->classes, type->name);
+}
+
+static void resolve_type(LitResolver* resolver, LitResolverType* type, uint64_t line) {
+	if (type != NULL && !lit_types_get(&resolver->types, type->base)) {
+		error(resolver, line, "Type %s is not defined", type->name->chars);
 	}
 }
 
@@ -114,105 +331,95 @@ void lit_define_type(LitResolver* resolver, const char* type) {
 }
 
 void lit_init_resolver_local(LitResolverLocal* local) {
+	local->name = NULL;
+	local->shadowed = -1;
 	local->type = NULL;
 	local->defined = false;
 	local->nil = false;
 	local->field = false;
 	local->final = false;
+	local->function = NULL;
 }
 
-static LitResolverLocal* resolve_local(LitResolver* resolver, const char* name, uint64_t line) {
-	LitString *str = lit_copy_string(MM(resolver->compiler), name, (int) strlen(name));
+static LitResolverLocal* resolve_local(LitResolver* resolver, LitString* name, uint64_t line) {
+	int* index = lit_resolver_index_get(&resolver->index, name);
 
-	for (int i = resolver->scopes.count - 1; i >= 0; i --) {
-		LitResolverLocal* value = lit_resolver_locals_get(resolver->scopes.values[i], str);
+	for (int i = index == NULL ? -1 : *index; i != -1; i = resolver->locals.values[i].shadowed) {
+		LitResolverLocal* value = &resolver->locals.values[i];
 
-		if (value != NULL && !value->nil) {
+		if (!value->nil) {
 			return value;
 		}
 	}
 
-	LitResolverLocal* value = lit_resolver_locals_get(&resolver->externals, str);
+	LitResolverLocal* value = lit_resolver_locals_get(&resolver->externals, name);
 
 	if (value != NULL && !value->nil) {
 		return value;
 	}
 
-	error(resolver, line, "Variable %s is not defined", name);
+	error(resolver, line, "Variable %s is not defined", name->chars);
 	return NULL;
 }
 
-static void declare(LitResolver* resolver, const char* name, uint64_t line) {
-	LitResolverLocals* scope = peek_scope(resolver);
-	LitString* str = lit_copy_string(MM(resolver->compiler), name, (int) strlen(name));
-	LitResolverLocal* value = lit_resolver_locals_get(scope, str);
-
-	if (value != NULL) {
-		error(resolver, line, "Variable %s is already defined in current scope", name);
+static void declare(LitResolver* resolver, LitString* name, uint64_t line) {
+	if (find_in_scope(resolver, name) != NULL) {
+		error(resolver, line, "Variable %s is already defined in current scope", name->chars);
 	}
 
-	LitResolverLocal* local = (LitResolverLocal*) reallocate(resolver->compiler, NULL, 0, sizeof(LitResolverLocal));
-
-	lit_init_resolver_local(local);
-	lit_resolver_locals_set(MM(resolver->compiler), scope, str, local);
+	add_local(resolver, name);
 }
 
-static void declare_and_define(LitResolver* resolver, const char* name, const char* type, uint64_t line) {
-	LitResolverLocals* scope = peek_scope(resolver);
-	LitString* str = lit_copy_string(MM(resolver->compiler), name, (int) strlen(name));
-	LitResolverLocal* value = lit_resolver_locals_get(scope, str);
-
-	if (value != NULL) {
-		error(resolver, line, "Variable %s is already defined in current scope", name);
+static void declare_and_define(LitResolver* resolver, LitString* name, LitResolverType* type, uint64_t line) {
+	if (find_in_scope(resolver, name) != NULL) {
+		error(resolver, line, "Variable %s is already defined in current scope", name->chars);
 	} else {
-		LitResolverLocal* local = (LitResolverLocal*) reallocate(resolver->compiler, NULL, 0, sizeof(LitResolverLocal));
-		lit_init_resolver_local(local);
+		LitResolverLocal* local = add_local(resolver, name);
 
 		local->defined = true;
 		local->type = type;
-
-		lit_resolver_locals_set(MM(resolver->compiler), scope, str, local);
 	}
 }
 
-static LitResolverLocal* define(LitResolver* resolver, const char* name, const char* type, bool field) {
-	LitResolverLocals* scope = peek_scope(resolver);
-	LitString* str = lit_copy_string(MM(resolver->compiler), name, (int) strlen(name));
-
-	LitResolverLocal* value = lit_resolver_locals_get(scope, str);
+// The returned pointer is only valid until the next declaration
+static LitResolverLocal* define(LitResolver* resolver, LitString* name, LitResolverType* type, bool field) {
+	LitResolverLocal* local = find_in_scope(resolver, name);
 
-	if (value == NULL) {
-		LitResolverLocal* local = (LitResolverLocal*) reallocate(resolver->compiler, NULL, 0, sizeof(LitResolverLocal));
-
-		lit_init_resolver_local(local);
+	if (local == NULL) {
+		local = add_local(resolver, name);
+	}
 
-		local->defined = true;
-		local->type = type;
-		local->field = field;
+	local->defined = true;
+	local->type = type;
+	local->field = field;
 
-		lit_resolver_locals_set(MM(resolver->compiler), scope, str, local);
-		return local;
-	} else {
-		value->defined = true;
-		value->type = type;
-		value->field = field;
+	return local;
+}
 
-		return value;
-	}
+LitResolverLocal* lit_resolver_define_global(LitResolver* resolver, LitString* name, LitResolverType* type) {
+	return define(resolver, name, type, false);
 }
 
-static const char* resolve_var_statement(LitResolver* resolver, LitVarStatement* statement) {
+static LitResolverType* resolve_var_statement(LitResolver* resolver, LitVarStatement* statement) {
 	declare(resolver, statement->name, statement->statement.line);
-	const char *type = statement->type == NULL ? "void" : statement->type;
+	LitResolverType* declared = statement->type == NULL ? NULL : type_from_name(resolver, statement->type);
+	LitResolverType* type = declared == NULL ? resolver->void_type : declared;
 
 	if (statement->init != NULL) {
-		type = (char*) resolve_expression(resolver, statement->init);
+		LitResolverType* given = resolve_expression(resolver, statement->init);
+
+		// Without a declared type, the variable takes the type of its value
+		if (declared == NULL) {
+			type = given;
+		} else if (given != NULL && !compare_arg(resolver, declared, given)) {
+			error(resolver, statement->statement.line, "Can't assign %s value to a %s var", given->name->chars, declared->name->chars);
+		}
 	} else if (statement->final) {
 		error(resolver, statement->statement.line, "Final variable must be assigned a value in the declaration!");
 	}
 
-	if (type != NULL && strcmp(type, "void") == 0) {
-		error(resolver, statement->statement.line, "Can't set variable's %s type to void", statement->name);
+	if (type == resolver->void_type) {
+		error(resolver, statement->statement.line, "Can't set variable's %s type to void", statement->name->chars);
 	} else {
 		if (type != NULL) {
 			resolve_type(resolver, type, statement->statement.line);
@@ -226,9 +433,9 @@ static const char* resolve_var_statement(LitResolver* resolver, LitVarStatement*
 		return NULL;
 	}
 
-	if (strcmp(type, "bool") == 0) {
+	if (type == resolver->bool_type) {
 		statement->default_value = OP_FALSE;
-	} else if (strcmp(type, "int") == 0 || strcmp(type, "double") == 0) {
+	} else if (is_number(resolver, type)) {
 		statement->default_value = OP_CONSTANT;
 	} else {
 		statement->default_value = OP_NIL;
@@ -283,16 +490,20 @@ static void resolve_function(LitResolver* resolver, LitParameters* parameters, L
 	if (parameters != NULL) {
 		for (int i = 0; i < parameters->count; i++) {
 			LitParameter parameter = parameters->values[i];
-			resolve_type(resolver, parameter.type, line);
-			define(resolver, parameter.name, parameter.type, false);
+			LitResolverType* type = type_from_name(resolver, parameter.type);
+
+			resolve_type(resolver, type, line);
+			define(resolver, parameter.name, type, false);
 		}
 	}
 
-	resolve_type(resolver, return_type->type, line);
+	LitResolverType* type = type_from_name(resolver, return_type->type);
+
+	resolve_type(resolver, type, line);
 	resolve_statement(resolver, body);
 
 	if (!resolver->had_return) {
-		if (strcmp(return_type->type, "void") != 0) {
+		if (type != resolver->void_type) {
 			error(resolver, line, message, name);
 		} else {
 			LitBlockStatement* block = (LitBlockStatement*) body;
@@ -309,76 +520,57 @@ static void resolve_function(LitResolver* resolver, LitParameters* parameters, L
 	pop_scope(resolver);
 }
 
-static const char* get_function_signature(LitResolver* resolver, LitParameters* parameters, LitParameter* return_type) {
-	size_t len = 11;
-
-	if (parameters != NULL) {
-		int cn = parameters->count;
-
-		for (int i = 0; i < cn; i++) {
-			len += strlen(parameters->values[i].type) + 2; // ', '
-		}
-	}
-
-	len += strlen(return_type->type);
-	char* type = (char*) reallocate(resolver->compiler, NULL, 0, len);
-
-	strncpy(type, "Function<", 9);
-	int place = 9;
+static LitResolverType* get_function_signature(LitResolver* resolver, LitParameters* parameters, LitParameter* return_type) {
+	LitResolverType* types[UINT8_COUNT];
+	int count = 0;
 
 	if (parameters != NULL) {
-		int cn = parameters->count;
-
-		for (int i = 0; i < cn; i++) {
-			const char* tp = parameters->values[i].type;
-			size_t l = strlen(tp);
-
-			strncpy(&type[place], tp, l);
-			place += l;
-			strncpy(&type[place], ", ", 2);
-			place += 2; // ', '
+		for (int i = 0; i < parameters->count && count < UINT8_COUNT; i++) {
+			types[count++] = type_from_name(resolver, parameters->values[i].type);
 		}
 	}
 
-	size_t l = strlen(return_type->type); // minus \0
-	strncpy(&type[place], return_type->type, l);
-
-	type[len - 2] = '>';
-	type[len - 1] = '\0';
-
-	return type;
+	return make_function_type(resolver, types, count, type_from_name(resolver, return_type->type));
 }
 
 static void resolve_function_statement(LitResolver* resolver, LitFunctionStatement* statement) {
-	const char* type = get_function_signature(resolver, statement->parameters, &statement->return_type);
+	LitResolverType* type = get_function_signature(resolver, statement->parameters, &statement->return_type);
 
 	LitFunctionStatement* last = resolver->function;
 	resolver->function = statement;
 
 	declare_and_define(resolver, statement->name, type, statement->statement.line);
-	resolve_function(resolver, statement->parameters, &statement->return_type, statement->body, "Missing return statement in function %s", statement->name, statement->statement.line);
 
-	resolver->function = last;
+	// Global functions always hold the same closure, until something is assigned to them
+	if (resolver->depth == 1) {
+		LitResolverLocal* local = find_in_scope(resolver, statement->name);
 
-	lit_strings_write(MM(resolver->compiler), &resolver->allocated_strings, (char*) type);
+		if (local != NULL) {
+			local->function = statement;
+		}
+	}
+
+	resolve_function(resolver, statement->parameters, &statement->return_type, statement->body, "Missing return statement in function %s", statement->name->chars, statement->statement.line);
+
+	resolver->function = last;
 
 	if (statement->parameters != NULL && statement->parameters->count > 255) {
-		error(resolver, statement->statement.line, "Function %s has more than 255 parameters", statement->name);
+		error(resolver, statement->statement.line, "Function %s has more than 255 parameters", statement->name->chars);
 	}
 }
 
 static void resolve_return_statement(LitResolver* resolver, LitReturnStatement* statement) {
-	char* type = (char*) (statement->value == NULL ? "void" : resolve_expression(resolver, statement->value));
+	LitResolverType* type = statement->value == NULL ? resolver->void_type : resolve_expression(resolver, statement->value);
 	resolver->had_return = true;
 
 	if (resolver->function == NULL) {
 		error(resolver, statement->statement.line, "Can't return from top-level code!");
-	} else if (!compare_arg((char*) resolver->function->return_type.type, type)) {
-		error(resolver, statement->statement.line, "Return type mismatch: required %s, but got %s", resolver->function->return_type.type, type);
+	} else if (!compare_arg(resolver, type_from_name(resolver, resolver->function->return_type.type), type)) {
+		error(resolver, statement->statement.line, "Return type mismatch: required %s, but got %s", resolver->function->return_type.type->chars, type->name->chars);
 	}
 }
 
-static const char* resolve_var_expression(LitResolver* resolver, LitVarExpression* expression);
+static LitResolverType* resolve_var_expression(LitResolver* resolver, LitVarExpression* expression);
 
 static const char* access_to_string(LitAccessType type) {
 	switch (type) {
@@ -390,8 +582,8 @@ static const char* access_to_string(LitAccessType type) {
 	}
 }
 
-static void resolve_method_statement(LitResolver* resolver, LitMethodStatement* statement, char* signature) {
-	if (statement->is_static && statement->parameters != NULL && statement->parameters->count != 0 && strcmp("init", statement->name) == 0) {
+static void resolve_method_statement(LitResolver* resolver, LitMethodStatement* statement, LitResolverType* signature) {
+	if (statement->is_static && statement->parameters != NULL && statement->parameters->count != 0 && statement->name == resolver->compiler->init_string) {
 		error(resolver, statement->statement.line, "Static constructors can not have parameters");
 	}
 
@@ -402,16 +594,16 @@ static void resolve_method_statement(LitResolver* resolver, LitMethodStatement*
 		if (resolver->class->super == NULL) {
 			error(resolver, statement->statement.line, "Can't override a method in a class without a base");
 		} else {
-			LitResolverMethod* super_method = lit_resolver_methods_get(&resolver->class->super->methods, lit_copy_string(MM(resolver->compiler), statement->name, strlen(statement->name)));
+			LitResolverMethod* super_method = lit_resolver_methods_get(&resolver->class->super->methods, statement->name);
 
 			if (super_method == NULL) {
-				error(resolver, statement->statement.line, "Can't override method %s, it does not exist in the base class", statement->name);
+				error(resolver, statement->statement.line, "Can't override method %s, it does not exist in the base class", statement->name->chars);
 			} else if (super_method->is_static) {
-				error(resolver, statement->statement.line, "Method %s is declared static and can not be overridden", statement->name);
+				error(resolver, statement->statement.line, "Method %s is declared static and can not be overridden", statement->name->chars);
 			} else if (super_method->access != statement->access) {
-				error(resolver, statement->statement.line, "Method %s type was declared as %s in super, but been changed to %s in child", statement->name, access_to_string(super_method->access), access_to_string(statement->access));
-			} else if (strcmp(super_method->signature, signature) != 0) {
-				error(resolver, statement->statement.line, "Method %s signature was declared as %s in super, but been changed to %s in child", statement->name, super_method->signature, signature);
+				error(resolver, statement->statement.line, "Method %s type was declared as %s in super, but been changed to %s in child", statement->name->chars, access_to_string(super_method->access), access_to_string(statement->access));
+			} else if (super_method->signature != signature) {
+				error(resolver, statement->statement.line, "Method %s signature was declared as %s in super, but been changed to %s in child", statement->name->chars, super_method->signature->name->chars, signature->name->chars);
 			}
 		}
 	}
@@ -419,20 +611,24 @@ static void resolve_method_statement(LitResolver* resolver, LitMethodStatement*
 	if (statement->parameters != NULL) {
 		for (int i = 0; i < statement->parameters->count; i++) {
 			LitParameter parameter = statement->parameters->values[i];
-			resolve_type(resolver, parameter.type, statement->statement.line);
-			define(resolver, parameter.name, parameter.type, false);
+			LitResolverType* type = type_from_name(resolver, parameter.type);
+
+			resolve_type(resolver, type, statement->statement.line);
+			define(resolver, parameter.name, type, false);
 		}
 
 		if (statement->parameters->count > 255) {
-			error(resolver, statement->statement.line, "Method %s has more than 255 parameters", statement->name);
+			error(resolver, statement->statement.line, "Method %s has more than 255 parameters", statement->name->chars);
 		}
 	}
 
-	if (strcmp(statement->name, "init") == 0 && strcmp(statement->return_type.type, "void") != 0) {
+	LitResolverType* return_type = signature->return_type;
+
+	if (statement->name == resolver->compiler->init_string && return_type != resolver->void_type) {
 		error(resolver, statement->statement.line, "Constructor must have void return type");
 	}
 
-	resolve_type(resolver, statement->return_type.type, statement->statement.line);
+	resolve_type(resolver, return_type, statement->statement.line);
 
 	if (statement->body != NULL) {
 		LitFunctionStatement *enclosing = resolver->function;
@@ -443,8 +639,8 @@ static void resolve_method_statement(LitResolver* resolver, LitMethodStatement*
 	}
 
 	if (!resolver->had_return) {
-		if (strcmp(statement->return_type.type, "void") != 0) {
-			error(resolver, statement->statement.line, "Missing return statement in method %s", statement->name);
+		if (return_type != resolver->void_type) {
+			error(resolver, statement->statement.line, "Missing return statement in method %s", statement->name->chars);
 		} else if (statement->body != NULL) {
 			LitBlockStatement* block = (LitBlockStatement*) statement->body;
 
@@ -460,23 +656,25 @@ static void resolve_method_statement(LitResolver* resolver, LitMethodStatement*
 	pop_scope(resolver);
 }
 
-static void resolve_field_statement(LitResolver* resolver, LitFieldStatement* statement) {
+static LitResolverType* resolve_field_statement(LitResolver* resolver, LitFieldStatement* statement) {
 	declare(resolver, statement->name, statement->statement.line);
+	LitResolverType* type = type_from_name(resolver, statement->type);
 
 	if (statement->init != NULL) {
-		const char* given = (char*) resolve_expression(resolver, statement->init);
+		LitResolverType* given = resolve_expression(resolver, statement->init);
 
-		if (statement->type == NULL) {
-			statement->type = given;
-		} else if (strcmp(statement->type, given) != 0) {
-			error(resolver, statement->statement.line, "Can't assign %s value to a %s var", given, statement->type);
+		if (type == NULL) {
+			type = given;
+			statement->type = given == NULL ? NULL : given->name;
+		} else if (given != NULL && type != given) {
+			error(resolver, statement->statement.line, "Can't assign %s value to a %s var", given->name->chars, type->name->chars);
 		}
 	} else if (statement->final) {
 		error(resolver, statement->statement.line, "Final field must have a value assigned!");
 	}
 
-	resolve_type(resolver, statement->type, statement->statement.line);
-	define(resolver, statement->name, statement->type, resolver->class != NULL && resolver->depth == 2);
+	resolve_type(resolver, type, statement->statement.line);
+	define(resolver, statement->name, type, resolver->class != NULL && resolver->depth == 2);
 
 	if (statement->getter != NULL) {
 		resolve_statement(resolver, statement->getter);
@@ -485,39 +683,35 @@ static void resolve_field_statement(LitResolver* resolver, LitFieldStatement* st
 	if (statement->setter != NULL) {
 		resolve_statement(resolver, statement->setter);
 	}
+
+	return type;
 }
 
 static void resolve_class_statement(LitResolver* resolver, LitClassStatement* statement) {
-	size_t len = strlen(statement->name);
-	char* type = (char*) reallocate(resolver->compiler, NULL, 0, len + 8);
-
-	strncpy(type, "Class<", 6);
-	strncpy(type + 6, statement->name, len);
-	type[6 + len] = '>';
-	type[7 + len] = '\0';
+	LitString* name = statement->name;
+	LitResolverType* type = make_class_type(resolver, name);
 
-	LitString* name = lit_copy_string(MM(resolver->compiler), statement->name, len);
-
-	lit_define_type(resolver, name->chars);
-	declare_and_define(resolver, name->chars, type, statement->statement.line);
+	lit_types_set(MM(resolver->compiler), &resolver->types, name, true);
+	declare_and_define(resolver, name, type, statement->statement.line);
 
 	if (statement->super != NULL) {
-		const char* tp = resolve_var_expression(resolver, statement->super);
+		LitResolverType* tp = resolve_var_expression(resolver, statement->super);
 
-		if (tp != NULL && strcmp(type, tp) == 0) {
-			error(resolver, statement->statement.line, "Class %s can't inherit self!", type);
+		if (tp == type) {
+			error(resolver, statement->statement.line, "Class %s can't inherit self!", type->name->chars);
 		}
 	}
 
 	LitType* super = NULL;
+	bool global = resolver->depth == 1;
 
 	if (statement->super != NULL) {
-		LitType* super_class = lit_classes_get(&resolver->classes, lit_copy_string(MM(resolver->compiler), statement->super->name, strlen(statement->super->name)));
+		LitType* super_class = lit_classes_get(&resolver->classes, statement->super->name);
 
 		if (super_class == NULL) {
-			error(resolver, statement->statement.line, "Can't inherit undefined class %s", statement->super->name);
+			error(resolver, statement->statement.line, "Can't inherit undefined class %s", statement->super->name->chars);
 		} else if (super_class->final) {
-			error(resolver, statement->statement.line, "Can't inherit final class %s", statement->super->name);
+			error(resolver, statement->statement.line, "Can't inherit final class %s", statement->super->name->chars);
 		} else {
 			super = super_class;
 		}
@@ -528,7 +722,7 @@ static void resolve_class_statement(LitResolver* resolver, LitClassStatement* st
 	class->inited = false;
 	class->super = super;
 	class->external = false;
-	class->name = lit_copy_string(MM(resolver->compiler), statement->name, len);
+	class->name = name;
 	class->is_static = statement->is_static;
 	class->final = statement->final;
 	class->abstract = statement->abstract;
@@ -550,7 +744,6 @@ static void resolve_class_statement(LitResolver* resolver, LitClassStatement* st
 	if (statement->fields != NULL) {
 		for (int i = 0; i < statement->fields->count; i++) {
 			LitFieldStatement* var = ((LitFieldStatement*) statement->fields->values[i]);
-			const char* n = var->name;
 
 			LitResolverField* field = (LitResolverField*) reallocate(resolver->compiler, NULL, 0, sizeof(LitResolverField));
 
@@ -559,10 +752,9 @@ static void resolve_class_statement(LitResolver* resolver, LitClassStatement* st
 			field->is_final = var->final;
 			field->original = class;
 
-			resolve_field_statement(resolver, var); // The var->type might be assigned here
-			field->type = var->type; // Thats why this must go here
+			field->type = resolve_field_statement(resolver, var);
 
-			LitString* fieldName = lit_copy_string(MM(resolver->compiler), n, strlen(n));
+			LitString* fieldName = var->name;
 			LitResolverField* check_field =	lit_resolver_fields_get(field->is_static ? &class->fields : &class->static_fields, fieldName);
 
 			if (check_field != NULL) {
@@ -588,7 +780,7 @@ static void resolve_class_statement(LitResolver* resolver, LitClassStatement* st
 	if (statement->methods != NULL) {
 		for (int i = 0; i < statement->methods->count; i++) {
 			LitMethodStatement* method = statement->methods->values[i];
-			char* signature = (char*) get_function_signature(resolver, method->parameters, &method->return_type);
+			LitResolverType* signature = get_function_signature(resolver, method->parameters, &method->return_type);
 
 			resolve_method_statement(resolver, method, signature);
 
@@ -600,8 +792,9 @@ static void resolve_class_statement(LitResolver* resolver, LitClassStatement* st
 			m->abstract = method->abstract;
 			m->is_overriden = method->overriden;
 			m->original = class;
+			m->statement = global && method->body != NULL ? method : NULL;
 
-			LitString* methodName = lit_copy_string(MM(resolver->compiler), method->name, strlen(method->name));
+			LitString* methodName = method->name;
 			LitResolverMethod* check_method = lit_resolver_methods_get(method->is_static ? &class->methods : &class->static_methods, methodName);
 
 			if (check_method != NULL) {
@@ -620,13 +813,12 @@ static void resolve_class_statement(LitResolver* resolver, LitClassStatement* st
 				}
 			}
 
-			lit_resolver_methods_set(MM(resolver->compiler), method->is_static ? &class->static_methods : &class->methods, lit_copy_string(MM(resolver->compiler), method->name, strlen(method->name)), m);
+			lit_resolver_methods_set(MM(resolver->compiler), method->is_static ? &class->static_methods : &class->methods, methodName, m);
 		}
 	}
 
 	pop_scope(resolver);
 	resolver->class = NULL;
-	lit_strings_write(MM(resolver->compiler), &resolver->allocated_strings, type);
 
 	if (super != NULL) {
 		for (int i = 0; i <= super->methods.capacity_mask; i++) {
@@ -689,79 +881,54 @@ static void resolve_statements(LitResolver* resolver, LitStatements* statements)
 	}
 }
 
-int strcmp_ignoring(const char* s1, const char* s2) {
-	while(*s1 && *s1 != '<' && *s2 != '<' && *s1 == *s2) {
-		s1++;
-		s2++;
-	}
-
-	return *s1 > *s2 ? 1 : (*s1 == *s2 ? 0 : -1);
-}
-
-static const char* resolve_binary_expression(LitResolver* resolver, LitBinaryExpression* expression) {
-	const char* a = resolve_expression(resolver, expression->left);
-	char* b = (char*) resolve_expression(resolver, expression->right);
+static LitResolverType* resolve_binary_expression(LitResolver* resolver, LitBinaryExpression* expression) {
+	LitResolverType* a = resolve_expression(resolver, expression->left);
+	LitResolverType* b = resolve_expression(resolver, expression->right);
 
 	if (a == NULL || b == NULL) {
 		return NULL;
 	}
 
 	if (expression->operator == TOKEN_IS) {
-		LitType* class = NULL;
-
-		if (strcmp_ignoring(b, "Class<") == 0) {
-			int len = (int) strlen(b);
-
-			// Hack that allows us not to reallocate another string
-			b[len - 1] = '\0';
-			class = lit_classes_get(&resolver->classes, lit_copy_string(MM(resolver->compiler), &b[6], (size_t) (len - 7)));
-			b[len - 1] = '>';
+		if (b->kind != CLASS_TYPE || get_class(resolver, b) == NULL) {
+			error(resolver, expression->expression.line, "%s is not defined", b->name->chars);
 		}
 
-		if (class == NULL) {
-			error(resolver, expression->expression.line, "%s is not defined", b);
-		}
-
-		return "bool";
+		return resolver->bool_type;
+	} else if (expression->operator == TOKEN_EQUAL_EQUAL || expression->operator == TOKEN_BANG_EQUAL) {
+		return resolver->bool_type;
 	} else {
-		if (!((strcmp(a, "int") == 0 || strcmp(a, "double") == 0) && (strcmp(b, "int") == 0 || strcmp(b, "double") == 0))) {
-			error(resolver, expression->expression.line, "Can't perform binary operation on %s and %s", a, b);
+		if (!(is_number(resolver, a) && is_number(resolver, b))) {
+			error(resolver, expression->expression.line, "Can't perform binary operation on %s and %s", a->name->chars, b->name->chars);
 		}
 
 		return a;
 	}
 }
 
-static const char* resolve_literal_expression(LitLiteralExpression* expression) {
+static LitResolverType* resolve_literal_expression(LitResolver* resolver, LitLiteralExpression* expression) {
 	if (IS_NUMBER(expression->value)) {
-		double number = AS_NUMBER(expression->value);
-		double temp;
-
-		if (modf(number, &temp) == 0) {
-			return "int";
-		}
-
-		return "double";
+		return IS_INT(expression->value) ? resolver->int_type : resolver->double_type;
 	} else if (IS_BOOL(expression->value)) {
-		return "bool";
+		return resolver->bool_type;
 	} else if (IS_CHAR(expression->value)) {
-		return "char";
+		return resolver->char_type;
 	} else if (IS_STRING(expression->value)) {
-		return "String";
+		return resolver->string_object_type;
 	}
 
 	// nil
-	return "Object";
+	return resolver->object_type;
 }
 
-static const char* resolve_unary_expression(LitResolver* resolver, LitUnaryExpression* expression) {
-	const char* type = resolve_expression(resolver, expression->right);
+static LitResolverType* resolve_unary_expression(LitResolver* resolver, LitUnaryExpression* expression) {
+	LitResolverType* type = resolve_expression(resolver, expression->right);
 
 	if (type == NULL) {
 		return NULL;
 	}
 
-	if (expression->operator == TOKEN_MINUS && (strcmp(type, "int") != 0 && strcmp(type, "double") != 0)) {
+	if (expression->operator == TOKEN_MINUS && !is_number(resolver, type)) {
 		error(resolver, expression->expression.line, "Can't negate non-number values");
 		return NULL;
 	}
@@ -769,15 +936,15 @@ static const char* resolve_unary_expression(LitResolver* resolver, LitUnaryExpre
 	return type;
 }
 
-static const char* resolve_grouping_expression(LitResolver* resolver, LitGroupingExpression* expression) {
+static LitResolverType* resolve_grouping_expression(LitResolver* resolver, LitGroupingExpression* expression) {
 	return resolve_expression(resolver, expression->expr);
 }
 
-static const char* resolve_var_expression(LitResolver* resolver, LitVarExpression* expression) {
-	LitResolverLocal* value = lit_resolver_locals_get(peek_scope(resolver), lit_copy_string(MM(resolver->compiler), expression->name, (int) strlen(expression->name)));
+static LitResolverType* resolve_var_expression(LitResolver* resolver, LitVarExpression* expression) {
+	LitResolverLocal* value = find_in_scope(resolver, expression->name);
 
 	if (value != NULL && !value->defined) {
-		error(resolver, expression->expression.line, "Can't use local variable %s in it's own initializer", expression->name);
+		error(resolver, expression->expression.line, "Can't use local variable %s in it's own initializer", expression->name->chars);
 		return NULL;
 	}
 
@@ -786,25 +953,26 @@ static const char* resolve_var_expression(LitResolver* resolver, LitVarExpressio
 	if (local == NULL) {
 		return NULL;
 	} else if (local->field && resolver->class != NULL && resolver->depth > 2) {
-		error(resolver, expression->expression.line, "Can't access class field %s without this", expression->name);
+		error(resolver, expression->expression.line, "Can't access class field %s without this", expression->name->chars);
 		return NULL;
 	}
 
 	return local->type;
 }
 
-static const char* resolve_get_expression(LitResolver* resolver, LitGetExpression* expression);
+static LitResolverType* resolve_get_expression(LitResolver* resolver, LitGetExpression* expression);
+static LitResolverType* resolve_get(LitResolver* resolver, LitGetExpression* expression, LitStatement** target);
 
-static const char* resolve_assign_expression(LitResolver* resolver, LitAssignExpression* expression) {
-	const char* given = resolve_expression(resolver, expression->value);
-	const char* type = resolve_expression(resolver, expression->to);
+static LitResolverType* resolve_assign_expression(LitResolver* resolver, LitAssignExpression* expression) {
+	LitResolverType* given = resolve_expression(resolver, expression->value);
+	LitResolverType* type = resolve_expression(resolver, expression->to);
 
 	if (type == NULL || given == NULL) {
 		return NULL;
 	}
 
-	if (!compare_arg((char*) type, (char*) given)) {
-		error(resolver, expression->expression.line, "Can't assign %s value to a %s var", given, type);
+	if (!compare_arg(resolver, type, given)) {
+		error(resolver, expression->expression.line, "Can't assign %s value to a %s var", given->name->chars, type->name->chars);
 	}
 
 	if (expression->to->type == GET_EXPRESSION) {
@@ -818,66 +986,34 @@ static const char* resolve_assign_expression(LitResolver* resolver, LitAssignExp
 		}
 
 		if (local->final) {
-			error(resolver, expression->expression.line, "Can't assign value to a final %s var", type);
+			error(resolver, expression->expression.line, "Can't assign value to a final %s var", type->name->chars);
+		}
+
+		if (local->function != NULL) {
+			local->function->reassigned = true;
 		}
 
 		return local->type;
 	}
 }
 
-static const char* resolve_logical_expression(LitResolver* resolver, LitLogicalExpression* expression) {
+static LitResolverType* resolve_logical_expression(LitResolver* resolver, LitLogicalExpression* expression) {
 	return resolve_expression(resolver, expression->right);
 }
 
-static char* last_string;
-static bool had_template;
-
-static char* tok(char* string) {
-	char* start = string == NULL ? last_string : string;
-
-	if (!*start || *start == '>') {
-		return NULL;
-	}
-
-	if (*start == ' ') {
-		start++;
-	}
-
-	char* where_started = start;
-
-	while (*start != '\0' && *start != ',' && *start != '>') {
-		start++;
-
-		if (*start == '<') {
-			while (*start != '>') {
-				start++;
-			}
-
-			start++;
-		}
-	}
-
-	had_template = (*start == '>');
-
-	*start = '\0';
-	last_string = start + 1;
-
-	return where_started;
-}
-
 static const char* extract_callee_name(LitExpression* expression) {
 	switch (expression->type) {
-		case VAR_EXPRESSION: return ((LitVarExpression*) expression)->name;
-		case GET_EXPRESSION: return ((LitGetExpression*) expression)->property;
-		case SET_EXPRESSION: return ((LitSetExpression*) expression)->property;
+		case VAR_EXPRESSION: return ((LitVarExpression*) expression)->name->chars;
+		case GET_EXPRESSION: return ((LitGetExpression*) expression)->property->chars;
+		case SET_EXPRESSION: return ((LitSetExpression*) expression)->property->chars;
 		case GROUPING_EXPRESSION: return extract_callee_name(((LitGroupingExpression*) expression)->expr);
-		case SUPER_EXPRESSION: return ((LitSuperExpression*) expression)->method;
+		case SUPER_EXPRESSION: return ((LitSuperExpression*) expression)->method->chars;
 		default: return NULL;
 	}
 }
 
-static const char* resolve_call_expression(LitResolver* resolver, LitCallExpression* expression) {
-	char* return_type = "void";
+static LitResolverType* resolve_call_expression(LitResolver* resolver, LitCallExpression* expression) {
+	LitResolverType* return_type = resolver->void_type;
 	int t = expression->callee->type;
 
 	if (t != VAR_EXPRESSION && t != GET_EXPRESSION && t != GROUPING_EXPRESSION
@@ -885,7 +1021,7 @@ static const char* resolve_call_expression(LitResolver* resolver, LitCallExpress
 
 		error(resolver, expression->expression.line, "Can't call non-variable of type %i", t);
 	} else {
-		const char* type = resolve_expression(resolver, expression->callee);
+		LitResolverType* type = t == GET_EXPRESSION ? resolve_get(resolver, (LitGetExpression*) expression->callee, &expression->target) : resolve_expression(resolver, expression->callee);
 
 		if (type == NULL) {
 			resolve_expressions(resolver, expression->args);
@@ -894,73 +1030,51 @@ static const char* resolve_call_expression(LitResolver* resolver, LitCallExpress
 
 		const char* name = extract_callee_name(expression->callee);
 
-		if (strcmp_ignoring(type, "Class<") == 0) {
-			size_t len = strlen(type);
-			return_type = (char*) reallocate(resolver->compiler, NULL, 0, len - 6);
-			strncpy(return_type, &type[6], len - 7);
-			return_type[len - 7] = '\0';
-
-			lit_strings_write(MM(resolver->compiler), &resolver->allocated_strings, return_type);
-			LitType* cl = lit_classes_get(&resolver->classes, lit_copy_string(MM(resolver->compiler), return_type, len - 7));
+		if (type->kind == CLASS_TYPE) {
+			return_type = type->arguments[0];
+			LitType* cl = get_class(resolver, type);
 
 			if (cl->is_static) {
 				error(resolver, expression->expression.line, "Can not create an instance of a static class %s", cl->name->chars);
 			} else if (cl->abstract) {
 				error(resolver, expression->expression.line, "Can not create an instance of an abstract class %s", cl->name->chars);
 			}
-		} else if (strcmp_ignoring(type, "Function<") != 0) {
-			error(resolver, expression->expression.line, "Can't call non-function variable %s with type %s", name, type);
+		} else if (type->kind != FUNCTION_TYPE) {
+			error(resolver, expression->expression.line, "Can't call non-function variable %s with type %s", name, type->name->chars);
 		} else {
-			if (type == NULL) {
-				return NULL;
-			}
-
-			size_t len = strlen(type);
-			char* tp = (char*) reallocate(resolver->compiler, NULL, 0, len + 1);
-			strncpy(tp, type, len);
-			tp[len] = '\0';
-
-			char* arg = tok(&tp[9]);
-			int i = 0;
 			int cn = expression->args->count;
+			int i = 0;
 
-			while (arg != NULL) {
-				if (!had_template && i >= cn) {
-					error(resolver, expression->expression.line, "Not enough arguments for %s, expected %i, got %i, for function %s", type, i + 1, cn, name);
-					break;
-				}
-
-				if (!had_template) {
-					const char* given_type = resolve_expression(resolver, expression->args->values[i]);
-
-					if (given_type == NULL) {
-						error(resolver, expression->expression.line, "Got null type resolved somehow");
-					} else if (!compare_arg(arg, (char*) given_type)) {
-						error(resolver, expression->expression.line, "Argument #%i type mismatch: required %s, but got %s, for function %s", i + 1, arg, given_type, name);
-					}
-				} else {
-					size_t l = strlen(arg);
-					return_type = (char*) reallocate(resolver->compiler, NULL, 0, l + 1);
-					strncpy(return_type, arg, l);
-					return_type[l] = '\0';
+			if (t == VAR_EXPRESSION) {
+				LitResolverLocal* local = resolve_local(resolver, ((LitVarExpression*) expression->callee)->name, expression->expression.line);
 
-					lit_strings_write(MM(resolver->compiler), &resolver->allocated_strings, return_type);
+				if (local != NULL && local->function != NULL) {
+					expression->target = (LitStatement*) local->function;
+				}
+			} else if (t == SUPER_EXPRESSION) {
+				LitResolverMethod* method = lit_resolver_methods_get(&resolver->class->super->methods, ((LitSuperExpression*) expression->callee)->method);
+				expression->target = (LitStatement*) method->statement;
+			}
 
+			for (; i < type->argument_count; i++) {
+				if (i >= cn) {
+					error(resolver, expression->expression.line, "Not enough arguments for %s, expected %i, got %i, for function %s", type->name->chars, i + 1, cn, name);
 					break;
 				}
 
-				arg = tok(NULL);
-				i++;
+				LitResolverType* given_type = resolve_expression(resolver, expression->args->values[i]);
 
-				if (arg == NULL) {
-					break;
+				if (given_type == NULL) {
+					error(resolver, expression->expression.line, "Got null type resolved somehow");
+				} else if (!compare_arg(resolver, type->arguments[i], given_type)) {
+					error(resolver, expression->expression.line, "Argument #%i type mismatch: required %s, but got %s, for function %s", i + 1, type->arguments[i]->name->chars, given_type->name->chars, name);
 				}
 			}
 
-			reallocate(resolver->compiler, tp, len, 0);
+			return_type = type->return_type;
 
 			if (i < cn) {
-				error(resolver, expression->expression.line, "Too many arguments for function %s, expected %i, got %i, for function %s", type, i, cn, ((LitVarExpression*) expression->callee)->name);
+				error(resolver, expression->expression.line, "Too many arguments for function %s, expected %i, got %i, for function %s", type->name->chars, i, cn, name);
 			}
 		}
 	}
@@ -968,8 +1082,9 @@ static const char* resolve_call_expression(LitResolver* resolver, LitCallExpress
 	return return_type;
 }
 
-static const char* resolve_get_expression(LitResolver* resolver, LitGetExpression* expression) {
-	char* type = (char*) resolve_expression(resolver, expression->object);
+// The target is set, if the method can't be overriden, so it can be called directly
+static LitResolverType* resolve_get(LitResolver* resolver, LitGetExpression* expression, LitStatement** target) {
+	LitResolverType* type = resolve_expression(resolver, expression->object);
 
 	if (type == NULL) {
 		return NULL;
@@ -978,35 +1093,28 @@ static const char* resolve_get_expression(LitResolver* resolver, LitGetExpressio
 	LitType* class = NULL;
 	bool should_be_static = false;
 
-	if (strcmp(type, "int") == 0) {
+	if (type == resolver->int_type) {
 		class = resolver->int_class;
-	} else if (strcmp(type, "string") == 0) {
+	} else if (type == resolver->string_type) {
 		class = resolver->string_class;
-	} else if (strcmp(type, "double") == 0) {
+	} else if (type == resolver->double_type) {
 		class = resolver->double_class;
-	} else if (strcmp(type, "bool") == 0) {
+	} else if (type == resolver->bool_type) {
 		class = resolver->bool_class;
-	} else if (strcmp_ignoring(type, "Class<") == 0) {
-		int len = (int) strlen(type);
-
-		// Hack that allows us not to reallocate another string
-		type[len - 1] = '\0';
-		class = lit_classes_get(&resolver->classes, lit_copy_string(MM(resolver->compiler), &type[6], (size_t) (len - 7)));
-		type[len - 1] = '>';
-		should_be_static = true;
 	} else {
-		class = lit_classes_get(&resolver->classes, lit_copy_string(MM(resolver->compiler), type, strlen(type)));
+		class = get_class(resolver, type);
+		should_be_static = type->kind == CLASS_TYPE;
 	}
 
 	if (class == NULL) {
-		error(resolver, expression->expression.line, "Class %s is not defined", type);
+		error(resolver, expression->expression.line, "Class %s is not defined", type->name->chars);
 		return NULL;
 	} else if (should_be_static && !class->inited) {
 		class->inited = true;
 		expression->emit_static_init = true;
 	}
 
-	LitString* str = lit_copy_string(MM(resolver->compiler), expression->property, strlen(expression->property));
+	LitString* str = expression->property;
 
 	if (str == resolver->compiler->init_string) {
 		error(resolver, expression->expression.line, "Can't call class constructor directly");
@@ -1018,7 +1126,7 @@ static const char* resolve_get_expression(LitResolver* resolver, LitGetExpressio
 		LitResolverMethod* method = lit_resolver_methods_get(should_be_static ? &class->static_methods : &class->methods, str);
 
 		if (method == NULL) {
-			error(resolver, expression->expression.line, "%s%s has no %sfield or method %s", should_be_static ? "" : "Class ", class->name->chars, should_be_static ? "static " : "", expression->property);
+			error(resolver, expression->expression.line, "%s%s has no %sfield or method %s", should_be_static ? "" : "Class ", class->name->chars, should_be_static ? "static " : "", expression->property->chars);
 			return NULL;
 		}
 
@@ -1029,11 +1137,15 @@ static const char* resolve_get_expression(LitResolver* resolver, LitGetExpressio
 		if (method->access == PRIVATE_ACCESS) {
 			if (expression->object->type != THIS_EXPRESSION || class->super != NULL) {
 				if (expression->object->type != THIS_EXPRESSION || lit_resolver_methods_get(&class->super->methods, str) != NULL || lit_resolver_methods_get(&class->super->static_methods, str) != NULL) {
-					error(resolver, expression->expression.line, "Can't access private method %s from %s", expression->property, type);
+					error(resolver, expression->expression.line, "Can't access private method %s from %s", expression->property->chars, type->name->chars);
 				}
 			}
 		} else if (method->access == PROTECTED_ACCESS && expression->object->type != THIS_EXPRESSION && expression->object->type != SUPER_EXPRESSION) {
-			error(resolver, expression->expression.line, "Can't access protected method %s", expression->property);
+			error(resolver, expression->expression.line, "Can't access protected method %s", expression->property->chars);
+		}
+
+		if (target != NULL && method->statement != NULL && (should_be_static || class->final)) {
+			*target = (LitStatement*) method->statement;
 		}
 
 		return method->signature;
@@ -1044,91 +1156,57 @@ static const char* resolve_get_expression(LitResolver* resolver, LitGetExpressio
 	return field->type;
 }
 
-static const char* resolve_set_expression(LitResolver* resolver, LitSetExpression* expression) {
-	const char* type = resolve_expression(resolver, expression->object);
+static LitResolverType* resolve_get_expression(LitResolver* resolver, LitGetExpression* expression) {
+	return resolve_get(resolver, expression, NULL);
+}
+
+static LitResolverType* resolve_set_expression(LitResolver* resolver, LitSetExpression* expression) {
+	LitResolverType* type = resolve_expression(resolver, expression->object);
 
 	if (type == NULL) {
 		return NULL;
 	}
 
-	if (strcmp_ignoring("Class<", type) == 0) {
-		size_t len = strlen(type);
-		char* tp = (char*) reallocate(resolver->compiler, NULL, 0, len - 6);
-		strncpy(tp, &type[6], len - 7);
-		tp[len - 7] = '\0';
-
-		lit_strings_write(MM(resolver->compiler), &resolver->allocated_strings, tp);
-		LitType* class = lit_classes_get(&resolver->classes, lit_copy_string(MM(resolver->compiler), tp, len - 7));
+	bool is_static = type->kind == CLASS_TYPE;
+	LitType* class = get_class(resolver, type);
 
-		if (class == NULL) {
-			error(resolver, expression->expression.line, "Undefined type %s", type);
-			return NULL;
-		}
-
-		if (!class->inited) {
-			class->inited = true;
-			expression->emit_static_init = true;
-		}
-
-		LitResolverField *field = lit_resolver_fields_get(&class->static_fields, lit_copy_string(MM(resolver->compiler), expression->property, strlen(expression->property)));
-
-		if (field == NULL) {
-			error(resolver, expression->expression.line, "Class %s has no field %s", type, expression->property);
-			return NULL;
-		}
-
-		const char *var_type = expression->value == NULL ? "void" : resolve_expression(resolver, expression->value);
-
-		if (var_type == NULL) {
-			return NULL;
-		}
-
-		if (!compare_arg((char *) field->type, (char *) var_type)) {
-			error(resolver, expression->expression.line, "Can't assign %s value to %s field %s", var_type, field->type, expression->property);
-			return NULL;
-		}
-
-		if (field->is_final) {
-			error(resolver, expression->expression.line, "Field %s is final, can't assign a value to it", expression->property);
-		}
-
-		return field->type;
-	} else {
-		LitType *class = lit_classes_get(&resolver->classes, lit_copy_string(MM(resolver->compiler), type, strlen(type)));
+	if (class == NULL) {
+		error(resolver, expression->expression.line, "Undefined type %s", type->name->chars);
+		return NULL;
+	}
 
-		if (class == NULL) {
-			error(resolver, expression->expression.line, "Undefined type %s", type);
-			return NULL;
-		}
+	if (is_static && !class->inited) {
+		class->inited = true;
+		expression->emit_static_init = true;
+	}
 
-		LitResolverField *field = lit_resolver_fields_get(&class->fields, lit_copy_string(MM(resolver->compiler), expression->property, strlen(expression->property)));
+	LitResolverField *field = lit_resolver_fields_get(is_static ? &class->static_fields : &class->fields, expression->property);
 
-		if (field == NULL) {
-			error(resolver, expression->expression.line, "Class %s has no field %s", type, expression->property);
-			return NULL;
-		}
+	if (field == NULL) {
+		error(resolver, expression->expression.line, "Class %s has no field %s", type->name->chars, expression->property->chars);
+		return NULL;
+	}
 
-		const char *var_type = expression->value == NULL ? "void" : resolve_expression(resolver, expression->value);
+	LitResolverType* var_type = expression->value == NULL ? resolver->void_type : resolve_expression(resolver, expression->value);
 
-		if (var_type == NULL) {
-			return NULL;
-		}
-
-		if (!compare_arg((char *) field->type, (char *) var_type)) {
-			error(resolver, expression->expression.line, "Can't assign %s value to %s field %s", var_type, field->type, expression->property);
-			return NULL;
-		}
+	if (var_type == NULL) {
+		return NULL;
+	}
 
-		if (field->is_final) {
-			error(resolver, expression->expression.line, "Field %s is final, can't assign a value to it", expression->property);
-		}
+	if (!compare_arg(resolver, field->type, var_type)) {
+		error(resolver, expression->expression.line, "Can't assign %s value to %s field %s", var_type->name->chars, field->type->name->chars, expression->property->chars);
+		return NULL;
+	}
 
-		return field->type;
+	if (field->is_final) {
+		error(resolver, expression->expression.line, "Field %s is final, can't assign a value to it", expression->property->chars);
 	}
+
+	return field->type;
 }
 
-static const char* resolve_lambda_expression(LitResolver* resolver, LitLambdaExpression* expression) {
-	const char* type = get_function_signature(resolver, expression->parameters, &expression->return_type);
+static LitResolverType* resolve_lambda_expression(LitResolver* resolver, LitLambdaExpression* expression) {
+	LitResolverType* type = get_function_signature(resolver, expression->parameters, &expression->return_type);
 
 	if (type == NULL) {
 		return NULL;
@@ -1140,21 +1218,19 @@ static const char* resolve_lambda_expression(LitResolver* resolver, LitLambdaExp
 	resolve_function(resolver, expression->parameters, &expression->return_type, expression->body, "Missing return statement in lambda", NULL, expression->expression.line);
 	resolver->function = last;
 
-	lit_strings_write(MM(resolver->compiler), &resolver->allocated_strings, (char*) type);
-
 	return type;
 }
 
-static const char* resolve_this_expression(LitResolver* resolver, LitThisExpression* expression) {
+static LitResolverType* resolve_this_expression(LitResolver* resolver, LitThisExpression* expression) {
 	if (resolver->class == NULL) {
 		error(resolver, expression->expression.line, "Can't use this outside of a class");
 		return NULL;
 	}
 
-	return resolver->class->name->chars;
+	return intern_type(resolver, resolver->class->name, resolver->class->name, NULL, 0);
 }
 
-static const char* resolve_super_expression(LitResolver* resolver, LitSuperExpression* expression) {
+static LitResolverType* resolve_super_expression(LitResolver* resolver, LitSuperExpression* expression) {
 	if (resolver->class == NULL) {
 		error(resolver, expression->expression.line, "Can't use super outside of a class");
 		return NULL;
@@ -1165,19 +1241,19 @@ static const char* resolve_super_expression(LitResolver* resolver, LitSuperExpre
 		return NULL;
 	}
 
-	LitResolverMethod* method = lit_resolver_methods_get(&resolver->class->super->methods, lit_copy_string(MM(resolver->compiler), expression->method, strlen(expression->method)));
+	LitResolverMethod* method = lit_resolver_methods_get(&resolver->class->super->methods, expression->method);
 
 	if (method == NULL) {
-		error(resolver, expression->expression.line, "Class %s has no method %s", resolver->class->super->name->chars, expression->method);
+		error(resolver, expression->expression.line, "Class %s has no method %s", resolver->class->super->name->chars, expression->method->chars);
 		return NULL;
 	}
 
 	return method->signature;
 }
 
-static const char* resolve_if_expression(LitResolver* resolver, LitIfExpression* expression) {
+static LitResolverType* resolve_if_expression(LitResolver* resolver, LitIfExpression* expression) {
 	resolve_expression(resolver, expression->condition);
-	const char* type = resolve_expression(resolver, expression->if_branch);
+	LitResolverType* type = resolve_expression(resolver, expression->if_branch);
 
 	if (type == NULL) {
 		return NULL;
@@ -1187,30 +1263,29 @@ static const char* resolve_if_expression(LitResolver* resolver, LitIfExpression*
 		resolve_expressions(resolver, expression->else_if_conditions);
 
 		for (int i = 0; i < expression->else_if_branches->count; i++) {
-			const char* branch_type = resolve_expression(resolver, expression->else_if_branches->values[i]);
+			LitResolverType* branch_type = resolve_expression(resolver, expression->else_if_branches->values[i]);
 
-
-			if (branch_type != NULL && strcmp(branch_type, type) != 0) {
-				error(resolver, expression->else_if_branches->values[i]->line, "If expression type was declared %s (from if branch), can't return a %s value from else if branch", type, branch_type);
+			if (branch_type != NULL && branch_type != type) {
+				error(resolver, expression->else_if_branches->values[i]->line, "If expression type was declared %s (from if branch), can't return a %s value from else if branch", type->name->chars, branch_type->name->chars);
 			}
 		}
 	}
 
 	if (expression->else_branch != NULL) {
-		const char* branch_type = resolve_expression(resolver, expression->else_branch);
+		LitResolverType* branch_type = resolve_expression(resolver, expression->else_branch);
 
-		if (branch_type != NULL && strcmp(branch_type, type) != 0) {
-			error(resolver, expression->else_branch->line, "If expression type was declared %s (from if branch), can't return a %s value from else branch", type, branch_type);
+		if (branch_type != NULL && branch_type != type) {
+			error(resolver, expression->else_branch->line, "If expression type was declared %s (from if branch), can't return a %s value from else branch", type->name->chars, branch_type->name->chars);
 		}
 	}
 
 	return type;
 }
 
-static const char* resolve_expression(LitResolver* resolver, LitExpression* expression) {
+static LitResolverType* resolve_expression(LitResolver* resolver, LitExpression* expression) {
 	switch (expression->type) {
 		case BINARY_EXPRESSION: return resolve_binary_expression(resolver, (LitBinaryExpression*) expression);
-		case LITERAL_EXPRESSION: return resolve_literal_expression((LitLiteralExpression*) expression);
+		case LITERAL_EXPRESSION: return resolve_literal_expression(resolver, (LitLiteralExpression*) expression);
 		case UNARY_EXPRESSION: return resolve_unary_expression(resolver, (LitUnaryExpression*) expression);
 		case GROUPING_EXPRESSION: return resolve_grouping_expression(resolver, (LitGroupingExpression*) expression);
 		case VAR_EXPRESSION: return resolve_var_expression(resolver, (LitVarExpression*) expression);
@@ -1239,10 +1314,12 @@ static void resolve_expressions(LitResolver* resolver, LitExpressions* expressio
 }
 
 void lit_init_resolver(LitResolver* resolver) {
+	lit_init_resolver_stack(&resolver->locals);
+	lit_init_resolver_index(&resolver->index);
 	lit_init_scopes(&resolver->scopes);
 	lit_init_types(&resolver->types);
+	lit_init_resolver_types(&resolver->interned_types);
 	lit_init_classes(&resolver->classes);
-	lit_init_strings(&resolver->allocated_strings);
 
 	resolver->loop = NULL;
 	resolver->had_error = false;
@@ -1258,26 +1335,63 @@ void lit_init_resolver(LitResolver* resolver) {
 	push_scope(resolver); // Global scope
 
 	lit_define_type(resolver, "void");
+	lit_define_type(resolver, "any");
 	lit_define_type(resolver, "int");
 	lit_define_type(resolver, "string");
 	lit_define_type(resolver, "double");
 	lit_define_type(resolver, "bool");
+
+	resolver->void_type = lit_resolver_type(resolver, "void");
+	resolver->any_type = lit_resolver_type(resolver, "any");
+	resolver->int_type = lit_resolver_type(resolver, "int");
+	resolver->double_type = lit_resolver_type(resolver, "double");
+	resolver->bool_type = lit_resolver_type(resolver, "bool");
+	resolver->char_type = lit_resolver_type(resolver, "char");
+	resolver->string_type = lit_resolver_type(resolver, "string");
+	resolver->string_object_type = lit_resolver_type(resolver, "String");
+	resolver->object_type = lit_resolver_type(resolver, "Object");
 }
 
 void lit_free_resolver(LitResolver* resolver) {
 	pop_scope(resolver);
 
+	lit_free_resolver_stack(MM(resolver->compiler), &resolver->locals);
+	lit_free_resolver_index(MM(resolver->compiler), &resolver->index);
+
 	for (int i = 0; i <= resolver->externals.capacity_mask; i++) {
 		LitResolverLocal* local = resolver->externals.entries[i].value;
 
 		if (local != NULL) {
-			reallocate(resolver->compiler, (void*) local->type, strlen(local->type), 0);
 			reallocate(resolver->compiler, (void*) local, sizeof(LitResolverLocal), 0);
 		}
 	}
 
 	lit_free_resolver_locals(MM(resolver->compiler), &resolver->externals);
 
+	// Subclasses share the inherited fields and methods, so they are forgotten first,
+	// otherwise a class, freed after its super, would read them, to find out, who owns them
+	for (int i = 0; i <= resolver->classes.capacity_mask; i++) {
+		LitType* type = resolver->classes.entries[i].value;
+
+		if (type != NULL && !type->external) {
+			for (int j = 0; type->fields.count != 0 && j <= type->fields.capacity_mask; j++) {
+				LitResolverField* a = type->fields.entries[j].value;
+
+				if (a != NULL && a->original != type) {
+					type->fields.entries[j].value = NULL;
+				}
+			}
+
+			for (int j = 0; type->methods.count != 0 && j <= type->methods.capacity_mask; j++) {
+				LitResolverMethod* a = type->methods.entries[j].value;
+
+				if (a != NULL && a->original != type) {
+					type->methods.entries[j].value = NULL;
+				}
+			}
+		}
+	}
+
 	for (int i = 0; i <= resolver->classes.capacity_mask; i++) {
 		LitType* type = resolver->classes.entries[i].value;
 
@@ -1333,12 +1447,19 @@ void lit_free_resolver(LitResolver* resolver) {
 
 	lit_free_classes(MM(resolver->compiler), &resolver->classes);
 
-	for (int i = 0; i < resolver->allocated_strings.count; i++) {
-		char* str = resolver->allocated_strings.values[i];
-		reallocate(resolver->compiler, (void*) str, strlen(str) + 1, 0);
+	for (int i = 0; i <= resolver->interned_types.capacity_mask; i++) {
+		LitResolverType* type = resolver->interned_types.entries[i].value;
+
+		if (type != NULL) {
+			if (type->arguments != NULL) {
+				FREE_ARRAY(resolver->compiler, LitResolverType*, type->arguments, type->argument_count);
+			}
+
+			reallocate(resolver->compiler, (void*) type, sizeof(LitResolverType), 0);
+		}
 	}
 
-	lit_free_strings(MM(resolver->compiler), &resolver->allocated_strings);
+	lit_free_resolver_types(MM(resolver->compiler), &resolver->interned_types);
 	lit_free_types(MM(resolver->compiler), &resolver->types);
 	lit_free_scopes(MM(resolver->compiler), &resolver->scopes);
 }
@@ -1353,7 +1474,6 @@ void lit_free_resolver_field(LitCompiler* compiler, LitResolverField* field) {
 }
 
 void lit_free_resolver_method(LitCompiler* compiler, LitResolverMethod* method) {
-	reallocate(compiler, (void*) method->signature, strlen(method->signature) + 1, 0);
 	reallocate(compiler, (void*) method, sizeof(LitResolverMethod), 0);
 }
 
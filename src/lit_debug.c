@@ -26,8 +26,8 @@ void lit_trace_statement(LitMemManager* manager, LitStatement* statement, int de
 				LitVarStatement* var = (LitVarStatement*) statement;
 
 				printf("\"type\" : \"var declaration\",\n");
-				printf("\"var_type\" : \"%s\",\n", var->type == NULL ? "undefined" : var->type);
-				printf("\"name\" : \"%s\",\n", var->name);
+				printf("\"var_type\" : \"%s\",\n", var->type == NULL ? "undefined" : var->type->chars);
+				printf("\"name\" : \"%s\",\n", var->name->chars);
 				printf("\"final\" : \"%s\",\n", var->final ? "true" : "false");
 				printf("\"init\" : ");
 
@@ -93,7 +93,7 @@ void lit_trace_statement(LitMemManager* manager, LitStatement* statement, int de
 				printf("\"type\" : \"block\",\n");
 				printf("\"statements\" : [");
 
-				int cn = block->statements->count;
+				int cn = block->statements == NULL ? 0 : block->statements->count;
 
 				if (cn > 0) {
 					printf("\n");
@@ -130,8 +130,8 @@ void lit_trace_statement(LitMemManager* manager, LitStatement* statement, int de
 				LitFunctionStatement* function = (LitFunctionStatement*) statement;
 
 				printf("\"type\" : \"function\",\n");
-				printf("\"name\" : \"%s\",\n", function->name);
-				printf("\"return_type\" : \"%s\",\n", function->return_type.type);
+				printf("\"name\" : \"%s\",\n", function->name->chars);
+				printf("\"return_type\" : \"%s\",\n", function->return_type.type->chars);
 				printf("\"args\" : [");
 
 				if (function->parameters != NULL) {
@@ -141,8 +141,8 @@ void lit_trace_statement(LitMemManager* manager, LitStatement* statement, int de
 					for (int i = 0; i < cn; i++) {
 						LitParameter parameter = function->parameters->values[i];
 
-						printf("{\n\"name\" : \"%s\",\n", parameter.name);
-						printf("\"type\" : \"%s\"\n}", parameter.type);
+						printf("{\n\"name\" : \"%s\",\n", parameter.name->chars);
+						printf("\"type\" : \"%s\"\n}", parameter.type->chars);
 
 						if (i < cn - 1) {
 							printf(",\n");
@@ -162,12 +162,12 @@ void lit_trace_statement(LitMemManager* manager, LitStatement* statement, int de
 				LitMethodStatement* function = (LitMethodStatement*) statement;
 
 				printf("\"type\" : \"method\",\n");
-				printf("\"name\" : \"%s\",\n", function->name);
+				printf("\"name\" : \"%s\",\n", function->name->chars);
 				printf("\"overriden\" : \"%s\",\n", function->overriden ? "true" : "false");
 				printf("\"static\" : \"%s\",\n", function->is_static ? "true" : "false");
 				printf("\"abstract\" : \"%s\",\n", function->abstract ? "true" : "false");
 				printf("\"access\" : \"%s\",\n", function->access == PUBLIC_ACCESS ? "public" : (function->access == PRIVATE_ACCESS ? "private" : "protected"));
-				printf("\"return_type\" : \"%s\",\n", function->return_type.type);
+				printf("\"return_type\" : \"%s\",\n", function->return_type.type->chars);
 				printf("\"args\" : [");
 
 				if (function->parameters != NULL) {
@@ -177,8 +177,8 @@ void lit_trace_statement(LitMemManager* manager, LitStatement* statement, int de
 					for (int i = 0; i < cn; i++) {
 						LitParameter parameter = function->parameters->values[i];
 
-						printf("{\n\"name\" : \"%s\",\n", parameter.name);
-						printf("\"type\" : \"%s\"\n}", parameter.type);
+						printf("{\n\"name\" : \"%s\",\n", parameter.name->chars);
+						printf("\"type\" : \"%s\"\n}", parameter.type->chars);
 
 						if (i < cn - 1) {
 							printf(",\n");
@@ -213,7 +213,7 @@ void lit_trace_statement(LitMemManager* manager, LitStatement* statement, int de
 				LitClassStatement* class = (LitClassStatement*) statement;
 
 				printf("\"type\" : \"class\",\n");
-				printf("\"name\" : \"%s\",\n", class->name);
+				printf("\"name\" : \"%s\",\n", class->name->chars);
 				printf("\"super\" : ");
 
 				if (class->super == NULL) {
@@ -266,8 +266,8 @@ void lit_trace_statement(LitMemManager* manager, LitStatement* statement, int de
 				LitFieldStatement* field = (LitFieldStatement*) statement;
 
 				printf("\"type\" : \"field\",\n");
-				printf("\"field_type\" : \"%s\",\n", field->type == NULL ? "undefined" : field->type);
-				printf("\"name\" : \"%s\",\n", field->name);
+				printf("\"field_type\" : \"%s\",\n", field->type == NULL ? "undefined" : field->type->chars);
+				printf("\"name\" : \"%s\",\n", field->name->chars);
 				printf("\"static\" : \"%s\",\n", field->is_static ? "true" : "false");
 				printf("\"final\" : \"%s\",\n", field->final ? "true" : "false");
 				printf("\"access\" : \"%s\",\n", field->access == PUBLIC_ACCESS ? "public" :
@@ -350,6 +350,12 @@ void lit_trace_expression(LitMemManager* manager, LitExpression* expression, int
 					case TOKEN_LESS_EQUAL: printf("\"<=\"\n"); break;
 					case TOKEN_GREATER: printf("\">\"\n"); break;
 					case TOKEN_GREATER_EQUAL: printf("\">=\"\n"); break;
+					case TOKEN_EQUAL_EQUAL: printf("\"==\"\n"); break;
+					case TOKEN_BANG_EQUAL: printf("\"!=\"\n"); break;
+					case TOKEN_PERCENT: printf("\"%%\"\n"); break;
+					case TOKEN_CARET: printf("\"^\"\n"); break;
+					case TOKEN_CELL: printf("\"#\"\n"); break;
+					case TOKEN_IS: printf("\"is\"\n"); break;
 					default: UNREACHABLE();
 				}
 
@@ -391,6 +397,7 @@ void lit_trace_expression(LitMemManager* manager, LitExpression* expression, int
 				switch (unary->operator) {
 					case TOKEN_MINUS: printf("\"-\"\n"); break;
 					case TOKEN_BANG: printf("\"!\"\n"); break;
+					case TOKEN_CELL: printf("\"#\"\n"); break;
 					default: printf("\"unknown\"\n"); break;
 				}
 
@@ -410,7 +417,7 @@ void lit_trace_expression(LitMemManager* manager, LitExpression* expression, int
 				LitVarExpression* var = (LitVarExpression*) expression;
 
 				printf("\"type\" : \"var usage\",\n");
-				printf("\"name\" : \"%s\"\n", var->name);
+				printf("\"name\" : \"%s\"\n", var->name->chars);
 
 				break;
 			}
@@ -420,7 +427,7 @@ void lit_trace_expression(LitMemManager* manager, LitExpression* expression, int
 				printf("\"type\" : \"assign\",\n");
 				printf("\"to\" : ");
 				lit_trace_expression(manager, var->to, depth + 1);
-				printf("\n");
+				printf(",\n");
 				printf("\"value\" : ");
 				lit_trace_expression(manager, var->value, depth + 1);
 				printf("\n");
@@ -463,7 +470,7 @@ void lit_trace_expression(LitMemManager* manager, LitExpression* expression, int
 				lit_trace_expression(manager, expr->object, depth);
 
 				printf(",\n");
-				printf("\"property\" : \"%s\"\n", expr->property);
+				printf("\"property\" : \"%s\"\n", expr->property->chars);
 
 				break;
 			}
@@ -476,7 +483,45 @@ void lit_trace_expression(LitMemManager* manager, LitExpression* expression, int
 				lit_trace_expression(manager, expr->object, depth);
 
 				printf(",\n");
-				printf("\"property\" : \"%s\"\n", expr->property);
+				printf("\"property\" : \"%s\",\n", expr->property->chars);
+				printf("\"value\" : ");
+
+				lit_trace_expression(manager, expr->value, depth + 1);
+				printf("\n");
+
+				break;
+			}
+			case IF_EXPRESSION: {
+				LitIfExpression* if_expression = (LitIfExpression*) expression;
+
+				printf("\"type\" : \"if\",\n");
+				printf("\"condition\" : ");
+				lit_trace_expression(manager, if_expression->condition, depth + 1);
+				printf(",\n\"if_branch\" : ");
+				lit_trace_expression(manager, if_expression->if_branch, depth + 1);
+				printf(",\n\"else_if_branches\" : [");
+
+				if (if_expression->else_if_branches != NULL) {
+					printf("\n");
+					int cn = if_expression->else_if_branches->count;
+
+					for (int i = 0; i < cn; i++) {
+						printf("{\n\"condition\" : ");
+						lit_trace_expression(manager, if_expression->else_if_conditions->values[i], depth + 1);
+						printf(",\n\"body\" : ");
+						lit_trace_expression(manager, if_expression->else_if_branches->values[i], depth + 1);
+
+						if (i < cn - 1) {
+							printf("},\n");
+						} else {
+							printf("}\n");
+						}
+					}
+				}
+
+				printf("],\n\"else_branch\" : ");
+				lit_trace_expression(manager, if_expression->else_branch, depth + 1);
+				printf("\n");
 
 				break;
 			}
@@ -484,7 +529,7 @@ void lit_trace_expression(LitMemManager* manager, LitExpression* expression, int
 				LitLambdaExpression* lamba = (LitLambdaExpression*) expression;
 
 				printf("\"type\" : \"lambda\",\n");
-				printf("\"return_type\" : \"%s\",\n", lamba->return_type.type);
+				printf("\"return_type\" : \"%s\",\n", lamba->return_type.type->chars);
 				printf("\"args\" : [");
 
 				if (lamba->parameters != NULL) {
@@ -494,8 +539,8 @@ void lit_trace_expression(LitMemManager* manager, LitExpression* expression, int
 					for (int i = 0; i < cn; i++) {
 						LitParameter parameter = lamba->parameters->values[i];
 
-						printf("{\n\"name\" : \"%s\",\n", parameter.name);
-						printf("\"type\" : \"%s\"\n}", parameter.type);
+						printf("{\n\"name\" : \"%s\",\n", parameter.name->chars);
+						printf("\"type\" : \"%s\"\n}", parameter.type->chars);
 
 						if (i < cn - 1) {
 							printf(",\n");
@@ -517,7 +562,7 @@ void lit_trace_expression(LitMemManager* manager, LitExpression* expression, int
 			}
 			case SUPER_EXPRESSION: {
 				printf("\"type\" : \"super\",\n");
-				printf("\"method\" : \"%s\"\n", ((LitSuperExpression*) expression)->method);
+				printf("\"method\" : \"%s\"\n", ((LitSuperExpression*) expression)->method->chars);
 				break;
 			}
 			default: {
@@ -559,6 +604,12 @@ static uint64_t byte_instruction(const char* name, LitChunk* chunk, uint64_t off
 	return offset + 2;
 }
 
+static uint64_t direct_call_instruction(LitMemManager* manager, const char* name, LitChunk* chunk, uint64_t offset) {
+	uint8_t constant = chunk->code[offset + 1];
+	printf("%-16s %4d '%s' (%d args)\n", name, constant, lit_to_string((LitVm*) manager, chunk->constants.values[constant]), chunk->code[offset + 2]);
+	return offset + 3;
+}
+
 static uint64_t jump_instruction(const char* name, int sign, LitChunk* chunk, uint64_t offset) {
 	uint16_t jump = (uint16_t)(chunk->code[offset + 1] << 8);
 	jump |= chunk->code[offset + 2];
@@ -593,6 +644,10 @@ uint64_t lit_disassemble_instruction(LitMemManager* manager, LitChunk* chunk, ui
 		case OP_GREATER_EQUAL: return simple_instruction("OP_GREATER_EQUAL", offset);
 		case OP_LESS_EQUAL: return simple_instruction("OP_LESS_EQUAL", offset);
 		case OP_CALL: return simple_instruction("OP_CALL", offset) + 1;
+		case OP_TAIL_CALL: return simple_instruction("OP_TAIL_CALL", offset) + 1;
+		case OP_CALL_DIRECT: return direct_call_instruction(manager, "OP_CALL_DIRECT", chunk, offset);
+		case OP_TAIL_CALL_DIRECT: return direct_call_instruction(manager, "OP_TAIL_CALL_DIRECT", chunk, offset);
+		case OP_INVOKE_DIRECT: return direct_call_instruction(manager, "OP_INVOKE_DIRECT", chunk, offset);
 		case OP_DEFINE_GLOBAL: return constant_instruction(manager, "OP_DEFINE_GLOBAL", chunk, offset);
 		case OP_GET_GLOBAL: return constant_instruction(manager, "OP_GET_GLOBAL", chunk, offset);
 		case OP_SET_GLOBAL: return constant_instruction(manager, "OP_SET_GLOBAL", chunk, offset);
@@ -603,6 +658,7 @@ uint64_t lit_disassemble_instruction(LitMemManager* manager, LitChunk* chunk, ui
 		case OP_CONSTANT: return constant_instruction(manager, "OP_CONSTANT", chunk, offset);
 		case OP_JUMP: return jump_instruction("OP_JUMP", 1, chunk, offset);
 		case OP_JUMP_IF_FALSE: return jump_instruction("OP_JUMP_IF_FALSE", 1, chunk, offset);
+		case OP_JUMP_IF_TRUE: return jump_instruction("OP_JUMP_IF_TRUE", 1, chunk, offset);
 		case OP_LOOP: return jump_instruction("OP_LOOP", -1, chunk, offset);
 		case OP_CLASS: return constant_instruction(manager, "OP_CLASS", chunk, offset);
 		case OP_SUBCLASS: return constant_instruction(manager, "OP_SUBCLASS", chunk, offset);
@@ -613,7 +669,7 @@ uint64_t lit_disassemble_instruction(LitMemManager* manager, LitChunk* chunk, ui
 		case OP_DEFINE_METHOD: return constant_instruction(manager, "OP_DEFINE_METHOD", chunk, offset);
 		case OP_DEFINE_STATIC_FIELD: return constant_instruction(manager, "OP_DEFINE_STATIC_FIELD", chunk, offset);
 		case OP_DEFINE_STATIC_METHOD: return constant_instruction(manager, "OP_DEFINE_STATIC_METHOD", chunk, offset);
-		case OP_INVOKE: return constant_instruction(manager, "OP_INVOKE", chunk, offset) + 2;
+		case OP_INVOKE: return byte_instruction("OP_INVOKE", chunk, offset);
 		case OP_SUPER: return constant_instruction(manager, "OP_SUPER", chunk, offset);
 		case OP_CLOSURE: {
 			offset++;
@@ -1,10 +1,15 @@
 #include <lit_bindings.h>
 #include <std/lit_std.h>
+#include <vm/lit_loop.h>
+#include <vm/lit_memory.h>
 
 #include <time.h>
 #include <ctype.h>
 #include <string.h>
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 /*
  * Class metaclass
@@ -32,15 +37,11 @@ END_METHODS
  */
 METHOD(object_getClass) {
 	if (IS_NUMBER(instance)) {
-		double temp;
-
-		if (modf(AS_NUMBER(instance), &temp) == 0) {
-			RETURN_OBJECT(vm->int_class) // Fixme: 10.0 will be still int
-		} else {
-			RETURN_OBJECT(vm->double_class)
-		}
+		RETURN_OBJECT(IS_INT(instance) ? vm->int_class : vm->double_class)
 	} else if (IS_STRING(instance)) {
 		RETURN_OBJECT(vm->string_class)
+	} else if (IS_FIBER(instance)) {
+		RETURN_OBJECT(vm->fiber_class)
 	}
 
 	RETURN_OBJECT(AS_INSTANCE(instance)->type)
@@ -172,8 +173,24 @@ METHOD(string_startsWith) {
 	RETURN_BOOL(true)
 }
 
+METHOD(string_concat) {
+	LitString* self = AS_STRING(instance);
+	LitString* other = AS_STRING(args[0]);
+	size_t length = (size_t) self->length + (size_t) other->length;
+	char* chars = ALLOCATE(vm, char, length);
+
+	memcpy(chars, self->chars, (size_t) self->length);
+	memcpy(chars + self->length, other->chars, (size_t) other->length);
+
+	// Copied, so that the result is interned, like the literals, that it is compared to
+	LitString* string = lit_copy_string(MM(vm), chars, length);
+	FREE_ARRAY(vm, char, chars, length);
+
+	RETURN_OBJECT(string)
+}
+
 METHOD(string_getLength) {
-	RETURN_NUMBER(AS_STRING(instance)->length);
+	RETURN_INT((int32_t) AS_STRING(instance)->length);
 }
 
 METHOD(string_getHash) {
@@ -181,11 +198,12 @@ METHOD(string_getHash) {
 }
 
 START_METHODS(string)
-	ADD("toLowerCase", "Function<void>", string_toLowerCase, false)
-	ADD("toUpperCase", "Function<void>", string_toUpperCase, false)
+	ADD("toLowerCase", "Function<String>", string_toLowerCase, false)
+	ADD("toUpperCase", "Function<String>", string_toUpperCase, false)
 	ADD("contains", "Function<String, void>", string_contains, false)
 	ADD("startsWith", "Function<String, void>", string_startsWith, false)
 	ADD("endsWith", "Function<String, void>", string_endsWith, false)
+	ADD("concat", "Function<String, String>", string_concat, false)
 	ADD("getLength", "Function<int>", string_getLength, false)
 	ADD("getHash", "Function<int>", string_getHash, false)
 END_METHODS
@@ -196,6 +214,144 @@ END_METHODS
 START_METHODS(function)
 END_METHODS
 
+/*
+ * Fiber class
+ * The natives only pick the next fiber, the vm switches to it, once they return (see lit_vm.h)
+ */
+static bool check_fiber_function(LitVm* vm, const LitValue* args, int count, const char* name) {
+	if (count != 1 || !IS_CLOSURE(args[0]) || AS_CLOSURE(args[0])->function->arity != 0) {
+		lit_runtime_error(vm, "Fiber.%s() expects a function without arguments", name);
+		return false;
+	}
+
+	return true;
+}
+
+METHOD(fiber_create) {
+	if (!check_fiber_function(vm, args, count, "create")) {
+		RETURN_NIL
+	}
+
+	RETURN_OBJECT(lit_new_fiber(MM(vm), AS_CLOSURE(args[0])))
+}
+
+// The fiber runs as a task on the event loop, once the running fiber waits or is done
+METHOD(fiber_spawn) {
+	if (!check_fiber_function(vm, args, count, "spawn")) {
+		RETURN_NIL
+	}
+
+	LitFiber* fiber = lit_new_fiber(MM(vm), AS_CLOSURE(args[0]));
+
+	lit_push(vm, MAKE_OBJECT_VALUE(fiber));
+	lit_loop_spawn(vm, fiber);
+
+	return 1;
+}
+
+METHOD(fiber_resume) {
+	LitFiber* fiber = AS_FIBER(instance);
+
+	if (fiber->stack == NULL) {
+		lit_runtime_error(vm, "Can't resume a fiber, that is done");
+		RETURN_NIL
+	}
+
+	if (fiber->parked) {
+		lit_runtime_error(vm, "Can't resume a fiber, that waits in the event loop");
+		RETURN_NIL
+	}
+
+	// The running fiber and the ones, that wait for it, can't be resumed
+	for (LitFiber* waiting = vm->fiber; waiting != NULL; waiting = waiting->parent) {
+		if (waiting == fiber) {
+			lit_runtime_error(vm, "Can't resume a fiber, that is running");
+			RETURN_NIL
+		}
+	}
+
+	fiber->parent = vm->fiber;
+	vm->next_fiber = fiber;
+
+	// Replaced by the value, that the fiber yields or returns
+	RETURN_NIL
+}
+
+METHOD(fiber_yield) {
+	LitFiber* fiber = vm->fiber;
+
+	if (fiber->parent == NULL) {
+		lit_runtime_error(vm, "Can't yield from a fiber, that was not resumed");
+		RETURN_NIL
+	}
+
+	vm->next_fiber = fiber->parent;
+	fiber->parent = NULL;
+
+	// Goes to the resume() of the parent, the fiber gets nil, once it is resumed
+	RETURN_VALUE(args[0])
+}
+
+METHOD(fiber_isDone) {
+	RETURN_BOOL(AS_FIBER(instance)->stack == NULL)
+}
+
+START_METHODS(fiber)
+	ADD("create", "Function<any, Fiber>", fiber_create, true)
+	ADD("spawn", "Function<any, Fiber>", fiber_spawn, true)
+	ADD("resume", "Function<any>", fiber_resume, false)
+	ADD("yield", "Function<any, void>", fiber_yield, true)
+	ADD("isDone", "Function<bool>", fiber_isDone, false)
+END_METHODS
+
+/*
+ * Pipe class
+ * Both ends are fds, that the io functions take
+ */
+static void set_pipe_end(LitVm* vm, LitInstance* pipe, const char* name, int fd) {
+	LitString* key = lit_copy_string(MM(vm), name, strlen(name));
+
+	lit_push(vm, MAKE_OBJECT_VALUE(key));
+	lit_table_set(MM(vm), &pipe->fields, key, MAKE_INT_VALUE(fd));
+	lit_pop(vm);
+}
+
+static int get_pipe_end(LitVm* vm, LitValue instance, const char* name) {
+	LitValue* fd = lit_table_get(&AS_INSTANCE(instance)->fields, lit_copy_string(MM(vm), name, strlen(name)));
+	RETURN_VALUE(fd == NULL ? MAKE_INT_VALUE(-1) : *fd)
+}
+
+METHOD(pipe_open) {
+	int fds[2];
+
+	if (!lit_loop_pipe(vm, fds)) {
+		lit_runtime_error(vm, "Can't open a pipe");
+		RETURN_NIL
+	}
+
+	LitInstance* pipe = lit_new_instance(MM(vm), AS_CLASS(instance));
+	lit_push(vm, MAKE_OBJECT_VALUE(pipe));
+
+	set_pipe_end(vm, pipe, "reader", fds[0]);
+	set_pipe_end(vm, pipe, "writer", fds[1]);
+
+	return 1;
+}
+
+METHOD(pipe_getReader) {
+	return get_pipe_end(vm, instance, "reader");
+}
+
+METHOD(pipe_getWriter) {
+	return get_pipe_end(vm, instance, "writer");
+}
+
+START_METHODS(pipe)
+	ADD("open", "Function<Pipe>", pipe_open, true)
+	ADD("getReader", "Function<int>", pipe_getReader, false)
+	ADD("getWriter", "Function<int>", pipe_getWriter, false)
+END_METHODS
+
 /*
  * Standard global functions
  */
@@ -208,10 +364,68 @@ FUNCTION(print) {
 	RETURN_VOID
 }
 
+/*
+ * Async io functions, the calling fiber waits in the event loop, while they would block (see lit_loop.h)
+ * Failed operations return -1 or nil, read() returns an empty string at the end of the data
+ */
+FUNCTION(sleep) {
+	return lit_loop_sleep(vm, AS_NUMBER(args[0]));
+}
+
+FUNCTION(readFile) {
+	return lit_loop_read_file(vm, AS_STRING(args[0]));
+}
+
+FUNCTION(read) {
+	return lit_loop_read(vm, (int) AS_NUMBER(args[0]));
+}
+
+FUNCTION(write) {
+	return lit_loop_write(vm, (int) AS_NUMBER(args[0]), AS_STRING(args[1]));
+}
+
+FUNCTION(accept) {
+	return lit_loop_accept(vm, (int) AS_NUMBER(args[0]));
+}
+
+FUNCTION(connect) {
+	return lit_loop_connect(vm, AS_STRING(args[0]));
+}
+
+FUNCTION(exec) {
+	return lit_loop_exec(vm, AS_STRING(args[0]));
+}
+
+FUNCTION(listen) {
+	lit_push(vm, MAKE_INT_VALUE(lit_loop_listen(vm, AS_STRING(args[0]))));
+	return 1;
+}
+
+FUNCTION(close) {
+	lit_loop_close(vm, (int) AS_NUMBER(args[0]));
+	RETURN_VOID
+}
+
+/*
+ * File functions, they don't block long enough to go through the event loop
+ */
+FUNCTION(tempPath) {
+	const char* directory = getenv("TMPDIR");
+	char path[1024];
+
+	// The pid keeps the files of the processes, that run at the same time, apart
+	snprintf(path, sizeof(path), "%s/lit-%d-%s", directory == NULL ? "/tmp" : directory, (int) getpid(), AS_STRING(args[0])->chars);
+	RETURN_OBJECT(lit_copy_string(MM(vm), path, strlen(path)))
+}
+
+FUNCTION(remove) {
+	RETURN_BOOL(unlink(AS_STRING(args[0])->chars) == 0)
+}
+
 LitLibRegistry* lit_create_std(LitCompiler* compiler) {
 	START_LIB
 
-	START_CLASSES(8)
+	START_CLASSES(10)
 		DEFINE_CLASS("Class", class, NULL)
 		DEFINE_CLASS("Object", object, NULL)
 		DEFINE_CLASS("Bool", bool, object_class)
@@ -220,11 +434,24 @@ LitLibRegistry* lit_create_std(LitCompiler* compiler) {
 		DEFINE_CLASS("Char", char, object_class)
 		DEFINE_CLASS("String", string, object_class)
 		DEFINE_CLASS("Function", function, object_class)
+		DEFINE_CLASS("Fiber", fiber, object_class)
+		DEFINE_CLASS("Pipe", pipe, object_class)
 	END_CLASSES
 
-	START_FUNCTIONS(2)
+	START_FUNCTIONS(13)
 		DEFINE_FUNCTION(time_native, "time", "Function<double>")
 		DEFINE_FUNCTION(print_native, "print", "Function<any, void>")
+		DEFINE_FUNCTION(sleep_native, "sleep", "Function<double, void>")
+		DEFINE_FUNCTION(readFile_native, "readFile", "Function<String, String>")
+		DEFINE_FUNCTION(read_native, "read", "Function<int, String>")
+		DEFINE_FUNCTION(write_native, "write", "Function<int, String, int>")
+		DEFINE_FUNCTION(accept_native, "accept", "Function<int, int>")
+		DEFINE_FUNCTION(connect_native, "connect", "Function<String, int>")
+		DEFINE_FUNCTION(exec_native, "exec", "Function<String, int>")
+		DEFINE_FUNCTION(listen_native, "listen", "Function<String, int>")
+		DEFINE_FUNCTION(close_native, "close", "Function<int, void>")
+		DEFINE_FUNCTION(tempPath_native, "tempPath", "Function<String, String>")
+		DEFINE_FUNCTION(remove_native, "remove", "Function<String, bool>")
 	END_FUNCTIONS
 
 	END_LIB
@@ -0,0 +1,256 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS under -std=c99
+#include <string.h>
+#include <sys/mman.h>
+
+#include <vm/lit_assembler.h>
+#include <vm/lit_memory.h>
+#include <vm/lit_value.h>
+
+DEFINE_ARRAY(LitCodeBytes, uint8_t, code_bytes)
+
+void lit_init_assembler(LitAssembler* assembler, LitMemManager* manager) {
+	assembler->manager = manager;
+	lit_init_code_bytes(&assembler->code);
+}
+
+void lit_free_assembler(LitAssembler* assembler) {
+	lit_free_code_bytes(assembler->manager, &assembler->code);
+}
+
+uint8_t* lit_asm_map(LitAssembler* assembler) {
+	size_t size = (size_t) assembler->code.count;
+	uint8_t* code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (code == MAP_FAILED) {
+		return NULL;
+	}
+
+	memcpy(code, assembler->code.values, size);
+
+	// The mapping is never writable and executable at the same time
+	if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(code, size);
+		return NULL;
+	}
+
+	return code;
+}
+
+void lit_asm_unmap(uint8_t* code, size_t size) {
+	munmap(code, size);
+}
+
+uint32_t lit_asm_position(LitAssembler* assembler) {
+	return (uint32_t) assembler->code.count;
+}
+
+void lit_asm_byte(LitAssembler* assembler, uint8_t byte) {
+	lit_code_bytes_write(assembler->manager, &assembler->code, byte);
+}
+
+void lit_asm_bytes(LitAssembler* assembler, const uint8_t* bytes, int count) {
+	for (int i = 0; i < count; i++) {
+		lit_asm_byte(assembler, bytes[i]);
+	}
+}
+
+void lit_asm_u32(LitAssembler* assembler, uint32_t value) {
+	lit_asm_bytes(assembler, (uint8_t*) &value, 4);
+}
+
+void lit_asm_u64(LitAssembler* assembler, uint64_t value) {
+	lit_asm_bytes(assembler, (uint8_t*) &value, 8);
+}
+
+static void emit_rex(LitAssembler* assembler, bool wide, int reg, int base) {
+	uint8_t rex = (uint8_t) (0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((base & 8) ? 1 : 0));
+
+	if (rex != 0x40) {
+		lit_asm_byte(assembler, rex);
+	}
+}
+
+// The modrm for [base + disp], rsp and r12 need a sib, rbp and r13 always need a displacement
+static void emit_operand(LitAssembler* assembler, int reg, int base, int32_t disp) {
+	int mod = disp == 0 && (base & 7) != 5 ? 0 : (disp >= -128 && disp <= 127 ? 1 : 2);
+	lit_asm_byte(assembler, (uint8_t) ((mod << 6) | ((reg & 7) << 3) | (base & 7)));
+
+	if ((base & 7) == 4) {
+		lit_asm_byte(assembler, 0x24);
+	}
+
+	if (mod == 1) {
+		lit_asm_byte(assembler, (uint8_t) (int8_t) disp);
+	} else if (mod == 2) {
+		lit_asm_u32(assembler, (uint32_t) disp);
+	}
+}
+
+static void emit_registers(LitAssembler* assembler, int reg, int rm) {
+	lit_asm_byte(assembler, (uint8_t) (0xc0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+void lit_asm_load(LitAssembler* assembler, int reg, int base, int32_t disp) {
+	emit_rex(assembler, true, reg, base);
+	lit_asm_byte(assembler, 0x8b);
+	emit_operand(assembler, reg, base, disp);
+}
+
+void lit_asm_store(LitAssembler* assembler, int base, int32_t disp, int reg) {
+	emit_rex(assembler, true, reg, base);
+	lit_asm_byte(assembler, 0x89);
+	emit_operand(assembler, reg, base, disp);
+}
+
+void lit_asm_address(LitAssembler* assembler, int reg, int base, int32_t disp) {
+	emit_rex(assembler, true, reg, base);
+	lit_asm_byte(assembler, 0x8d);
+	emit_operand(assembler, reg, base, disp);
+}
+
+void lit_asm_move(LitAssembler* assembler, int to, int from) {
+	emit_rex(assembler, true, from, to);
+	lit_asm_byte(assembler, 0x89);
+	emit_registers(assembler, from, to);
+}
+
+void lit_asm_immediate(LitAssembler* assembler, int reg, uint64_t value) {
+	emit_rex(assembler, true, 0, reg);
+	lit_asm_byte(assembler, (uint8_t) (0xb8 | (reg & 7)));
+	lit_asm_u64(assembler, value);
+}
+
+void lit_asm_sse(LitAssembler* assembler, uint8_t prefix, uint8_t opcode, int xmm, int base, int32_t disp) {
+	lit_asm_byte(assembler, prefix);
+	emit_rex(assembler, false, xmm, base);
+	lit_asm_byte(assembler, 0x0f);
+	lit_asm_byte(assembler, opcode);
+	emit_operand(assembler, xmm, base, disp);
+}
+
+void lit_asm_sse_registers(LitAssembler* assembler, uint8_t prefix, uint8_t opcode, int to, int from) {
+	lit_asm_byte(assembler, prefix);
+	emit_rex(assembler, false, to, from);
+	lit_asm_byte(assembler, 0x0f);
+	lit_asm_byte(assembler, opcode);
+	emit_registers(assembler, to, from);
+}
+
+void lit_asm_to_xmm(LitAssembler* assembler, int xmm, int reg) {
+	lit_asm_byte(assembler, 0x66);
+	emit_rex(assembler, true, xmm, reg);
+	lit_asm_byte(assembler, 0x0f);
+	lit_asm_byte(assembler, 0x6e);
+	emit_registers(assembler, xmm, reg);
+}
+
+void lit_asm_from_xmm(LitAssembler* assembler, int reg, int xmm) {
+	lit_asm_byte(assembler, 0x66);
+	emit_rex(assembler, true, xmm, reg);
+	lit_asm_byte(assembler, 0x0f);
+	lit_asm_byte(assembler, 0x7e);
+	emit_registers(assembler, xmm, reg);
+}
+
+void lit_asm_check_int(LitAssembler* assembler, int reg) {
+	static const uint8_t shr_rdx_32[] = { 0x48, 0xc1, 0xea, 0x20 };
+	static const uint8_t cmp_edx[] = { 0x81, 0xfa };
+
+	lit_asm_move(assembler, RDX, reg);
+	lit_asm_bytes(assembler, shr_rdx_32, sizeof(shr_rdx_32));
+	lit_asm_bytes(assembler, cmp_edx, sizeof(cmp_edx));
+	lit_asm_u32(assembler, (uint32_t) (INT_TAG >> 32));
+}
+
+void lit_asm_unbox(LitAssembler* assembler, int xmm, int base, int32_t disp) {
+	lit_asm_load(assembler, RAX, base, disp);
+	lit_asm_check_int(assembler, RAX);
+
+	uint32_t not_int = lit_asm_jump(assembler, CONDITION_NOT_EQUAL);
+	lit_asm_sse_registers(assembler, 0xf2, CVTSI2SD, xmm, RAX);
+	uint32_t done = lit_asm_jump(assembler, CONDITION_ALWAYS);
+
+	lit_asm_patch(assembler, not_int, lit_asm_position(assembler));
+	lit_asm_to_xmm(assembler, xmm, RAX);
+	lit_asm_patch(assembler, done, lit_asm_position(assembler));
+}
+
+void lit_asm_box_int(LitAssembler* assembler, int reg, int scratch) {
+	lit_asm_immediate(assembler, scratch, INT_TAG);
+
+	// or reg, scratch
+	emit_rex(assembler, true, scratch, reg);
+	lit_asm_byte(assembler, 0x09);
+	emit_registers(assembler, scratch, reg);
+}
+
+void lit_asm_set(LitAssembler* assembler, uint8_t condition) {
+	uint8_t set_al[] = { 0x0f, (uint8_t) (0x90 | condition), 0xc0 };
+	lit_asm_bytes(assembler, set_al, sizeof(set_al));
+}
+
+void lit_asm_bool(LitAssembler* assembler, bool invert) {
+	static const uint8_t movzx_eax_al[] = { 0x0f, 0xb6, 0xc0 };
+	static const uint8_t xor_eax_1[] = { 0x83, 0xf0, 0x01 };
+	static const uint8_t add_rax_rcx[] = { 0x48, 0x01, 0xc8 };
+
+	lit_asm_bytes(assembler, movzx_eax_al, sizeof(movzx_eax_al));
+
+	if (invert) {
+		lit_asm_bytes(assembler, xor_eax_1, sizeof(xor_eax_1));
+	}
+
+	lit_asm_immediate(assembler, RCX, FALSE_VALUE);
+	lit_asm_bytes(assembler, add_rax_rcx, sizeof(add_rax_rcx));
+}
+
+void lit_asm_save(LitAssembler* assembler) {
+	static const uint8_t save[] = {
+		0x53, // push rbx
+		0x41, 0x54, // push r12
+		0x41, 0x55, // push r13
+		0x41, 0x56, // push r14
+		0x41, 0x57 // push r15, keeps the stack aligned for calls
+	};
+
+	lit_asm_bytes(assembler, save, sizeof(save));
+}
+
+void lit_asm_restore(LitAssembler* assembler) {
+	static const uint8_t restore[] = {
+		0x41, 0x5f, // pop r15
+		0x41, 0x5e, // pop r14
+		0x41, 0x5d, // pop r13
+		0x41, 0x5c, // pop r12
+		0x5b, // pop rbx
+		0xc3 // ret
+	};
+
+	lit_asm_bytes(assembler, restore, sizeof(restore));
+}
+
+void lit_asm_call(LitAssembler* assembler, void* function) {
+	static const uint8_t call_rax[] = { 0xff, 0xd0 };
+
+	lit_asm_immediate(assembler, RAX, (uint64_t) (uintptr_t) function);
+	lit_asm_bytes(assembler, call_rax, sizeof(call_rax));
+}
+
+uint32_t lit_asm_jump(LitAssembler* assembler, uint8_t condition) {
+	if (condition == CONDITION_ALWAYS) {
+		lit_asm_byte(assembler, 0xe9);
+	} else {
+		lit_asm_byte(assembler, 0x0f);
+		lit_asm_byte(assembler, (uint8_t) (0x80 | condition));
+	}
+
+	uint32_t position = lit_asm_position(assembler);
+	lit_asm_u32(assembler, 0);
+
+	return position;
+}
+
+void lit_asm_patch(LitAssembler* assembler, uint32_t position, uint32_t target) {
+	uint32_t distance = target - (position + 4);
+	memcpy(assembler->code.values + position, &distance, 4);
+}
\ No newline at end of file
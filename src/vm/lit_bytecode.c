@@ -0,0 +1,475 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <vm/lit_bytecode.h>
+#include <compiler/lit_compiler.h>
+#include <vm/lit_chunk.h>
+#include <vm/lit_memory.h>
+#include <util/lit_table.h>
+
+#define ALIGN(size) (((size) + 7) & ~((uint64_t) 7))
+
+static const uint32_t opcode_count = 0
+	#define OPCODE(name) + 1
+	#include <vm/lit_opcode.h>
+	#undef OPCODE
+;
+
+typedef struct {
+	LitMemManager* manager;
+
+	LitArray functions;
+	LitArray strings;
+	LitTable string_indices; // String to its index in strings
+} LitBytecodeWriter;
+
+static uint32_t add_string(LitBytecodeWriter* writer, LitString* string) {
+	LitValue* index = lit_table_get(&writer->string_indices, string);
+
+	if (index != NULL) {
+		return (uint32_t) AS_NUMBER(*index);
+	}
+
+	lit_array_write(writer->manager, &writer->strings, MAKE_OBJECT_VALUE(string));
+	lit_table_set(writer->manager, &writer->string_indices, string, MAKE_NUMBER_VALUE(writer->strings.count - 1));
+
+	return (uint32_t) (writer->strings.count - 1);
+}
+
+static uint32_t add_function(LitBytecodeWriter* writer, LitFunction* function) {
+	LitValue value = MAKE_OBJECT_VALUE(function);
+
+	for (int i = 0; i < writer->functions.count; i++) {
+		if (writer->functions.values[i] == value) {
+			return (uint32_t) i;
+		}
+	}
+
+	lit_array_write(writer->manager, &writer->functions, value);
+	return (uint32_t) (writer->functions.count - 1);
+}
+
+// A NULL path keeps the error silent
+static void error(const char* path, const char* message) {
+	if (path == NULL) {
+		return;
+	}
+
+	fflush(stdout);
+	fprintf(stderr, "Bytecode error in %s: %s\n", path, message);
+	fflush(stderr);
+}
+
+bool lit_serialize_bytecode(LitMemManager* manager, LitFunction* function, const char* path, bool debug, LitBytecode* bytecode) {
+	LitBytecodeWriter writer;
+
+	writer.manager = manager;
+	lit_init_array(&writer.functions);
+	lit_init_array(&writer.strings);
+	lit_init_table(&writer.string_indices);
+
+	add_function(&writer, function);
+
+	// Nested functions are found, while the list is walked, so they end up after their parent
+	for (int i = 0; i < writer.functions.count; i++) {
+		LitFunction* current = AS_FUNCTION(writer.functions.values[i]);
+
+		if (current->name != NULL) {
+			add_string(&writer, current->name);
+		}
+
+		for (int j = 0; j < current->chunk.constants.count; j++) {
+			LitValue constant = current->chunk.constants.values[j];
+
+			if (IS_FUNCTION(constant)) {
+				add_function(&writer, AS_FUNCTION(constant));
+			} else if (IS_CLOSURE(constant)) {
+				add_function(&writer, AS_CLOSURE(constant)->function);
+			} else if (IS_STRING(constant)) {
+				add_string(&writer, AS_STRING(constant));
+			}
+		}
+	}
+
+	uint64_t strings_offset = ALIGN(sizeof(LitBytecodeHeader));
+	uint64_t functions_offset = ALIGN(strings_offset + sizeof(LitBytecodeString) * writer.strings.count);
+	uint64_t size = ALIGN(functions_offset + sizeof(LitBytecodeFunction) * writer.functions.count);
+	uint64_t debug_size = 0;
+
+	for (int i = 0; i < writer.functions.count; i++) {
+		LitChunk* chunk = &AS_FUNCTION(writer.functions.values[i])->chunk;
+		size += ALIGN(sizeof(LitBytecodeConstant) * chunk->constants.count) + ALIGN(chunk->count);
+
+		if (debug) {
+			debug_size += ALIGN(chunk->line_table_size);
+		}
+	}
+
+	for (int i = 0; i < writer.strings.count; i++) {
+		size += AS_STRING(writer.strings.values[i])->length + 1;
+	}
+
+	uint64_t debug_offset = ALIGN(size);
+	size = debug_offset + debug_size;
+
+	uint8_t* data = ALLOCATE(manager, uint8_t, size);
+	memset(data, 0, size);
+
+	LitBytecodeHeader* header = (LitBytecodeHeader*) data;
+
+	memcpy(header->magic, LIT_BYTECODE_MAGIC, 4);
+	header->version = LIT_BYTECODE_VERSION;
+	header->opcode_count = opcode_count;
+	header->string_count = (uint32_t) writer.strings.count;
+	header->function_count = (uint32_t) writer.functions.count;
+	header->size = size;
+	header->strings_offset = strings_offset;
+	header->functions_offset = functions_offset;
+	header->debug_offset = debug_offset;
+	header->debug_size = debug_size;
+
+	uint64_t position = ALIGN(functions_offset + sizeof(LitBytecodeFunction) * writer.functions.count);
+
+	for (int i = 0; i < writer.functions.count; i++) {
+		LitFunction* current = AS_FUNCTION(writer.functions.values[i]);
+		LitChunk* chunk = &current->chunk;
+		LitBytecodeFunction* entry = &((LitBytecodeFunction*) (data + functions_offset))[i];
+
+		entry->arity = current->arity;
+		entry->upvalue_count = current->upvalue_count;
+		entry->name = current->name == NULL ? -1 : (int32_t) add_string(&writer, current->name);
+		entry->constant_count = (uint32_t) chunk->constants.count;
+		entry->constants_offset = position;
+
+		LitBytecodeConstant* constants = (LitBytecodeConstant*) (data + position);
+
+		for (int j = 0; j < chunk->constants.count; j++) {
+			LitValue constant = chunk->constants.values[j];
+
+			if (IS_FUNCTION(constant)) {
+				constants[j].type = BYTECODE_FUNCTION;
+				constants[j].index = add_function(&writer, AS_FUNCTION(constant));
+			} else if (IS_CLOSURE(constant) && AS_CLOSURE(constant)->upvalue_count == 0) {
+				constants[j].type = BYTECODE_CLOSURE;
+				constants[j].index = add_function(&writer, AS_CLOSURE(constant)->function);
+			} else if (IS_STRING(constant)) {
+				constants[j].type = BYTECODE_STRING;
+				constants[j].index = add_string(&writer, AS_STRING(constant));
+			} else if (IS_OBJECT(constant)) {
+				error(path, "only strings, functions and closures without upvalues can be saved as constants");
+
+				FREE_ARRAY(manager, uint8_t, data, size);
+				lit_free_array(manager, &writer.functions);
+				lit_free_array(manager, &writer.strings);
+				lit_free_table(manager, &writer.string_indices);
+
+				return false;
+			} else {
+				constants[j].type = BYTECODE_VALUE;
+				constants[j].value = constant;
+			}
+		}
+
+		position += ALIGN(sizeof(LitBytecodeConstant) * chunk->constants.count);
+
+		entry->code_offset = position;
+		entry->code_count = chunk->count;
+		memcpy(data + position, chunk->code, chunk->count);
+		position += ALIGN(chunk->count);
+	}
+
+	LitBytecodeString* strings = (LitBytecodeString*) (data + strings_offset);
+
+	for (int i = 0; i < writer.strings.count; i++) {
+		LitString* string = AS_STRING(writer.strings.values[i]);
+
+		strings[i].offset = (uint32_t) position;
+		strings[i].length = (uint32_t) string->length;
+
+		memcpy(data + position, string->chars, (size_t) string->length);
+		position += string->length + 1;
+	}
+
+	uint64_t debug_position = debug_offset;
+
+	for (int i = 0; debug && i < writer.functions.count; i++) {
+		LitChunk* chunk = &AS_FUNCTION(writer.functions.values[i])->chunk;
+		LitBytecodeFunction* entry = &((LitBytecodeFunction*) (data + functions_offset))[i];
+
+		entry->lines_offset = debug_position;
+		entry->lines_size = chunk->line_table_size;
+
+		if (chunk->line_table != NULL) {
+			memcpy(data + debug_position, chunk->line_table, chunk->line_table_size);
+		}
+
+		debug_position += ALIGN(chunk->line_table_size);
+	}
+
+	lit_free_array(manager, &writer.functions);
+	lit_free_array(manager, &writer.strings);
+	lit_free_table(manager, &writer.string_indices);
+
+	bytecode->data = data;
+	bytecode->size = (size_t) size;
+
+	return true;
+}
+
+void lit_free_serialized_bytecode(LitMemManager* manager, LitBytecode* bytecode) {
+	FREE_ARRAY(manager, uint8_t, bytecode->data, bytecode->size);
+
+	bytecode->data = NULL;
+	bytecode->size = 0;
+}
+
+// The errors are reported under the report path, that may be NULL
+static bool save_bytecode(LitMemManager* manager, LitFunction* function, const char* path, const char* report, bool debug) {
+	LitBytecode bytecode;
+
+	if (!lit_serialize_bytecode(manager, function, report, debug, &bytecode)) {
+		return false;
+	}
+
+	FILE* file = fopen(path, "wb");
+	bool written = file != NULL && fwrite(bytecode.data, 1, bytecode.size, file) == bytecode.size;
+
+	if (file != NULL && fclose(file) != 0) {
+		written = false;
+	}
+
+	if (!written) {
+		error(report, "could not write the file");
+	}
+
+	lit_free_serialized_bytecode(manager, &bytecode);
+	return written;
+}
+
+bool lit_save_bytecode(LitMemManager* manager, LitFunction* function, const char* path, bool debug) {
+	return save_bytecode(manager, function, path, path, debug);
+}
+
+#define FNV_OFFSET 14695981039346656037UL
+#define FNV_PRIME 1099511628211UL
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+	const uint8_t* bytes = (const uint8_t*) data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+uint64_t lit_bytecode_key(const char* source_code, LitOptions* options) {
+	uint32_t version[] = { LIT_BYTECODE_VERSION, opcode_count, options->optimize, (uint32_t) options->inline_limit };
+	uint64_t hash = hash_bytes(FNV_OFFSET, version, sizeof(version));
+
+	// The executable stands for the compiler version, every link gives it another inode, size or time
+	struct stat executable;
+
+	if (stat("/proc/self/exe", &executable) == 0) {
+		uint64_t build[] = { (uint64_t) executable.st_ino, (uint64_t) executable.st_size, (uint64_t) executable.st_mtime };
+		hash = hash_bytes(hash, build, sizeof(build));
+	} else {
+		static const char* build = __DATE__ " " __TIME__;
+		hash = hash_bytes(hash, build, strlen(build));
+	}
+
+	return hash_bytes(hash, source_code, strlen(source_code));
+}
+
+bool lit_save_bytecode_atomic(LitMemManager* manager, LitFunction* function, const char* path, bool debug) {
+	size_t length = strlen(path) + 48;
+	char* temporary = ALLOCATE(manager, char, length);
+
+	// Other processes and other threads, that save the same file, write their own copy
+	snprintf(temporary, length, "%s.%d.%lx.tmp", path, (int) getpid(), (unsigned long) (uintptr_t) manager);
+	bool saved = save_bytecode(manager, function, temporary, NULL, debug) && rename(temporary, path) == 0;
+
+	if (!saved) {
+		unlink(temporary);
+	}
+
+	FREE_ARRAY(manager, char, temporary, length);
+	return saved;
+}
+
+bool lit_map_bytecode(LitBytecode* bytecode, const char* path, bool report) {
+	const char* report_path = report ? path : NULL;
+
+	bytecode->data = NULL;
+	bytecode->size = 0;
+
+	int file = open(path, O_RDONLY);
+
+	if (file == -1) {
+		error(report_path, "could not open the file");
+		return false;
+	}
+
+	struct stat info;
+
+	if (fstat(file, &info) != 0 || (size_t) info.st_size < sizeof(LitBytecodeHeader)) {
+		close(file);
+		error(report_path, "the file is too small");
+
+		return false;
+	}
+
+	void* data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+
+	if (data == MAP_FAILED) {
+		error(report_path, "could not map the file");
+		return false;
+	}
+
+	bytecode->data = (uint8_t*) data;
+	bytecode->size = (size_t) info.st_size;
+
+	return true;
+}
+
+void lit_unmap_bytecode(LitBytecode* bytecode) {
+	if (bytecode->data != NULL) {
+		munmap(bytecode->data, bytecode->size);
+	}
+
+	bytecode->data = NULL;
+	bytecode->size = 0;
+}
+
+static bool in_bounds(LitBytecode* bytecode, uint64_t offset, uint64_t count, uint64_t size) {
+	return offset <= bytecode->size && count <= (bytecode->size - offset) / size;
+}
+
+// Checks, that everything points inside of the file, the code itself is trusted
+// Line tables are only checked to be inside of the debug section, so that their pages aren't touched
+static bool validate(LitBytecode* bytecode) {
+	LitBytecodeHeader* header = (LitBytecodeHeader*) bytecode->data;
+
+	if (memcmp(header->magic, LIT_BYTECODE_MAGIC, 4) != 0 || header->version != LIT_BYTECODE_VERSION || header->opcode_count != opcode_count) {
+		return false;
+	}
+
+	if (header->size != bytecode->size || header->function_count == 0
+		|| !in_bounds(bytecode, header->strings_offset, header->string_count, sizeof(LitBytecodeString))
+		|| !in_bounds(bytecode, header->functions_offset, header->function_count, sizeof(LitBytecodeFunction))
+		|| !in_bounds(bytecode, header->debug_offset, header->debug_size, 1)) {
+
+		return false;
+	}
+
+	LitBytecodeString* strings = (LitBytecodeString*) (bytecode->data + header->strings_offset);
+
+	for (uint32_t i = 0; i < header->string_count; i++) {
+		// The terminating zero has to be there too
+		if (!in_bounds(bytecode, strings[i].offset, (uint64_t) strings[i].length + 1, 1)) {
+			return false;
+		}
+	}
+
+	LitBytecodeFunction* functions = (LitBytecodeFunction*) (bytecode->data + header->functions_offset);
+
+	for (uint32_t i = 0; i < header->function_count; i++) {
+		LitBytecodeFunction* function = &functions[i];
+
+		bool lines_in_bounds = function->lines_size == 0 || (function->lines_offset >= header->debug_offset
+			&& function->lines_offset - header->debug_offset <= header->debug_size
+			&& function->lines_size <= header->debug_size - (function->lines_offset - header->debug_offset));
+
+		if (function->lines_offset % sizeof(uint64_t) != 0 || function->constants_offset % sizeof(uint64_t) != 0
+			|| function->name >= (int32_t) header->string_count || function->constant_count > UINT8_COUNT
+			|| !in_bounds(bytecode, function->code_offset, function->code_count, 1) || !lines_in_bounds
+			|| !in_bounds(bytecode, function->constants_offset, function->constant_count, sizeof(LitBytecodeConstant))) {
+
+			return false;
+		}
+
+		LitBytecodeConstant* constants = (LitBytecodeConstant*) (bytecode->data + function->constants_offset);
+
+		for (uint32_t j = 0; j < function->constant_count; j++) {
+			LitBytecodeConstant* constant = &constants[j];
+
+			if ((constant->type == BYTECODE_STRING && constant->index >= header->string_count)
+				|| (constant->type == BYTECODE_FUNCTION && (constant->index >= header->function_count || constant->index == 0))
+				|| (constant->type == BYTECODE_CLOSURE && (constant->index >= header->function_count || constant->index == 0 || functions[constant->index].upvalue_count != 0))
+				|| (constant->type == BYTECODE_VALUE && IS_OBJECT(constant->value))
+				|| constant->type > BYTECODE_CLOSURE) {
+
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+LitFunction* lit_load_bytecode(LitMemManager* manager, LitBytecode* bytecode) {
+	if (bytecode->size < sizeof(LitBytecodeHeader) || !validate(bytecode)) {
+		return NULL;
+	}
+
+	LitBytecodeHeader* header = (LitBytecodeHeader*) bytecode->data;
+	LitBytecodeString* strings = (LitBytecodeString*) (bytecode->data + header->strings_offset);
+	LitBytecodeFunction* entries = (LitBytecodeFunction*) (bytecode->data + header->functions_offset);
+
+	// Strings are interned, so that they are the same objects, as the ones the vm makes
+	LitString** loaded_strings = ALLOCATE(manager, LitString*, header->string_count);
+
+	for (uint32_t i = 0; i < header->string_count; i++) {
+		loaded_strings[i] = lit_copy_string(manager, (const char*) bytecode->data + strings[i].offset, strings[i].length);
+	}
+
+	LitFunction** functions = ALLOCATE(manager, LitFunction*, header->function_count);
+
+	for (uint32_t i = 0; i < header->function_count; i++) {
+		functions[i] = lit_new_function(manager);
+	}
+
+	for (uint32_t i = 0; i < header->function_count; i++) {
+		LitBytecodeFunction* entry = &entries[i];
+		LitFunction* function = functions[i];
+		LitChunk* chunk = &function->chunk;
+
+		function->arity = entry->arity;
+		function->upvalue_count = entry->upvalue_count;
+		function->name = entry->name == -1 ? NULL : loaded_strings[entry->name];
+
+		// Zero capacity tells the chunk, that it doesn't own the code and the line table
+		chunk->code = bytecode->data + entry->code_offset;
+		chunk->count = entry->code_count;
+		chunk->line_table = entry->lines_size == 0 ? NULL : bytecode->data + entry->lines_offset;
+		chunk->line_table_size = entry->lines_size;
+
+		LitBytecodeConstant* constants = (LitBytecodeConstant*) (bytecode->data + entry->constants_offset);
+
+		for (uint32_t j = 0; j < entry->constant_count; j++) {
+			LitBytecodeConstant* constant = &constants[j];
+			LitValue value;
+
+			switch (constant->type) {
+				case BYTECODE_STRING: value = MAKE_OBJECT_VALUE(loaded_strings[constant->index]); break;
+				case BYTECODE_FUNCTION: value = MAKE_OBJECT_VALUE(functions[constant->index]); break;
+				case BYTECODE_CLOSURE: value = MAKE_OBJECT_VALUE(lit_new_closure(manager, functions[constant->index])); break;
+				default: value = constant->value; break;
+			}
+
+			lit_array_write(manager, &chunk->constants, value);
+		}
+	}
+
+	LitFunction* script = functions[0];
+
+	FREE_ARRAY(manager, LitString*, loaded_strings, header->string_count);
+	FREE_ARRAY(manager, LitFunction*, functions, header->function_count);
+
+	return script;
+}
\ No newline at end of file
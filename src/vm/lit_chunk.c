@@ -2,21 +2,36 @@
 
 #include <vm/lit_chunk.h>
 #include <vm/lit_memory.h>
+#include <vm/lit_object.h>
 
 void lit_init_chunk(LitChunk* chunk) {
 	chunk->count = 0;
 	chunk->capacity = 0;
 	chunk->code = NULL;
+	chunk->threaded = NULL;
 	chunk->line_count = 0;
 	chunk->line_capacity = 0;
 	chunk->lines = NULL;
+	chunk->line_table = NULL;
+	chunk->line_table_size = 0;
 
 	lit_init_array(&chunk->constants);
 }
 
 void lit_free_chunk(LitMemManager* manager, LitChunk* chunk) {
-	FREE_ARRAY(manager, uint8_t , chunk->code, chunk->capacity);
-	FREE_ARRAY(manager, uint64_t , chunk->lines, chunk->line_capacity);
+	// Chunks, loaded from bytecode, point into the mapped file, and don't own the code and the line table
+	if (chunk->capacity != 0) {
+		FREE_ARRAY(manager, uint8_t , chunk->code, chunk->capacity);
+		FREE_ARRAY(manager, uint8_t, chunk->line_table, chunk->line_table_size);
+	}
+
+	if (chunk->line_capacity != 0) {
+		FREE_ARRAY(manager, uint64_t , chunk->lines, chunk->line_capacity);
+	}
+
+	if (chunk->threaded != NULL) {
+		FREE_ARRAY(manager, LitThreadedInstruction, chunk->threaded, chunk->count + 1);
+	}
 
 	lit_free_array(manager, &chunk->constants);
 	lit_init_chunk(chunk);
@@ -52,19 +67,242 @@ int lit_chunk_add_constant(LitMemManager* manager, LitChunk* chunk, LitValue con
 	return chunk->constants.count - 1;
 }
 
+static uint64_t varint_size(uint64_t value) {
+	uint64_t size = 1;
+
+	while (value >= 0x80) {
+		value >>= 7;
+		size++;
+	}
+
+	return size;
+}
+
+static uint64_t write_varint(uint8_t* to, uint64_t value) {
+	uint64_t size = 0;
+
+	while (value >= 0x80) {
+		to[size++] = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+
+	to[size++] = (uint8_t) value;
+	return size;
+}
+
+// The table might come from a file, so nothing is read past its end
+static bool read_varint(const uint8_t** from, const uint8_t* end, uint64_t* value) {
+	uint64_t result = 0;
+
+	for (int shift = 0; *from < end && shift < 64; shift += 7) {
+		uint8_t byte = *(*from)++;
+		result |= (uint64_t) (byte & 0x7f) << shift;
+
+		if ((byte & 0x80) == 0) {
+			*value = result;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static uint64_t zigzag(int64_t value) {
+	return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+void lit_chunk_pack_lines(LitMemManager* manager, LitChunk* chunk) {
+	uint32_t run_count = (uint32_t) (chunk->line_count / 2);
+	uint32_t checkpoint_count = (run_count + LIT_LINE_CHECKPOINT - 1) / LIT_LINE_CHECKPOINT;
+	uint64_t runs_size = 0;
+	uint64_t previous = 0;
+
+	for (uint64_t i = 0; i < chunk->line_count; i += 2) {
+		runs_size += varint_size(chunk->lines[i]) + varint_size(zigzag((int64_t) (chunk->lines[i + 1] - previous)));
+		previous = chunk->lines[i + 1];
+	}
+
+	uint64_t runs_start = sizeof(LitLineTableHeader) + sizeof(LitLineCheckpoint) * checkpoint_count;
+	uint64_t size = runs_start + runs_size;
+	uint8_t* table = ALLOCATE(manager, uint8_t, size);
+
+	LitLineTableHeader* header = (LitLineTableHeader*) table;
+	LitLineCheckpoint* checkpoints = (LitLineCheckpoint*) (table + sizeof(LitLineTableHeader));
+
+	header->run_count = run_count;
+	header->checkpoint_count = checkpoint_count;
+
+	uint64_t position = 0;
+	uint64_t offset = 0;
+	previous = 0;
+
+	for (uint32_t run = 0; run < run_count; run++) {
+		uint64_t length = chunk->lines[run * 2];
+		uint64_t line = chunk->lines[run * 2 + 1];
+
+		if (run % LIT_LINE_CHECKPOINT == 0) {
+			LitLineCheckpoint* checkpoint = &checkpoints[run / LIT_LINE_CHECKPOINT];
+
+			checkpoint->offset = (uint32_t) offset;
+			checkpoint->line = (uint32_t) previous;
+			checkpoint->position = (uint32_t) position;
+		}
+
+		position += write_varint(table + runs_start + position, length);
+		position += write_varint(table + runs_start + position, zigzag((int64_t) (line - previous)));
+
+		offset += length;
+		previous = line;
+	}
+
+	FREE_ARRAY(manager, uint64_t, chunk->lines, chunk->line_capacity);
+
+	chunk->lines = NULL;
+	chunk->line_count = 0;
+	chunk->line_capacity = 0;
+	chunk->line_table = table;
+	chunk->line_table_size = size;
+}
+
+static uint64_t find_packed_line(LitChunk* chunk, uint64_t offset) {
+	if (chunk->line_table_size < sizeof(LitLineTableHeader)) {
+		return 0;
+	}
+
+	LitLineTableHeader* header = (LitLineTableHeader*) chunk->line_table;
+	LitLineCheckpoint* checkpoints = (LitLineCheckpoint*) (chunk->line_table + sizeof(LitLineTableHeader));
+	uint64_t runs_start = sizeof(LitLineTableHeader) + sizeof(LitLineCheckpoint) * (uint64_t) header->checkpoint_count;
+
+	if (header->checkpoint_count == 0 || runs_start > chunk->line_table_size) {
+		return 0;
+	}
+
+	// The last checkpoint, that starts at or before the offset
+	uint32_t low = 0;
+	uint32_t high = header->checkpoint_count - 1;
+
+	while (low < high) {
+		uint32_t middle = low + (high - low + 1) / 2;
+
+		if (checkpoints[middle].offset <= offset) {
+			low = middle;
+		} else {
+			high = middle - 1;
+		}
+	}
+
+	LitLineCheckpoint* checkpoint = &checkpoints[low];
+
+	if (checkpoint->position > chunk->line_table_size - runs_start) {
+		return 0;
+	}
+
+	const uint8_t* current = chunk->line_table + runs_start + checkpoint->position;
+	const uint8_t* end = chunk->line_table + chunk->line_table_size;
+
+	uint64_t start = checkpoint->offset;
+	int64_t line = checkpoint->line;
+
+	for (int i = 0; i < LIT_LINE_CHECKPOINT; i++) {
+		uint64_t length;
+		uint64_t delta;
+
+		if (!read_varint(&current, end, &length) || !read_varint(&current, end, &delta)) {
+			break;
+		}
+
+		line += unzigzag(delta);
+
+		if (offset < start + length) {
+			return (uint64_t) line;
+		}
+
+		start += length;
+	}
+
+	return 0;
+}
+
 uint64_t lit_chunk_get_line(LitChunk* chunk, uint64_t offset) {
-	uint64_t i = 0;
+	if (chunk->line_table != NULL) {
+		return find_packed_line(chunk, offset);
+	}
+
 	uint64_t total = 0;
 
-	while (i < chunk->line_count) {
+	for (uint64_t i = 0; i < chunk->line_count; i += 2) {
 		total += chunk->lines[i];
 
-		if (total >= offset) {
+		if (offset < total) {
 			return chunk->lines[i + 1];
 		}
-
-		i += 2;
 	}
 
 	return 0;
+}
+
+uint64_t lit_chunk_instruction_size(LitChunk* chunk, uint64_t offset) {
+	LitOpCode opcode = (LitOpCode) chunk->code[offset];
+
+	if (opcode == OP_CLOSURE) {
+		// Each upvalue has is local flag and index bytes
+		LitFunction* function = AS_FUNCTION(chunk->constants.values[chunk->code[offset + 1]]);
+		return 2 + function->upvalue_count * 2;
+	}
+
+	return lit_opcode_size(opcode);
+}
+
+void lit_chunk_thread(LitMemManager* manager, LitChunk* chunk, void** handlers) {
+	LitThreadedInstruction* threaded = ALLOCATE(manager, LitThreadedInstruction, chunk->count + 1);
+	LitValue* constants = chunk->constants.values;
+
+	for (uint64_t offset = 0; offset < chunk->count; offset += lit_chunk_instruction_size(chunk, offset)) {
+		uint8_t* ip = chunk->code + offset;
+		LitThreadedInstruction* instruction = &threaded[offset];
+
+		instruction->handler = handlers[*ip];
+
+		switch ((LitOpCode) *ip) {
+			case OP_CONSTANT: case OP_DEFINE_GLOBAL: case OP_GET_GLOBAL: case OP_SET_GLOBAL:
+			case OP_CLASS: case OP_SUBCLASS: case OP_METHOD: case OP_GET_FIELD: case OP_SET_FIELD:
+			case OP_DEFINE_FIELD: case OP_DEFINE_METHOD: case OP_DEFINE_STATIC_FIELD: case OP_DEFINE_STATIC_METHOD:
+			case OP_SUPER: case OP_CLOSURE: {
+				instruction->operand.constant = constants[ip[1]];
+				break;
+			}
+
+			case OP_GET_LOCAL: case OP_SET_LOCAL: case OP_GET_UPVALUE: case OP_SET_UPVALUE:
+			case OP_CALL: case OP_TAIL_CALL: case OP_INVOKE: {
+				instruction->operand.index = ip[1];
+				break;
+			}
+
+			case OP_JUMP: case OP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE: {
+				instruction->operand.target = &threaded[offset + 3 + (uint16_t) ((ip[1] << 8) | ip[2])];
+				break;
+			}
+
+			case OP_LOOP: {
+				instruction->operand.target = &threaded[offset + 3 - (uint16_t) ((ip[1] << 8) | ip[2])];
+				break;
+			}
+
+			case OP_CALL_DIRECT: case OP_TAIL_CALL_DIRECT: case OP_INVOKE_DIRECT: {
+				instruction->operand.constant = constants[ip[1]];
+				threaded[offset + 1].operand.index = ip[2];
+
+				break;
+			}
+
+			default: break;
+		}
+	}
+
+	threaded[chunk->count].handler = handlers[OP_RETURN];
+	chunk->threaded = threaded;
 }
\ No newline at end of file
@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <vm/lit_feedback.h>
+#include <vm/lit_vm.h>
+#include <vm/lit_memory.h>
+
+#define PROFILE_HEADER "# lit profile: offset, instruction, types, taken, not taken, megamorphic, receiver classes"
+#define SECTION_FUNCTIONS 64 // Most functions with the same name and code, that a section of the profile is merged into
+
+static const char* opcode_names[] = {
+#define OPCODE(name) #name,
+#include <vm/lit_opcode.h>
+#undef OPCODE
+};
+
+bool lit_is_profiled(LitOpCode opcode) {
+	switch (opcode) {
+		case OP_GET_FIELD: case OP_INVOKE: case OP_CALL: case OP_TAIL_CALL:
+		case OP_NEGATE: case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE:
+		case OP_MODULO: case OP_POWER: case OP_ROOT: case OP_EQUAL: case OP_NOT_EQUAL:
+		case OP_GREATER: case OP_LESS: case OP_GREATER_EQUAL: case OP_LESS_EQUAL:
+		case OP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE: return true;
+		default: return false;
+	}
+}
+
+LitFeedbackType lit_feedback_type(LitValue value) {
+	if (IS_INT(value)) {
+		return FEEDBACK_INT;
+	} else if (IS_DOUBLE(value)) {
+		return FEEDBACK_DOUBLE;
+	} else if (IS_BOOL(value)) {
+		return FEEDBACK_BOOL;
+	} else if (IS_NIL(value)) {
+		return FEEDBACK_NIL;
+	} else if (!IS_OBJECT(value)) {
+		return FEEDBACK_OTHER;
+	}
+
+	switch (OBJECT_TYPE(value)) {
+		case OBJECT_STRING: return FEEDBACK_STRING;
+		case OBJECT_INSTANCE: return FEEDBACK_INSTANCE;
+		case OBJECT_CLASS: return FEEDBACK_CLASS;
+		case OBJECT_CLOSURE: return FEEDBACK_CLOSURE;
+		case OBJECT_NATIVE: case OBJECT_NATIVE_METHOD: return FEEDBACK_NATIVE;
+		case OBJECT_BOUND_METHOD: return FEEDBACK_BOUND_METHOD;
+		default: return FEEDBACK_OTHER;
+	}
+}
+
+static uint64_t hash_code(LitChunk* chunk) {
+	uint64_t hash = 14695981039346656037u;
+
+	for (uint64_t i = 0; i < chunk->count; i++) {
+		hash = (hash ^ chunk->code[i]) * 1099511628211u;
+	}
+
+	return hash;
+}
+
+static const char* function_name(LitFunction* function) {
+	return function->name == NULL ? "top-level" : function->name->chars;
+}
+
+static LitFeedback* create_feedback(LitMemManager* manager, LitFunction* function) {
+	LitChunk* chunk = &function->chunk;
+	uint32_t slot_count = 0;
+
+	for (uint64_t offset = 0; offset < chunk->count; offset += lit_chunk_instruction_size(chunk, offset)) {
+		if (lit_is_profiled((LitOpCode) chunk->code[offset])) {
+			slot_count++;
+		}
+	}
+
+	LitFeedback* feedback = ALLOCATE(manager, LitFeedback, 1);
+
+	feedback->slots = ALLOCATE(manager, LitFeedbackSlot, slot_count);
+	feedback->slot_count = slot_count;
+	feedback->index = ALLOCATE(manager, uint32_t, chunk->count);
+	feedback->code_count = chunk->count;
+
+	memset(feedback->index, 0xff, sizeof(uint32_t) * chunk->count);
+	uint32_t slot = 0;
+
+	for (uint64_t offset = 0; offset < chunk->count; offset += lit_chunk_instruction_size(chunk, offset)) {
+		if (lit_is_profiled((LitOpCode) chunk->code[offset])) {
+			memset(&feedback->slots[slot], 0, sizeof(LitFeedbackSlot));
+			feedback->slots[slot].offset = (uint32_t) offset;
+			feedback->index[offset] = slot++;
+		}
+	}
+
+	function->feedback = feedback;
+	return feedback;
+}
+
+LitFeedbackSlot* lit_get_feedback(LitFunction* function, uint64_t offset) {
+	LitFeedback* feedback = function->feedback;
+
+	if (feedback == NULL || offset >= feedback->code_count || feedback->index[offset] == UINT32_MAX) {
+		return NULL;
+	}
+
+	return &feedback->slots[feedback->index[offset]];
+}
+
+static void observe_class(LitFeedbackSlot* slot, LitString* name) {
+	for (uint8_t i = 0; i < slot->class_count; i++) {
+		if (slot->classes[i] == name) {
+			return;
+		}
+	}
+
+	if (slot->class_count < LIT_FEEDBACK_CLASSES) {
+		slot->classes[slot->class_count++] = name;
+	} else {
+		slot->megamorphic = true;
+	}
+}
+
+// Picks the class, that the field is looked up in, the same way OP_GET_FIELD does
+static void observe_receiver(LitVm* vm, LitFeedbackSlot* slot, LitValue receiver) {
+	LitFeedbackType type = lit_feedback_type(receiver);
+	LitClass* class = NULL;
+
+	slot->types |= type;
+
+	switch (type) {
+		case FEEDBACK_INSTANCE: class = AS_INSTANCE(receiver)->type; break;
+		case FEEDBACK_CLASS: class = AS_CLASS(receiver); break;
+		case FEEDBACK_STRING: class = vm->string_class; break;
+		case FEEDBACK_INT: class = vm->int_class; break;
+		case FEEDBACK_DOUBLE: class = vm->double_class; break;
+		default: break;
+	}
+
+	if (class != NULL) {
+		observe_class(slot, class->name);
+	}
+}
+
+void lit_feedback_record(LitVm* vm, LitFunction* function, uint64_t offset) {
+	LitFeedbackSlot* slot = lit_get_feedback(function, offset);
+
+	if (slot == NULL) {
+		create_feedback(MM(vm), function);
+		slot = lit_get_feedback(function, offset);
+	}
+
+	uint8_t* ip = function->chunk.code + offset;
+	LitValue* top = vm->stack_top;
+
+	switch ((LitOpCode) *ip) {
+		case OP_GET_FIELD: observe_receiver(vm, slot, top[-1]); break;
+		case OP_INVOKE: observe_receiver(vm, slot, top[-2 - ip[1]]); break;
+		case OP_CALL: case OP_TAIL_CALL: slot->types |= lit_feedback_type(top[-1 - ip[1]]); break;
+		case OP_NEGATE: slot->types |= lit_feedback_type(top[-1]); break;
+
+		case OP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE: {
+			if (lit_is_false(top[-1]) == (*ip == OP_JUMP_IF_FALSE)) {
+				slot->taken++;
+			} else {
+				slot->not_taken++;
+			}
+
+			break;
+		}
+
+		default: {
+			slot->types |= lit_feedback_type(top[-1]) | lit_feedback_type(top[-2]);
+			break;
+		}
+	}
+}
+
+void lit_gray_feedback(LitVm* vm, LitFunction* function) {
+	LitFeedback* feedback = function->feedback;
+
+	if (feedback == NULL) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < feedback->slot_count; i++) {
+		for (uint8_t j = 0; j < feedback->slots[i].class_count; j++) {
+			lit_gray_object(vm, (LitObject*) feedback->slots[i].classes[j]);
+		}
+	}
+}
+
+void lit_free_feedback(LitMemManager* manager, LitFunction* function) {
+	LitFeedback* feedback = function->feedback;
+
+	if (feedback == NULL) {
+		return;
+	}
+
+	FREE_ARRAY(manager, LitFeedbackSlot, feedback->slots, feedback->slot_count);
+	FREE_ARRAY(manager, uint32_t, feedback->index, feedback->code_count);
+	FREE(manager, LitFeedback, feedback);
+
+	function->feedback = NULL;
+}
+
+// Merges a slot line of the profile into the feedback of the function
+static void load_slot(LitVm* vm, LitFunction* function, char* line) {
+	unsigned long offset;
+	char opcode[32];
+	unsigned int types, taken, not_taken, megamorphic, class_count;
+	int read;
+
+	if (sscanf(line, "%lu %31s %x %u %u %u %u%n", &offset, opcode, &types, &taken, &not_taken, &megamorphic, &class_count, &read) != 7) {
+		return;
+	}
+
+	LitChunk* chunk = &function->chunk;
+
+	if (offset >= chunk->count || !lit_is_profiled((LitOpCode) chunk->code[offset]) || strcmp(opcode_names[chunk->code[offset]], opcode) != 0) {
+		return;
+	}
+
+	if (function->feedback == NULL) {
+		create_feedback(MM(vm), function);
+	}
+
+	LitFeedbackSlot* slot = lit_get_feedback(function, offset);
+
+	// A line, that is no instruction start, would be a broken file
+	if (slot == NULL) {
+		return;
+	}
+
+	slot->types |= (uint16_t) types;
+	slot->taken += taken;
+	slot->not_taken += not_taken;
+	slot->megamorphic |= megamorphic != 0;
+
+	char* names = line + read;
+	char name[256];
+
+	for (unsigned int i = 0; i < class_count && sscanf(names, "%255s%n", name, &read) == 1; i++) {
+		names += read;
+		observe_class(slot, lit_copy_string(MM(vm), name, (int) strlen(name)));
+	}
+}
+
+void lit_load_profile(LitVm* vm, const char* path) {
+	FILE* file = fopen(path, "r");
+
+	if (file == NULL) {
+		return;
+	}
+
+	// The functions, that the current section of the file belongs to, names are not unique
+	LitFunction* functions[SECTION_FUNCTIONS];
+	int function_count = 0;
+	char line[4096];
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char name[256];
+		unsigned long long hash;
+		unsigned long code_count;
+
+		if (line[0] == '#') {
+			continue;
+		} else if (sscanf(line, "function %255s %llx %lu", name, &hash, &code_count) == 3) {
+			function_count = 0;
+
+			for (LitObject* object = MM(vm)->objects; object != NULL && function_count < SECTION_FUNCTIONS; object = object->next) {
+				if (object->type == OBJECT_FUNCTION) {
+					LitFunction* function = (LitFunction*) object;
+
+					if (function->chunk.count == code_count && strcmp(function_name(function), name) == 0 && hash_code(&function->chunk) == hash) {
+						functions[function_count++] = function;
+					}
+				}
+			}
+		} else {
+			for (int i = 0; i < function_count; i++) {
+				load_slot(vm, functions[i], line);
+			}
+		}
+	}
+
+	fclose(file);
+}
+
+bool lit_save_profile(LitVm* vm, const char* path) {
+	FILE* file = fopen(path, "w");
+
+	if (file == NULL) {
+		return false;
+	}
+
+	fprintf(file, "%s\n", PROFILE_HEADER);
+
+	for (LitObject* object = MM(vm)->objects; object != NULL; object = object->next) {
+		if (object->type != OBJECT_FUNCTION || ((LitFunction*) object)->feedback == NULL) {
+			continue;
+		}
+
+		LitFunction* function = (LitFunction*) object;
+		LitFeedback* feedback = function->feedback;
+
+		fprintf(file, "function %s %llx %lu\n", function_name(function), (unsigned long long) hash_code(&function->chunk), (unsigned long) function->chunk.count);
+
+		for (uint32_t i = 0; i < feedback->slot_count; i++) {
+			LitFeedbackSlot* slot = &feedback->slots[i];
+
+			// Instructions, that never ran, are left out
+			if (slot->types == 0 && slot->taken == 0 && slot->not_taken == 0) {
+				continue;
+			}
+
+			fprintf(file, "\t%u %s %x %u %u %d %d", slot->offset, opcode_names[function->chunk.code[slot->offset]], slot->types, slot->taken, slot->not_taken, slot->megamorphic, slot->class_count);
+
+			for (uint8_t j = 0; j < slot->class_count; j++) {
+				fprintf(file, " %s", slot->classes[j]->chars);
+			}
+
+			fprintf(file, "\n");
+		}
+	}
+
+	return fclose(file) == 0;
+}
\ No newline at end of file
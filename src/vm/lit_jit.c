@@ -0,0 +1,480 @@
+#include <stddef.h>
+#include <math.h>
+
+#include <vm/lit_jit.h>
+#include <vm/lit_trace.h>
+#include <vm/lit_assembler.h>
+#include <vm/lit_memory.h>
+#include <vm/lit_object.h>
+
+/*
+ * The native code keeps the vm state in callee saved registers:
+ * rbx is the stack top, r12 the vm, r13 the slots of the frame and r14 the frame
+ * The stack top is written back to the vm, before a helper is called and when the code is left
+ */
+
+#define XMM0 0
+#define XMM1 1
+
+typedef void (*LitJitEntry)(LitVm* vm, LitFrame* frame, uint8_t* target);
+
+typedef struct {
+	uint32_t position; // Where the rel32 of the jump is
+	uint32_t target; // Bytecode offset
+} LitJitPatch;
+
+DECLARE_ARRAY(LitJitPatches, LitJitPatch, jit_patches)
+DEFINE_ARRAY(LitJitPatches, LitJitPatch, jit_patches)
+
+typedef struct {
+	LitVm* vm;
+	LitFunction* function;
+	LitChunk* chunk;
+
+	LitAssembler assembler;
+	LitJitPatches patches;
+	uint32_t epilogue;
+} LitJit;
+
+static void emit_push_slot(LitAssembler* assembler) {
+	static const uint8_t add_rbx[] = { 0x48, 0x83, 0xc3, 0x08 };
+	lit_asm_bytes(assembler, add_rbx, sizeof(add_rbx));
+}
+
+static void emit_pop_slot(LitAssembler* assembler) {
+	static const uint8_t sub_rbx[] = { 0x48, 0x83, 0xeb, 0x08 };
+	lit_asm_bytes(assembler, sub_rbx, sizeof(sub_rbx));
+}
+
+static void emit_push(LitAssembler* assembler, int reg) {
+	lit_asm_store(assembler, RBX, 0, reg);
+	emit_push_slot(assembler);
+}
+
+static void emit_sync(LitAssembler* assembler) {
+	lit_asm_store(assembler, R12, offsetof(LitVm, stack_top), RBX);
+}
+
+static void emit_call(LitAssembler* assembler, void* function) {
+	emit_sync(assembler);
+	lit_asm_call(assembler, function);
+}
+
+// Jumps to the native code of the instruction at the bytecode offset, the target is patched later
+static void emit_jump(LitJit* jit, uint8_t condition, uint64_t target) {
+	LitJitPatch patch = { lit_asm_jump(&jit->assembler, condition), (uint32_t) target };
+	lit_jit_patches_write(MM(jit->vm), &jit->patches, patch);
+}
+
+// Leaves the native code, the interpreter goes on from the instruction at the offset
+static void emit_exit(LitJit* jit, uint64_t offset) {
+	LitAssembler* assembler = &jit->assembler;
+
+	emit_sync(assembler);
+	lit_asm_immediate(assembler, RAX, (uint64_t) (uintptr_t) (jit->chunk->code + offset));
+	lit_asm_store(assembler, R14, offsetof(LitFrame, ip), RAX);
+	lit_asm_patch(assembler, lit_asm_jump(assembler, CONDITION_ALWAYS), jit->epilogue);
+}
+
+static void emit_prologue(LitJit* jit) {
+	static const uint8_t jump_rdx[] = { 0xff, 0xe2 };
+	LitAssembler* assembler = &jit->assembler;
+
+	lit_asm_save(assembler);
+	lit_asm_move(assembler, R12, RDI);
+	lit_asm_move(assembler, R14, RSI);
+	lit_asm_load(assembler, R13, RSI, offsetof(LitFrame, slots));
+	lit_asm_load(assembler, RBX, RDI, offsetof(LitVm, stack_top));
+	lit_asm_bytes(assembler, jump_rdx, sizeof(jump_rdx));
+
+	jit->epilogue = lit_asm_position(assembler);
+	lit_asm_restore(assembler);
+}
+
+static LitValue get_global(LitVm* vm, LitString* name) {
+	return *lit_table_get(&vm->globals, name);
+}
+
+static void set_global(LitVm* vm, LitString* name, LitValue value) {
+	lit_table_set(MM(vm), &vm->globals, name, value);
+}
+
+// Compares [rbx - 16] with [rbx - 8], the first one goes into xmm0, the result replaces both
+static void emit_compare(LitAssembler* assembler, bool swap, uint8_t condition) {
+	lit_asm_unbox(assembler, XMM0, RBX, swap ? -8 : -16);
+	lit_asm_unbox(assembler, XMM1, RBX, swap ? -16 : -8);
+	lit_asm_sse_registers(assembler, 0x66, UCOMISD, XMM0, XMM1);
+	lit_asm_set(assembler, condition);
+	lit_asm_bool(assembler, false);
+	emit_pop_slot(assembler);
+	lit_asm_store(assembler, RBX, -8, RAX);
+}
+
+// Stores the int in edx as the value at [rbx + disp], uses rax and rcx
+static void emit_store_int(LitAssembler* assembler, int32_t disp) {
+	static const uint8_t mov_eax_edx[] = { 0x89, 0xd0 };
+
+	lit_asm_bytes(assembler, mov_eax_edx, sizeof(mov_eax_edx));
+	lit_asm_box_int(assembler, RAX, RCX);
+	lit_asm_store(assembler, RBX, disp, RAX);
+}
+
+/*
+ * Two ints are computed in eax and ecx, the result goes into edx and stays an int, when the vm opcode would keep it one,
+ * anything else is computed in doubles
+ */
+static void emit_arithmetic(LitAssembler* assembler, uint8_t opcode) {
+	static const uint8_t mov_edx_eax[] = { 0x89, 0xc2 };
+	static const uint8_t add_edx_ecx[] = { 0x01, 0xca };
+	static const uint8_t sub_edx_ecx[] = { 0x29, 0xca };
+	static const uint8_t imul_edx_ecx[] = { 0x0f, 0xaf, 0xd1 };
+	static const uint8_t test_edx_edx[] = { 0x85, 0xd2 };
+	static const uint8_t or_eax_ecx[] = { 0x09, 0xc8 };
+	static const uint8_t test_ecx_ecx[] = { 0x85, 0xc9 };
+	static const uint8_t cdq_idiv_ecx[] = { 0x99, 0xf7, 0xf9 }; // Quotient in eax, remainder in edx
+
+	uint32_t doubles[4];
+	int count = 0;
+
+	lit_asm_load(assembler, RAX, RBX, -16);
+	lit_asm_load(assembler, RCX, RBX, -8);
+	lit_asm_check_int(assembler, RAX);
+	doubles[count++] = lit_asm_jump(assembler, CONDITION_NOT_EQUAL);
+	lit_asm_check_int(assembler, RCX);
+	doubles[count++] = lit_asm_jump(assembler, CONDITION_NOT_EQUAL);
+
+	switch (opcode) {
+		case ADDSD: case SUBSD: {
+			lit_asm_bytes(assembler, mov_edx_eax, sizeof(mov_edx_eax));
+			lit_asm_bytes(assembler, opcode == ADDSD ? add_edx_ecx : sub_edx_ecx, 2);
+			doubles[count++] = lit_asm_jump(assembler, CONDITION_OVERFLOW);
+
+			break;
+		}
+
+		// Zero times a negative number is -0
+		case MULSD: {
+			lit_asm_bytes(assembler, mov_edx_eax, sizeof(mov_edx_eax));
+			lit_asm_bytes(assembler, imul_edx_ecx, sizeof(imul_edx_ecx));
+			doubles[count++] = lit_asm_jump(assembler, CONDITION_OVERFLOW);
+			lit_asm_bytes(assembler, test_edx_edx, sizeof(test_edx_edx));
+
+			uint32_t not_zero = lit_asm_jump(assembler, CONDITION_NOT_EQUAL);
+			lit_asm_bytes(assembler, or_eax_ecx, sizeof(or_eax_ecx));
+			doubles[count++] = lit_asm_jump(assembler, CONDITION_SIGN);
+			lit_asm_patch(assembler, not_zero, lit_asm_position(assembler));
+
+			break;
+		}
+
+		// Only divisions without a remainder stay ints
+		case DIVSD: {
+			lit_asm_bytes(assembler, test_ecx_ecx, sizeof(test_ecx_ecx));
+			doubles[count++] = lit_asm_jump(assembler, CONDITION_LESS_EQUAL);
+			lit_asm_bytes(assembler, cdq_idiv_ecx, sizeof(cdq_idiv_ecx));
+			lit_asm_bytes(assembler, test_edx_edx, sizeof(test_edx_edx));
+			doubles[count++] = lit_asm_jump(assembler, CONDITION_NOT_EQUAL);
+			lit_asm_bytes(assembler, mov_edx_eax, sizeof(mov_edx_eax));
+
+			break;
+		}
+	}
+
+	emit_store_int(assembler, -16);
+	uint32_t done = lit_asm_jump(assembler, CONDITION_ALWAYS);
+
+	for (int i = 0; i < count; i++) {
+		lit_asm_patch(assembler, doubles[i], lit_asm_position(assembler));
+	}
+
+	lit_asm_unbox(assembler, XMM0, RBX, -16);
+	lit_asm_unbox(assembler, XMM1, RBX, -8);
+	lit_asm_sse_registers(assembler, 0xf2, opcode, XMM0, XMM1);
+	lit_asm_sse(assembler, 0xf2, MOVSD_STORE, XMM0, RBX, -16);
+
+	lit_asm_patch(assembler, done, lit_asm_position(assembler));
+	emit_pop_slot(assembler);
+}
+
+// Bools are checked right away, anything else goes through lit_is_false
+static void emit_conditional_jump(LitJit* jit, bool if_true, uint64_t target, uint64_t next) {
+	static const uint8_t cmp_rax_rcx[] = { 0x48, 0x39, 0xc8 };
+	static const uint8_t test_al[] = { 0x84, 0xc0 };
+	LitAssembler* assembler = &jit->assembler;
+
+	lit_asm_load(assembler, RAX, RBX, -8);
+	lit_asm_immediate(assembler, RCX, if_true ? TRUE_VALUE : FALSE_VALUE);
+	lit_asm_bytes(assembler, cmp_rax_rcx, sizeof(cmp_rax_rcx));
+	emit_jump(jit, CONDITION_EQUAL, target);
+	lit_asm_immediate(assembler, RCX, if_true ? FALSE_VALUE : TRUE_VALUE);
+	lit_asm_bytes(assembler, cmp_rax_rcx, sizeof(cmp_rax_rcx));
+	emit_jump(jit, CONDITION_EQUAL, next);
+
+	lit_asm_move(assembler, RDI, RAX);
+	emit_call(assembler, (void*) lit_is_false);
+	lit_asm_bytes(assembler, test_al, sizeof(test_al));
+	emit_jump(jit, if_true ? CONDITION_EQUAL : CONDITION_NOT_EQUAL, target);
+}
+
+/*
+ * Counts the back edge in the trace of the loop (see lit_trace.h),
+ * once it runs out, the interpreter runs the loop instruction, to record or to run the trace
+ */
+static void emit_loop(LitJit* jit, uint64_t offset, uint64_t target) {
+	static const uint8_t decrement[] = { 0x83, 0x28, 0x01 }; // sub dword [rax], 1
+	LitAssembler* assembler = &jit->assembler;
+	LitTrace* trace = lit_get_trace(jit->vm, jit->function, jit->chunk->code + target);
+
+	lit_asm_immediate(assembler, RAX, (uint64_t) (uintptr_t) &trace->countdown);
+	lit_asm_bytes(assembler, decrement, sizeof(decrement));
+	emit_jump(jit, CONDITION_NOT_EQUAL, target);
+	emit_exit(jit, offset);
+}
+
+// Emits the template of the instruction, returns false, if it has none
+static bool emit_instruction(LitJit* jit, uint64_t offset) {
+	LitAssembler* assembler = &jit->assembler;
+	uint8_t* ip = jit->chunk->code + offset;
+	LitValue* constants = jit->chunk->constants.values;
+	uint64_t next = offset + lit_chunk_instruction_size(jit->chunk, offset);
+
+	switch ((LitOpCode) *ip) {
+		case OP_CONSTANT: {
+			lit_asm_immediate(assembler, RAX, constants[ip[1]]);
+			emit_push(assembler, RAX);
+			return true;
+		}
+
+		case OP_NIL: case OP_TRUE: case OP_FALSE: {
+			lit_asm_immediate(assembler, RAX, *ip == OP_NIL ? NIL_VALUE : (*ip == OP_TRUE ? TRUE_VALUE : FALSE_VALUE));
+			emit_push(assembler, RAX);
+			return true;
+		}
+
+		case OP_POP: {
+			emit_pop_slot(assembler);
+			return true;
+		}
+
+		case OP_GET_LOCAL: {
+			lit_asm_load(assembler, RAX, R13, ip[1] * (int32_t) sizeof(LitValue));
+			emit_push(assembler, RAX);
+			return true;
+		}
+
+		case OP_SET_LOCAL: {
+			lit_asm_load(assembler, RAX, RBX, -8);
+			lit_asm_store(assembler, R13, ip[1] * (int32_t) sizeof(LitValue), RAX);
+			return true;
+		}
+
+		case OP_GET_UPVALUE: case OP_SET_UPVALUE: {
+			lit_asm_load(assembler, RAX, R14, offsetof(LitFrame, closure));
+			lit_asm_load(assembler, RAX, RAX, offsetof(LitClosure, upvalues));
+			lit_asm_load(assembler, RAX, RAX, ip[1] * (int32_t) sizeof(LitUpvalue*));
+			lit_asm_load(assembler, RAX, RAX, offsetof(LitUpvalue, value));
+
+			if (*ip == OP_GET_UPVALUE) {
+				lit_asm_load(assembler, RAX, RAX, 0);
+				emit_push(assembler, RAX);
+			} else {
+				lit_asm_load(assembler, RCX, RBX, -8);
+				lit_asm_store(assembler, RAX, 0, RCX);
+			}
+
+			return true;
+		}
+
+		case OP_GET_GLOBAL: {
+			lit_asm_move(assembler, RDI, R12);
+			lit_asm_immediate(assembler, RSI, (uint64_t) (uintptr_t) AS_OBJECT(constants[ip[1]]));
+			emit_call(assembler, (void*) get_global);
+			emit_push(assembler, RAX);
+			return true;
+		}
+
+		case OP_SET_GLOBAL: case OP_DEFINE_GLOBAL: {
+			lit_asm_move(assembler, RDI, R12);
+			lit_asm_immediate(assembler, RSI, (uint64_t) (uintptr_t) AS_OBJECT(constants[ip[1]]));
+			lit_asm_load(assembler, RDX, RBX, -8);
+			emit_call(assembler, (void*) set_global);
+
+			if (*ip == OP_DEFINE_GLOBAL) {
+				emit_pop_slot(assembler);
+			}
+
+			return true;
+		}
+
+		// -0 is a double, and so is the negated INT32_MIN, neg overflows on it
+		case OP_NEGATE: {
+			static const uint8_t flip_sign[] = { 0x48, 0x0f, 0xba, 0xf8, 0x3f }; // btc rax, 63
+			static const uint8_t mov_edx_eax[] = { 0x89, 0xc2 };
+			static const uint8_t neg_edx[] = { 0xf7, 0xda };
+
+			lit_asm_load(assembler, RAX, RBX, -8);
+			lit_asm_check_int(assembler, RAX);
+			uint32_t not_int = lit_asm_jump(assembler, CONDITION_NOT_EQUAL);
+			lit_asm_bytes(assembler, mov_edx_eax, sizeof(mov_edx_eax));
+			lit_asm_bytes(assembler, neg_edx, sizeof(neg_edx));
+			uint32_t zero = lit_asm_jump(assembler, CONDITION_EQUAL);
+			uint32_t overflow = lit_asm_jump(assembler, CONDITION_OVERFLOW);
+			emit_store_int(assembler, -8);
+			uint32_t done = lit_asm_jump(assembler, CONDITION_ALWAYS);
+
+			lit_asm_patch(assembler, not_int, lit_asm_position(assembler));
+			lit_asm_patch(assembler, zero, lit_asm_position(assembler));
+			lit_asm_patch(assembler, overflow, lit_asm_position(assembler));
+			lit_asm_unbox(assembler, XMM0, RBX, -8);
+			lit_asm_from_xmm(assembler, RAX, XMM0);
+			lit_asm_bytes(assembler, flip_sign, sizeof(flip_sign));
+			lit_asm_store(assembler, RBX, -8, RAX);
+			lit_asm_patch(assembler, done, lit_asm_position(assembler));
+
+			return true;
+		}
+
+		case OP_ADD: emit_arithmetic(assembler, ADDSD); return true;
+		case OP_SUBTRACT: emit_arithmetic(assembler, SUBSD); return true;
+		case OP_MULTIPLY: emit_arithmetic(assembler, MULSD); return true;
+		case OP_DIVIDE: emit_arithmetic(assembler, DIVSD); return true;
+
+		case OP_SQUARE: {
+			lit_asm_unbox(assembler, XMM0, RBX, -8);
+			lit_asm_sse_registers(assembler, 0xf2, SQRTSD, XMM0, XMM0);
+			lit_asm_sse(assembler, 0xf2, MOVSD_STORE, XMM0, RBX, -8);
+			return true;
+		}
+
+		// Ints are already whole
+		case OP_FLOOR: {
+			lit_asm_load(assembler, RAX, RBX, -8);
+			lit_asm_check_int(assembler, RAX);
+			uint32_t is_int = lit_asm_jump(assembler, CONDITION_EQUAL);
+
+			lit_asm_unbox(assembler, XMM0, RBX, -8);
+			emit_call(assembler, (void*) floor);
+			lit_asm_sse(assembler, 0xf2, MOVSD_STORE, XMM0, RBX, -8);
+			lit_asm_patch(assembler, is_int, lit_asm_position(assembler));
+
+			return true;
+		}
+
+		// Unordered operands leave the carry set, so nan compares false, like in c
+		case OP_GREATER: emit_compare(assembler, false, CONDITION_ABOVE); return true;
+		case OP_GREATER_EQUAL: emit_compare(assembler, false, CONDITION_ABOVE_EQUAL); return true;
+		case OP_LESS: emit_compare(assembler, true, CONDITION_ABOVE); return true;
+		case OP_LESS_EQUAL: emit_compare(assembler, true, CONDITION_ABOVE_EQUAL); return true;
+
+		case OP_EQUAL: case OP_NOT_EQUAL: {
+			lit_asm_move(assembler, RDI, R12);
+			lit_asm_load(assembler, RSI, RBX, -8);
+			lit_asm_load(assembler, RDX, RBX, -16);
+			emit_call(assembler, (void*) lit_are_values_equal);
+			lit_asm_bool(assembler, *ip == OP_NOT_EQUAL);
+			emit_pop_slot(assembler);
+			lit_asm_store(assembler, RBX, -8, RAX);
+			return true;
+		}
+
+		case OP_NOT: {
+			lit_asm_load(assembler, RDI, RBX, -8);
+			emit_call(assembler, (void*) lit_is_false);
+			lit_asm_bool(assembler, false);
+			lit_asm_store(assembler, RBX, -8, RAX);
+			return true;
+		}
+
+		case OP_JUMP: case OP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE: case OP_LOOP: {
+			uint16_t distance = (uint16_t) ((ip[1] << 8) | ip[2]);
+			uint64_t target = *ip == OP_LOOP ? next - distance : next + distance;
+
+			if (*ip == OP_LOOP) {
+				emit_loop(jit, offset, target);
+			} else if (*ip == OP_JUMP) {
+				emit_jump(jit, CONDITION_ALWAYS, target);
+			} else {
+				emit_conditional_jump(jit, *ip == OP_JUMP_IF_TRUE, target, next);
+			}
+
+			return true;
+		}
+
+		default: return false;
+	}
+}
+
+bool lit_jit_compile(LitVm* vm, LitFunction* function) {
+#if defined(__x86_64__)
+	LitChunk* chunk = &function->chunk;
+	LitJit jit;
+
+	jit.vm = vm;
+	jit.function = function;
+	jit.chunk = chunk;
+	lit_init_assembler(&jit.assembler, MM(vm));
+	lit_init_jit_patches(&jit.patches);
+
+	uint32_t* entries = ALLOCATE(vm, uint32_t, chunk->count + 1);
+	emit_prologue(&jit);
+
+	for (uint64_t offset = 0; offset < chunk->count; offset += lit_chunk_instruction_size(chunk, offset)) {
+		entries[offset] = lit_asm_position(&jit.assembler);
+
+		if (!emit_instruction(&jit, offset)) {
+			emit_exit(&jit, offset);
+		}
+	}
+
+	// Running off the end can't happen, the chunk always returns, but jumps may point there
+	entries[chunk->count] = lit_asm_position(&jit.assembler);
+	emit_exit(&jit, chunk->count);
+
+	for (int i = 0; i < jit.patches.count; i++) {
+		LitJitPatch* patch = &jit.patches.values[i];
+		lit_asm_patch(&jit.assembler, patch->position, entries[patch->target]);
+	}
+
+	size_t size = (size_t) lit_asm_position(&jit.assembler);
+	uint8_t* code = lit_asm_map(&jit.assembler);
+
+	lit_free_assembler(&jit.assembler);
+	lit_free_jit_patches(MM(vm), &jit.patches);
+
+	if (code == NULL) {
+		FREE_ARRAY(vm, uint32_t, entries, chunk->count + 1);
+		return false;
+	}
+
+	LitJitCode* native = ALLOCATE(vm, LitJitCode, 1);
+
+	native->code = code;
+	native->size = size;
+	native->entries = entries;
+	native->entry_count = chunk->count + 1;
+	function->jit = native;
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+void lit_jit_free(LitMemManager* manager, LitFunction* function) {
+	LitJitCode* native = function->jit;
+
+	if (native != NULL) {
+		lit_asm_unmap(native->code, native->size);
+		FREE_ARRAY(manager, uint32_t, native->entries, native->entry_count);
+		FREE(manager, LitJitCode, native);
+
+		function->jit = NULL;
+	}
+}
+
+void lit_jit_run(LitVm* vm, LitFrame* frame) {
+	LitFunction* function = frame->closure->function;
+	LitJitCode* native = function->jit;
+
+	((LitJitEntry) native->code)(vm, frame, native->code + native->entries[frame->ip - function->chunk.code]);
+}
\ No newline at end of file
@@ -0,0 +1,678 @@
+#define _GNU_SOURCE // accept4, pipe2 and the linux apis under -std=c99
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <vm/lit_loop.h>
+#include <vm/lit_memory.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+extern char** environ;
+
+static LitLoop* get_loop(LitVm* vm) {
+	if (vm->loop == NULL) {
+		LitLoop* loop = ALLOCATE(vm, LitLoop, 1);
+
+		loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+		loop->ready = NULL;
+		loop->ready_start = 0;
+		loop->ready_count = 0;
+		loop->ready_capacity = 0;
+		loop->waits = NULL;
+		loop->wait_count = 0;
+		loop->fd_waits = NULL;
+		loop->fd_capacity = 0;
+
+		// Writes to a closed pipe or socket fail with EPIPE, instead of killing the process
+		signal(SIGPIPE, SIG_IGN);
+		vm->loop = loop;
+	}
+
+	return vm->loop;
+}
+
+static bool would_block(int error) {
+	return error == EAGAIN || error == EWOULDBLOCK;
+}
+
+static void set_non_blocking(int fd) {
+	int flags = fcntl(fd, F_GETFL);
+
+	if (flags >= 0 && (flags & O_NONBLOCK) == 0) {
+		fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+	}
+}
+
+static int push_result(LitVm* vm, LitValue value) {
+	lit_push(vm, value);
+	return 1;
+}
+
+static int push_string(LitVm* vm, const char* chars, size_t length) {
+	return push_result(vm, MAKE_OBJECT_VALUE(lit_copy_string(MM(vm), chars, length)));
+}
+
+// Makes room for one more ready fiber, before its value is made, so that the gc never sees a half written entry
+static void reserve_ready(LitVm* vm, LitLoop* loop) {
+	if (loop->ready_count < loop->ready_capacity) {
+		return;
+	}
+
+	uint32_t capacity = GROW_CAPACITY(loop->ready_capacity);
+	LitReady* ready = ALLOCATE(vm, LitReady, capacity);
+
+	for (uint32_t i = 0; i < loop->ready_count; i++) {
+		ready[i] = loop->ready[(loop->ready_start + i) % loop->ready_capacity];
+	}
+
+	FREE_ARRAY(vm, LitReady, loop->ready, loop->ready_capacity);
+
+	loop->ready = ready;
+	loop->ready_start = 0;
+	loop->ready_capacity = capacity;
+}
+
+static void make_ready(LitLoop* loop, LitFiber* fiber, LitValue value) {
+	loop->ready[(loop->ready_start + loop->ready_count) % loop->ready_capacity] = (LitReady) {fiber, value};
+	loop->ready_count++;
+	fiber->parked = true;
+}
+
+static LitWait* new_wait(LitVm* vm, LitWaitType type, int fd) {
+	LitWait* wait = ALLOCATE(vm, LitWait, 1);
+
+	wait->type = type;
+	wait->fd = fd;
+	wait->fiber = vm->fiber;
+	wait->data = NULL;
+	wait->buffer = NULL;
+	wait->length = 0;
+	wait->capacity = 0;
+	wait->pid = -1;
+	wait->events = 0;
+	wait->previous = NULL;
+	wait->next = NULL;
+	wait->next_on_fd = NULL;
+
+	return wait;
+}
+
+// The timer, the file and the pidfd belong to the wait, the other fds belong to the script
+static bool owns_fd(LitWait* wait) {
+	return wait->type == WAIT_TIMER || wait->type == WAIT_READ_FILE || wait->type == WAIT_PROCESS;
+}
+
+static void free_wait(LitVm* vm, LitWait* wait) {
+	if (owns_fd(wait)) {
+		close(wait->fd);
+	}
+
+	FREE_ARRAY(vm, char, wait->buffer, wait->capacity);
+	FREE(vm, LitWait, wait);
+}
+
+static LitWait* first_on_fd(LitLoop* loop, int fd) {
+	return (uint32_t) fd < loop->fd_capacity ? loop->fd_waits[fd] : NULL;
+}
+
+// Registers the fd with the events, that its waits need, or takes it out of the epoll, once none wait on it
+static int register_fd(LitLoop* loop, int fd, int operation) {
+	struct epoll_event event;
+
+	event.events = 0;
+	event.data.fd = fd;
+
+	for (LitWait* wait = first_on_fd(loop, fd); wait != NULL; wait = wait->next_on_fd) {
+		event.events |= wait->events;
+	}
+
+	if (event.events == 0) {
+		return epoll_ctl(loop->epoll, EPOLL_CTL_DEL, fd, NULL);
+	}
+
+	return epoll_ctl(loop->epoll, operation, fd, &event);
+}
+
+static void unlink_wait(LitVm* vm, LitLoop* loop, LitWait* wait) {
+	LitWait** slot = &loop->fd_waits[wait->fd];
+
+	while (*slot != wait) {
+		slot = &(*slot)->next_on_fd;
+	}
+
+	*slot = wait->next_on_fd;
+
+	if (wait->previous == NULL) {
+		loop->waits = wait->next;
+	} else {
+		wait->previous->next = wait->next;
+	}
+
+	if (wait->next != NULL) {
+		wait->next->previous = wait->previous;
+	}
+
+	loop->wait_count--;
+
+	// The fds of the wait are closed with it, what takes them out of the epoll
+	if (!owns_fd(wait)) {
+		register_fd(loop, wait->fd, EPOLL_CTL_MOD);
+	}
+}
+
+// Reads the file into the buffer, tells, if the end of it was reached, a failed read ends it too
+static bool read_file(LitVm* vm, LitWait* wait) {
+	while (true) {
+		if (wait->capacity - wait->length < LIT_LOOP_CHUNK) {
+			size_t capacity = wait->capacity < LIT_LOOP_CHUNK ? LIT_LOOP_CHUNK * 2 : wait->capacity * 2;
+
+			wait->buffer = GROW_ARRAY(vm, wait->buffer, char, wait->capacity, capacity);
+			wait->capacity = capacity;
+		}
+
+		ssize_t length = read(wait->fd, wait->buffer + wait->length, wait->capacity - wait->length);
+
+		if (length > 0) {
+			wait->length += (size_t) length;
+		} else if (length == 0 || (errno != EINTR && !would_block(errno))) {
+			return true;
+		} else if (errno != EINTR) {
+			return false;
+		}
+	}
+}
+
+// Writes, what is left of the data, tells, if it is done, a failed write is done with the bytes, that made it
+static bool write_rest(LitWait* wait) {
+	size_t length = (size_t) wait->data->length;
+
+	while (wait->length < length) {
+		ssize_t written = write(wait->fd, wait->data->chars + wait->length, length - wait->length);
+
+		if (written >= 0) {
+			wait->length += (size_t) written;
+		} else if (errno != EINTR) {
+			return !would_block(errno);
+		}
+	}
+
+	return true;
+}
+
+static int exit_code(int status) {
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+// Parks the running fiber, until the fd of the wait gets one of the events, the next ready fiber runs meanwhile
+static int park(LitVm* vm, LitWait* wait, uint32_t events) {
+	LitLoop* loop = vm->loop;
+	int fd = wait->fd;
+
+	if ((uint32_t) fd >= loop->fd_capacity) {
+		uint32_t capacity = loop->fd_capacity;
+
+		while ((uint32_t) fd >= capacity) {
+			capacity = GROW_CAPACITY(capacity);
+		}
+
+		loop->fd_waits = GROW_ARRAY(vm, loop->fd_waits, LitWait*, loop->fd_capacity, capacity);
+		memset(loop->fd_waits + loop->fd_capacity, 0, (capacity - loop->fd_capacity) * sizeof(LitWait*));
+		loop->fd_capacity = capacity;
+	}
+
+	// Other fibers might wait on the fd already, it stays registered once, with the events of all of them
+	LitWait** slot = &loop->fd_waits[fd];
+	bool registered = *slot != NULL;
+
+	while (*slot != NULL) {
+		slot = &(*slot)->next_on_fd;
+	}
+
+	*slot = wait;
+	wait->events = events;
+
+	if (register_fd(loop, fd, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD) != 0) {
+		lit_runtime_error(vm, "Can't wait for fd %d: %s", fd, strerror(errno));
+
+		*slot = NULL;
+		free_wait(vm, wait);
+
+		return push_result(vm, NIL_VALUE);
+	}
+
+	wait->next = loop->waits;
+
+	if (loop->waits != NULL) {
+		loop->waits->previous = wait;
+	}
+
+	loop->waits = wait;
+	loop->wait_count++;
+	vm->fiber->parked = true;
+
+	lit_loop_next(vm);
+	return 1;
+}
+
+// Does the operation of the wait, that got its event, and queues its fiber with the result, once it is done
+static void finish_wait(LitVm* vm, LitLoop* loop, LitWait* wait) {
+	reserve_ready(vm, loop);
+	LitValue value = NIL_VALUE;
+
+	switch (wait->type) {
+		case WAIT_TIMER: {
+			uint64_t expirations;
+
+			if (read(wait->fd, &expirations, sizeof(expirations)) < 0 && would_block(errno)) {
+				return;
+			}
+
+			break;
+		}
+		case WAIT_READ_FILE: {
+			if (!read_file(vm, wait)) {
+				return;
+			}
+
+			value = MAKE_OBJECT_VALUE(lit_copy_string(MM(vm), wait->buffer, wait->length));
+			break;
+		}
+		case WAIT_READ: {
+			char chunk[LIT_LOOP_CHUNK];
+			ssize_t length = read(wait->fd, chunk, sizeof(chunk));
+
+			if (length < 0 && (errno == EINTR || would_block(errno))) {
+				return;
+			}
+
+			if (length >= 0) {
+				value = MAKE_OBJECT_VALUE(lit_copy_string(MM(vm), chunk, (size_t) length));
+			}
+
+			break;
+		}
+		case WAIT_WRITE: {
+			if (!write_rest(wait)) {
+				return;
+			}
+
+			value = MAKE_INT_VALUE(wait->length);
+			break;
+		}
+		case WAIT_ACCEPT: {
+			int fd = accept4(wait->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+			if (fd < 0 && (errno == EINTR || would_block(errno))) {
+				return;
+			}
+
+			value = MAKE_INT_VALUE(fd);
+			break;
+		}
+		case WAIT_CONNECT: {
+			int error = 0;
+			socklen_t size = sizeof(error);
+
+			getsockopt(wait->fd, SOL_SOCKET, SO_ERROR, &error, &size);
+			value = MAKE_INT_VALUE(error == 0 ? wait->fd : -1);
+			break;
+		}
+		case WAIT_PROCESS: {
+			int status;
+
+			if (waitpid(wait->pid, &status, WNOHANG) == 0) {
+				return;
+			}
+
+			value = MAKE_INT_VALUE(exit_code(status));
+			break;
+		}
+	}
+
+	unlink_wait(vm, loop, wait);
+
+	if (wait->type == WAIT_CONNECT && AS_INT(value) == -1) {
+		close(wait->fd);
+	}
+
+	make_ready(loop, wait->fiber, value);
+	free_wait(vm, wait);
+}
+
+static void poll_loop(LitVm* vm, LitLoop* loop, int timeout) {
+	struct epoll_event events[LIT_LOOP_EVENTS];
+	int count = epoll_wait(loop->epoll, events, LIT_LOOP_EVENTS, timeout);
+
+	for (int i = 0; i < count; i++) {
+		LitWait* wait = first_on_fd(loop, events[i].data.fd);
+		uint32_t ready = events[i].events | EPOLLERR | EPOLLHUP;
+
+		// Every wait, that got its event, tries its operation, the ones, that would still block, stay
+		while (wait != NULL) {
+			LitWait* next = wait->next_on_fd;
+
+			if ((wait->events & ready) != 0) {
+				finish_wait(vm, loop, wait);
+			}
+
+			wait = next;
+		}
+	}
+}
+
+void lit_loop_spawn(LitVm* vm, LitFiber* fiber) {
+	LitLoop* loop = get_loop(vm);
+
+	reserve_ready(vm, loop);
+	make_ready(loop, fiber, NIL_VALUE);
+}
+
+bool lit_loop_pending(LitVm* vm) {
+	return vm->loop != NULL && (vm->loop->ready_count > 0 || vm->loop->wait_count > 0);
+}
+
+void lit_loop_next(LitVm* vm) {
+	LitLoop* loop = vm->loop;
+
+	// The ready fibers go first, but the operations, that are done already, get in line behind them
+	if (loop->wait_count > 0) {
+		poll_loop(vm, loop, loop->ready_count == 0 ? -1 : 0);
+	}
+
+	while (loop->ready_count == 0) {
+		poll_loop(vm, loop, -1);
+	}
+
+	LitReady next = loop->ready[loop->ready_start];
+
+	loop->ready_start = (loop->ready_start + 1) % loop->ready_capacity;
+	loop->ready_count--;
+
+	next.fiber->parked = false;
+	vm->next_fiber = next.fiber;
+	lit_push(vm, next.value);
+}
+
+int lit_loop_sleep(LitVm* vm, double milliseconds) {
+	get_loop(vm);
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if (fd < 0) {
+		lit_runtime_error(vm, "Can't create a timer: %s", strerror(errno));
+		return push_result(vm, NIL_VALUE);
+	}
+
+	struct itimerspec time;
+	memset(&time, 0, sizeof(time));
+
+	// A zero time disarms the timer, so sleep(0) waits a nanosecond and lets the other fibers run
+	if (milliseconds > 0) {
+		time.it_value.tv_sec = (time_t) (milliseconds / 1000);
+		time.it_value.tv_nsec = (long) ((milliseconds - (double) time.it_value.tv_sec * 1000) * 1000000);
+	}
+
+	if (time.it_value.tv_sec == 0 && time.it_value.tv_nsec == 0) {
+		time.it_value.tv_nsec = 1;
+	}
+
+	timerfd_settime(fd, 0, &time, NULL);
+	return park(vm, new_wait(vm, WAIT_TIMER, fd), EPOLLIN);
+}
+
+int lit_loop_read_file(LitVm* vm, LitString* path) {
+	get_loop(vm);
+	int fd = open(path->chars, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+	if (fd < 0) {
+		lit_runtime_error(vm, "Can't open %s: %s", path->chars, strerror(errno));
+		return push_result(vm, NIL_VALUE);
+	}
+
+	LitWait* wait = new_wait(vm, WAIT_READ_FILE, fd);
+
+	// Regular files are never waited for, they are read to the end right away
+	if (read_file(vm, wait)) {
+		LitString* string = lit_copy_string(MM(vm), wait->buffer, wait->length);
+
+		free_wait(vm, wait);
+		return push_result(vm, MAKE_OBJECT_VALUE(string));
+	}
+
+	return park(vm, wait, EPOLLIN);
+}
+
+int lit_loop_read(LitVm* vm, int fd) {
+	get_loop(vm);
+	set_non_blocking(fd);
+
+	char chunk[LIT_LOOP_CHUNK];
+	ssize_t length;
+
+	do {
+		length = read(fd, chunk, sizeof(chunk));
+	} while (length < 0 && errno == EINTR);
+
+	if (length >= 0) {
+		return push_string(vm, chunk, (size_t) length);
+	}
+
+	if (!would_block(errno)) {
+		return push_result(vm, NIL_VALUE);
+	}
+
+	return park(vm, new_wait(vm, WAIT_READ, fd), EPOLLIN);
+}
+
+int lit_loop_write(LitVm* vm, int fd, LitString* data) {
+	get_loop(vm);
+	set_non_blocking(fd);
+
+	LitWait* wait = new_wait(vm, WAIT_WRITE, fd);
+	wait->data = data;
+
+	if (write_rest(wait)) {
+		int written = (int) wait->length;
+
+		free_wait(vm, wait);
+		return push_result(vm, MAKE_INT_VALUE(written));
+	}
+
+	return park(vm, wait, EPOLLOUT);
+}
+
+int lit_loop_accept(LitVm* vm, int fd) {
+	get_loop(vm);
+	set_non_blocking(fd);
+
+	int client;
+
+	do {
+		client = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	} while (client < 0 && errno == EINTR);
+
+	if (client >= 0 || !would_block(errno)) {
+		return push_result(vm, MAKE_INT_VALUE(client));
+	}
+
+	return park(vm, new_wait(vm, WAIT_ACCEPT, fd), EPOLLIN);
+}
+
+static bool make_address(struct sockaddr_un* address, LitString* path) {
+	if ((size_t) path->length >= sizeof(address->sun_path)) {
+		return false;
+	}
+
+	memset(address, 0, sizeof(struct sockaddr_un));
+	address->sun_family = AF_UNIX;
+	memcpy(address->sun_path, path->chars, (size_t) path->length);
+
+	return true;
+}
+
+int lit_loop_connect(LitVm* vm, LitString* path) {
+	get_loop(vm);
+	struct sockaddr_un address;
+
+	if (!make_address(&address, path)) {
+		return push_result(vm, MAKE_INT_VALUE(-1));
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	if (fd < 0) {
+		return push_result(vm, MAKE_INT_VALUE(-1));
+	}
+
+	if (connect(fd, (struct sockaddr*) &address, sizeof(address)) == 0) {
+		return push_result(vm, MAKE_INT_VALUE(fd));
+	}
+
+	if (errno == EINPROGRESS) {
+		return park(vm, new_wait(vm, WAIT_CONNECT, fd), EPOLLOUT);
+	}
+
+	close(fd);
+	return push_result(vm, MAKE_INT_VALUE(-1));
+}
+
+int lit_loop_exec(LitVm* vm, LitString* command) {
+	get_loop(vm);
+
+	char* arguments[] = { "sh", "-c", command->chars, NULL };
+	pid_t pid;
+
+	// Or the buffered output of the script would come after the one of the process
+	fflush(stdout);
+
+	if (posix_spawn(&pid, "/bin/sh", NULL, NULL, arguments, environ) != 0) {
+		return push_result(vm, MAKE_INT_VALUE(-1));
+	}
+
+	int fd = (int) syscall(SYS_pidfd_open, pid, 0);
+	int status;
+
+	// Kernels before 5.3 have no pidfd, the process is waited for right away there
+	if (fd < 0) {
+		waitpid(pid, &status, 0);
+		return push_result(vm, MAKE_INT_VALUE(exit_code(status)));
+	}
+
+	LitWait* wait = new_wait(vm, WAIT_PROCESS, fd);
+	wait->pid = pid;
+
+	return park(vm, wait, EPOLLIN);
+}
+
+int lit_loop_listen(LitVm* vm, LitString* path) {
+	struct sockaddr_un address;
+
+	if (!make_address(&address, path)) {
+		return -1;
+	}
+
+	struct stat info;
+
+	// Only a socket, that an earlier server left behind, is replaced, any other file stays
+	if (lstat(path->chars, &info) == 0 && (!S_ISSOCK(info.st_mode) || unlink(path->chars) != 0)) {
+		return -1;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	if (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+bool lit_loop_pipe(LitVm* vm, int fds[2]) {
+	return pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0;
+}
+
+int lit_loop_close(LitVm* vm, int fd) {
+	LitLoop* loop = vm->loop;
+
+	// The fibers, that wait on the fd, would never get an event, so they get the result of a failed operation
+	if (loop != NULL) {
+		LitWait* wait = first_on_fd(loop, fd);
+
+		while (wait != NULL) {
+			LitWait* next = wait->next_on_fd;
+
+			if (!owns_fd(wait)) {
+				reserve_ready(vm, loop);
+				unlink_wait(vm, loop, wait);
+				make_ready(loop, wait->fiber, wait->type == WAIT_READ ? NIL_VALUE : MAKE_INT_VALUE(-1));
+				free_wait(vm, wait);
+			}
+
+			wait = next;
+		}
+	}
+
+	return close(fd);
+}
+
+void lit_gray_loop(LitVm* vm) {
+	LitLoop* loop = vm->loop;
+
+	if (loop == NULL) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < loop->ready_count; i++) {
+		LitReady* ready = &loop->ready[(loop->ready_start + i) % loop->ready_capacity];
+
+		lit_gray_object(vm, (LitObject*) ready->fiber);
+		lit_gray_value(vm, ready->value);
+	}
+
+	for (LitWait* wait = loop->waits; wait != NULL; wait = wait->next) {
+		lit_gray_object(vm, (LitObject*) wait->fiber);
+		lit_gray_object(vm, (LitObject*) wait->data);
+	}
+}
+
+void lit_free_loop(LitVm* vm) {
+	LitLoop* loop = vm->loop;
+
+	if (loop == NULL) {
+		return;
+	}
+
+	LitWait* wait = loop->waits;
+
+	while (wait != NULL) {
+		LitWait* next = wait->next;
+
+		free_wait(vm, wait);
+		wait = next;
+	}
+
+	close(loop->epoll);
+	FREE_ARRAY(vm, LitReady, loop->ready, loop->ready_capacity);
+	FREE_ARRAY(vm, LitWait*, loop->fd_waits, loop->fd_capacity);
+	FREE(vm, LitLoop, loop);
+
+	vm->loop = NULL;
+}
\ No newline at end of file
@@ -5,6 +5,10 @@
 #include <lit_debug.h>
 #include <vm/lit_memory.h>
 #include <vm/lit_object.h>
+#include <vm/lit_jit.h>
+#include <vm/lit_trace.h>
+#include <vm/lit_feedback.h>
+#include <vm/lit_loop.h>
 
 #define GC_HEAP_GROW_FACTOR 2
 
@@ -27,6 +31,30 @@ void* base_reallocate(LitMemManager* manager, void* previous, size_t old_size, s
 	return realloc(previous, new_size);
 }
 
+void lit_move_objects(LitMemManager* to, LitMemManager* from) {
+	assert(to->strings.count == 0);
+
+	if (from->objects != NULL) {
+		LitObject* last = from->objects;
+
+		while (last->next != NULL) {
+			last = last->next;
+		}
+
+		last->next = to->objects;
+		to->objects = from->objects;
+		from->objects = NULL;
+	}
+
+	// The table is moved as is, so the strings keep their identity
+	lit_free_table(to, &to->strings);
+	to->strings = from->strings;
+	lit_init_table(&from->strings);
+
+	to->bytes_allocated += from->bytes_allocated;
+	from->bytes_allocated = 0;
+}
+
 void lit_gray_object(LitVm* vm, LitObject* object) {
 	if (object == NULL) {
 		return;
@@ -72,6 +100,7 @@ static void blacken_object(LitVm* vm, LitObject* object) {
 			LitFunction* function = (LitFunction*) object;
 			lit_gray_object(vm, (LitObject*) function->name);
 			gray_array(vm, &function->chunk.constants);
+			lit_gray_feedback(vm, function);
 
 			break;
 		}
@@ -86,7 +115,7 @@ static void blacken_object(LitVm* vm, LitObject* object) {
 			break;
 		}
 		case OBJECT_UPVALUE: lit_gray_value(vm, ((LitUpvalue*) object)->closed); break;
-		case OBJECT_NATIVE: case OBJECT_STRING: break;
+		case OBJECT_NATIVE: case OBJECT_NATIVE_METHOD: case OBJECT_STRING: break;
 		case OBJECT_CLASS: {
 			LitClass* class = (LitClass*) object;
 
@@ -100,6 +129,31 @@ static void blacken_object(LitVm* vm, LitObject* object) {
 
 			break;
 		}
+		case OBJECT_FIBER: {
+			LitFiber* fiber = (LitFiber*) object;
+
+			lit_gray_object(vm, (LitObject*) fiber->closure);
+			lit_gray_object(vm, (LitObject*) fiber->parent);
+
+			// The running fiber has its stack top, frames and upvalues in the vm, they are roots
+			if (fiber == vm->fiber || fiber->stack == NULL) {
+				break;
+			}
+
+			for (LitValue* slot = fiber->stack; slot < fiber->stack_top; slot++) {
+				lit_gray_value(vm, *slot);
+			}
+
+			for (int i = 0; i < fiber->frame_count; i++) {
+				lit_gray_object(vm, (LitObject*) fiber->frames[i].closure);
+			}
+
+			for (LitUpvalue* upvalue = fiber->open_upvalues; upvalue != NULL; upvalue = upvalue->next) {
+				lit_gray_object(vm, (LitObject*) upvalue);
+			}
+
+			break;
+		}
 		case OBJECT_INSTANCE: {
 			LitInstance* instance = (LitInstance*) object;
 			lit_gray_object(vm, (LitObject*) instance->type);
@@ -143,6 +197,9 @@ void lit_free_object(LitMemManager* manager, LitObject* object) {
 		case OBJECT_FUNCTION: {
 			LitFunction* function = (LitFunction*) object;
 
+			lit_jit_free(manager, function);
+			lit_free_traces(manager, function);
+			lit_free_feedback(manager, function);
 			lit_free_chunk(manager, &function->chunk);
 			FREE(manager, LitFunction, object);
 
@@ -170,7 +227,7 @@ void lit_free_object(LitMemManager* manager, LitObject* object) {
 			lit_free_table(manager, &class->methods);
 			lit_free_table(manager, &class->static_methods);
 			lit_free_table(manager, &class->fields);
-			lit_free_table(manager, &class->static_methods);
+			lit_free_table(manager, &class->static_fields);
 
 			FREE(manager, LitClass, object);
 			break;
@@ -183,6 +240,12 @@ void lit_free_object(LitMemManager* manager, LitObject* object) {
 
 			break;
 		}
+		case OBJECT_FIBER: {
+			lit_free_fiber_stack(manager, (LitFiber*) object);
+			FREE(manager, LitFiber, object);
+
+			break;
+		}
 		default: UNREACHABLE();
 	}
 }
@@ -206,6 +269,9 @@ void lit_collect_garbage(LitVm* vm) {
 		lit_gray_object(vm, (LitObject*) upvalue);
 	}
 
+	lit_gray_object(vm, (LitObject*) vm->fiber);
+	lit_gray_object(vm, (LitObject*) vm->next_fiber);
+	lit_gray_loop(vm);
 	lit_table_gray(vm, &vm->globals);
 	lit_gray_object(vm, (LitObject*) vm->init_string);
 
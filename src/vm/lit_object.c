@@ -54,6 +54,11 @@ LitFunction* lit_new_function(LitMemManager* manager) {
 	function->arity = 0;
 	function->upvalue_count = 0;
 	function->name = NULL;
+	function->hotness = 0;
+	function->jit = NULL;
+	function->traces = NULL;
+	function->compiled = NULL;
+	function->feedback = NULL;
 
 	lit_init_chunk(&function->chunk);
 
@@ -98,13 +103,48 @@ LitNativeMethod* lit_new_native_method(LitMemManager* manager, LitNativeMethodFn
 	return m;
 }
 
+LitFiber* lit_new_fiber(LitMemManager* manager, LitClosure* closure) {
+	// The stack is allocated first, so the gc never sees a fiber without one
+	LitValue* stack = ALLOCATE(manager, LitValue, VM_STACK_MAX);
+	LitFrame* frames = ALLOCATE(manager, LitFrame, FRAMES_MAX);
+	LitFiber* fiber = ALLOCATE_OBJECT(manager, LitFiber, OBJECT_FIBER);
+
+	fiber->closure = closure;
+	fiber->parent = NULL;
+	fiber->stack = stack;
+	fiber->stack_top = stack;
+	fiber->frames = frames;
+	fiber->frame_count = 0;
+	fiber->open_upvalues = NULL;
+	fiber->parked = false;
+
+	return fiber;
+}
+
+void lit_free_fiber_stack(LitMemManager* manager, LitFiber* fiber) {
+	if (fiber->stack != NULL) {
+		FREE_ARRAY(manager, LitValue, fiber->stack, VM_STACK_MAX);
+		FREE_ARRAY(manager, LitFrame, fiber->frames, FRAMES_MAX);
+
+		fiber->stack = NULL;
+		fiber->stack_top = NULL;
+		fiber->frames = NULL;
+		fiber->frame_count = 0;
+		fiber->open_upvalues = NULL;
+	}
+}
+
 LitInstance* lit_new_instance(LitMemManager* manager, LitClass* class) {
+	// Fields are copied first, because the instance is not reachable by the gc yet
+	LitTable fields;
+
+	lit_init_table(&fields);
+	lit_table_add_all(manager, &fields, &class->fields);
+
 	LitInstance* instance = ALLOCATE_OBJECT(manager, LitInstance, OBJECT_INSTANCE);
 
 	instance->type = class;
-
-	lit_init_table(&instance->fields);
-	lit_table_add_all(manager, &instance->fields, &class->fields);
+	instance->fields = fields;
 
 	return instance;
 }
@@ -115,7 +155,15 @@ static LitString* allocate_string(LitMemManager* manager, char* chars, int lengt
 	string->length = length;
 	string->chars = chars;
 	string->hash = hash;
+	string->interned = false;
+
+	return string;
+}
+
+static LitString* allocate_interned_string(LitMemManager* manager, char* chars, int length, uint32_t hash) {
+	LitString* string = allocate_string(manager, chars, length, hash);
 
+	string->interned = true;
 	lit_table_set(manager, &manager->strings, string, NIL_VALUE);
 
 	return string;
@@ -137,6 +185,23 @@ void lit_hash_string(LitString* string) {
 	string->hash = hash_string(string->chars, string->length);
 }
 
+LitString* lit_intern_string(LitMemManager* manager, LitString* string) {
+	if (string->interned) {
+		return string;
+	}
+
+	LitString* interned = lit_table_find(&manager->strings, string->chars, string->length, string->hash);
+
+	if (interned != NULL) {
+		return interned;
+	}
+
+	string->interned = true;
+	lit_table_set(manager, &manager->strings, string, NIL_VALUE);
+
+	return string;
+}
+
 LitString* lit_new_string(LitMemManager* manager, int length) {
 	LitString* string = allocate_string(manager, NULL, length, 0);
 
@@ -154,7 +219,7 @@ LitString* lit_make_string(LitMemManager* manager, char* chars, int length) {
 		return interned;
 	}
 
-	return allocate_string(manager, chars, length, hash);
+	return allocate_interned_string(manager, chars, length, hash);
 }
 
 LitString* lit_copy_string(LitMemManager* manager, const char* chars, size_t length) {
@@ -170,7 +235,7 @@ LitString* lit_copy_string(LitMemManager* manager, const char* chars, size_t len
 	memcpy(heap_chars, chars, length);
 	heap_chars[length] = '\0';
 
-	return allocate_string(manager, heap_chars, (int) length, hash);
+	return allocate_interned_string(manager, heap_chars, (int) length, hash);
 }
 
 static int get_string_length(const char* format, va_list arg_list) {
@@ -0,0 +1,1387 @@
+#include <stddef.h>
+#include <math.h>
+
+#include <vm/lit_trace.h>
+#include <vm/lit_assembler.h>
+#include <vm/lit_memory.h>
+#include <vm/lit_object.h>
+
+/*
+ * The trace keeps r12 on the vm, r13 on the slots of the frame and r14 on the frame
+ * xmm8 - xmm15 hold the locals below the base, that the loop uses, xmm0 - xmm7 hold the temporaries
+ * Ints are converted to doubles, when they are loaded, the compiler keeps track of, which registers hold ints,
+ * and boxes them again, when they are written back
+ * The stack top is only written back, before a helper is called and when the trace is left
+ */
+#define TEMPORARY_REGISTERS 8
+#define LOCAL_REGISTERS 8
+
+#define SLOT(index) ((int32_t) ((index) * sizeof(LitValue)))
+
+typedef void (*LitTraceEntry)(LitVm* vm, LitFrame* frame);
+
+typedef enum {
+	OBSERVED_NOTHING,
+	OBSERVED_BOOL,
+	OBSERVED_NUMBER,
+	OBSERVED_OTHER
+} LitObserved;
+
+// Which values were ints, while recording
+#define INTEGER_TOP 0x1
+#define INTEGER_BELOW 0x2 // Right under the top
+#define INTEGER_RESULT 0x4 // Arithmetic only
+
+typedef struct {
+	uint32_t offset;
+	uint8_t observed; // What the instruction looked at, the operand of a jump or both sides of an equality
+	uint8_t integers;
+	bool taken; // Jumps only
+	LitClass* class; // Class of the instance, whose field is read
+} LitTraceStep;
+
+DECLARE_ARRAY(LitTraceSteps, LitTraceStep, trace_steps)
+DEFINE_ARRAY(LitTraceSteps, LitTraceStep, trace_steps)
+
+typedef struct sLitTraceRecorder {
+	LitTrace* trace;
+	LitFrame* frame;
+	int frame_count;
+	int base;
+	bool integers[VM_STACK_MAX]; // Which slots below the base held ints at the header
+
+	LitTraceSteps steps;
+} LitTraceRecorder;
+
+LitTrace* lit_get_trace(LitVm* vm, LitFunction* function, uint8_t* header) {
+	for (LitTrace* trace = function->traces; trace != NULL; trace = trace->next) {
+		if (trace->header == header) {
+			return trace;
+		}
+	}
+
+	LitTrace* trace = ALLOCATE(vm, LitTrace, 1);
+
+	trace->header = header;
+	trace->countdown = LIT_TRACE_THRESHOLD;
+	trace->blacklisted = false;
+	trace->base = 0;
+	trace->code = NULL;
+	trace->size = 0;
+	trace->next = function->traces;
+	function->traces = trace;
+
+	return trace;
+}
+
+void lit_free_traces(LitMemManager* manager, LitFunction* function) {
+	LitTrace* trace = function->traces;
+
+	while (trace != NULL) {
+		LitTrace* next = trace->next;
+
+		if (trace->code != NULL) {
+			lit_asm_unmap(trace->code, trace->size);
+		}
+
+		FREE(manager, LitTrace, trace);
+		trace = next;
+	}
+
+	function->traces = NULL;
+}
+
+/*
+ * Compiling
+ */
+
+typedef enum {
+	VALUE_MEMORY, // In its slot on the vm stack
+	VALUE_CONSTANT,
+	VALUE_REGISTER, // In a temporary register, numbers are unboxed, anything else is kept as its bits
+	VALUE_CONDITION // Flags of a comparison, only until the jump right after it
+} LitTraceValueType;
+
+typedef struct {
+	LitTraceValueType type;
+	LitValue constant;
+	int xmm;
+	bool integer; // The register holds an int as a double
+	uint8_t condition;
+} LitTraceValue;
+
+typedef struct {
+	LitVm* vm;
+	LitChunk* chunk;
+	LitAssembler assembler;
+
+	LitTraceValue stack[VM_STACK_MAX];
+	int depth;
+	int base;
+
+	int locals[LOCAL_REGISTERS]; // Slot, that xmm8 + i holds
+	bool local_integers[LOCAL_REGISTERS];
+	bool entry_integers[LOCAL_REGISTERS]; // What the locals are at the header, the loop has to leave them the same
+	int local_count;
+	bool used[TEMPORARY_REGISTERS];
+
+	LitTraceStep* step; // The types, that it recorded, are what values from memory are expected to be
+	uint32_t epilogue;
+} LitTraceCompiler;
+
+static void guard(LitTraceCompiler* compiler, uint8_t condition, uint32_t offset);
+
+static int local_register(LitTraceCompiler* compiler, int slot) {
+	for (int i = 0; i < compiler->local_count; i++) {
+		if (compiler->locals[i] == slot) {
+			return TEMPORARY_REGISTERS + i;
+		}
+	}
+
+	return -1;
+}
+
+static void release(LitTraceCompiler* compiler, LitTraceValue* value) {
+	if (value->type == VALUE_REGISTER) {
+		compiler->used[value->xmm] = false;
+	}
+}
+
+// Writes the register into the slot, ints are boxed again, uses rax and rcx
+static void store_register(LitTraceCompiler* compiler, int xmm, bool integer, int slot) {
+	LitAssembler* assembler = &compiler->assembler;
+
+	if (integer) {
+		lit_asm_sse_registers(assembler, 0xf2, CVTTSD2SI, RAX, xmm);
+		lit_asm_box_int(assembler, RAX, RCX);
+		lit_asm_store(assembler, R13, SLOT(slot), RAX);
+	} else {
+		lit_asm_sse(assembler, 0xf2, MOVSD_STORE, xmm, R13, SLOT(slot));
+	}
+}
+
+// Writes the value of the stack entry into the slot, the entry stays as it is
+static void store_value(LitTraceCompiler* compiler, int index, int slot) {
+	LitAssembler* assembler = &compiler->assembler;
+	LitTraceValue* value = &compiler->stack[index];
+
+	switch (value->type) {
+		case VALUE_MEMORY: {
+			if (index != slot) {
+				lit_asm_load(assembler, RAX, R13, SLOT(index));
+				lit_asm_store(assembler, R13, SLOT(slot), RAX);
+			}
+
+			break;
+		}
+
+		case VALUE_CONSTANT: {
+			lit_asm_immediate(assembler, RAX, value->constant);
+			lit_asm_store(assembler, R13, SLOT(slot), RAX);
+			break;
+		}
+
+		case VALUE_REGISTER: {
+			store_register(compiler, value->xmm, value->integer, slot);
+			break;
+		}
+
+		case VALUE_CONDITION: {
+			lit_asm_set(assembler, value->condition);
+			lit_asm_bool(assembler, false);
+			lit_asm_store(assembler, R13, SLOT(slot), RAX);
+			break;
+		}
+	}
+}
+
+static void spill(LitTraceCompiler* compiler, int index) {
+	LitTraceValue* value = &compiler->stack[index];
+
+	if (value->type != VALUE_MEMORY) {
+		store_value(compiler, index, index);
+		release(compiler, value);
+		value->type = VALUE_MEMORY;
+	}
+}
+
+// Returns a free temporary register, the deepest entry in a register is spilled, if there is none
+// The two entries on top are never spilled, they are the operands of the instruction
+static int allocate(LitTraceCompiler* compiler) {
+	for (int i = 0; i < TEMPORARY_REGISTERS; i++) {
+		if (!compiler->used[i]) {
+			compiler->used[i] = true;
+			return i;
+		}
+	}
+
+	for (int i = compiler->base; i < compiler->depth - 2; i++) {
+		if (compiler->stack[i].type == VALUE_REGISTER) {
+			int xmm = compiler->stack[i].xmm;
+			spill(compiler, i);
+			compiler->used[xmm] = true;
+
+			return xmm;
+		}
+	}
+
+	UNREACHABLE();
+	return 0;
+}
+
+// Moves the bits in rax into a new register entry
+static void set_from_rax(LitTraceCompiler* compiler, int index) {
+	int xmm = allocate(compiler);
+	lit_asm_to_xmm(&compiler->assembler, xmm, RAX);
+
+	compiler->stack[index].type = VALUE_REGISTER;
+	compiler->stack[index].xmm = xmm;
+	compiler->stack[index].integer = false;
+}
+
+// Whether the recording saw an int in the entry, only the two entries on top are recorded
+static bool recorded_int(LitTraceCompiler* compiler, int index) {
+	int below = compiler->depth - 1 - index;
+	return below <= 1 && (compiler->step->integers & (INTEGER_TOP << below)) != 0;
+}
+
+// Loads the value at [base + disp] into rax, side exits, unless it is an int or not, like the recording saw it
+static void guard_type(LitTraceCompiler* compiler, int base, int32_t disp, bool integer) {
+	lit_asm_load(&compiler->assembler, RAX, base, disp);
+	lit_asm_check_int(&compiler->assembler, RAX);
+	guard(compiler, integer ? CONDITION_EQUAL : CONDITION_NOT_EQUAL, compiler->step->offset);
+}
+
+// Same as above, but the value goes on into the register
+static void load_typed(LitTraceCompiler* compiler, int xmm, int base, int32_t disp, bool integer) {
+	LitAssembler* assembler = &compiler->assembler;
+	guard_type(compiler, base, disp, integer);
+
+	if (integer) {
+		lit_asm_sse_registers(assembler, 0xf2, CVTSI2SD, xmm, RAX);
+	} else {
+		lit_asm_to_xmm(assembler, xmm, RAX);
+	}
+}
+
+// Moves the entry into a temporary register, that it owns, and returns the register
+static int to_register(LitTraceCompiler* compiler, int index) {
+	LitAssembler* assembler = &compiler->assembler;
+	LitTraceValue* value = &compiler->stack[index];
+
+	switch (value->type) {
+		case VALUE_REGISTER: break;
+
+		case VALUE_MEMORY: {
+			int xmm = allocate(compiler);
+			bool integer = recorded_int(compiler, index);
+
+			load_typed(compiler, xmm, R13, SLOT(index), integer);
+
+			value->type = VALUE_REGISTER;
+			value->xmm = xmm;
+			value->integer = integer;
+
+			break;
+		}
+
+		case VALUE_CONSTANT: {
+			LitValue constant = value->constant;
+			lit_asm_immediate(assembler, RAX, IS_INT(constant) ? MAKE_NUMBER_VALUE(AS_NUMBER(constant)) : constant);
+			set_from_rax(compiler, index);
+			value->integer = IS_INT(constant);
+
+			break;
+		}
+
+		case VALUE_CONDITION: {
+			lit_asm_set(assembler, value->condition);
+			lit_asm_bool(assembler, false);
+			set_from_rax(compiler, index);
+			break;
+		}
+	}
+
+	return value->xmm;
+}
+
+/*
+ * Same as above, but only for the number in the entry, that is used right away,
+ * ints in memory are converted without a guard, so the entry has to be popped after it
+ */
+static int to_number_register(LitTraceCompiler* compiler, int index) {
+	LitTraceValue* value = &compiler->stack[index];
+
+	if (value->type != VALUE_MEMORY) {
+		return to_register(compiler, index);
+	}
+
+	int xmm = allocate(compiler);
+	lit_asm_unbox(&compiler->assembler, xmm, R13, SLOT(index));
+
+	value->type = VALUE_REGISTER;
+	value->xmm = xmm;
+	value->integer = false;
+
+	return xmm;
+}
+
+// Loads the bits of the entry into rax, ints are boxed, uses rcx
+static void to_rax(LitTraceCompiler* compiler, int index) {
+	LitTraceValue* value = &compiler->stack[index];
+
+	if (value->type == VALUE_MEMORY) {
+		lit_asm_load(&compiler->assembler, RAX, R13, SLOT(index));
+	} else if (value->type == VALUE_CONSTANT) {
+		lit_asm_immediate(&compiler->assembler, RAX, value->constant);
+	} else {
+		int xmm = to_register(compiler, index);
+
+		if (value->integer) {
+			lit_asm_sse_registers(&compiler->assembler, 0xf2, CVTTSD2SI, RAX, xmm);
+			lit_asm_box_int(&compiler->assembler, RAX, RCX);
+		} else {
+			lit_asm_from_xmm(&compiler->assembler, RAX, xmm);
+		}
+	}
+}
+
+// Copies the entry into the other one, that holds nothing
+static void copy(LitTraceCompiler* compiler, int from, int to) {
+	LitTraceValue* value = &compiler->stack[from];
+
+	if (value->type == VALUE_CONSTANT) {
+		compiler->stack[to] = *value;
+		return;
+	}
+
+	// Memory entries are copied as they are, so they stay ints or not
+	if (value->type == VALUE_MEMORY) {
+		lit_asm_load(&compiler->assembler, RAX, R13, SLOT(from));
+		lit_asm_store(&compiler->assembler, R13, SLOT(to), RAX);
+		compiler->stack[to].type = VALUE_MEMORY;
+
+		return;
+	}
+
+	int xmm = allocate(compiler);
+	bool integer = false;
+
+	if (value->type == VALUE_CONDITION) {
+		lit_asm_set(&compiler->assembler, value->condition);
+		lit_asm_bool(&compiler->assembler, false);
+		lit_asm_to_xmm(&compiler->assembler, xmm, RAX);
+	} else {
+		lit_asm_sse_registers(&compiler->assembler, 0x66, MOVAPD, xmm, value->xmm);
+		integer = value->integer;
+	}
+
+	compiler->stack[to].type = VALUE_REGISTER;
+	compiler->stack[to].xmm = xmm;
+	compiler->stack[to].integer = integer;
+}
+
+static void push_constant(LitTraceCompiler* compiler, LitValue constant) {
+	LitTraceValue* value = &compiler->stack[compiler->depth++];
+
+	value->type = VALUE_CONSTANT;
+	value->constant = constant;
+}
+
+static void pop(LitTraceCompiler* compiler) {
+	release(compiler, &compiler->stack[--compiler->depth]);
+}
+
+static void sync_stack_top(LitTraceCompiler* compiler) {
+	lit_asm_address(&compiler->assembler, RAX, R13, SLOT(compiler->depth));
+	lit_asm_store(&compiler->assembler, R12, offsetof(LitVm, stack_top), RAX);
+}
+
+static void store_locals(LitTraceCompiler* compiler) {
+	for (int i = 0; i < compiler->local_count; i++) {
+		store_register(compiler, TEMPORARY_REGISTERS + i, compiler->local_integers[i], compiler->locals[i]);
+	}
+}
+
+// The locals are loaded as what the trace knows them to be, helpers don't change them
+static void load_locals(LitTraceCompiler* compiler) {
+	LitAssembler* assembler = &compiler->assembler;
+
+	for (int i = 0; i < compiler->local_count; i++) {
+		if (compiler->local_integers[i]) {
+			lit_asm_load(assembler, RAX, R13, SLOT(compiler->locals[i]));
+			lit_asm_sse_registers(assembler, 0xf2, CVTSI2SD, TEMPORARY_REGISTERS + i, RAX);
+		} else {
+			lit_asm_sse(assembler, 0xf2, MOVSD_LOAD, TEMPORARY_REGISTERS + i, R13, SLOT(compiler->locals[i]));
+		}
+	}
+}
+
+// Helpers are free to use any sse register and may collect garbage, so everything goes to the vm stack first
+static void flush(LitTraceCompiler* compiler) {
+	for (int i = compiler->base; i < compiler->depth; i++) {
+		spill(compiler, i);
+	}
+
+	store_locals(compiler);
+	sync_stack_top(compiler);
+}
+
+// The result stays in rax, rbx keeps it, while the locals are loaded
+static void call(LitTraceCompiler* compiler, void* function) {
+	lit_asm_call(&compiler->assembler, function);
+
+	if (compiler->local_count > 0) {
+		lit_asm_move(&compiler->assembler, RBX, RAX);
+		load_locals(compiler);
+		lit_asm_move(&compiler->assembler, RAX, RBX);
+	}
+}
+
+// Writes everything back and leaves the trace, the interpreter goes on from the instruction at the offset
+static void emit_exit(LitTraceCompiler* compiler, uint32_t offset) {
+	LitAssembler* assembler = &compiler->assembler;
+
+	for (int i = compiler->base; i < compiler->depth; i++) {
+		store_value(compiler, i, i);
+	}
+
+	store_locals(compiler);
+	sync_stack_top(compiler);
+
+	lit_asm_immediate(assembler, RAX, (uint64_t) (uintptr_t) (compiler->chunk->code + offset));
+	lit_asm_store(assembler, R14, offsetof(LitFrame, ip), RAX);
+	lit_asm_patch(assembler, lit_asm_jump(assembler, CONDITION_ALWAYS), compiler->epilogue);
+}
+
+// The trace goes on, if the condition holds, and side exits otherwise
+static void guard(LitTraceCompiler* compiler, uint8_t condition, uint32_t offset) {
+	uint32_t pass = lit_asm_jump(&compiler->assembler, condition);
+
+	emit_exit(compiler, offset);
+	lit_asm_patch(&compiler->assembler, pass, lit_asm_position(&compiler->assembler));
+}
+
+// Compares the register with the number in the entry
+static void emit_compare(LitTraceCompiler* compiler, int xmm, int index) {
+	lit_asm_sse_registers(&compiler->assembler, 0x66, UCOMISD, xmm, to_number_register(compiler, index));
+}
+
+static bool is_number_constant(LitTraceValue* value) {
+	return value->type == VALUE_CONSTANT && IS_NUMBER(value->constant);
+}
+
+// Mirrors the math opcodes in the vm, two ints stay an int, unless the opcode would give a double
+static LitValue fold(LitOpCode opcode, LitValue a, LitValue b) {
+	int32_t result;
+
+	if (IS_INT(a) && IS_INT(b)) {
+		int32_t x = AS_INT(a);
+		int32_t y = AS_INT(b);
+
+		switch (opcode) {
+			case OP_ADD: {
+				if (!__builtin_add_overflow(x, y, &result)) {
+					return MAKE_INT_VALUE(result);
+				}
+
+				break;
+			}
+
+			case OP_SUBTRACT: {
+				if (!__builtin_sub_overflow(x, y, &result)) {
+					return MAKE_INT_VALUE(result);
+				}
+
+				break;
+			}
+
+			case OP_MULTIPLY: {
+				if (!__builtin_mul_overflow(x, y, &result) && (result != 0 || (x >= 0 && y >= 0))) {
+					return MAKE_INT_VALUE(result);
+				}
+
+				break;
+			}
+
+			default: {
+				if (y > 0 && x % y == 0) {
+					return MAKE_INT_VALUE(x / y);
+				}
+
+				break;
+			}
+		}
+	}
+
+	switch (opcode) {
+		case OP_ADD: return MAKE_NUMBER_VALUE(AS_NUMBER(a) + AS_NUMBER(b));
+		case OP_SUBTRACT: return MAKE_NUMBER_VALUE(AS_NUMBER(a) - AS_NUMBER(b));
+		case OP_MULTIPLY: return MAKE_NUMBER_VALUE(AS_NUMBER(a) * AS_NUMBER(b));
+		default: return MAKE_NUMBER_VALUE(AS_NUMBER(a) / AS_NUMBER(b));
+	}
+}
+
+// -0 is a double, and so is the negated INT32_MIN
+static LitValue negate(LitValue value) {
+	if (IS_INT(value) && AS_INT(value) != 0 && AS_INT(value) != INT32_MIN) {
+		return MAKE_INT_VALUE(-AS_INT(value));
+	}
+
+	return MAKE_NUMBER_VALUE(-AS_NUMBER(value));
+}
+
+/*
+ * The vm keeps the result of ints an int, if it is whole, fits one and is not -0, divisions also need a positive divisor,
+ * the recorded result decides, which of both the guard expects, uses rax, rcx and rdx
+ */
+static void guard_int_result(LitTraceCompiler* compiler, int result, int divisor, bool integer) {
+	static const uint8_t set_no_parity_cl[] = { 0x0f, 0x9b, 0xc1 };
+	static const uint8_t set_not_equal_cl[] = { 0x0f, 0x95, 0xc1 };
+	static const uint8_t set_above_cl[] = { 0x0f, 0x97, 0xc1 };
+	static const uint8_t and_al_cl[] = { 0x20, 0xc8 };
+	static const uint8_t rol_rdx_1[] = { 0x48, 0xd1, 0xc2 };
+	static const uint8_t cmp_rdx_1[] = { 0x48, 0x83, 0xfa, 0x01 };
+	static const uint8_t test_al[] = { 0x84, 0xc0 };
+
+	LitAssembler* assembler = &compiler->assembler;
+	int scratch = allocate(compiler);
+
+	// Anything out of range is converted to INT32_MIN, so it doesn't come back as the same double
+	lit_asm_sse_registers(assembler, 0xf2, CVTTSD2SI, RAX, result);
+	lit_asm_sse_registers(assembler, 0xf2, CVTSI2SD, scratch, RAX);
+	lit_asm_sse_registers(assembler, 0x66, UCOMISD, result, scratch);
+	lit_asm_set(assembler, CONDITION_EQUAL);
+	lit_asm_bytes(assembler, set_no_parity_cl, sizeof(set_no_parity_cl));
+	lit_asm_bytes(assembler, and_al_cl, sizeof(and_al_cl));
+
+	// -0 is the only double, that rotates into 1
+	lit_asm_from_xmm(assembler, RDX, result);
+	lit_asm_bytes(assembler, rol_rdx_1, sizeof(rol_rdx_1));
+	lit_asm_bytes(assembler, cmp_rdx_1, sizeof(cmp_rdx_1));
+	lit_asm_bytes(assembler, set_not_equal_cl, sizeof(set_not_equal_cl));
+	lit_asm_bytes(assembler, and_al_cl, sizeof(and_al_cl));
+
+	if (divisor != -1) {
+		lit_asm_sse_registers(assembler, 0x66, XORPD, scratch, scratch);
+		lit_asm_sse_registers(assembler, 0x66, UCOMISD, divisor, scratch);
+		lit_asm_bytes(assembler, set_above_cl, sizeof(set_above_cl));
+		lit_asm_bytes(assembler, and_al_cl, sizeof(and_al_cl));
+	}
+
+	compiler->used[scratch] = false;
+
+	lit_asm_bytes(assembler, test_al, sizeof(test_al));
+	guard(compiler, integer ? CONDITION_NOT_EQUAL : CONDITION_EQUAL, compiler->step->offset);
+}
+
+// Gives the entry the checked result of the operation on ints, the entry itself stays, until the guard passed
+static void set_int_result(LitTraceCompiler* compiler, int index, int result, int divisor) {
+	LitTraceValue* value = &compiler->stack[index];
+	bool integer = (compiler->step->integers & INTEGER_RESULT) != 0;
+
+	guard_int_result(compiler, result, divisor, integer);
+	release(compiler, value);
+
+	value->xmm = result;
+	value->integer = integer;
+}
+
+static void compile_arithmetic(LitTraceCompiler* compiler, LitOpCode opcode) {
+	static const uint8_t opcodes[] = { ADDSD, SUBSD, MULSD, DIVSD };
+
+	LitAssembler* assembler = &compiler->assembler;
+	int a = compiler->depth - 2;
+	int b = compiler->depth - 1;
+	uint8_t operation = opcodes[opcode - OP_ADD];
+
+	if (is_number_constant(&compiler->stack[a]) && is_number_constant(&compiler->stack[b])) {
+		compiler->stack[a].constant = fold(opcode, compiler->stack[a].constant, compiler->stack[b].constant);
+		compiler->depth--;
+
+		return;
+	}
+
+	int left = to_register(compiler, a);
+	int right = to_register(compiler, b);
+
+	if (compiler->stack[a].integer && compiler->stack[b].integer) {
+		int result = allocate(compiler);
+
+		lit_asm_sse_registers(assembler, 0x66, MOVAPD, result, left);
+		lit_asm_sse_registers(assembler, 0xf2, operation, result, right);
+		set_int_result(compiler, a, result, opcode == OP_DIVIDE ? right : -1);
+	} else {
+		lit_asm_sse_registers(assembler, 0xf2, operation, left, right);
+		compiler->stack[a].integer = false;
+	}
+
+	pop(compiler);
+}
+
+// Unordered operands leave the carry set, so nan compares false, like in c
+static void compile_comparison(LitTraceCompiler* compiler, LitOpCode opcode, bool jump_follows) {
+	bool swap = opcode == OP_LESS || opcode == OP_LESS_EQUAL;
+	int left = compiler->depth - (swap ? 1 : 2);
+	int right = compiler->depth - (swap ? 2 : 1);
+
+	int xmm = to_number_register(compiler, left);
+	emit_compare(compiler, xmm, right);
+
+	pop(compiler);
+	pop(compiler);
+
+	LitTraceValue* value = &compiler->stack[compiler->depth++];
+
+	value->type = VALUE_CONDITION;
+	value->condition = (uint8_t) (opcode == OP_GREATER || opcode == OP_LESS ? CONDITION_ABOVE : CONDITION_ABOVE_EQUAL);
+
+	// The flags only live until the next instruction
+	if (!jump_follows) {
+		to_register(compiler, compiler->depth - 1);
+	}
+}
+
+static void guard_number(LitTraceCompiler* compiler, int index, uint32_t offset) {
+	static const uint8_t and_rax_rcx[] = { 0x48, 0x21, 0xc8 };
+	static const uint8_t cmp_rax_rcx[] = { 0x48, 0x39, 0xc8 };
+	static const uint8_t shr_rcx_32[] = { 0x48, 0xc1, 0xe9, 0x20 };
+	static const uint8_t cmp_ecx[] = { 0x81, 0xf9 };
+
+	LitAssembler* assembler = &compiler->assembler;
+
+	if (compiler->stack[index].type == VALUE_CONSTANT) {
+		return;
+	}
+
+	to_rax(compiler, index);
+
+	lit_asm_move(assembler, RCX, RAX);
+	lit_asm_bytes(assembler, shr_rcx_32, sizeof(shr_rcx_32));
+	lit_asm_bytes(assembler, cmp_ecx, sizeof(cmp_ecx));
+	lit_asm_u32(assembler, (uint32_t) (INT_TAG >> 32));
+	uint32_t is_int = lit_asm_jump(assembler, CONDITION_EQUAL);
+
+	lit_asm_immediate(assembler, RCX, QNAN);
+	lit_asm_bytes(assembler, and_rax_rcx, sizeof(and_rax_rcx));
+	lit_asm_bytes(assembler, cmp_rax_rcx, sizeof(cmp_rax_rcx));
+	guard(compiler, CONDITION_NOT_EQUAL, offset);
+
+	lit_asm_patch(assembler, is_int, lit_asm_position(assembler));
+}
+
+// Whether the entry is an int, a memory entry is guarded to be, what the recording saw
+static bool is_int(LitTraceCompiler* compiler, int index) {
+	LitTraceValue* value = &compiler->stack[index];
+
+	switch (value->type) {
+		case VALUE_CONSTANT: return IS_INT(value->constant);
+		case VALUE_REGISTER: return value->integer;
+		case VALUE_CONDITION: return false;
+
+		case VALUE_MEMORY: {
+			bool integer = recorded_int(compiler, index);
+			guard_type(compiler, R13, SLOT(index), integer);
+
+			return integer;
+		}
+	}
+
+	return false;
+}
+
+static LitValue get_global(LitVm* vm, LitString* name) {
+	return *lit_table_get(&vm->globals, name);
+}
+
+static void set_global(LitVm* vm, LitString* name, LitValue value) {
+	lit_table_set(MM(vm), &vm->globals, name, value);
+}
+
+// Returns NULL, if the value is not an instance of the class, that the trace saw, or has no such field
+static LitValue* get_field(LitValue from, LitClass* class, LitString* name) {
+	if (!IS_INSTANCE(from) || AS_INSTANCE(from)->type != class || lit_table_get(&class->methods, name) != NULL) {
+		return NULL;
+	}
+
+	return lit_table_get(&AS_INSTANCE(from)->fields, name);
+}
+
+static bool set_field(LitVm* vm, LitValue from, LitString* name, LitValue value) {
+	if (!IS_INSTANCE(from)) {
+		return false;
+	}
+
+	lit_table_set(MM(vm), &AS_INSTANCE(from)->fields, name, value);
+	return true;
+}
+
+static void compile_equality(LitTraceCompiler* compiler, LitTraceStep* step, bool not_equal) {
+	static const uint8_t set_no_parity_cl[] = { 0x0f, 0x9b, 0xc1 };
+	static const uint8_t and_al_cl[] = { 0x20, 0xc8 };
+
+	LitAssembler* assembler = &compiler->assembler;
+	int a = compiler->depth - 2;
+	int b = compiler->depth - 1;
+	bool numbers = step->observed == OBSERVED_NUMBER;
+
+	for (int i = a; i <= b; i++) {
+		if (compiler->stack[i].type == VALUE_CONSTANT && !IS_NUMBER(compiler->stack[i].constant)) {
+			numbers = false;
+		}
+	}
+
+	if (numbers) {
+		guard_number(compiler, a, step->offset);
+		guard_number(compiler, b, step->offset);
+
+		// Equal means, that zero is set and parity is not, nan is unordered and sets both
+		int xmm = to_number_register(compiler, a);
+		emit_compare(compiler, xmm, b);
+
+		lit_asm_set(assembler, CONDITION_EQUAL);
+		lit_asm_bytes(assembler, set_no_parity_cl, sizeof(set_no_parity_cl));
+		lit_asm_bytes(assembler, and_al_cl, sizeof(and_al_cl));
+	} else {
+		flush(compiler);
+
+		lit_asm_move(assembler, RDI, R12);
+		lit_asm_load(assembler, RSI, R13, SLOT(b));
+		lit_asm_load(assembler, RDX, R13, SLOT(a));
+		call(compiler, (void*) lit_are_values_equal);
+	}
+
+	lit_asm_bool(assembler, not_equal);
+
+	pop(compiler);
+	pop(compiler);
+	compiler->depth++;
+	set_from_rax(compiler, compiler->depth - 1);
+}
+
+static void compile_not(LitTraceCompiler* compiler, LitTraceStep* step) {
+	static const uint8_t sub_rax_rcx[] = { 0x48, 0x29, 0xc8 };
+	static const uint8_t cmp_rax_1[] = { 0x48, 0x83, 0xf8, 0x01 };
+	static const uint8_t xor_eax_1[] = { 0x83, 0xf0, 0x01 };
+	static const uint8_t add_rax_rcx[] = { 0x48, 0x01, 0xc8 };
+
+	LitAssembler* assembler = &compiler->assembler;
+	int top = compiler->depth - 1;
+	LitTraceValue* value = &compiler->stack[top];
+
+	if (value->type == VALUE_CONSTANT) {
+		value->constant = MAKE_BOOL_VALUE(lit_is_false(value->constant));
+		return;
+	}
+
+	if (value->type == VALUE_CONDITION) {
+		value->condition ^= 1;
+		return;
+	}
+
+	if (step->observed == OBSERVED_BOOL) {
+		// false and true are next to each other, so the bool is checked and flipped at once
+		to_rax(compiler, top);
+		lit_asm_immediate(assembler, RCX, FALSE_VALUE);
+		lit_asm_bytes(assembler, sub_rax_rcx, sizeof(sub_rax_rcx));
+		lit_asm_bytes(assembler, cmp_rax_1, sizeof(cmp_rax_1));
+		guard(compiler, CONDITION_BELOW_EQUAL, step->offset);
+		lit_asm_bytes(assembler, xor_eax_1, sizeof(xor_eax_1));
+		lit_asm_bytes(assembler, add_rax_rcx, sizeof(add_rax_rcx));
+	} else {
+		flush(compiler);
+		lit_asm_load(assembler, RDI, R13, SLOT(top));
+		call(compiler, (void*) lit_is_false);
+		lit_asm_bool(assembler, false);
+	}
+
+	release(compiler, value);
+	set_from_rax(compiler, top);
+}
+
+// The trace follows the branch, that was taken, while recording, the other one side exits
+static bool compile_conditional_jump(LitTraceCompiler* compiler, LitTraceStep* step, bool if_true) {
+	static const uint8_t cmp_rax_rcx[] = { 0x48, 0x39, 0xc8 };
+	static const uint8_t test_al[] = { 0x84, 0xc0 };
+
+	LitAssembler* assembler = &compiler->assembler;
+	int top = compiler->depth - 1;
+	LitTraceValue* value = &compiler->stack[top];
+	bool truthy = if_true == step->taken;
+
+	switch (value->type) {
+		case VALUE_CONSTANT: {
+			return lit_is_false(value->constant) != truthy;
+		}
+
+		case VALUE_CONDITION: {
+			uint8_t condition = (uint8_t) (truthy ? value->condition : value->condition ^ 1);
+
+			value->type = VALUE_CONSTANT;
+			value->constant = MAKE_BOOL_VALUE(!truthy);
+			guard(compiler, condition, step->offset);
+
+			break;
+		}
+
+		default: {
+			if (step->observed == OBSERVED_BOOL) {
+				to_rax(compiler, top);
+				lit_asm_immediate(assembler, RCX, MAKE_BOOL_VALUE(truthy));
+				lit_asm_bytes(assembler, cmp_rax_rcx, sizeof(cmp_rax_rcx));
+				guard(compiler, CONDITION_EQUAL, step->offset);
+
+				release(compiler, value);
+				break;
+			}
+
+			flush(compiler);
+			lit_asm_load(assembler, RDI, R13, SLOT(top));
+			call(compiler, (void*) lit_is_false);
+			lit_asm_bytes(assembler, test_al, sizeof(test_al));
+			guard(compiler, truthy ? CONDITION_EQUAL : CONDITION_NOT_EQUAL, step->offset);
+
+			return true;
+		}
+	}
+
+	// Past the guard the value is known
+	value->type = VALUE_CONSTANT;
+	value->constant = MAKE_BOOL_VALUE(truthy);
+
+	return true;
+}
+
+static void emit_upvalue(LitTraceCompiler* compiler, int index) {
+	LitAssembler* assembler = &compiler->assembler;
+
+	lit_asm_load(assembler, RAX, R14, offsetof(LitFrame, closure));
+	lit_asm_load(assembler, RAX, RAX, offsetof(LitClosure, upvalues));
+	lit_asm_load(assembler, RAX, RAX, index * (int32_t) sizeof(LitUpvalue*));
+	lit_asm_load(assembler, RAX, RAX, offsetof(LitUpvalue, value));
+}
+
+static bool compile_step(LitTraceCompiler* compiler, LitTraceStep* step, LitTraceStep* next) {
+	LitAssembler* assembler = &compiler->assembler;
+	uint8_t* ip = compiler->chunk->code + step->offset;
+	LitValue* constants = compiler->chunk->constants.values;
+	int top = compiler->depth - 1;
+
+	compiler->step = step;
+
+	switch ((LitOpCode) *ip) {
+		case OP_CONSTANT: push_constant(compiler, constants[ip[1]]); break;
+		case OP_NIL: push_constant(compiler, NIL_VALUE); break;
+		case OP_TRUE: push_constant(compiler, TRUE_VALUE); break;
+		case OP_FALSE: push_constant(compiler, FALSE_VALUE); break;
+
+		case OP_POP: {
+			if (compiler->depth == compiler->base) {
+				return false;
+			}
+
+			pop(compiler);
+			break;
+		}
+
+		case OP_GET_LOCAL: {
+			int slot = ip[1];
+			int xmm = slot < compiler->base ? local_register(compiler, slot) : -1;
+
+			if (slot >= compiler->depth) {
+				return false;
+			}
+
+			if (slot >= compiler->base) {
+				compiler->stack[compiler->depth].type = VALUE_MEMORY;
+				compiler->depth++;
+				copy(compiler, slot, compiler->depth - 1);
+			} else if (xmm == -1) {
+				lit_asm_load(assembler, RAX, R13, SLOT(slot));
+				lit_asm_store(assembler, R13, SLOT(compiler->depth), RAX);
+				compiler->stack[compiler->depth++].type = VALUE_MEMORY;
+			} else {
+				int copy = allocate(compiler);
+				lit_asm_sse_registers(assembler, 0x66, MOVAPD, copy, xmm);
+
+				LitTraceValue* value = &compiler->stack[compiler->depth++];
+
+				value->type = VALUE_REGISTER;
+				value->xmm = copy;
+				value->integer = compiler->local_integers[xmm - TEMPORARY_REGISTERS];
+			}
+
+			break;
+		}
+
+		case OP_SET_LOCAL: {
+			int slot = ip[1];
+
+			if (slot >= top) {
+				return slot == top;
+			}
+
+			if (slot >= compiler->base) {
+				release(compiler, &compiler->stack[slot]);
+				compiler->stack[slot].type = VALUE_MEMORY;
+				copy(compiler, top, slot);
+
+				break;
+			}
+
+			int xmm = local_register(compiler, slot);
+
+			if (xmm == -1) {
+				store_value(compiler, top, slot);
+			} else if (compiler->stack[top].type == VALUE_MEMORY) {
+				bool integer = recorded_int(compiler, top);
+
+				load_typed(compiler, xmm, R13, SLOT(top), integer);
+				compiler->local_integers[xmm - TEMPORARY_REGISTERS] = integer;
+			} else {
+				lit_asm_sse_registers(assembler, 0x66, MOVAPD, xmm, to_register(compiler, top));
+				compiler->local_integers[xmm - TEMPORARY_REGISTERS] = compiler->stack[top].integer;
+			}
+
+			break;
+		}
+
+		// Upvalues are copied as they are, so they stay ints or not
+		case OP_GET_UPVALUE: {
+			emit_upvalue(compiler, ip[1]);
+			lit_asm_load(assembler, RAX, RAX, 0);
+			lit_asm_store(assembler, R13, SLOT(compiler->depth), RAX);
+			compiler->stack[compiler->depth++].type = VALUE_MEMORY;
+
+			break;
+		}
+
+		case OP_SET_UPVALUE: {
+			to_rax(compiler, top);
+			lit_asm_move(assembler, RDX, RAX);
+			emit_upvalue(compiler, ip[1]);
+			lit_asm_store(assembler, RAX, 0, RDX);
+
+			break;
+		}
+
+		case OP_GET_GLOBAL: {
+			flush(compiler);
+			lit_asm_move(assembler, RDI, R12);
+			lit_asm_immediate(assembler, RSI, (uint64_t) (uintptr_t) AS_OBJECT(constants[ip[1]]));
+			call(compiler, (void*) get_global);
+
+			lit_asm_store(assembler, R13, SLOT(compiler->depth), RAX);
+			compiler->stack[compiler->depth++].type = VALUE_MEMORY;
+
+			break;
+		}
+
+		case OP_SET_GLOBAL: case OP_DEFINE_GLOBAL: {
+			flush(compiler);
+			lit_asm_move(assembler, RDI, R12);
+			lit_asm_immediate(assembler, RSI, (uint64_t) (uintptr_t) AS_OBJECT(constants[ip[1]]));
+			lit_asm_load(assembler, RDX, R13, SLOT(top));
+			call(compiler, (void*) set_global);
+
+			if (*ip == OP_DEFINE_GLOBAL) {
+				pop(compiler);
+			}
+
+			break;
+		}
+
+		case OP_GET_FIELD: {
+			static const uint8_t test_rax[] = { 0x48, 0x85, 0xc0 };
+
+			flush(compiler);
+			lit_asm_load(assembler, RDI, R13, SLOT(top));
+			lit_asm_immediate(assembler, RSI, (uint64_t) (uintptr_t) step->class);
+			lit_asm_immediate(assembler, RDX, (uint64_t) (uintptr_t) AS_OBJECT(constants[ip[1]]));
+			call(compiler, (void*) get_field);
+
+			lit_asm_bytes(assembler, test_rax, sizeof(test_rax));
+			guard(compiler, CONDITION_NOT_EQUAL, step->offset);
+			lit_asm_load(assembler, RAX, RAX, 0);
+			lit_asm_store(assembler, R13, SLOT(top), RAX);
+
+			break;
+		}
+
+		case OP_SET_FIELD: {
+			static const uint8_t test_al[] = { 0x84, 0xc0 };
+
+			flush(compiler);
+			lit_asm_move(assembler, RDI, R12);
+			lit_asm_load(assembler, RSI, R13, SLOT(top - 1));
+			lit_asm_immediate(assembler, RDX, (uint64_t) (uintptr_t) AS_OBJECT(constants[ip[1]]));
+			lit_asm_load(assembler, RCX, R13, SLOT(top));
+			call(compiler, (void*) set_field);
+
+			lit_asm_bytes(assembler, test_al, sizeof(test_al));
+			guard(compiler, CONDITION_NOT_EQUAL, step->offset);
+
+			// The value takes the place of the instance
+			store_value(compiler, top, top - 1);
+			compiler->depth--;
+
+			break;
+		}
+
+		case OP_NEGATE: {
+			static const uint8_t flip_sign[] = { 0x48, 0x0f, 0xba, 0xf8, 0x3f }; // btc rax, 63
+
+			if (is_number_constant(&compiler->stack[top])) {
+				compiler->stack[top].constant = negate(compiler->stack[top].constant);
+				break;
+			}
+
+			int xmm = to_register(compiler, top);
+			bool integer = compiler->stack[top].integer;
+			int result = integer ? allocate(compiler) : xmm;
+
+			lit_asm_from_xmm(assembler, RAX, xmm);
+			lit_asm_bytes(assembler, flip_sign, sizeof(flip_sign));
+			lit_asm_to_xmm(assembler, result, RAX);
+
+			if (integer) {
+				set_int_result(compiler, top, result, -1);
+			}
+
+			break;
+		}
+
+		case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE: {
+			compile_arithmetic(compiler, (LitOpCode) *ip);
+			break;
+		}
+
+		case OP_SQUARE: {
+			int xmm = to_number_register(compiler, top);
+
+			lit_asm_sse_registers(assembler, 0xf2, SQRTSD, xmm, xmm);
+			compiler->stack[top].integer = false;
+
+			break;
+		}
+
+		// Ints are already whole
+		case OP_FLOOR: {
+			if (is_int(compiler, top)) {
+				break;
+			}
+
+			flush(compiler);
+			lit_asm_unbox(assembler, 0, R13, SLOT(top));
+			lit_asm_call(assembler, (void*) floor);
+			lit_asm_sse(assembler, 0xf2, MOVSD_STORE, 0, R13, SLOT(top));
+			load_locals(compiler);
+
+			break;
+		}
+
+		case OP_GREATER: case OP_GREATER_EQUAL: case OP_LESS: case OP_LESS_EQUAL: {
+			LitOpCode following = next == NULL ? OP_RETURN : (LitOpCode) compiler->chunk->code[next->offset];
+			compile_comparison(compiler, (LitOpCode) *ip, following == OP_JUMP_IF_FALSE || following == OP_JUMP_IF_TRUE);
+
+			break;
+		}
+
+		case OP_EQUAL: case OP_NOT_EQUAL: {
+			compile_equality(compiler, step, *ip == OP_NOT_EQUAL);
+			break;
+		}
+
+		case OP_NOT: {
+			compile_not(compiler, step);
+			break;
+		}
+
+		case OP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE: {
+			return compile_conditional_jump(compiler, step, *ip == OP_JUMP_IF_TRUE);
+		}
+
+		case OP_JUMP: break;
+
+		// The recorder made sure, that it is the last step and closes the loop, the next iteration expects the locals as they were
+		case OP_LOOP: {
+			for (int i = 0; i < compiler->local_count; i++) {
+				if (compiler->local_integers[i] != compiler->entry_integers[i]) {
+					return false;
+				}
+			}
+
+			return compiler->depth == compiler->base;
+		}
+
+		default: return false;
+	}
+
+	return true;
+}
+
+// Picks the locals below the base, that the loop uses, to live in registers
+static void pick_locals(LitTraceCompiler* compiler, LitTraceRecorder* recorder) {
+	LitTraceSteps* steps = &recorder->steps;
+	compiler->local_count = 0;
+
+	for (int i = 0; i < steps->count && compiler->local_count < LOCAL_REGISTERS; i++) {
+		uint8_t* ip = compiler->chunk->code + steps->values[i].offset;
+
+		if ((*ip == OP_GET_LOCAL || *ip == OP_SET_LOCAL) && ip[1] < compiler->base && local_register(compiler, ip[1]) == -1) {
+			compiler->entry_integers[compiler->local_count] = recorder->integers[ip[1]];
+			compiler->local_integers[compiler->local_count] = recorder->integers[ip[1]];
+			compiler->locals[compiler->local_count++] = ip[1];
+		}
+	}
+}
+
+// The trace returns right away, before it loaded anything, if the locals are not, what they were at the recording
+static void check_locals(LitTraceCompiler* compiler) {
+	LitAssembler* assembler = &compiler->assembler;
+
+	for (int i = 0; i < compiler->local_count; i++) {
+		lit_asm_load(assembler, RAX, R13, SLOT(compiler->locals[i]));
+		lit_asm_check_int(assembler, RAX);
+		lit_asm_patch(assembler, lit_asm_jump(assembler, compiler->entry_integers[i] ? CONDITION_NOT_EQUAL : CONDITION_EQUAL), compiler->epilogue);
+	}
+}
+
+static bool compile(LitVm* vm, LitTraceRecorder* recorder) {
+#if defined(__x86_64__)
+	static const uint8_t jump_start[] = { 0xeb, 0x0a }; // Over the epilogue
+	LitTraceCompiler compiler;
+	LitAssembler* assembler = &compiler.assembler;
+	LitTrace* trace = recorder->trace;
+
+	compiler.vm = vm;
+	compiler.chunk = &recorder->frame->closure->function->chunk;
+	compiler.base = recorder->base;
+	compiler.depth = recorder->base;
+	compiler.step = NULL;
+
+	for (int i = 0; i < TEMPORARY_REGISTERS; i++) {
+		compiler.used[i] = false;
+	}
+
+	pick_locals(&compiler, recorder);
+	lit_init_assembler(assembler, MM(vm));
+
+	lit_asm_save(assembler);
+	lit_asm_move(assembler, R12, RDI);
+	lit_asm_move(assembler, R14, RSI);
+	lit_asm_load(assembler, R13, RSI, offsetof(LitFrame, slots));
+	lit_asm_bytes(assembler, jump_start, sizeof(jump_start));
+
+	compiler.epilogue = lit_asm_position(assembler);
+	lit_asm_restore(assembler);
+
+	check_locals(&compiler);
+	load_locals(&compiler);
+	uint32_t loop = lit_asm_position(assembler);
+	bool compiled = true;
+
+	for (int i = 0; i < recorder->steps.count && compiled; i++) {
+		LitTraceStep* next = i + 1 < recorder->steps.count ? &recorder->steps.values[i + 1] : NULL;
+		compiled = compile_step(&compiler, &recorder->steps.values[i], next);
+	}
+
+	if (compiled) {
+		lit_asm_patch(assembler, lit_asm_jump(assembler, CONDITION_ALWAYS), loop);
+
+		trace->size = (size_t) lit_asm_position(assembler);
+		trace->code = lit_asm_map(assembler);
+		trace->base = recorder->base;
+	}
+
+	lit_free_assembler(assembler);
+	return trace->code != NULL;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Recording
+ */
+
+static void stop_recording(LitVm* vm) {
+	LitTraceRecorder* recorder = vm->recorder;
+
+	lit_free_trace_steps(MM(vm), &recorder->steps);
+	FREE(vm, LitTraceRecorder, recorder);
+
+	vm->recorder = NULL;
+}
+
+static bool abort_recording(LitVm* vm) {
+	LitTrace* trace = vm->recorder->trace;
+
+	trace->blacklisted = true;
+	trace->countdown = INT32_MAX;
+	stop_recording(vm);
+
+	return false;
+}
+
+void lit_free_recorder(LitVm* vm) {
+	if (vm->recorder != NULL) {
+		stop_recording(vm);
+	}
+}
+
+static uint8_t observe(LitValue value) {
+	if (IS_BOOL(value)) {
+		return OBSERVED_BOOL;
+	}
+
+	return IS_NUMBER(value) ? OBSERVED_NUMBER : OBSERVED_OTHER;
+}
+
+bool lit_trace_record(LitVm* vm, LitFrame* frame) {
+	LitTraceRecorder* recorder = vm->recorder;
+	LitChunk* chunk = &frame->closure->function->chunk;
+	uint8_t* ip = frame->ip - 1;
+
+	if (frame != recorder->frame || vm->frame_count != recorder->frame_count || recorder->steps.count == LIT_TRACE_LENGTH) {
+		return abort_recording(vm);
+	}
+
+	// The stack is empty before the first push
+	LitValue top = vm->stack_top > vm->stack ? vm->stack_top[-1] : NIL_VALUE;
+	LitValue below = vm->stack_top - vm->stack > 1 ? vm->stack_top[-2] : NIL_VALUE;
+	uint8_t integers = (uint8_t) ((IS_INT(top) ? INTEGER_TOP : 0) | (IS_INT(below) ? INTEGER_BELOW : 0));
+	LitTraceStep step = { (uint32_t) (ip - chunk->code), OBSERVED_NOTHING, integers, false, NULL };
+
+	switch ((LitOpCode) *ip) {
+		case OP_CONSTANT: case OP_NIL: case OP_TRUE: case OP_FALSE: case OP_POP:
+		case OP_GET_LOCAL: case OP_SET_LOCAL: case OP_GET_UPVALUE: case OP_SET_UPVALUE:
+		case OP_GET_GLOBAL: case OP_SET_GLOBAL: case OP_DEFINE_GLOBAL:
+		case OP_SQUARE: case OP_FLOOR:
+		case OP_GREATER: case OP_GREATER_EQUAL: case OP_LESS: case OP_LESS_EQUAL: case OP_JUMP: {
+			break;
+		}
+
+		case OP_NEGATE: {
+			if (IS_INT(negate(top))) {
+				step.integers |= INTEGER_RESULT;
+			}
+
+			break;
+		}
+
+		case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE: {
+			if (IS_INT(fold((LitOpCode) *ip, below, top))) {
+				step.integers |= INTEGER_RESULT;
+			}
+
+			break;
+		}
+
+		case OP_EQUAL: case OP_NOT_EQUAL: {
+			step.observed = (uint8_t) (IS_NUMBER(top) && IS_NUMBER(below) ? OBSERVED_NUMBER : OBSERVED_OTHER);
+			break;
+		}
+
+		case OP_NOT: {
+			step.observed = observe(top);
+			break;
+		}
+
+		case OP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE: {
+			step.observed = observe(top);
+			step.taken = lit_is_false(top) == (*ip == OP_JUMP_IF_FALSE);
+
+			break;
+		}
+
+		// Only fields of instances, methods and statics go through the interpreter
+		case OP_GET_FIELD: {
+			LitString* name = AS_STRING(chunk->constants.values[ip[1]]);
+
+			if (!IS_INSTANCE(top) || lit_table_get(&AS_INSTANCE(top)->type->methods, name) != NULL || lit_table_get(&AS_INSTANCE(top)->fields, name) == NULL) {
+				return abort_recording(vm);
+			}
+
+			step.class = AS_INSTANCE(top)->type;
+			break;
+		}
+
+		case OP_SET_FIELD: {
+			if (!IS_INSTANCE(vm->stack_top[-2])) {
+				return abort_recording(vm);
+			}
+
+			break;
+		}
+
+		// Inner loops get their own traces
+		case OP_LOOP: {
+			uint16_t distance = (uint16_t) ((ip[1] << 8) | ip[2]);
+
+			if (ip + 3 - distance != recorder->trace->header) {
+				return abort_recording(vm);
+			}
+
+			break;
+		}
+
+		default: return abort_recording(vm);
+	}
+
+	lit_trace_steps_write(MM(vm), &recorder->steps, step);
+	return true;
+}
+
+bool lit_trace_loop(LitVm* vm, LitFrame* frame) {
+	// The recorder only lets the back edge of its own loop through, so the iteration is complete
+	if (vm->recorder != NULL) {
+		LitTraceRecorder* recorder = vm->recorder;
+
+		if (compile(vm, recorder)) {
+			recorder->trace->countdown = 0;
+		} else {
+			recorder->trace->blacklisted = true;
+			recorder->trace->countdown = INT32_MAX;
+		}
+
+		stop_recording(vm);
+	}
+
+	LitTrace* trace = lit_get_trace(vm, frame->closure->function, frame->ip);
+
+	if (trace->countdown > 0 && --trace->countdown > 0) {
+		return false;
+	}
+
+	if (trace->code != NULL) {
+		trace->countdown = 1;
+
+		// The stack always has the same depth at the header, but the trace relies on it
+		if (vm->stack_top - frame->slots == trace->base) {
+			((LitTraceEntry) trace->code)(vm, frame);
+		}
+
+		return false;
+	}
+
+	if (trace->blacklisted) {
+		trace->countdown = INT32_MAX;
+		return false;
+	}
+
+	LitTraceRecorder* recorder = ALLOCATE(vm, LitTraceRecorder, 1);
+
+	recorder->trace = trace;
+	recorder->frame = frame;
+	recorder->frame_count = vm->frame_count;
+	recorder->base = (int) (vm->stack_top - frame->slots);
+	lit_init_trace_steps(&recorder->steps);
+
+	for (int i = 0; i < recorder->base; i++) {
+		recorder->integers[i] = IS_INT(frame->slots[i]);
+	}
+
+	vm->recorder = recorder;
+	return true;
+}
\ No newline at end of file
@@ -6,11 +6,10 @@
 #include <vm/lit_object.h>
 #include <lit.h>
 
-// FIXME: move to non global
-static char output[21];
-static DoubleUnion data;
-
+// Numbers and chars are formatted into the buffer of the manager, so the result is valid until the next call
 char *lit_to_string(LitVm* vm, LitValue value) {
+	char* output = MM(vm)->buffer;
+
 	if (IS_NUMBER(value)) {
 		snprintf(output, 21, "%g", AS_NUMBER(value));
 		output[20] = '\0';
@@ -25,6 +24,7 @@ char *lit_to_string(LitVm* vm, LitValue value) {
 	} else if (tag == TAG_TRUE) {
 		return "true";
 	} else if (tag == TAG_CHAR) {
+		DoubleUnion data;
 		data.bits64 = value;
 
 		snprintf(output, 2, "%c", data.bits16[0]);
@@ -62,6 +62,9 @@ char *lit_to_string(LitVm* vm, LitValue value) {
 			case OBJECT_CLOSURE: {
 				return lit_format_string(MM(vm), "<function %>", AS_CLOSURE(value)->function->name)->chars;
 			}
+			case OBJECT_FIBER: {
+				return "<fiber>";
+			}
 			default: UNREACHABLE();
 		}
 	}
@@ -75,6 +78,19 @@ bool lit_is_false(LitValue value) {
 		|| (IS_BOOL(value) && !AS_BOOL(value));
 }
 
-bool lit_are_values_equal(LitValue a, LitValue b) {
-	return a == b;
+bool lit_are_values_equal(LitVm* vm, LitValue a, LitValue b) {
+	if (IS_NUMBER(a) && IS_NUMBER(b)) {
+		return AS_NUMBER(a) == AS_NUMBER(b);
+	}
+
+	if (a == b) {
+		return true;
+	}
+
+	if (IS_STRING(a) && IS_STRING(b)) {
+		// Runtime strings are interned only once they get compared
+		return lit_intern_string(MM(vm), AS_STRING(a)) == lit_intern_string(MM(vm), AS_STRING(b));
+	}
+
+	return false;
 }
\ No newline at end of file
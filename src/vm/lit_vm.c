@@ -1,5 +1,9 @@
+#define _DEFAULT_SOURCE // PATH_MAX under -std=c99
 #include <stdio.h>
 #include <zconf.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
@@ -10,6 +14,12 @@
 #include <std/lit_std.h>
 #include <lit_debug.h>
 #include <vm/lit_object.h>
+#include <vm/lit_bytecode.h>
+#include <vm/lit_jit.h>
+#include <vm/lit_trace.h>
+#include <vm/lit_feedback.h>
+#include <vm/lit_loop.h>
+#include <compiler/lit_c_emitter.h>
 
 static inline void reset_stack(LitVm *vm) {
 	vm->stack_top = vm->stack;
@@ -33,7 +43,7 @@ LitValue lit_peek(LitVm* vm, int depth) {
 	return vm->stack_top[-1 - depth];
 }
 
-static void runtime_error(LitVm* vm, const char* format, ...) {
+void lit_runtime_error(LitVm* vm, const char* format, ...) {
 	va_list args;
 	va_start(args, format);
 	fprintf(stderr, "Runtime error: ");
@@ -54,7 +64,7 @@ static void runtime_error(LitVm* vm, const char* format, ...) {
 
 static bool call(LitVm* vm, LitClosure* closure, int arg_count) {
 	if (vm->frame_count == FRAMES_MAX) {
-		runtime_error(vm, "Stack overflow");
+		lit_runtime_error(vm, "Stack overflow");
 		return false;
 	}
 
@@ -86,6 +96,73 @@ static void trace_stack(LitVm* vm) {
 	}
 }
 
+// Saves the stack top, the frames and the upvalues of the running fiber and loads the ones of the other fiber
+static void switch_fiber(LitVm* vm, LitFiber* fiber) {
+	LitFiber* running = vm->fiber;
+
+	running->stack_top = vm->stack_top;
+	running->frame_count = vm->frame_count;
+	running->open_upvalues = vm->open_upvalues;
+
+	vm->fiber = fiber;
+	vm->stack = fiber->stack;
+	vm->stack_top = fiber->stack_top;
+	vm->frames = fiber->frames;
+	vm->frame_count = fiber->frame_count;
+	vm->open_upvalues = fiber->open_upvalues;
+}
+
+/*
+ * Called, once the native of Fiber.resume() or Fiber.yield() has returned and its arguments are popped
+ * Its result is handed to the next fiber, as the result of the yield() or the resume(), that it waits in,
+ * a fiber, that was never resumed, calls its function instead
+ */
+static void run_next_fiber(LitVm* vm) {
+	LitFiber* fiber = vm->next_fiber;
+	LitValue value = vm->stack_top[-1];
+
+	vm->next_fiber = NULL;
+	switch_fiber(vm, fiber);
+
+	if (vm->frame_count == 0) {
+		lit_push(vm, MAKE_OBJECT_VALUE(fiber->closure));
+		call(vm, fiber->closure, 0);
+	} else {
+		vm->stack_top[-1] = value;
+	}
+}
+
+// The function of the fiber returned, the result goes to the fiber, that resumed it
+static void finish_fiber(LitVm* vm, LitValue result) {
+	LitFiber* fiber = vm->fiber;
+	LitFiber* parent = fiber->parent;
+
+	fiber->parent = NULL;
+	switch_fiber(vm, parent);
+	lit_free_fiber_stack(MM(vm), fiber);
+
+	vm->stack_top[-1] = result;
+}
+
+// A fiber without a parent returned, the event loop goes on with the next task, if there is one
+static bool finish_task(LitVm* vm) {
+	LitFiber* fiber = vm->fiber;
+
+	if (!lit_loop_pending(vm)) {
+		return false;
+	}
+
+	lit_loop_next(vm);
+	run_next_fiber(vm);
+
+	// The main fiber keeps its stack, the vm was made with it
+	if (fiber->closure != NULL) {
+		lit_free_fiber_stack(MM(vm), fiber);
+	}
+
+	return true;
+}
+
 static bool invoke_simple(LitVm* vm, int arg_count, LitValue receiver, LitValue method) {
 	if (IS_NATIVE_METHOD(method)) {
 		int count = AS_NATIVE_METHOD(method)(vm, vm->stack_top[-arg_count - 2], vm->stack_top - arg_count, arg_count);
@@ -113,6 +190,10 @@ static bool invoke_simple(LitVm* vm, int arg_count, LitValue receiver, LitValue
 			lit_push(vm, values[i]);
 		}
 
+		if (vm->next_fiber != NULL) {
+			run_next_fiber(vm);
+		}
+
 		return true;
 	} else {
 		bool value = call(vm, AS_CLOSURE(method), arg_count);
@@ -130,12 +211,8 @@ static bool invoke(LitVm* vm, int arg_count) {
 	return invoke_simple(vm, arg_count, lit_peek(vm, arg_count + 1), lit_peek(vm, arg_count));
 }
 
-static bool last_native;
-static bool last_init;
-static bool last_super;
-
 static bool call_value(LitVm* vm, LitValue callee, int arg_count, bool static_init) {
-	last_native = false;
+	vm->last_native = false;
 
 	if (IS_OBJECT(callee)) {
 		switch (OBJECT_TYPE(callee)) {
@@ -143,7 +220,7 @@ static bool call_value(LitVm* vm, LitValue callee, int arg_count, bool static_in
 				return call(vm, AS_CLOSURE(callee), arg_count);
 			}
 			case OBJECT_NATIVE: {
-				last_native = true;
+				vm->last_native = true;
 				int count = AS_NATIVE(callee)(vm, vm->stack_top - arg_count, arg_count);
 
 				if (count == 0) {
@@ -168,6 +245,12 @@ static bool call_value(LitVm* vm, LitValue callee, int arg_count, bool static_in
 					lit_push(vm, values[i]);
 				}
 
+				// An async native parked the fiber, the frames of the next one are loaded
+				if (vm->next_fiber != NULL) {
+					run_next_fiber(vm);
+					vm->last_native = false;
+				}
+
 				return true;
 			}
 			case OBJECT_NATIVE_METHOD: {
@@ -176,8 +259,8 @@ static bool call_value(LitVm* vm, LitValue callee, int arg_count, bool static_in
 			case OBJECT_BOUND_METHOD: {
 				LitMethod* bound = AS_METHOD(callee);
 
-				vm->stack_top[-arg_count - (last_super ? 0 : 1)] = bound->receiver;
-				last_super = false;
+				vm->stack_top[-arg_count - (vm->last_super ? 0 : 1)] = bound->receiver;
+				vm->last_super = false;
 				return call(vm, bound->method, arg_count);
 			}
 			case OBJECT_CLASS: {
@@ -198,23 +281,24 @@ static bool call_value(LitVm* vm, LitValue callee, int arg_count, bool static_in
 
 					lit_push(vm, *initializer);
 
-					for (int i = 0; i < arg_count; i++) {
+					// The values were popped from the last one
+					for (int i = arg_count - 1; i >= 0; i--) {
 						lit_push(vm, values[i]);
 					}
 
-					last_init = true;
+					vm->last_init = true;
 
 					return invoke_simple(vm, arg_count, lit_peek(vm, arg_count + 1), *initializer);
 				}
 
-				last_native = true;
+				vm->last_native = true;
 				return true;
 			}
 			default: UNREACHABLE();
 		}
 	}
 
-	runtime_error(vm, "Can only call functions and classes");
+	lit_runtime_error(vm, "Can only call functions and classes");
 	return false;
 }
 
@@ -278,6 +362,29 @@ static void define_method(LitVm* vm, LitString* name) {
 	lit_pop(vm);
 }
 
+// Counts the calls and the loops of the function, once it is hot, the frame goes on natively
+static inline void enter_jit(LitVm* vm, LitFrame* frame, bool count) {
+	LitFunction* function = frame->closure->function;
+
+	if (function->compiled != NULL) {
+		if (frame->ip == function->chunk.code) {
+			lit_push(vm, function->compiled(frame->slots));
+
+			// The threaded code returns right after the last instruction
+			frame->ip = function->chunk.code + function->chunk.count;
+		}
+
+		return;
+	}
+
+	if (count && function->jit == NULL && function->hotness < LIT_JIT_THRESHOLD && ++function->hotness == LIT_JIT_THRESHOLD) {
+		lit_jit_compile(vm, function);
+	}
+
+	if (function->jit != NULL) {
+		lit_jit_run(vm, frame);
+	}
+}
 
 static bool interpret(LitVm* vm) {
 	static void* dispatch_table[] = {
@@ -286,19 +393,55 @@ static bool interpret(LitVm* vm) {
 #undef OPCODE
 	};
 
-	vm->abort = false;
+	// Same as the dispatch table, but the profiled instructions go through PROFILE first
+	void* profile_table[sizeof(dispatch_table) / sizeof(void*)];
 
-	register LitFrame* frame = &vm->frames[vm->frame_count - 1];
+	if (vm->profile) {
+		for (size_t i = 0; i < sizeof(dispatch_table) / sizeof(void*); i++) {
+			profile_table[i] = lit_is_profiled((LitOpCode) i) ? &&PROFILE : dispatch_table[i];
+		}
+	}
+
+	vm->abort = false;
+	lit_free_recorder(vm);
+
+	// While a loop is recorded, every instruction goes through the recorder first
+	bool recording = false;
+
+	/*
+	 * The interpreter runs the threaded code of the frame, ip points to the next instruction in it,
+	 * frame->ip is only synced, before anything else looks at it (calls, errors, the jit and the traces)
+	 */
+	register LitFrame* frame;
+	register LitThreadedInstruction* ip;
+	LitThreadedInstruction* instruction;
+	LitThreadedInstruction* threaded;
+	uint8_t* code;
 	register LitValue* stack = vm->stack;
 
-#define READ_BYTE() (*frame->ip++)
-#define READ_CONSTANT() (frame->closure->function->chunk.constants.values[READ_BYTE()])
+#define SAVE_IP() frame->ip = code + (ip - threaded)
+#define LOAD_IP() ip = threaded + (frame->ip - code)
+#define LOAD_FRAME() { \
+	stack = vm->stack; \
+	frame = &vm->frames[vm->frame_count - 1]; \
+	LitChunk* chunk = &frame->closure->function->chunk; \
+	if (chunk->threaded == NULL) { lit_chunk_thread(MM(vm), chunk, vm->profile ? profile_table : dispatch_table); } \
+	code = chunk->code; \
+	threaded = chunk->threaded; \
+	LOAD_IP(); \
+}
+#define READ_INDEX() (instruction->operand.index)
+#define READ_SECOND_INDEX() (instruction[1].operand.index)
+#define READ_CONSTANT() (instruction->operand.constant)
 #define READ_STRING() AS_STRING(READ_CONSTANT())
-#define READ_SHORT() (frame->ip += 2, (uint16_t) ((frame->ip[-2] << 8) | frame->ip[-1]))
 #define PUSH(value) { *vm->stack_top = value; vm->stack_top++; }
-#define POP() ({if (vm->stack_top == stack) { runtime_error(vm, "Attempt to pop below zero"); assert(false); } vm->stack_top--; *vm->stack_top; })
-#define PEEK(depth) (vm->stack_top[-1 - depth])
-#define CASE_CODE(name) CODE_##name:
+#define POP() ({if (vm->stack_top == stack) { SAVE_IP(); lit_runtime_error(vm, "Attempt to pop below zero"); assert(false); } vm->stack_top--; *vm->stack_top; })
+#define PEEK(depth) (vm->stack_top[-1 - (depth)])
+#define ARE_INTS(a, b) (IS_INT(a) && IS_INT(b))
+#define CASE_CODE(name) CODE_##name: instruction = ip; ip += lit_opcode_size(OP_##name);
+#define JIT_ENTER(count) if (vm->jit) { SAVE_IP(); enter_jit(vm, frame, count); LOAD_IP(); }
+
+	LOAD_FRAME()
 
 	while (true) {
 		if (vm->abort) {
@@ -307,10 +450,27 @@ static bool interpret(LitVm* vm) {
 
 		if (DEBUG_TRACE_EXECUTION) {
 			trace_stack(vm);
-			lit_disassemble_instruction(MM(vm), &frame->closure->function->chunk, (uint64_t) (frame->ip - frame->closure->function->chunk.code));
+			lit_disassemble_instruction(MM(vm), &frame->closure->function->chunk, (uint64_t) (ip - threaded));
+		}
+
+		if (recording) {
+			goto RECORD;
 		}
 
-		goto *dispatch_table[*frame->ip++];
+		goto *ip->handler;
+
+		RECORD: {
+			// The recorder expects the ip right after the opcode
+			frame->ip = code + (ip - threaded) + 1;
+			recording = lit_trace_record(vm, frame);
+
+			goto *ip->handler;
+		};
+
+		PROFILE: {
+			lit_feedback_record(vm, frame->closure->function, (uint64_t) (ip - threaded));
+			goto *dispatch_table[code[ip - threaded]];
+		};
 
 		CASE_CODE(CONSTANT) {
 			PUSH(READ_CONSTANT());
@@ -318,8 +478,8 @@ static bool interpret(LitVm* vm) {
 		};
 
 		CASE_CODE(RETURN) {
-			if (last_init) {
-				last_init = false;
+			if (vm->last_init) {
+				vm->last_init = false;
 				close_upvalues(vm, frame->slots);
 				vm->frame_count--;
 
@@ -335,79 +495,144 @@ static bool interpret(LitVm* vm) {
 				vm->frame_count--;
 
 				if (vm->frame_count == 0) {
-					return false;
+					if (vm->fiber->parent != NULL) {
+						finish_fiber(vm, result);
+					} else if (!finish_task(vm)) {
+						return false;
+					}
+				} else {
+					vm->stack_top = frame->slots - 1;
+					PUSH(result);
 				}
-
-				vm->stack_top = frame->slots - 1;
-				PUSH(result);
 			}
 
-			frame = &vm->frames[vm->frame_count - 1];
+			LOAD_FRAME()
 
 			if (DEBUG_TRACE_EXECUTION) {
 				printf("== %s ==\n", frame->closure->function->name == NULL ? "top-level" : frame->closure->function->name->chars);
 			}
 
+			// The caller goes on natively, if it was left for the call
+			JIT_ENTER(false)
 			continue;
 		};
 
 		CASE_CODE(STATIC_INIT) {
+			SAVE_IP();
+
 			if (!call_value(vm, PEEK(0), 0, true)) {
 				return false;
 			}
 
-			frame = &vm->frames[vm->frame_count - 1];
+			LOAD_FRAME()
+			JIT_ENTER(true)
+
 			continue;
 		};
 
 		CASE_CODE(NEGATE) {
-			vm->stack_top[-1] = MAKE_NUMBER_VALUE(-AS_NUMBER(vm->stack_top[-1]));
+			LitValue a = vm->stack_top[-1];
+
+			// -0 is a double, and so is the negated INT32_MIN
+			if (IS_INT(a) && AS_INT(a) != 0 && AS_INT(a) != INT32_MIN) {
+				vm->stack_top[-1] = MAKE_INT_VALUE(-AS_INT(a));
+			} else {
+				vm->stack_top[-1] = MAKE_NUMBER_VALUE(-AS_NUMBER(a));
+			}
+
 			continue;
 		};
 
 		CASE_CODE(ADD) {
-			PUSH(MAKE_NUMBER_VALUE(AS_NUMBER(POP()) + AS_NUMBER(POP())));
+			LitValue b = POP();
+			LitValue a = vm->stack_top[-1];
+			int32_t result;
+
+			if (ARE_INTS(a, b) && !__builtin_add_overflow(AS_INT(a), AS_INT(b), &result)) {
+				vm->stack_top[-1] = MAKE_INT_VALUE(result);
+			} else {
+				vm->stack_top[-1] = MAKE_NUMBER_VALUE(AS_NUMBER(a) + AS_NUMBER(b));
+			}
+
 			continue;
 		};
 
 		CASE_CODE(SUBTRACT) {
 			LitValue b = POP();
-			PUSH(MAKE_NUMBER_VALUE(AS_NUMBER(POP()) - AS_NUMBER(b)));
+			LitValue a = vm->stack_top[-1];
+			int32_t result;
+
+			if (ARE_INTS(a, b) && !__builtin_sub_overflow(AS_INT(a), AS_INT(b), &result)) {
+				vm->stack_top[-1] = MAKE_INT_VALUE(result);
+			} else {
+				vm->stack_top[-1] = MAKE_NUMBER_VALUE(AS_NUMBER(a) - AS_NUMBER(b));
+			}
 
 			continue;
 		};
 
 		CASE_CODE(MULTIPLY) {
 			LitValue b = POP();
-			PUSH(MAKE_NUMBER_VALUE(AS_NUMBER(POP()) * AS_NUMBER(b)));
+			LitValue a = vm->stack_top[-1];
+			int32_t result;
+
+			// Zero times a negative number is -0
+			if (ARE_INTS(a, b) && !__builtin_mul_overflow(AS_INT(a), AS_INT(b), &result) && (result != 0 || (AS_INT(a) >= 0 && AS_INT(b) >= 0))) {
+				vm->stack_top[-1] = MAKE_INT_VALUE(result);
+			} else {
+				vm->stack_top[-1] = MAKE_NUMBER_VALUE(AS_NUMBER(a) * AS_NUMBER(b));
+			}
 
 			continue;
 		};
 
 		CASE_CODE(DIVIDE) {
 			LitValue b = POP();
-			PUSH(MAKE_NUMBER_VALUE(AS_NUMBER(POP()) / AS_NUMBER(b)));
+			LitValue a = vm->stack_top[-1];
+
+			// Only divisions without a remainder stay ints
+			if (ARE_INTS(a, b) && AS_INT(b) > 0 && AS_INT(a) % AS_INT(b) == 0) {
+				vm->stack_top[-1] = MAKE_INT_VALUE(AS_INT(a) / AS_INT(b));
+			} else {
+				vm->stack_top[-1] = MAKE_NUMBER_VALUE(AS_NUMBER(a) / AS_NUMBER(b));
+			}
 
 			continue;
 		};
 
 		CASE_CODE(MODULO) {
-			PUSH(MAKE_NUMBER_VALUE(fmod(AS_NUMBER(POP()), AS_NUMBER(POP()))));
+			LitValue b = POP();
+			LitValue a = vm->stack_top[-1];
+
+			// The remainder has the sign of a, like fmod, but a negative a without a remainder gives -0
+			if (ARE_INTS(a, b) && AS_INT(b) > 0 && (AS_INT(a) >= 0 || AS_INT(a) % AS_INT(b) != 0)) {
+				vm->stack_top[-1] = MAKE_INT_VALUE(AS_INT(a) % AS_INT(b));
+			} else {
+				vm->stack_top[-1] = MAKE_NUMBER_VALUE(fmod(AS_NUMBER(a), AS_NUMBER(b)));
+			}
+
 			continue;
 		};
 
 		CASE_CODE(FLOOR) {
-			vm->stack_top[-1] = MAKE_NUMBER_VALUE(floor(AS_NUMBER(vm->stack_top[-1])));
+			if (!IS_INT(vm->stack_top[-1])) {
+				vm->stack_top[-1] = MAKE_NUMBER_VALUE(floor(AS_NUMBER(vm->stack_top[-1])));
+			}
+
 			continue;
 		};
 
 		CASE_CODE(POWER) {
-			PUSH(MAKE_NUMBER_VALUE(pow(AS_NUMBER(POP()), AS_NUMBER(POP()))));
+			LitValue b = POP();
+			vm->stack_top[-1] = MAKE_NUMBER_VALUE(pow(AS_NUMBER(vm->stack_top[-1]), AS_NUMBER(b)));
+
 			continue;
 		};
 
 		CASE_CODE(ROOT) {
-			PUSH(MAKE_NUMBER_VALUE(pow(AS_NUMBER(POP()), 1.0 / AS_NUMBER(POP()))));
+			LitValue b = POP();
+			vm->stack_top[-1] = MAKE_NUMBER_VALUE(pow(AS_NUMBER(vm->stack_top[-1]), 1.0 / AS_NUMBER(b)));
+
 			continue;
 		};
 
@@ -438,42 +663,50 @@ static bool interpret(LitVm* vm) {
 
 		CASE_CODE(EQUAL) {
 			LitValue a = POP();
-			vm->stack_top[-1] = MAKE_BOOL_VALUE(AS_NUMBER(a) == AS_NUMBER(vm->stack_top[-1]));
+			vm->stack_top[-1] = MAKE_BOOL_VALUE(lit_are_values_equal(vm, a, vm->stack_top[-1]));
 
 			continue;
 		};
 
 		CASE_CODE(GREATER) {
 			LitValue a = POP();
-			vm->stack_top[-1] = MAKE_BOOL_VALUE(AS_NUMBER(a) < AS_NUMBER(vm->stack_top[-1]));
+			LitValue b = vm->stack_top[-1];
+
+			vm->stack_top[-1] = MAKE_BOOL_VALUE(ARE_INTS(a, b) ? AS_INT(a) < AS_INT(b) : AS_NUMBER(a) < AS_NUMBER(b));
 
 			continue;
 		};
 
 		CASE_CODE(LESS) {
 			LitValue a = POP();
-			vm->stack_top[-1] = MAKE_BOOL_VALUE(AS_NUMBER(a) > AS_NUMBER(vm->stack_top[-1]));
+			LitValue b = vm->stack_top[-1];
+
+			vm->stack_top[-1] = MAKE_BOOL_VALUE(ARE_INTS(a, b) ? AS_INT(a) > AS_INT(b) : AS_NUMBER(a) > AS_NUMBER(b));
 
 			continue;
 		};
 
 		CASE_CODE(GREATER_EQUAL) {
 			LitValue a = POP();
-			vm->stack_top[-1] = MAKE_BOOL_VALUE(AS_NUMBER(a) <= AS_NUMBER(vm->stack_top[-1]));
+			LitValue b = vm->stack_top[-1];
+
+			vm->stack_top[-1] = MAKE_BOOL_VALUE(ARE_INTS(a, b) ? AS_INT(a) <= AS_INT(b) : AS_NUMBER(a) <= AS_NUMBER(b));
 
 			continue;
 		};
 
 		CASE_CODE(LESS_EQUAL) {
 			LitValue a = POP();
-			vm->stack_top[-1] = MAKE_BOOL_VALUE(AS_NUMBER(a) >= AS_NUMBER(vm->stack_top[-1]));
+			LitValue b = vm->stack_top[-1];
+
+			vm->stack_top[-1] = MAKE_BOOL_VALUE(ARE_INTS(a, b) ? AS_INT(a) >= AS_INT(b) : AS_NUMBER(a) >= AS_NUMBER(b));
 
 			continue;
 		};
 
 		CASE_CODE(NOT_EQUAL) {
 			LitValue a = POP();
-			vm->stack_top[-1] = MAKE_BOOL_VALUE(AS_NUMBER(a) != AS_NUMBER(vm->stack_top[-1]));
+			vm->stack_top[-1] = MAKE_BOOL_VALUE(!lit_are_values_equal(vm, a, vm->stack_top[-1]));
 
 			continue;
 		};
@@ -509,55 +742,78 @@ static bool interpret(LitVm* vm) {
 		};
 
 		CASE_CODE(GET_LOCAL) {
-			PUSH(frame->slots[READ_BYTE()]);
+			PUSH(frame->slots[READ_INDEX()]);
 
 			continue;
 		};
 
 		CASE_CODE(SET_LOCAL) {
-			frame->slots[READ_BYTE()] = vm->stack_top[-1];
+			frame->slots[READ_INDEX()] = vm->stack_top[-1];
 			continue;
 		};
 
 		CASE_CODE(GET_UPVALUE) {
-			PUSH(*frame->closure->upvalues[READ_BYTE()]->value);
+			PUSH(*frame->closure->upvalues[READ_INDEX()]->value);
 			continue;
 		};
 
 		CASE_CODE(SET_UPVALUE) {
-			*frame->closure->upvalues[READ_BYTE()]->value = vm->stack_top[-1];
+			*frame->closure->upvalues[READ_INDEX()]->value = vm->stack_top[-1];
 			continue;
 		};
 
 		CASE_CODE(JUMP) {
-			frame->ip += READ_SHORT();
+			ip = instruction->operand.target;
 			continue;
 		};
 
 		CASE_CODE(JUMP_IF_FALSE) {
-			uint16_t offset = READ_SHORT();
-
 			if (lit_is_false(PEEK(0))) {
-				frame->ip += offset;
+				ip = instruction->operand.target;
+			}
+
+			continue;
+		};
+
+		CASE_CODE(JUMP_IF_TRUE) {
+			if (!lit_is_false(PEEK(0))) {
+				ip = instruction->operand.target;
 			}
 
 			continue;
 		};
 
 		CASE_CODE(LOOP) {
-			frame->ip -= READ_SHORT();
+			ip = instruction->operand.target;
+
+			if (vm->jit) {
+				SAVE_IP();
+				recording = lit_trace_loop(vm, frame);
+
+				if (recording) {
+					continue;
+				}
+
+				// A trace might have run the loop and left the frame somewhere else
+				LOAD_IP();
+			}
+
+			JIT_ENTER(true)
+
 			continue;
 		};
 
 		CASE_CODE(CLOSURE) {
 			LitFunction* function = AS_FUNCTION(READ_CONSTANT());
+			uint8_t* upvalues = code + (instruction - threaded) + 2;
 
 			LitClosure* closure = lit_new_closure(MM(vm), function);
 			PUSH(MAKE_OBJECT_VALUE(closure));
+			ip += closure->upvalue_count * 2;
 
 			for (int i = 0; i < closure->upvalue_count; i++) {
-				uint8_t is_local = READ_BYTE();
-				uint8_t index = READ_BYTE();
+				uint8_t is_local = *upvalues++;
+				uint8_t index = *upvalues++;
 
 				if (is_local) {
 					closure->upvalues[i] = capture_upvalue(vm, frame->slots + index);
@@ -570,16 +826,126 @@ static bool interpret(LitVm* vm) {
 		};
 
 		CASE_CODE(CALL) {
-			int arg_count = READ_BYTE();
+			int arg_count = (int) READ_INDEX();
+			SAVE_IP();
 
 			if (!call_value(vm, PEEK(arg_count), arg_count, false)) {
 				return false;
 			}
 
-			if (!last_native) {
-				frame = &vm->frames[vm->frame_count - 1];
+			if (!vm->last_native) {
+				LOAD_FRAME()
+				JIT_ENTER(true)
+			}
+
+			continue;
+		};
+
+		CASE_CODE(TAIL_CALL) {
+			int arg_count = (int) READ_INDEX();
+			LitValue callee = PEEK(arg_count);
+
+			SAVE_IP();
+
+			// Anything, but a plain closure, is called as usual and the next OP_RETURN returns its result
+			if (!IS_CLOSURE(callee) || vm->last_init) {
+				if (!call_value(vm, callee, arg_count, false)) {
+					return false;
+				}
+
+				if (!vm->last_native) {
+					LOAD_FRAME()
+					JIT_ENTER(true)
+				}
+
+				continue;
+			}
+
+			// The callee and the arguments take the place of the current function and its locals
+			LitValue* base = frame->slots - 1;
+			close_upvalues(vm, base);
+
+			memmove(base, vm->stack_top - arg_count - 1, sizeof(LitValue) * (arg_count + 1));
+			vm->stack_top = base + arg_count + 1;
+
+			frame->closure = AS_CLOSURE(callee);
+			frame->ip = frame->closure->function->chunk.code;
+			frame->slots = base + 1;
+
+			LOAD_FRAME()
+			JIT_ENTER(true)
+
+			continue;
+		};
+
+		CASE_CODE(CALL_DIRECT) {
+			LitClosure* closure = AS_CLOSURE(READ_CONSTANT());
+			SAVE_IP();
+
+			if (!call(vm, closure, (int) READ_SECOND_INDEX())) {
+				return false;
+			}
+
+			LOAD_FRAME()
+			JIT_ENTER(true)
+
+			continue;
+		};
+
+		CASE_CODE(TAIL_CALL_DIRECT) {
+			LitClosure* closure = AS_CLOSURE(READ_CONSTANT());
+			int arg_count = (int) READ_SECOND_INDEX();
+
+			SAVE_IP();
+
+			if (vm->last_init) {
+				if (!call(vm, closure, arg_count)) {
+					return false;
+				}
+
+				LOAD_FRAME()
+				JIT_ENTER(true)
+
+				continue;
+			}
+
+			LitValue* base = frame->slots - 1;
+			close_upvalues(vm, base);
+
+			memmove(base + 1, vm->stack_top - arg_count, sizeof(LitValue) * arg_count);
+			vm->stack_top = base + arg_count + 1;
+
+			frame->closure = closure;
+			frame->ip = closure->function->chunk.code;
+			frame->slots = base + 1;
+
+			LOAD_FRAME()
+			JIT_ENTER(true)
+
+			continue;
+		};
+
+		CASE_CODE(INVOKE_DIRECT) {
+			LitClosure* closure = AS_CLOSURE(READ_CONSTANT());
+			int arg_count = (int) READ_SECOND_INDEX();
+			LitValue receiver = PEEK(arg_count + 1);
+
+			SAVE_IP();
+
+			if (IS_NIL(receiver)) {
+				lit_runtime_error(vm, "Attempt to get a field from a nil value");
+				return false;
+			}
+
+			// The empty slot becomes this
+			if (!call(vm, closure, arg_count + 1)) {
+				return false;
 			}
 
+			LOAD_FRAME()
+			frame->slots[0] = receiver;
+			JIT_ENTER(true)
+
 			continue;
 		};
 
@@ -590,9 +956,10 @@ static bool interpret(LitVm* vm) {
 
 		CASE_CODE(SUBCLASS) {
 			LitValue super = POP();
+			SAVE_IP();
 
 			if (!IS_CLASS(super)) {
-				runtime_error(vm, "Superclass must be a class");
+				lit_runtime_error(vm, "Superclass must be a class");
 				return false;
 			}
 
@@ -607,6 +974,7 @@ static bool interpret(LitVm* vm) {
 
 		CASE_CODE(GET_FIELD) {
 			LitValue from = PEEK(0);
+			SAVE_IP();
 
 			if (IS_CLASS(from)) {
 				LitString *name = READ_STRING();
@@ -629,7 +997,7 @@ static bool interpret(LitVm* vm) {
 							POP();
 							PUSH(*method);
 						} else {
-							runtime_error(vm, "Class %s has no static field or method %s", class->name->chars, name->chars);
+							lit_runtime_error(vm, "Class %s has no static field or method %s", class->name->chars, name->chars);
 						}
 					}
 				}
@@ -637,21 +1005,16 @@ static bool interpret(LitVm* vm) {
 				LitClass *type = NULL;
 
 				if (IS_NIL(from)) {
-					runtime_error(vm, "Attempt to get a field from a nil value");
+					lit_runtime_error(vm, "Attempt to get a field from a nil value");
 					return false;
 				} else if (IS_STRING(from)) {
 					type = vm->string_class;
 				} else if (IS_CLASS(from)) {
 					type = vm->class_class;
 				} else if (IS_NUMBER(from)) {
-					double number = AS_NUMBER(from);
-					double temp;
-
-					if (modf(number, &temp) == 0) {
-						type = vm->int_class;
-					} else {
-						type = vm->double_class;
-					}
+					type = IS_INT(from) ? vm->int_class : vm->double_class;
+				} else if (IS_FIBER(from)) {
+					type = vm->fiber_class;
 				}
 
 				if (type != NULL || IS_INSTANCE(from)) {
@@ -669,11 +1032,11 @@ static bool interpret(LitVm* vm) {
 							POP();
 							PUSH(*field);
 						} else {
-							runtime_error(vm, "Class %s has no field or method %s", instance->type->name->chars, name->chars);
+							lit_runtime_error(vm, "Class %s has no field or method %s", instance->type->name->chars, name->chars);
 						}
 					}
 				} else {
-					runtime_error(vm, "Only instances and classes have properties");
+					lit_runtime_error(vm, "Only instances and classes have properties");
 					return false;
 				}
 			}
@@ -683,24 +1046,27 @@ static bool interpret(LitVm* vm) {
 
 		CASE_CODE(SET_FIELD) {
 			LitValue from = PEEK(1);
+			SAVE_IP();
 
 			if (IS_CLASS(from)) {
-				LitValue value = POP();
+				LitValue value = PEEK(0);
 				lit_table_set(MM(vm), &AS_CLASS(from)->static_fields, READ_STRING(), value);
 
+				POP();
 				POP();
 				PUSH(value);
 			} else if (IS_INSTANCE(from)) {
 				LitInstance* instance = AS_INSTANCE(PEEK(1));
-				LitValue value = POP();
+				LitValue value = PEEK(0);
 
 				lit_table_set(MM(vm), &instance->fields, READ_STRING(), value);
 
+				POP();
 				POP();
 				PUSH(value);
 			} else {
 				printf("%s\n", "test");
-				runtime_error(vm, "Only instances and classes have fields");
+				lit_runtime_error(vm, "Only instances and classes have fields");
 				return false;
 			}
 
@@ -708,34 +1074,41 @@ static bool interpret(LitVm* vm) {
 		};
 
 		CASE_CODE(INVOKE) {
-			int arg_count = READ_BYTE();
+			int arg_count = (int) READ_INDEX();
+			SAVE_IP();
 
 			if (!invoke(vm, arg_count)) {
 				return false;
 			}
 
-			frame = &vm->frames[vm->frame_count - 1];
+			LOAD_FRAME()
+			JIT_ENTER(true)
+
 			continue;
 		};
 
 		CASE_CODE(DEFINE_FIELD) {
+			SAVE_IP();
+
 			if (!IS_CLASS(PEEK(1))) {
-				runtime_error(vm, "Can't define a field in non-class");
+				lit_runtime_error(vm, "Can't define a field in non-class");
 				return false;
 			}
 
 			LitClass* class = AS_CLASS(PEEK(1));
-			lit_table_set(MM(vm), &class->fields, READ_STRING(), POP());
+			lit_table_set(MM(vm), &class->fields, READ_STRING(), PEEK(0));
+			POP();
 
 			continue;
 		};
 
 		CASE_CODE(DEFINE_METHOD) {
 			LitString* name = READ_STRING();
-			LitValue method = POP();
-			LitClass* class = AS_CLASS(PEEK(0));
+			LitClass* class = AS_CLASS(PEEK(1));
+
+			lit_table_set(MM(vm), &class->methods, name, PEEK(0));
+			POP();
 
-			lit_table_set(MM(vm), &class->methods, name, method);
 			continue;
 		};
 
@@ -743,13 +1116,14 @@ static bool interpret(LitVm* vm) {
 			LitString* name = READ_STRING();
 			LitInstance* instance = AS_INSTANCE(PEEK(0));
 			LitValue *method = lit_table_get(&instance->type->super->methods, name);
+			SAVE_IP();
 
 			if (method == NULL) {
-				runtime_error(vm, "Undefined method %s", name->chars);
+				lit_runtime_error(vm, "Undefined method %s", name->chars);
 				return false;
 			}
 
-			last_super = true;
+			vm->last_super = true;
 
 			LitMethod* bound = lit_new_bound_method(MM(vm), MAKE_OBJECT_VALUE(instance), AS_CLOSURE(*method));
 			PUSH(MAKE_OBJECT_VALUE(bound));
@@ -758,23 +1132,27 @@ static bool interpret(LitVm* vm) {
 		};
 
 		CASE_CODE(DEFINE_STATIC_FIELD) {
+			SAVE_IP();
+
 			if (!IS_CLASS(PEEK(1))) {
-				runtime_error(vm, "Can't define a field in non-class");
+				lit_runtime_error(vm, "Can't define a field in non-class");
 				return false;
 			}
 
 			LitClass* class = AS_CLASS(PEEK(1));
-			lit_table_set(MM(vm), &class->static_fields, READ_STRING(), POP());
+			lit_table_set(MM(vm), &class->static_fields, READ_STRING(), PEEK(0));
+			POP();
 
 			continue;
 		};
 
 		CASE_CODE(DEFINE_STATIC_METHOD) {
 			LitString* name = READ_STRING();
-			LitValue method = POP();
-			LitClass* class = AS_CLASS(PEEK(0));
+			LitClass* class = AS_CLASS(PEEK(1));
+
+			lit_table_set(MM(vm), &class->static_methods, name, PEEK(0));
+			POP();
 
-			lit_table_set(MM(vm), &class->static_methods, name, method);
 			continue;
 		};
 
@@ -801,17 +1179,22 @@ static bool interpret(LitVm* vm) {
 			continue;
 		};
 
-		runtime_error(vm, "Unknown opcode!");
+		lit_runtime_error(vm, "Unknown opcode!");
 	}
 
-#undef READ_BYTE
+#undef SAVE_IP
+#undef LOAD_IP
+#undef LOAD_FRAME
+#undef READ_INDEX
+#undef READ_SECOND_INDEX
 #undef READ_CONSTANT
 #undef READ_STRING
-#undef READ_SHORT
 #undef PUSH
 #undef POP
 #undef PEEK
+#undef ARE_INTS
 #undef CASE_CODE
+#undef JIT_ENTER
 
 	return true;
 }
@@ -825,9 +1208,15 @@ void lit_init_vm(LitVm* vm) {
 
 	lit_init_table(&manager->strings);
 
+	vm->stack = NULL;
+	vm->frames = NULL;
+	vm->fiber = NULL;
+	vm->next_fiber = NULL;
+	vm->loop = NULL;
 	reset_stack(vm);
 
 	lit_init_table(&vm->globals);
+	vm->init_string = NULL;
 
 	vm->next_gc = 1024 * 1024;
 	vm->gray_capacity = 0;
@@ -839,6 +1228,23 @@ void lit_init_vm(LitVm* vm) {
 	vm->string_class = NULL;
 	vm->int_class = NULL;
 	vm->double_class = NULL;
+	vm->fiber_class = NULL;
+
+	// Tracing shows every instruction, so it needs the interpreter
+	vm->jit = !DEBUG_TRACE_EXECUTION;
+	vm->recorder = NULL;
+	vm->profile = false;
+
+	vm->last_native = false;
+	vm->last_init = false;
+	vm->last_super = false;
+
+	// The main fiber runs the script, it is never done
+	vm->fiber = lit_new_fiber(manager, NULL);
+	vm->stack = vm->fiber->stack;
+	vm->frames = vm->fiber->frames;
+
+	reset_stack(vm);
 }
 
 void lit_free_vm(LitVm* vm) {
@@ -850,6 +1256,8 @@ void lit_free_vm(LitVm* vm) {
 
 	lit_free_table(MM(vm), &manager->strings);
 	lit_free_table(MM(vm), &vm->globals);
+	lit_free_recorder(vm);
+	lit_free_loop(vm);
 	lit_free_objects(MM(vm));
 
 	vm->init_string = NULL;
@@ -861,7 +1269,11 @@ void lit_free_vm(LitVm* vm) {
 
 bool lit_execute(LitVm* vm, LitFunction* function) {
 	if (!DEBUG_NO_EXECUTE) {
-		call_value(vm, MAKE_OBJECT_VALUE(lit_new_closure(MM(vm), function)), 0, false);
+		lit_push(vm, MAKE_OBJECT_VALUE(function));
+		LitClosure* closure = lit_new_closure(MM(vm), function);
+		lit_pop(vm);
+
+		call_value(vm, MAKE_OBJECT_VALUE(closure), 0, false);
 		return interpret(vm);
 	}
 
@@ -869,31 +1281,237 @@ bool lit_execute(LitVm* vm, LitFunction* function) {
 }
 
 bool lit_eval(const char* source_code) {
+	LitOptions options;
+	lit_init_options(&options);
+
+	return lit_eval_with_options(source_code, &options);
+}
+
+// Runs a function, that was made by the compiler, the compiler must be freed already
+static bool run_function(LitCompiler* compiler, LitLibRegistry* std, LitFunction* function, LitOptions* options) {
+	LitVm vm;
+	lit_init_vm(&vm);
+
+	// Compiled code would run past the profiled instructions
+	vm.jit &= options->jit && options->profile == NULL;
+	vm.profile = options->profile != NULL;
+
+	// The VM takes over the compiled functions and the interned strings
+	lit_move_objects(MM(&vm), MM(compiler));
+	vm.init_string = lit_copy_string(MM(&vm), "init", 4);
+
+	/*
+	 * The lib registry points to strings, that are not reachable from the vm yet,
+	 * so the gc is paused, until all the classes and natives are defined (and the profile is loaded)
+	 */
+	size_t next_gc = vm.next_gc;
+	vm.next_gc = SIZE_MAX;
+
+	lit_define_lib(&vm, std);
+
+	if (vm.profile) {
+		lit_load_profile(&vm, options->profile);
+	}
+
+	vm.next_gc = next_gc;
+	bool had_error = lit_execute(&vm, function);
+
+	if (vm.profile && !lit_save_profile(&vm, options->profile)) {
+		fprintf(stderr, "Could not save the profile to \"%s\"\n", options->profile);
+	}
+
+	lit_free_vm(&vm);
+
+	return !had_error;
+}
+
+// Loads the mapped functions into the compiler memory, returns NULL, if the file is broken
+static LitFunction* load_bytecode(LitCompiler* compiler, LitLibRegistry** std, LitBytecode* bytecode) {
+	// The std still has to be declared, the natives are defined from its registry
+	lit_init_compiler(compiler);
+	*std = lit_create_std(compiler);
+	lit_free_compiler(compiler);
+
+	LitFunction* function = lit_load_bytecode(MM(compiler), bytecode);
+
+	if (function == NULL) {
+		lit_free_bytecode_objects(compiler);
+	}
+
+	return function;
+}
+
+// Creates the directory with all of its parents
+static void make_directories(const char* path) {
+	char directory[PATH_MAX];
+	snprintf(directory, sizeof(directory), "%s", path);
+
+	for (char* current = directory + 1; *current != '\0'; current++) {
+		if (*current == '/') {
+			*current = '\0';
+			mkdir(directory, 0755);
+			*current = '/';
+		}
+	}
+
+	mkdir(directory, 0755);
+}
+
+static double milliseconds_since(clock_t start) {
+	return (double) (clock() - start) * 1000 / CLOCKS_PER_SEC;
+}
+
+bool lit_eval_with_options(const char* source_code, LitOptions* options) {
+	// Tracing needs the AST, so it always compiles
+	bool cached = options->cache != NULL && !options->trace_ast;
+	char path[PATH_MAX];
+
+	if (cached) {
+		snprintf(path, sizeof(path), "%s/%016lx.litc", options->cache, (unsigned long) lit_bytecode_key(source_code, options));
+		LitBytecode bytecode;
+
+		if (access(path, R_OK) == 0 && lit_map_bytecode(&bytecode, path, false)) {
+			clock_t start = clock();
+
+			LitCompiler compiler;
+			LitLibRegistry* std;
+			LitFunction* function = load_bytecode(&compiler, &std, &bytecode);
+
+			if (function != NULL) {
+				if (options->stats) {
+					fprintf(stderr, "Cache hit %s, loaded in %.3f ms\n", path, milliseconds_since(start));
+				}
+
+				bool result = run_function(&compiler, std, function, options);
+				lit_unmap_bytecode(&bytecode);
+
+				return result;
+			}
+
+			// A broken file is compiled and written again
+			lit_unmap_bytecode(&bytecode);
+		}
+	}
+
+	clock_t start = clock();
+
 	LitCompiler compiler;
 	lit_init_compiler(&compiler);
+	compiler.options = *options;
 	LitLibRegistry* std = lit_create_std(&compiler);
 
 	LitFunction* function = lit_compile(&compiler, source_code);
 	lit_free_compiler(&compiler);
 
+	if (options->stats) {
+		double time = milliseconds_since(start);
+
+		if (cached) {
+			fprintf(stderr, "Cache miss %s, compiled in %.3f ms\n", path, time);
+		} else {
+			fprintf(stderr, "Compiled in %.3f ms\n", time);
+		}
+	}
+
 	if (function == NULL) {
 		return false;
 	}
 
-	LitVm vm;
-	lit_init_vm(&vm);
+	if (cached) {
+		make_directories(options->cache);
 
-	lit_table_add_all(MM(&vm), &vm.mem_manager.strings, &compiler.mem_manager.strings);
-	vm.init_string = lit_copy_string(MM(&vm), "init", 4);
+		// The cache is only a help, the program runs without it
+		if (!lit_save_bytecode_atomic(MM(&compiler), function, path, true) && options->stats) {
+			fprintf(stderr, "Cache entry %s could not be saved\n", path);
+		}
+	}
 
-	lit_define_lib(&vm, std);
+	return run_function(&compiler, std, function, options);
+}
 
-	bool had_error = lit_execute(&vm, function);
+bool lit_compile_to_file(const char* source_code, const char* path, LitOptions* options) {
+	LitCompiler compiler;
+	lit_init_compiler(&compiler);
+	compiler.options = *options;
+	lit_create_std(&compiler);
 
-	lit_free_vm(&vm);
+	LitFunction* function = lit_compile(&compiler, source_code);
+	bool saved = function != NULL && lit_save_bytecode(MM(&compiler), function, path, !options->strip);
+
+	lit_free_compiler(&compiler);
 	lit_free_bytecode_objects(&compiler);
 
-	return !had_error;
+	return saved;
+}
+
+bool lit_compile_to_c(const char* source_code, const char* path, LitOptions* options) {
+	LitCompiler compiler;
+	lit_init_compiler(&compiler);
+	compiler.options = *options;
+	lit_create_std(&compiler);
+
+	LitCEmitter emitter;
+	lit_init_c_emitter(&compiler, &emitter);
+	compiler.c_emitter = &emitter;
+
+	LitFunction* function = lit_compile(&compiler, source_code);
+	bool saved = function != NULL && lit_write_c(&emitter, function, path, !options->strip);
+
+	lit_free_c_emitter(&emitter);
+	lit_free_compiler(&compiler);
+	lit_free_bytecode_objects(&compiler);
+
+	return saved;
+}
+
+bool lit_eval_compiled(const uint8_t* data, size_t size, LitCompiledRegistry* functions) {
+	LitBytecode bytecode = { (uint8_t*) data, size };
+	LitCompiler compiler;
+	LitLibRegistry* std;
+	LitFunction* function = load_bytecode(&compiler, &std, &bytecode);
+
+	if (function == NULL) {
+		fprintf(stderr, "Bytecode error: the program was translated by another version of lit\n");
+		return false;
+	}
+
+	LitArray* constants = &function->chunk.constants;
+
+	for (LitCompiledRegistry* entry = functions; entry->name != NULL; entry++) {
+		LitValue constant = entry->constant < (uint32_t) constants->count ? constants->values[entry->constant] : NIL_VALUE;
+
+		if (IS_FUNCTION(constant) && AS_FUNCTION(constant)->name != NULL && strcmp(AS_FUNCTION(constant)->name->chars, entry->name) == 0) {
+			AS_FUNCTION(constant)->compiled = entry->function;
+		}
+	}
+
+	LitOptions options;
+	lit_init_options(&options);
+
+	return run_function(&compiler, std, function, &options);
+}
+
+bool lit_eval_bytecode(const char* path, LitOptions* options) {
+	LitBytecode bytecode;
+
+	if (!lit_map_bytecode(&bytecode, path, true)) {
+		return false;
+	}
+
+	LitCompiler compiler;
+	LitLibRegistry* std;
+	LitFunction* function = load_bytecode(&compiler, &std, &bytecode);
+	bool result = false;
+
+	if (function == NULL) {
+		fprintf(stderr, "Bytecode error in %s: the file is broken or was written by another version of lit\n", path);
+	} else {
+		result = run_function(&compiler, std, function, options);
+	}
+
+	// The chunks point into the mapping, so it goes away only after the vm
+	lit_unmap_bytecode(&bytecode);
+	return result;
 }
 
 void lit_vm_define_native(LitVm* vm, LitNativeRegistry* native) {
@@ -928,6 +1546,8 @@ LitClass* lit_vm_define_class(LitVm* vm, LitType* type, LitClass* super) {
 		vm->int_class = class;
 	} else if (vm->double_class == NULL && strcmp(type->name->chars, "Double") == 0) {
 		vm->double_class = class;
+	} else if (vm->fiber_class == NULL && strcmp(type->name->chars, "Fiber") == 0) {
+		vm->fiber_class = class;
 	}
 
 	if (super != NULL) {
@@ -409,5 +409,255 @@ def run_suites(names):
   if any_failed:
     sys.exit(1)
 
+def compare_ast(reference, binary):
+  """
+  Runs two builds of lit with --trace-ast over the tests and reports the files,
+  where the parsed trees or the errors differ. Used to check parser changes
+  against a build of the previous parser.
+  """
+
+  paths = []
+  walk(join(REPO_DIR, 'test'), lambda path: paths.append(path) if splitext(path)[1] == '.lit' else None)
+
+  differ = 0
+
+  for path in sorted(paths):
+    outputs = []
+
+    for interpreter in [reference, binary]:
+      proc = Popen([interpreter, '--trace-ast', path], stdin=PIPE, stdout=PIPE, stderr=PIPE)
+      out, err = proc.communicate()
+      outputs.append((proc.returncode, out, err))
+
+    if outputs[0] != outputs[1]:
+      differ += 1
+      print(red('DIFF') + ': ' + relpath(path))
+
+  if differ == 0:
+    print('All ' + green(len(paths)) + ' trees match.')
+  else:
+    print(red(differ) + ' of ' + str(len(paths)) + ' trees differ.')
+    sys.exit(1)
+
+CLI_TESTS = []
+
+class CliContext:
+  def __init__(self, binary, directory, compiler, runtime):
+    self.binary = binary
+    self.directory = directory
+    self.compiler = compiler
+    self.runtime = runtime
+    self.failures = []
+
+  def path(self, name):
+    return join(self.directory, name)
+
+  def write(self, name, source):
+    path = self.path(name)
+
+    with open(path, 'w') as file:
+      file.write(source)
+
+    return path
+
+  def run(self, args, env=None):
+    """Runs lit and returns the exit code, stdout and stderr"""
+
+    environment = dict(os.environ)
+    environment.update(env or {})
+
+    proc = Popen([self.binary] + args, stdin=PIPE, stdout=PIPE, stderr=PIPE, env=environment)
+    out, err = proc.communicate()
+
+    return proc.returncode, out.decode('utf-8'), err.decode('utf-8')
+
+  def expect(self, condition, message, *args):
+    if not condition:
+      self.failures.append(message.format(*args))
+
+
+def cli_test(function):
+  CLI_TESTS.append(function)
+  return function
+
+
+@cli_test
+def inline_arguments(context):
+  """Calls with a variable as the argument are inlined, so they leave the bytecode"""
+
+  source = context.write('inline.lit', 'int twice(int x) {\n\treturn x * 2\n}\n\nvar a = 3\nvar b = 0\n' +
+    'b += twice(a)\n' * 30 + 'print(b)\n')
+
+  context.run(['-c', context.path('inlined.litc'), source])
+  context.run(['--inline-limit', '0', '-c', context.path('called.litc'), source])
+
+  inlined = os.path.getsize(context.path('inlined.litc'))
+  called = os.path.getsize(context.path('called.litc'))
+  context.expect(inlined < called, 'Expected the inlined file ({0} bytes) to be smaller than the called one ({1} bytes).', inlined, called)
+
+  for name in ['inlined.litc', 'called.litc']:
+    code, out, err = context.run([context.path(name)])
+    context.expect(out == '180\n', 'Expected "180" from {0} and got "{1}".', name, out.strip())
+
+
+@cli_test
+def compiled_file(context):
+  """A file, saved with -c, runs without the source and prints the same"""
+
+  source = context.write('compiled.lit', 'class Greeter {\n\tpublic var name = "lit"\n}\n\n' +
+    'int add(int a, int b) {\n\treturn a + b\n}\n\nprint(add(2, 3))\nprint(Greeter().name)\n')
+
+  code, out, err = context.run(['-c', context.path('compiled.litc'), source])
+  context.expect(code == 0 and out == '' and err == '', 'Expected -c to only save the file and got "{0}{1}".', out, err)
+
+  os.remove(source)
+  code, out, err = context.run([context.path('compiled.litc')])
+  context.expect(out == '5\nlit\n', 'Expected "5 lit" from the compiled file and got "{0}{1}".', out, err)
+
+
+@cli_test
+def cache(context):
+  """The second run loads the cached bytecode, broken entries and failed saves are compiled again without errors"""
+
+  source = context.write('cached.lit', 'print(6 * 7)\n')
+  cache = context.path('cache')
+  runs = []
+
+  def run(directory):
+    code, out, err = context.run(['--stats', '--cache', directory, source])
+    context.expect(out == '42\n', 'Expected "42" from run {0} and got "{1}".', len(runs) + 1, out.strip())
+    runs.append(err.split(' ')[:2])
+
+  run(cache)
+  run(cache)
+
+  entries = os.listdir(cache)
+  context.expect(len(entries) == 1, 'Expected one cache entry and got {0}.', entries)
+
+  for entry in entries:
+    with open(join(cache, entry), 'w') as file:
+      file.write('broken')
+
+  run(cache)
+  run(cache)
+
+  code, out, err = context.run(['--cache', join(source, 'nope'), source])
+  context.expect(out == '42\n' and err == '', 'Expected a cache, that can not be written, to be ignored and got "{0}{1}".', out, err)
+
+  expected = [['Cache', 'miss'], ['Cache', 'hit'], ['Cache', 'miss'], ['Cache', 'hit']]
+  context.expect(runs == expected, 'Expected miss, hit, miss for the broken entry, hit and got {0}.', runs)
+
+
+@cli_test
+def compiled_lines(context):
+  """Runtime errors in a .litc file point at the source lines, files saved with --strip have no lines"""
+
+  source = context.write('lines.lit', 'int deep(int n) {\n\treturn deep(n + 1) + 1\n}\n\nprint(1)\ndeep(0)\n')
+
+  context.run(['-c', context.path('lines.litc'), source])
+  context.run(['--strip', '-c', context.path('stripped.litc'), source])
+
+  for name, lines in [('lines.litc', ['deep():2', '$main():6']), ('stripped.litc', ['deep():0', '$main():0'])]:
+    code, out, err = context.run([context.path(name)])
+    trace = [line.strip() for line in err.split('\n')]
+
+    context.expect('Runtime error: Stack overflow' in trace, 'Expected a stack overflow from {0} and got "{1}".', name, err[:200])
+
+    for line in lines:
+      context.expect('at ' + line in trace, 'Expected "at {0}" in the trace of {1}.', line, name)
+
+
+@cli_test
+def emit_c(context):
+  """A program, translated with --emit-c and built with the runtime, prints the same, as in the interpreter, ints and doubles included"""
+
+  if context.compiler is None:
+    return
+
+  source = context.write('numbers.lit', 'int fib(int n) {\n\treturn if (n < 2) n else fib(n - 1) + fib(n - 2)\n}\n\n' +
+    'double half(double x) {\n\treturn x / 2\n}\n\nprint(fib(20))\nprint(half(fib(10)))\n' +
+    'print(fib(20).getClass())\nprint(half(8).getClass())\nprint("done")\n')
+
+  code, expected, err = context.run(['--no-cache', source])
+  context.run(['--emit-c', context.path('numbers.c'), source])
+
+  with open(context.path('numbers.c')) as file:
+    translated = file.read()
+
+  context.expect('lit_fib_0(' in translated, 'Expected fib to be translated to c.')
+
+  proc = Popen([context.compiler, '-O2', '-I' + join(REPO_DIR, 'include'), context.path('numbers.c'), context.runtime, '-lm', '-o', context.path('numbers')], stdout=PIPE, stderr=PIPE)
+  out, err = proc.communicate()
+  context.expect(proc.returncode == 0, 'Expected the translated file to build and got "{0}".', err.decode('utf-8'))
+
+  if proc.returncode == 0:
+    proc = Popen([context.path('numbers')], stdout=PIPE, stderr=PIPE)
+    out, err = proc.communicate()
+    context.expect(out.decode('utf-8') == expected, 'Expected "{0}" from the translated program and got "{1}".', expected, out.decode('utf-8'))
+
+
+@cli_test
+def profile(context):
+  """--profile writes the type feedback into the file, the next run adds its counts to it"""
+
+  source = context.write('profiled.lit', 'var s = 0\nvar i = 0\n\nwhile (i < 50) {\n\ts += i\n\ti++\n}\n\nprint(s)\n')
+  path = context.path('profiled.profile')
+  counts = []
+
+  for run in range(2):
+    code, out, err = context.run(['--no-cache', '--profile', path, source])
+    context.expect(out == '1225\n', 'Expected "1225" from run {0} and got "{1}".', run + 1, out.strip())
+
+    if not os.path.exists(path):
+      context.expect(False, 'Expected run {0} to write the profile.', run + 1)
+      return
+
+    with open(path) as file:
+      # The taken and not taken counts of the loop condition
+      counts.append([line.split()[3:5] for line in file if 'JUMP_IF_FALSE' in line])
+
+  context.expect(counts[0] == [['1', '50']], 'Expected the branch counts 1 and 50 and got {0}.', counts[0])
+  context.expect(counts[1] == [['2', '100']], 'Expected the second run to add its counts and got {0}.', counts[1])
+
+
+def run_cli_tests(binary, compiler=None, runtime=None):
+  """
+  Runs the tests of the command line, that need more than one run of lit, every test gets its own directory
+  The c compiler and the lit_runtime library are needed only to build the output of --emit-c
+  """
+
+  from shutil import rmtree
+  from tempfile import mkdtemp
+
+  failed = 0
+
+  for test in CLI_TESTS:
+    context = CliContext(abspath(binary), mkdtemp(prefix='lit-test-'), compiler, runtime)
+
+    try:
+      test(context)
+    finally:
+      rmtree(context.directory)
+
+    if context.failures:
+      failed += 1
+      print(red('FAIL') + ': ' + test.__name__)
+
+      for failure in context.failures:
+        print('      ' + pink(failure))
+
+  if failed == 0:
+    print('All ' + green(len(CLI_TESTS)) + ' command line tests passed.')
+  else:
+    print(green(len(CLI_TESTS) - failed) + ' tests passed. ' + red(failed) + ' tests failed.')
+    sys.exit(1)
+
 if __name__ == '__main__':
-  run_suites(C_SUITES)
+  if len(sys.argv) == 4 and sys.argv[1] == '--compare-ast':
+    compare_ast(sys.argv[2], sys.argv[3])
+  elif len(sys.argv) == 3 and sys.argv[1] == '--cli':
+    run_cli_tests(sys.argv[2])
+  elif len(sys.argv) == 5 and sys.argv[1] == '--cli':
+    run_cli_tests(sys.argv[2], sys.argv[3], sys.argv[4])
+  else:
+    run_suites(C_SUITES)
@@ -0,0 +1,148 @@
+#define _DEFAULT_SOURCE // fileno() and sysconf() under -std=c99
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <lit.h>
+
+/*
+ * Runs independent programs on many threads at once, every thread has its own compiler and vm
+ * The program calls natives, inits, super methods and gets hot enough for the jit,
+ * so it goes through everything, that used to be process global
+ * Each run prints the same lines, so the output has to be every line once per run
+ */
+
+#define RUNS 16 // Per thread
+
+static const char* program =
+	"class Counter {\n"
+	"\tpublic var count = 0\n"
+	"\n"
+	"\tvoid init() {\n"
+	"\t\tthis.count = 1\n"
+	"\t}\n"
+	"\n"
+	"\tvoid add(int n) {\n"
+	"\t\tthis.count = this.count + n\n"
+	"\t}\n"
+	"}\n"
+	"\n"
+	"class Twice < Counter {\n"
+	"\toverride void add(int n) {\n"
+	"\t\tsuper.add(n * 2)\n"
+	"\t}\n"
+	"}\n"
+	"\n"
+	"int fib(int n) {\n"
+	"\tif (n < 2) {\n"
+	"\t\treturn n\n"
+	"\t}\n"
+	"\n"
+	"\treturn fib(n - 1) + fib(n - 2)\n"
+	"}\n"
+	"\n"
+	"var counter = Twice()\n"
+	"var i = 0\n"
+	"\n"
+	"while (i < 1000) {\n"
+	"\tcounter.add(i)\n"
+	"\ti = i + 1\n"
+	"}\n"
+	"\n"
+	"print(counter.count)\n"
+	"print(fib(20))\n"
+	"print(i / 16)\n"
+	"print(\"done\")\n";
+
+static const char* expected[] = { "999001", "6765", "62.5", "done" };
+
+static void* run_programs(void* data) {
+	int* failed = (int*) data;
+
+	for (int i = 0; i < RUNS; i++) {
+		if (!lit_eval(program)) {
+			(*failed)++;
+		}
+	}
+
+	return NULL;
+}
+
+int main(int argc, char** argv) {
+	int thread_count = argc > 1 ? atoi(argv[1]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (thread_count < 4) {
+		thread_count = 4;
+	}
+
+	// The output of all threads goes into a file, it is counted, once they are done
+	FILE* output = tmpfile();
+	int terminal = dup(fileno(stdout));
+
+	if (output == NULL || terminal < 0) {
+		fprintf(stderr, "Could not redirect the output\n");
+		return 1;
+	}
+
+	fflush(stdout);
+	dup2(fileno(output), fileno(stdout));
+
+	pthread_t threads[thread_count];
+	int failed[thread_count];
+
+	for (int i = 0; i < thread_count; i++) {
+		failed[i] = 0;
+		pthread_create(&threads[i], NULL, run_programs, &failed[i]);
+	}
+
+	int failed_runs = 0;
+
+	for (int i = 0; i < thread_count; i++) {
+		pthread_join(threads[i], NULL);
+		failed_runs += failed[i];
+	}
+
+	fflush(stdout);
+	dup2(terminal, fileno(stdout));
+	rewind(output);
+
+	size_t expected_count = sizeof(expected) / sizeof(expected[0]);
+	int counts[expected_count];
+	int unexpected = 0;
+	char line[256];
+
+	memset(counts, 0, sizeof(counts));
+
+	while (fgets(line, sizeof(line), output) != NULL) {
+		line[strcspn(line, "\n")] = '\0';
+		bool found = false;
+
+		for (size_t i = 0; i < expected_count && !found; i++) {
+			if (strcmp(line, expected[i]) == 0) {
+				counts[i]++;
+				found = true;
+			}
+		}
+
+		if (!found) {
+			printf("Unexpected output: %s\n", line);
+			unexpected++;
+		}
+	}
+
+	fclose(output);
+	int runs = thread_count * RUNS;
+	bool passed = failed_runs == 0 && unexpected == 0;
+
+	for (size_t i = 0; i < expected_count; i++) {
+		if (counts[i] != runs) {
+			printf("Expected %s %d times, got it %d times\n", expected[i], runs, counts[i]);
+			passed = false;
+		}
+	}
+
+	printf("%d runs on %d threads, %d failed: %s\n", runs, thread_count, failed_runs, passed ? "passed" : "FAILED");
+	return passed ? 0 : 1;
+}
\ No newline at end of file